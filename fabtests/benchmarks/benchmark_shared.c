@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #include <rdma/fi_errno.h>
 
@@ -47,6 +48,17 @@
  */
 static int inject_size_set;
 
+/*
+ * With -L, pingpong() times every iteration and reports latency
+ * percentiles for each message size.  With -O, the client also writes
+ * the samples to a CSV file.  Samples are one way latencies, half of
+ * each round trip, in line with the reported usec/xfer.
+ */
+static int lat_stats;
+static char *lat_csv;
+static uint64_t *lat_samples;
+static uint64_t lat_prev;
+
 void ft_parse_benchmark_opts(int op, char *optarg)
 {
 	switch (op) {
@@ -63,6 +75,13 @@ void ft_parse_benchmark_opts(int op, char *optarg)
 	case 'W':
 		opts.window_size = atoi(optarg);
 		break;
+	case 'L':
+		lat_stats = 1;
+		break;
+	case 'O':
+		lat_stats = 1;
+		lat_csv = optarg;
+		break;
 	default:
 		break;
 	}
@@ -77,6 +96,95 @@ void ft_benchmark_usage(void)
 			"* The following condition is required to have at least "
 			"one window\nsize # of messsages to be sent: "
 			"# of iterations > window size");
+	FT_PRINT_OPTS_USAGE("-L", "report latency percentiles (for latency tests)");
+	FT_PRINT_OPTS_USAGE("-O <file>", "also write latency samples to a CSV "
+			    "file (client only)");
+}
+
+/* Stores the time since the previous call, from the first timed iteration */
+static void lat_sample(int i)
+{
+	uint64_t now;
+
+	if (!lat_samples)
+		return;
+
+	now = ft_gettime_ns();
+	if (i > opts.warmup_iterations)
+		lat_samples[i - opts.warmup_iterations - 1] = now - lat_prev;
+	lat_prev = now;
+}
+
+static int lat_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest rank per mille of the sorted samples, in usec per transfer */
+static double lat_pct(uint64_t permille)
+{
+	uint64_t rank;
+
+	rank = (permille * opts.iterations + 999) / 1000;
+	return lat_samples[rank ? rank - 1 : 0] / 2000.0;
+}
+
+static int lat_write_csv(void)
+{
+	static int header = 1;
+	FILE *file;
+	int i;
+
+	file = fopen(lat_csv, header ? "w" : "a");
+	if (!file) {
+		FT_PRINTERR("fopen", -errno);
+		return -errno;
+	}
+
+	if (header) {
+		fprintf(file, "bytes,iteration,usec\n");
+		header = 0;
+	}
+	for (i = 0; i < opts.iterations; i++)
+		fprintf(file, "%zu,%d,%.3f\n", opts.transfer_size, i,
+			lat_samples[i] / 2000.0);
+
+	fclose(file);
+	return 0;
+}
+
+static int show_lat(void)
+{
+	static int header = 1;
+	int ret;
+
+	if (lat_csv && opts.dst_addr) {
+		ret = lat_write_csv();
+		if (ret)
+			return ret;
+	}
+
+	qsort(lat_samples, opts.iterations, sizeof(*lat_samples), lat_cmp);
+	if (opts.machr) {
+		printf("- { xfer_size: %zu, usec_min: %f, usec_p50: %f, "
+		       "usec_p90: %f, usec_p99: %f, usec_p99.9: %f, "
+		       "usec_max: %f }\n", opts.transfer_size, lat_pct(0),
+		       lat_pct(500), lat_pct(900), lat_pct(990), lat_pct(999),
+		       lat_pct(1000));
+		return 0;
+	}
+
+	if (header) {
+		printf("%-8s%10s%10s%10s%10s%10s%10s  (usec/xfer)\n", "bytes",
+		       "min", "p50", "p90", "p99", "p99.9", "max");
+		header = 0;
+	}
+	printf("%-8zu%10.2f%10.2f%10.2f%10.2f%10.2f%10.2f\n",
+	       opts.transfer_size, lat_pct(0), lat_pct(500), lat_pct(900),
+	       lat_pct(990), lat_pct(999), lat_pct(1000));
+	return 0;
 }
 
 int pingpong(void)
@@ -89,43 +197,52 @@ int pingpong(void)
 	if (opts.options & FT_OPT_ENABLE_HMEM)
 		inject_size = 0;
 
+	if (lat_stats && opts.iterations > 0) {
+		lat_samples = calloc(opts.iterations, sizeof(*lat_samples));
+		if (!lat_samples)
+			return -FI_ENOMEM;
+	}
+
 	ret = ft_sync();
 	if (ret)
-		return ret;
+		goto out;
 
 	if (opts.dst_addr) {
 		for (i = 0; i < opts.iterations + opts.warmup_iterations; i++) {
 			if (i == opts.warmup_iterations)
 				ft_start();
+			lat_sample(i);
 
 			if (opts.transfer_size < inject_size)
 				ret = ft_inject(ep, remote_fi_addr, opts.transfer_size);
 			else
 				ret = ft_tx(ep, remote_fi_addr, opts.transfer_size, &tx_ctx);
 			if (ret)
-				return ret;
+				goto out;
 
 			ret = ft_rx(ep, opts.transfer_size);
 			if (ret)
-				return ret;
+				goto out;
 		}
 	} else {
 		for (i = 0; i < opts.iterations + opts.warmup_iterations; i++) {
 			if (i == opts.warmup_iterations)
 				ft_start();
+			lat_sample(i);
 
 			ret = ft_rx(ep, opts.transfer_size);
 			if (ret)
-				return ret;
+				goto out;
 
 			if (opts.transfer_size < inject_size)
 				ret = ft_inject(ep, remote_fi_addr, opts.transfer_size);
 			else
 				ret = ft_tx(ep, remote_fi_addr, opts.transfer_size, &tx_ctx);
 			if (ret)
-				return ret;
+				goto out;
 		}
 	}
+	lat_sample(i);
 	ft_stop();
 
 	if (opts.machr)
@@ -134,7 +251,12 @@ int pingpong(void)
 	else
 		show_perf(NULL, opts.transfer_size, opts.iterations, &start, &end, 2);
 
-	return 0;
+	if (lat_samples)
+		ret = show_lat();
+out:
+	free(lat_samples);
+	lat_samples = NULL;
+	return ret;
 }
 
 static int bw_tx_comp()
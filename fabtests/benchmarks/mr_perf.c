@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2024 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Memory registration benchmark.  Each thread maps a set of regions and
+ * measures, through fi_mr_reg and fi_close:
+ * - miss: the first registration of every region
+ * - hit: registering the regions again, which providers with an MR cache
+ *   serve from the cache
+ * - unmap: munmap of a registered mapping, which drives the memory
+ *   monitor to invalidate the cached entries, next to the cost of
+ *   unmapping a mapping that was never registered
+ * - rereg: registering a region again after its memory was replaced
+ * Regions are either separate mappings, overlap each other by half, or
+ * are the same region every time.  The memory monitor used by the cache
+ * can be chosen with -m, which sets FI_MR_CACHE_MONITOR.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_domain.h>
+
+#include <shared.h>
+
+#define PERF_REGIONS	16
+#define PERF_ALIGN(size) (((size) + page_size - 1) / page_size * page_size)
+
+enum perf_pattern {
+	PERF_DISJOINT,
+	PERF_OVERLAP,
+	PERF_SAME,
+	PERF_PATTERN_MAX,
+};
+
+static const char *perf_pattern_name[PERF_PATTERN_MAX] = {
+	"disjoint",
+	"overlap",
+	"same",
+};
+
+enum {
+	PERF_MISS,
+	PERF_HIT,
+	PERF_UNMAP,
+	PERF_BASE_UNMAP,
+	PERF_REREG,
+	PERF_PHASE_MAX,
+};
+
+struct perf_thread {
+	pthread_t thread;
+	int id;
+	int ret;
+	uint64_t key;
+	size_t map_size;
+	size_t map_cnt;
+	char *map[PERF_REGIONS];
+	uint64_t ns[PERF_PHASE_MAX];
+	uint64_t cnt[PERF_PHASE_MAX];
+};
+
+static int thread_cnt = 1;
+static enum perf_pattern pattern;
+static size_t page_size;
+static size_t cur_size;
+static struct perf_thread *threads;
+
+static char *perf_region(struct perf_thread *pt, int i)
+{
+	switch (pattern) {
+	case PERF_DISJOINT:
+		return pt->map[i];
+	case PERF_OVERLAP:
+		return pt->map[0] + i * (cur_size / 2);
+	default:
+		return pt->map[0];
+	}
+}
+
+static int perf_map(struct perf_thread *pt)
+{
+	size_t size = PERF_ALIGN(cur_size);
+	size_t i;
+
+	switch (pattern) {
+	case PERF_DISJOINT:
+		pt->map_cnt = PERF_REGIONS;
+		pt->map_size = size;
+		break;
+	case PERF_OVERLAP:
+		pt->map_cnt = 1;
+		pt->map_size = PERF_ALIGN(cur_size +
+					  (PERF_REGIONS - 1) * (cur_size / 2));
+		break;
+	default:
+		pt->map_cnt = 1;
+		pt->map_size = size;
+		break;
+	}
+
+	for (i = 0; i < pt->map_cnt; i++) {
+		pt->map[i] = mmap(NULL, pt->map_size, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pt->map[i] == MAP_FAILED) {
+			pt->map[i] = NULL;
+			return -FI_ENOMEM;
+		}
+		memset(pt->map[i], 0, pt->map_size);
+	}
+	return 0;
+}
+
+static void perf_unmap(struct perf_thread *pt)
+{
+	size_t i;
+
+	for (i = 0; i < pt->map_cnt; i++) {
+		if (pt->map[i])
+			munmap(pt->map[i], pt->map_size);
+		pt->map[i] = NULL;
+	}
+}
+
+static int perf_reg(struct perf_thread *pt, void *buf, int phase)
+{
+	struct fid_mr *mr;
+	uint64_t start;
+	int ret;
+
+	start = ft_gettime_ns();
+	ret = fi_mr_reg(domain, buf, cur_size, ft_info_to_mr_access(fi), 0,
+			pt->key++, 0, &mr, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_mr_reg", ret);
+		return ret;
+	}
+
+	ret = fi_close(&mr->fid);
+	pt->ns[phase] += ft_gettime_ns() - start;
+	pt->cnt[phase]++;
+	if (ret)
+		FT_PRINTERR("fi_close", ret);
+	return ret;
+}
+
+static int perf_unmap_timed(struct perf_thread *pt, int phase)
+{
+	uint64_t start;
+	size_t i;
+
+	for (i = 0; i < pt->map_cnt; i++) {
+		start = ft_gettime_ns();
+		munmap(pt->map[i], pt->map_size);
+		pt->ns[phase] += ft_gettime_ns() - start;
+		pt->cnt[phase]++;
+		pt->map[i] = NULL;
+	}
+	return perf_map(pt);
+}
+
+static int perf_run_thread(struct perf_thread *pt)
+{
+	int i, ret;
+
+	ret = perf_map(pt);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < PERF_REGIONS; i++) {
+		ret = perf_reg(pt, perf_region(pt, i), PERF_MISS);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < opts.iterations; i++) {
+		ret = perf_reg(pt, perf_region(pt, i % PERF_REGIONS), PERF_HIT);
+		if (ret)
+			return ret;
+	}
+
+	ret = perf_unmap_timed(pt, PERF_UNMAP);
+	if (ret)
+		return ret;
+
+	/* the mappings that replaced them have never been registered */
+	ret = perf_unmap_timed(pt, PERF_BASE_UNMAP);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < PERF_REGIONS; i++) {
+		ret = perf_reg(pt, perf_region(pt, i), PERF_REREG);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void *perf_thread(void *arg)
+{
+	struct perf_thread *pt = arg;
+
+	pt->ret = perf_run_thread(pt);
+	perf_unmap(pt);
+	return NULL;
+}
+
+static double perf_usec(int phase)
+{
+	uint64_t ns = 0, cnt = 0;
+	int i;
+
+	for (i = 0; i < thread_cnt; i++) {
+		ns += threads[i].ns[phase];
+		cnt += threads[i].cnt[phase];
+	}
+	return cnt ? ns / 1000.0 / cnt : 0;
+}
+
+/* Registrations per second summed over the threads, from the hit phase */
+static double perf_rate(void)
+{
+	double rate = 0;
+	int i;
+
+	for (i = 0; i < thread_cnt; i++) {
+		if (threads[i].ns[PERF_HIT])
+			rate += threads[i].cnt[PERF_HIT] * 1000000000.0 /
+				threads[i].ns[PERF_HIT];
+	}
+	return rate;
+}
+
+static int perf_run_size(size_t size)
+{
+	int i, ret = 0;
+
+	cur_size = size;
+	memset(threads, 0, sizeof(*threads) * thread_cnt);
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].id = i;
+		threads[i].key = ((uint64_t) i << 32) + FT_MR_KEY + 1;
+		ret = pthread_create(&threads[i].thread, NULL, perf_thread,
+				     &threads[i]);
+		if (ret) {
+			FT_PRINTERR("pthread_create", -ret);
+			thread_cnt = i;
+			ret = -ret;
+			break;
+		}
+	}
+
+	for (i = 0; i < thread_cnt; i++) {
+		pthread_join(threads[i].thread, NULL);
+		if (threads[i].ret)
+			ret = threads[i].ret;
+	}
+	if (ret)
+		return ret;
+
+	printf("%-10zu %-8d %10.2f %10.2f %10.2f %10.2f %10.2f %12.0f\n",
+	       size, thread_cnt, perf_usec(PERF_MISS), perf_usec(PERF_HIT),
+	       perf_usec(PERF_UNMAP), perf_usec(PERF_BASE_UNMAP),
+	       perf_usec(PERF_REREG), perf_rate());
+	return 0;
+}
+
+static int run(void)
+{
+	const char *monitor = getenv("FI_MR_CACHE_MONITOR");
+	int i, ret;
+
+	ret = ft_getinfo(hints, &fi);
+	if (ret)
+		return ret;
+
+	ret = ft_open_fabric_res();
+	if (ret)
+		return ret;
+
+	threads = calloc(thread_cnt, sizeof(*threads));
+	if (!threads)
+		return -FI_ENOMEM;
+
+	printf("# provider: %s, domain: %s, monitor: %s, pattern: %s\n",
+	       fi->fabric_attr->prov_name, fi->domain_attr->name,
+	       monitor ? monitor : "default", perf_pattern_name[pattern]);
+	printf("%-10s %-8s %10s %10s %10s %10s %10s %12s\n", "bytes",
+	       "threads", "miss_usec", "hit_usec", "unmap_usec",
+	       "base_usec", "rereg_usec", "regs/sec");
+
+	if (opts.options & FT_OPT_SIZE)
+		return perf_run_size(opts.transfer_size);
+
+	for (i = 0; i < TEST_CNT; i++) {
+		if (!ft_use_size(i, opts.sizes_enabled))
+			continue;
+
+		ret = perf_run_size(test_size[i].size);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "  %s [OPTIONS]\n", name);
+	fprintf(stderr, "\nMemory registration and MR cache benchmark.\n");
+	fprintf(stderr, "\nOptions:\n");
+	FT_PRINT_OPTS_USAGE("-f <fabric>", "fabric name");
+	FT_PRINT_OPTS_USAGE("-d <domain>", "domain name");
+	FT_PRINT_OPTS_USAGE("-p <provider>", "specific provider name eg "
+			    "verbs, efa");
+	FT_PRINT_OPTS_USAGE("-S <size>", "region size, or 'all' to sweep "
+			    "all sizes (default: sweep common sizes)");
+	FT_PRINT_OPTS_USAGE("-I <number>", "cached registrations per thread "
+			    "(default 1000)");
+	FT_PRINT_OPTS_USAGE("-T <threads>", "threads registering in "
+			    "parallel (default 1)");
+	FT_PRINT_OPTS_USAGE("-o <pattern>", "regions are disjoint, overlap "
+			    "or same (default disjoint)");
+	FT_PRINT_OPTS_USAGE("-m <monitor>", "MR cache monitor: userfaultfd, "
+			    "memhooks or disabled");
+	FT_PRINT_OPTS_USAGE("-h", "display this help output");
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	page_size = sysconf(_SC_PAGESIZE);
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "S:I:T:o:m:h" INFO_OPTS)) != -1) {
+		switch (op) {
+		default:
+			ft_parseinfo(op, optarg, hints, &opts);
+			break;
+		case 'S':
+			if (!strncasecmp("all", optarg, 3)) {
+				opts.sizes_enabled = FT_ENABLE_SIZES;
+			} else {
+				opts.options |= FT_OPT_SIZE;
+				opts.transfer_size = atol(optarg);
+			}
+			break;
+		case 'I':
+			opts.iterations = atoi(optarg);
+			break;
+		case 'T':
+			thread_cnt = atoi(optarg);
+			break;
+		case 'o':
+			for (pattern = 0; pattern < PERF_PATTERN_MAX; pattern++) {
+				if (!strcasecmp(optarg,
+						perf_pattern_name[pattern]))
+					break;
+			}
+			break;
+		case 'm':
+			setenv("FI_MR_CACHE_MONITOR", optarg, 1);
+			break;
+		case '?':
+		case 'h':
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (thread_cnt < 1 || opts.iterations < 1 ||
+	    pattern == PERF_PATTERN_MAX ||
+	    (ft_check_opts(FT_OPT_SIZE) && !opts.transfer_size)) {
+		fprintf(stderr, "Invalid threads, iterations, pattern or "
+			"size\n");
+		return EXIT_FAILURE;
+	}
+
+	hints->caps = FI_MSG | FI_RMA;
+	hints->mode = ~0;
+	hints->domain_attr->mode = ~0;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->domain_attr->threading = thread_cnt > 1 ?
+					FI_THREAD_SAFE : FI_THREAD_DOMAIN;
+
+	ret = run();
+
+	free(threads);
+	ft_free_res();
+	return ft_exit_code(ret);
+}
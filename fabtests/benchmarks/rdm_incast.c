@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2026 The libfabric contributors.  All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Many-to-one (incast) benchmark.  A single process opens one receiving
+ * endpoint and N sending endpoints, and every sender streams messages to
+ * the receiver at the same time, keeping a window of sends outstanding.
+ * The goodput is measured at the receiver, from the first send until the
+ * last message has arrived.
+ *
+ * Providers that retransmit packets themselves (rxd) export how many
+ * packets they sent and resent as the tx_pkts and retrans_pkts metrics.
+ * The benchmark enables FI_METRICS unless it is set, reads its own
+ * metric segments around the timed phase and reports the retransmit
+ * ratio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <rdma/fi_cm.h>
+#include <rdma/fi_errno.h>
+
+#include <shared.h>
+
+#define INCAST_CQ_BATCH	16
+
+/* Layout of the segments that FI_METRICS exports, see fi_top(1) */
+#define INCAST_METRICS_DIR	"/dev/shm"
+#define INCAST_METRICS_PREFIX	"fi_metrics."
+#define INCAST_METRICS_MAGIC	0x5343495254454d46ULL
+#define INCAST_METRICS_VERSION	1
+
+struct incast_metrics_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	slot_size;
+	uint32_t	slot_cnt;
+	uint32_t	pid;
+	uint32_t	used;
+	uint8_t		resv[36];
+};
+
+struct incast_metrics_slot {
+	uint64_t	value;
+	uint32_t	gen;
+	uint16_t	type;
+	uint16_t	resv;
+	char		name[48];
+};
+
+struct incast_pkts {
+	uint64_t	tx;
+	uint64_t	retrans;
+	bool		found;
+};
+
+static int sender_cnt = 8;
+static int window = 8;
+static struct fid_ep **sender_eps;
+static struct fid_cq *sender_cq;
+static struct fid_mr *incast_mr;
+static void *incast_desc;
+static char *incast_buf;
+static fi_addr_t recv_addr;
+static struct fi_context2 *send_ctx, *recv_ctx;
+/* per sender: messages posted, sends outstanding and free tx contexts */
+static int *posted, *inflight, *free_ctx;
+static int rx_cnt;
+
+static void incast_add_metric(struct incast_pkts *pkts, const char *name,
+			      uint64_t value)
+{
+	const char *metric = strchr(name, '/');
+
+	if (!metric)
+		return;
+
+	if (!strcmp(metric, "/tx_pkts")) {
+		pkts->tx += value;
+		pkts->found = true;
+	} else if (!strcmp(metric, "/retrans_pkts")) {
+		pkts->retrans += value;
+	}
+}
+
+static void incast_read_seg(struct incast_pkts *pkts, const char *name)
+{
+	const struct incast_metrics_slot *slot;
+	const struct incast_metrics_hdr *hdr;
+	char path[PATH_MAX];
+	struct stat st;
+	uint32_t i;
+	void *seg;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", INCAST_METRICS_DIR, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return;
+	}
+
+	seg = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (seg == MAP_FAILED)
+		return;
+
+	hdr = seg;
+	if (hdr->magic != INCAST_METRICS_MAGIC ||
+	    hdr->version != INCAST_METRICS_VERSION ||
+	    hdr->slot_size < sizeof(*slot) ||
+	    sizeof(*hdr) + (size_t) hdr->used * hdr->slot_size > st.st_size)
+		goto out;
+
+	for (i = 0; i < hdr->used; i++) {
+		slot = (const void *) ((const char *) (hdr + 1) +
+				       (size_t) i * hdr->slot_size);
+		if (slot->gen & 1)
+			incast_add_metric(pkts, slot->name, slot->value);
+	}
+out:
+	munmap(seg, st.st_size);
+}
+
+/* Sum the packet counters of every metric segment of this process */
+static void incast_read_pkts(struct incast_pkts *pkts)
+{
+	char prefix[64];
+	struct dirent *entry;
+	DIR *dir;
+
+	memset(pkts, 0, sizeof(*pkts));
+	snprintf(prefix, sizeof(prefix), INCAST_METRICS_PREFIX "%d.",
+		 (int) getpid());
+
+	dir = opendir(INCAST_METRICS_DIR);
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir))) {
+		if (!strncmp(entry->d_name, prefix, strlen(prefix)))
+			incast_read_seg(pkts, entry->d_name);
+	}
+	closedir(dir);
+}
+
+/*
+ * Socket addresses keep their host with the port cleared, so that each
+ * sender gets its own port.  Wildcard hosts and other formats are
+ * dropped, leaving the choice of address to the provider.
+ */
+static void incast_clear_port(struct fi_info *info)
+{
+	struct sockaddr_in6 *sin6 = info->src_addr;
+	struct sockaddr_in *sin = info->src_addr;
+
+	if (info->src_addr && info->src_addrlen >= sizeof(*sin)) {
+		if (sin->sin_family == AF_INET &&
+		    sin->sin_addr.s_addr != htonl(INADDR_ANY)) {
+			sin->sin_port = 0;
+			return;
+		}
+		if (sin6->sin6_family == AF_INET6 &&
+		    info->src_addrlen >= sizeof(*sin6) &&
+		    !IN6_IS_ADDR_UNSPECIFIED(&sin6->sin6_addr)) {
+			sin6->sin6_port = 0;
+			return;
+		}
+	}
+
+	free(info->src_addr);
+	info->src_addr = NULL;
+	info->src_addrlen = 0;
+}
+
+static int incast_open_senders(void)
+{
+	struct fi_info *info = NULL, *ep_hints;
+	int i, ret;
+
+	ret = fi_cq_open(domain, &cq_attr, &sender_cq, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_cq_open", ret);
+		return ret;
+	}
+
+	ep_hints = fi_dupinfo(fi);
+	if (!ep_hints)
+		return -FI_ENOMEM;
+
+	free(ep_hints->dest_addr);
+	ep_hints->dest_addr = NULL;
+	ep_hints->dest_addrlen = 0;
+	incast_clear_port(ep_hints);
+
+	ret = fi_getinfo(FT_FIVERSION, NULL, NULL, 0, ep_hints, &info);
+	fi_freeinfo(ep_hints);
+	if (ret) {
+		FT_PRINTERR("fi_getinfo", ret);
+		return ret;
+	}
+
+	sender_eps = calloc(sender_cnt, sizeof(*sender_eps));
+	if (!sender_eps) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < sender_cnt; i++) {
+		ret = fi_endpoint(domain, info, &sender_eps[i], NULL);
+		if (ret) {
+			FT_PRINTERR("fi_endpoint", ret);
+			break;
+		}
+
+		ret = ft_enable_ep(sender_eps[i], NULL, av, sender_cq,
+				   sender_cq, NULL, NULL);
+		if (ret)
+			break;
+	}
+out:
+	fi_freeinfo(info);
+	return ret;
+}
+
+/* Every sender sends to the receiving endpoint, ep */
+static int incast_av_insert(void)
+{
+	char name[FT_MAX_CTRL_MSG];
+	size_t len = sizeof(name);
+	int ret;
+
+	ret = fi_getname(&ep->fid, name, &len);
+	if (ret) {
+		FT_PRINTERR("fi_getname", ret);
+		return ret;
+	}
+
+	ret = fi_av_insert(av, name, 1, &recv_addr, 0, NULL);
+	if (ret != 1) {
+		FT_PRINTERR("fi_av_insert", ret);
+		return ret < 0 ? ret : -FI_EOTHER;
+	}
+
+	return 0;
+}
+
+static int incast_alloc_res(void)
+{
+	size_t size = opts.transfer_size;
+	int i, ctx_cnt = sender_cnt * window;
+	int ret;
+
+	/* one send buffer shared by all senders, then one per receive */
+	incast_buf = calloc(1 + rx_cnt, size);
+	send_ctx = calloc(ctx_cnt, sizeof(*send_ctx));
+	recv_ctx = calloc(rx_cnt, sizeof(*recv_ctx));
+	posted = calloc(sender_cnt, sizeof(*posted));
+	inflight = calloc(sender_cnt, sizeof(*inflight));
+	free_ctx = calloc(ctx_cnt, sizeof(*free_ctx));
+	if (!incast_buf || !send_ctx || !recv_ctx || !posted || !inflight ||
+	    !free_ctx)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < ctx_cnt; i++)
+		free_ctx[i] = i;
+
+	ret = ft_reg_mr(fi, incast_buf, (1 + rx_cnt) * size,
+			ft_info_to_mr_access(fi), FT_MR_KEY + 1,
+			FI_HMEM_SYSTEM, 0, &incast_mr, &incast_desc);
+	if (ret)
+		FT_PRINTERR("ft_reg_mr", ret);
+	return ret;
+}
+
+static int incast_post_recv(int i)
+{
+	size_t size = opts.transfer_size;
+	int ret;
+
+	do {
+		ret = fi_recv(ep, &incast_buf[(1 + i) * size], size,
+			      incast_desc, FI_ADDR_UNSPEC, &recv_ctx[i]);
+		if (ret == -FI_EAGAIN)
+			(void) fi_cq_read(rxcq, NULL, 0);
+	} while (ret == -FI_EAGAIN);
+
+	if (ret)
+		FT_PRINTERR("fi_recv", ret);
+	return ret;
+}
+
+/* Fill the window of every sender that still has messages to send */
+static int incast_post_sends(void)
+{
+	int i, idx, ret;
+
+	for (i = 0; i < sender_cnt; i++) {
+		while (inflight[i] < window && posted[i] < opts.iterations) {
+			idx = free_ctx[i * window + inflight[i]];
+			ret = fi_send(sender_eps[i], incast_buf,
+				      opts.transfer_size, incast_desc,
+				      recv_addr, &send_ctx[idx]);
+			if (ret == -FI_EAGAIN)
+				break;
+			if (ret) {
+				FT_PRINTERR("fi_send", ret);
+				return ret;
+			}
+			inflight[i]++;
+			posted[i]++;
+		}
+	}
+
+	return 0;
+}
+
+static int incast_read_tx(void)
+{
+	struct fi_cq_entry comp[INCAST_CQ_BATCH];
+	int i, idx, sender, ret;
+
+	ret = fi_cq_read(sender_cq, comp, INCAST_CQ_BATCH);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret == -FI_EAVAIL)
+		return ft_cq_readerr(sender_cq);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < ret; i++) {
+		idx = (struct fi_context2 *) comp[i].op_context - send_ctx;
+		sender = idx / window;
+		free_ctx[sender * window + --inflight[sender]] = idx;
+	}
+
+	return 0;
+}
+
+static int incast_read_rx(int *rx_done)
+{
+	struct fi_cq_entry comp[INCAST_CQ_BATCH];
+	int i, cnt, ret;
+
+	cnt = fi_cq_read(rxcq, comp, INCAST_CQ_BATCH);
+	if (cnt == -FI_EAGAIN)
+		return 0;
+	if (cnt == -FI_EAVAIL)
+		return ft_cq_readerr(rxcq);
+	if (cnt < 0)
+		return cnt;
+
+	for (i = 0; i < cnt; i++) {
+		(*rx_done)++;
+		ret = incast_post_recv((struct fi_context2 *)
+				       comp[i].op_context - recv_ctx);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int incast_xfer(void)
+{
+	int i, rx_done = 0, total = sender_cnt * opts.iterations;
+	struct incast_pkts start_pkts, end_pkts;
+	uint64_t start_ns, end_ns, retrans, tx;
+	double usec;
+	int ret;
+
+	for (i = 0; i < rx_cnt; i++) {
+		ret = incast_post_recv(i);
+		if (ret)
+			return ret;
+	}
+
+	incast_read_pkts(&start_pkts);
+	start_ns = ft_gettime_ns();
+	while (rx_done < total) {
+		ret = incast_post_sends();
+		if (!ret)
+			ret = incast_read_tx();
+		if (!ret)
+			ret = incast_read_rx(&rx_done);
+		if (ret)
+			return ret;
+
+		if (timeout >= 0 &&
+		    ft_gettime_ns() - start_ns > timeout * 1000000000ULL) {
+			FT_ERR("timed out: %d of %d messages received\n",
+			       rx_done, total);
+			return -FI_ETIMEDOUT;
+		}
+	}
+	end_ns = ft_gettime_ns();
+	incast_read_pkts(&end_pkts);
+
+	/* let the last send completions arrive before the endpoints close */
+	for (i = 0; i < sender_cnt; i++) {
+		while (inflight[i]) {
+			ret = incast_read_tx();
+			if (ret)
+				return ret;
+		}
+	}
+
+	usec = (end_ns - start_ns) / 1000.0;
+	printf("%-10s %-10s %-10s %-12s %-12s %-12s\n", "senders", "window",
+	       "bytes", "msgs", "usec", "goodput");
+	printf("%-10d %-10d %-10zu %-12d %-12.2f %.2f MB/s\n", sender_cnt,
+	       window, opts.transfer_size, total, usec,
+	       (double) total * opts.transfer_size / usec);
+
+	if (end_pkts.found) {
+		tx = end_pkts.tx - start_pkts.tx;
+		retrans = end_pkts.retrans - start_pkts.retrans;
+		printf("packets sent %" PRIu64 ", retransmitted %" PRIu64
+		       " (%.2f%%)\n", tx, retrans,
+		       tx ? retrans * 100.0 / tx : 0);
+	} else {
+		printf("retransmit ratio not reported by the provider\n");
+	}
+
+	return 0;
+}
+
+static int run(void)
+{
+	int ret;
+
+	ret = ft_getinfo(hints, &fi);
+	if (ret)
+		return ret;
+
+	opts.av_size = sender_cnt + 1;
+	ret = ft_open_fabric_res();
+	if (ret)
+		return ret;
+
+	ret = ft_alloc_active_res(fi);
+	if (ret)
+		return ret;
+
+	ret = ft_enable_ep(ep, eq, av, txcq, rxcq, txcntr, rxcntr);
+	if (ret)
+		return ret;
+
+	ret = incast_open_senders();
+	if (ret)
+		return ret;
+
+	ret = incast_av_insert();
+	if (ret)
+		return ret;
+
+	rx_cnt = MIN(sender_cnt * window, fi->rx_attr->size);
+	ret = incast_alloc_res();
+	if (ret)
+		return ret;
+
+	return incast_xfer();
+}
+
+static void incast_free_res(void)
+{
+	FT_CLOSE_FID(incast_mr);
+	if (sender_eps) {
+		FT_CLOSEV_FID(sender_eps, sender_cnt);
+		free(sender_eps);
+	}
+	FT_CLOSE_FID(sender_cq);
+	free(incast_buf);
+	free(send_ctx);
+	free(recv_ctx);
+	free(posted);
+	free(inflight);
+	free(free_ctx);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "  %s [OPTIONS]\n", name);
+	fprintf(stderr, "\nMany-to-one (incast) benchmark for RDM "
+		"endpoints.\n");
+	fprintf(stderr, "\nOptions:\n");
+	FT_PRINT_OPTS_USAGE("-f <fabric>", "fabric name");
+	FT_PRINT_OPTS_USAGE("-d <domain>", "domain name");
+	FT_PRINT_OPTS_USAGE("-p <provider>", "specific provider name eg "
+			    "udp;ofi_rxd, tcp");
+	FT_PRINT_OPTS_USAGE("-s <address>", "source address, needed by "
+			    "providers that bind to the wildcard address");
+	FT_PRINT_OPTS_USAGE("-n <senders>", "number of sending endpoints "
+			    "(default 8)");
+	FT_PRINT_OPTS_USAGE("-W <window>", "sends outstanding per sender "
+			    "(default 8)");
+	FT_PRINT_OPTS_USAGE("-I <count>", "messages per sender "
+			    "(default 1000)");
+	FT_PRINT_OPTS_USAGE("-S <size>", "message size (default 4096)");
+	FT_PRINT_OPTS_USAGE("-T <timeout>", "seconds to wait for the "
+			    "messages");
+	FT_PRINT_OPTS_USAGE("-h", "display this help output");
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	opts.options |= FT_OPT_SIZE;
+	opts.transfer_size = 4096;
+	opts.iterations = 1000;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "n:W:I:S:T:h" ADDR_OPTS
+			    INFO_OPTS)) != -1) {
+		switch (op) {
+		default:
+			ft_parse_addr_opts(op, optarg, &opts);
+			ft_parseinfo(op, optarg, hints, &opts);
+			break;
+		case 'n':
+			sender_cnt = atoi(optarg);
+			break;
+		case 'W':
+			window = atoi(optarg);
+			break;
+		case 'I':
+			opts.iterations = atoi(optarg);
+			break;
+		case 'S':
+			opts.transfer_size = atol(optarg);
+			break;
+		case 'T':
+			timeout = atoi(optarg);
+			break;
+		case '?':
+		case 'h':
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (sender_cnt < 1 || window < 1 || opts.iterations < 1 ||
+	    !opts.transfer_size) {
+		fprintf(stderr, "Invalid sender count, window, message count "
+			"or size\n");
+		return EXIT_FAILURE;
+	}
+
+	/* the packet counters are only exported with metrics enabled */
+	setenv("FI_METRICS", "1", 0);
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->caps = FI_MSG;
+	hints->mode |= FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->domain_attr->threading = FI_THREAD_DOMAIN;
+	hints->addr_format = opts.address_format;
+
+	ret = run();
+
+	incast_free_res();
+	ft_free_res();
+	return ft_exit_code(ret);
+}
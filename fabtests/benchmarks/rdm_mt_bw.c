@@ -0,0 +1,770 @@
+/*
+ * Copyright (c) 2024 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Multi-threaded message rate test.  Each client thread streams windows of
+ * tagged messages to its peer thread on the server, which acknowledges
+ * every window.  The threads share either a single FI_THREAD_SAFE endpoint
+ * and completion queue, or each own an endpoint on the shared domain, or
+ * each own a transmit and receive context of a scalable endpoint.
+ * Completions are credited to the thread that posted the operation, which
+ * may not be the thread that read them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include <shared.h>
+#include "benchmark_shared.h"
+
+#define MT_ACK_TAG	(1ULL << 32)
+#define MT_CQ_BATCH	16
+#define MT_CACHE_LINE	64
+
+enum {
+	MT_SAFE,
+	MT_EP,
+	MT_SEP,
+	MT_MAX,
+};
+
+static const char *mt_mode_name[MT_MAX] = {
+	"safe",
+	"ep",
+	"sep",
+};
+
+struct mt_thread;
+
+struct mt_ctx {
+	struct fi_context2	context;
+	struct mt_thread	*thread;
+	uint64_t		post;
+	uint64_t		done;
+};
+
+struct mt_thread {
+	_Atomic uint64_t	comp;
+	uint64_t		expect;
+	pthread_t		thread;
+	uint64_t		id;
+	struct fid_ep		*tx_ep;
+	struct fid_ep		*rx_ep;
+	struct fid_cq		*cq;
+	fi_addr_t		addr;
+	char			*buf;
+	struct mt_ctx		*ctx;
+	uint64_t		start;
+	uint64_t		end;
+	uint64_t		lat_sum;
+	uint64_t		lat_max;
+	int			ret;
+} __attribute__((aligned(MT_CACHE_LINE)));
+
+static int mode = MT_EP;
+static int thread_cnt = 4;
+static int rx_ctx_bits;
+static struct mt_thread *threads;
+static struct fid_ep **data_eps;
+static struct fid_cq **data_cqs;
+static struct fid_ep *sep;
+static struct fid_mr *data_mr;
+static void *data_desc;
+static char *data_buf;
+static size_t data_size;
+static atomic_int mt_failed;
+
+/* Counts of the endpoints and completion queues backing the threads */
+static int mt_ep_cnt(void)
+{
+	return mode == MT_SAFE ? 1 : thread_cnt;
+}
+
+static int mt_progress(struct mt_thread *t)
+{
+	struct fi_cq_entry comp[MT_CQ_BATCH];
+	struct mt_ctx *ctx;
+	uint64_t now;
+	int i, ret;
+
+	ret = fi_cq_read(t->cq, comp, MT_CQ_BATCH);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret < 0) {
+		if (ret == -FI_EAVAIL)
+			ret = ft_cq_readerr(t->cq);
+		else
+			FT_PRINTERR("fi_cq_read", ret);
+		return ret;
+	}
+
+	now = ft_gettime_ns();
+	for (i = 0; i < ret; i++) {
+		ctx = comp[i].op_context;
+		ctx->done = now;
+		atomic_fetch_add_explicit(&ctx->thread->comp, 1,
+					  memory_order_release);
+	}
+	return 0;
+}
+
+static int mt_wait(struct mt_thread *t)
+{
+	uint64_t start = ft_gettime_ms();
+	int ret;
+
+	while (atomic_load_explicit(&t->comp, memory_order_acquire) <
+	       t->expect) {
+		if (atomic_load_explicit(&mt_failed, memory_order_relaxed))
+			return -FI_ECANCELED;
+
+		ret = mt_progress(t);
+		if (ret)
+			return ret;
+
+		if (timeout >= 0 && ft_gettime_ms() - start > timeout * 1000) {
+			fprintf(stderr, "%ds timeout expired\n", timeout);
+			return -FI_ENODATA;
+		}
+	}
+	return 0;
+}
+
+static int mt_tsend(struct mt_thread *t, void *buf, size_t size, uint64_t tag,
+		    struct mt_ctx *ctx)
+{
+	int ret;
+
+	ctx->post = ft_gettime_ns();
+	do {
+		ret = fi_tsend(t->tx_ep, buf, size, data_desc, t->addr, tag,
+			       &ctx->context);
+		if (ret == -FI_EAGAIN && (ret = mt_progress(t)) == 0)
+			ret = -FI_EAGAIN;
+	} while (ret == -FI_EAGAIN);
+
+	if (ret) {
+		FT_PRINTERR("fi_tsend", ret);
+		return ret;
+	}
+	t->expect++;
+	return 0;
+}
+
+static int mt_trecv(struct mt_thread *t, void *buf, size_t size, uint64_t tag,
+		    struct mt_ctx *ctx)
+{
+	int ret;
+
+	do {
+		ret = fi_trecv(t->rx_ep, buf, size, data_desc, FI_ADDR_UNSPEC,
+			       tag, 0, &ctx->context);
+		if (ret == -FI_EAGAIN && (ret = mt_progress(t)) == 0)
+			ret = -FI_EAGAIN;
+	} while (ret == -FI_EAGAIN);
+
+	if (ret) {
+		FT_PRINTERR("fi_trecv", ret);
+		return ret;
+	}
+	t->expect++;
+	return 0;
+}
+
+static int mt_send_window(struct mt_thread *t, int n)
+{
+	char *ack = t->buf + opts.transfer_size;
+	int i, ret;
+
+	ret = mt_trecv(t, ack, 1, MT_ACK_TAG | t->id, &t->ctx[opts.window_size]);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < n; i++) {
+		ret = mt_tsend(t, t->buf, opts.transfer_size, t->id, &t->ctx[i]);
+		if (ret)
+			return ret;
+	}
+
+	ret = mt_wait(t);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < n; i++) {
+		t->lat_sum += t->ctx[i].done - t->ctx[i].post;
+		t->lat_max = MAX(t->lat_max, t->ctx[i].done - t->ctx[i].post);
+	}
+	return 0;
+}
+
+static int mt_recv_window(struct mt_thread *t, int n)
+{
+	char *ack = t->buf + opts.transfer_size;
+	int i, ret;
+
+	for (i = 0; i < n; i++) {
+		ret = mt_trecv(t, t->buf, opts.transfer_size, t->id, &t->ctx[i]);
+		if (ret)
+			return ret;
+	}
+
+	/* also collects the previous acknowledgement */
+	ret = mt_wait(t);
+	if (ret)
+		return ret;
+
+	if (ft_check_opts(FT_OPT_VERIFY_DATA)) {
+		ret = ft_check_buf(t->buf, opts.transfer_size);
+		if (ret)
+			return ret;
+	}
+
+	return mt_tsend(t, ack, 1, MT_ACK_TAG | t->id,
+			&t->ctx[opts.window_size]);
+}
+
+static int mt_windows(struct mt_thread *t, int total)
+{
+	int i, n, ret;
+
+	for (i = 0; i < total; i += n) {
+		n = MIN(opts.window_size, total - i);
+		ret = opts.dst_addr ? mt_send_window(t, n) :
+				      mt_recv_window(t, n);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void *mt_thread_run(void *arg)
+{
+	struct mt_thread *t = arg;
+
+	t->ret = mt_windows(t, opts.warmup_iterations);
+	if (t->ret)
+		goto out;
+
+	t->lat_sum = 0;
+	t->lat_max = 0;
+	t->start = ft_gettime_ns();
+	t->ret = mt_windows(t, opts.iterations);
+	t->end = ft_gettime_ns();
+
+	/* the last acknowledgement */
+	if (!t->ret && !opts.dst_addr)
+		t->ret = mt_wait(t);
+out:
+	if (t->ret)
+		atomic_store(&mt_failed, 1);
+	return NULL;
+}
+
+static void mt_ns_to_ts(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+static void mt_show_perf(void)
+{
+	struct mt_thread *t;
+	uint64_t first = UINT64_MAX, last = 0, msgs;
+	double usec;
+	int i;
+
+	for (i = 0; i < thread_cnt; i++) {
+		first = MIN(first, threads[i].start);
+		last = MAX(last, threads[i].end);
+	}
+	mt_ns_to_ts(first, &start);
+	mt_ns_to_ts(last, &end);
+
+	msgs = (uint64_t) opts.iterations * thread_cnt;
+	if (opts.machr) {
+		show_perf_mr(opts.transfer_size, msgs, &start, &end, 1,
+			     opts.argc, opts.argv);
+		return;
+	}
+	show_perf(NULL, opts.transfer_size, msgs, &start, &end, 1);
+
+	for (i = 0; i < thread_cnt; i++) {
+		t = &threads[i];
+		usec = (t->end - t->start) / 1000.0;
+		printf("  thread %-3d %10.2f usec/xfer %10.2f Mxfers/sec", i,
+		       usec / opts.iterations, opts.iterations / usec);
+		if (opts.dst_addr && opts.iterations)
+			printf("  lat avg %8.2f us  max %8.2f us",
+			       t->lat_sum / 1000.0 / opts.iterations,
+			       t->lat_max / 1000.0);
+		printf("\n");
+	}
+}
+
+static int mt_run(void)
+{
+	int i, cnt, ret;
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].comp = 0;
+		threads[i].expect = 0;
+		threads[i].ret = 0;
+		if (opts.dst_addr && ft_check_opts(FT_OPT_VERIFY_DATA)) {
+			ret = ft_fill_buf(threads[i].buf, opts.transfer_size);
+			if (ret)
+				return ret;
+		}
+	}
+
+	ret = ft_sync();
+	if (ret)
+		return ret;
+
+	for (cnt = 0; cnt < thread_cnt; cnt++) {
+		ret = pthread_create(&threads[cnt].thread, NULL, mt_thread_run,
+				     &threads[cnt]);
+		if (ret) {
+			FT_PRINTERR("pthread_create", -ret);
+			atomic_store(&mt_failed, 1);
+			break;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		pthread_join(threads[i].thread, NULL);
+		if (threads[i].ret && !ret)
+			ret = threads[i].ret;
+	}
+	if (ret)
+		return ret;
+
+	mt_show_perf();
+	return 0;
+}
+
+static int mt_bind_ep(struct fid_ep *ep, struct fid_cq *cq, uint64_t flags)
+{
+	int ret;
+
+	ret = fi_ep_bind(ep, &cq->fid, flags);
+	if (ret) {
+		FT_PRINTERR("fi_ep_bind", ret);
+		return ret;
+	}
+
+	ret = fi_enable(ep);
+	if (ret)
+		FT_PRINTERR("fi_enable", ret);
+	return ret;
+}
+
+static int mt_alloc_cqs(void)
+{
+	struct fi_cq_attr attr = {
+		.format = FI_CQ_FORMAT_CONTEXT,
+		.wait_obj = FI_WAIT_NONE,
+	};
+	int i, ret;
+
+	data_cqs = calloc(mt_ep_cnt(), sizeof(*data_cqs));
+	if (!data_cqs)
+		return -FI_ENOMEM;
+
+	/* a window of transfers plus the acknowledgement per thread */
+	attr.size = (opts.window_size + 1) * (thread_cnt / mt_ep_cnt());
+	attr.size = MAX(attr.size, fi->rx_attr->size);
+	for (i = 0; i < mt_ep_cnt(); i++) {
+		ret = fi_cq_open(domain, &attr, &data_cqs[i], NULL);
+		if (ret) {
+			FT_PRINTERR("fi_cq_open", ret);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+/* Data endpoints take any address, the control endpoint owns src_addr */
+static struct fi_info *mt_getinfo(void)
+{
+	struct fi_info *info = NULL, *ep_hints;
+	int ret;
+
+	ep_hints = fi_dupinfo(fi);
+	if (!ep_hints)
+		return NULL;
+
+	free(ep_hints->src_addr);
+	free(ep_hints->dest_addr);
+	ep_hints->src_addr = NULL;
+	ep_hints->dest_addr = NULL;
+	ep_hints->src_addrlen = 0;
+	ep_hints->dest_addrlen = 0;
+
+	ret = fi_getinfo(FT_FIVERSION, NULL, NULL, 0, ep_hints, &info);
+	if (ret)
+		FT_PRINTERR("fi_getinfo", ret);
+	fi_freeinfo(ep_hints);
+	return info;
+}
+
+static int mt_alloc_eps(void)
+{
+	struct fi_info *info;
+	int i, ret;
+
+	data_eps = calloc(mt_ep_cnt(), sizeof(*data_eps));
+	info = mt_getinfo();
+	if (!data_eps || !info) {
+		fi_freeinfo(info);
+		return -FI_ENODATA;
+	}
+
+	for (i = 0; i < mt_ep_cnt(); i++) {
+		ret = fi_endpoint(domain, info, &data_eps[i], NULL);
+		if (ret) {
+			FT_PRINTERR("fi_endpoint", ret);
+			break;
+		}
+
+		ret = fi_ep_bind(data_eps[i], &av->fid, 0);
+		if (ret) {
+			FT_PRINTERR("fi_ep_bind", ret);
+			break;
+		}
+
+		ret = mt_bind_ep(data_eps[i], data_cqs[i],
+				 FI_TRANSMIT | FI_RECV);
+		if (ret)
+			break;
+
+		ret = ft_init_av_addr(av, data_eps[i], &threads[i].addr);
+		if (ret)
+			break;
+	}
+	fi_freeinfo(info);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].tx_ep = data_eps[i % mt_ep_cnt()];
+		threads[i].rx_ep = data_eps[i % mt_ep_cnt()];
+		threads[i].addr = threads[i % mt_ep_cnt()].addr;
+	}
+	return 0;
+}
+
+static int mt_alloc_sep(void)
+{
+	struct fi_info *info;
+	fi_addr_t addr;
+	int i, ret;
+
+	if (fi->domain_attr->max_ep_tx_ctx < thread_cnt ||
+	    fi->domain_attr->max_ep_rx_ctx < thread_cnt) {
+		fprintf(stderr, "Provider supports only %zu contexts\n",
+			MIN(fi->domain_attr->max_ep_tx_ctx,
+			    fi->domain_attr->max_ep_rx_ctx));
+		return -FI_ENODATA;
+	}
+
+	info = mt_getinfo();
+	if (!info)
+		return -FI_ENODATA;
+
+	info->ep_attr->tx_ctx_cnt = thread_cnt;
+	info->ep_attr->rx_ctx_cnt = thread_cnt;
+	ret = fi_scalable_ep(domain, info, &sep, NULL);
+	fi_freeinfo(info);
+	if (ret) {
+		FT_PRINTERR("fi_scalable_ep", ret);
+		return ret;
+	}
+
+	ret = fi_scalable_ep_bind(sep, &av->fid, 0);
+	if (ret) {
+		FT_PRINTERR("fi_scalable_ep_bind", ret);
+		return ret;
+	}
+
+	for (i = 0; i < thread_cnt; i++) {
+		ret = fi_tx_context(sep, i, NULL, &threads[i].tx_ep, NULL);
+		if (ret) {
+			FT_PRINTERR("fi_tx_context", ret);
+			return ret;
+		}
+
+		ret = mt_bind_ep(threads[i].tx_ep, data_cqs[i], FI_TRANSMIT);
+		if (ret)
+			return ret;
+
+		ret = fi_rx_context(sep, i, NULL, &threads[i].rx_ep, NULL);
+		if (ret) {
+			FT_PRINTERR("fi_rx_context", ret);
+			return ret;
+		}
+
+		ret = mt_bind_ep(threads[i].rx_ep, data_cqs[i], FI_RECV);
+		if (ret)
+			return ret;
+	}
+
+	ret = fi_enable(sep);
+	if (ret) {
+		FT_PRINTERR("fi_enable", ret);
+		return ret;
+	}
+
+	ret = ft_init_av_addr(av, sep, &addr);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < thread_cnt; i++)
+		threads[i].addr = fi_rx_addr(addr, i, rx_ctx_bits);
+	return 0;
+}
+
+static int mt_alloc_res(void)
+{
+	size_t buf_size;
+	int i, ret;
+
+	if (fi->domain_attr->mr_mode & FI_MR_ENDPOINT) {
+		fprintf(stderr, "FI_MR_ENDPOINT is not supported\n");
+		return -FI_ENODATA;
+	}
+
+	ret = posix_memalign((void **) &threads, MT_CACHE_LINE,
+			     thread_cnt * sizeof(*threads));
+	if (ret)
+		return -FI_ENOMEM;
+	memset(threads, 0, thread_cnt * sizeof(*threads));
+
+	/* each thread gets a message buffer followed by an ack buffer */
+	buf_size = (opts.options & FT_OPT_SIZE ?
+		    opts.transfer_size : FT_BENCHMARK_MAX_MSG_SIZE) +
+		   MT_CACHE_LINE;
+	buf_size = (buf_size + MT_CACHE_LINE - 1) & ~(MT_CACHE_LINE - 1);
+	data_size = buf_size * thread_cnt;
+	data_buf = calloc(1, data_size);
+	if (!data_buf)
+		return -FI_ENOMEM;
+
+	ret = ft_reg_mr(fi, data_buf, data_size, ft_info_to_mr_access(fi),
+			FT_MR_KEY + 1, FI_HMEM_SYSTEM, 0, &data_mr, &data_desc);
+	if (ret) {
+		FT_PRINTERR("ft_reg_mr", ret);
+		return ret;
+	}
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].id = i;
+		threads[i].buf = data_buf + buf_size * i;
+		threads[i].ctx = calloc(opts.window_size + 1,
+					sizeof(*threads[i].ctx));
+		if (!threads[i].ctx)
+			return -FI_ENOMEM;
+		for (ret = 0; ret <= opts.window_size; ret++)
+			threads[i].ctx[ret].thread = &threads[i];
+	}
+
+	ret = mt_alloc_cqs();
+	if (ret)
+		return ret;
+
+	if (mode == MT_SEP)
+		ret = mt_alloc_sep();
+	else
+		ret = mt_alloc_eps();
+	if (ret)
+		return ret;
+
+	for (i = 0; i < thread_cnt; i++)
+		threads[i].cq = data_cqs[i % mt_ep_cnt()];
+	return 0;
+}
+
+static void mt_free_res(void)
+{
+	int i;
+
+	if (threads) {
+		for (i = 0; i < thread_cnt; i++) {
+			if (mode == MT_SEP) {
+				FT_CLOSE_FID(threads[i].tx_ep);
+				FT_CLOSE_FID(threads[i].rx_ep);
+			}
+			free(threads[i].ctx);
+		}
+		free(threads);
+	}
+	FT_CLOSE_FID(sep);
+	if (data_eps) {
+		FT_CLOSEV_FID(data_eps, mt_ep_cnt());
+		free(data_eps);
+	}
+	if (data_cqs) {
+		FT_CLOSEV_FID(data_cqs, mt_ep_cnt());
+		free(data_cqs);
+	}
+	FT_CLOSE_FID(data_mr);
+	free(data_buf);
+}
+
+static int run(void)
+{
+	int i, ret;
+
+	if (mode == MT_SEP) {
+		while (thread_cnt >> ++rx_ctx_bits)
+			;
+		av_attr.rx_ctx_bits = rx_ctx_bits;
+	}
+
+	ret = ft_init_fabric();
+	if (ret)
+		return ret;
+
+	ret = mt_alloc_res();
+	if (ret)
+		goto out;
+
+	printf("%s mode, %d threads\n", mt_mode_name[mode], thread_cnt);
+	if (!(opts.options & FT_OPT_SIZE)) {
+		for (i = 0; i < TEST_CNT; i++) {
+			if (!ft_use_size(i, opts.sizes_enabled))
+				continue;
+			opts.transfer_size = test_size[i].size;
+			init_test(&opts, test_name, sizeof(test_name));
+			ret = mt_run();
+			if (ret)
+				goto out;
+		}
+	} else {
+		init_test(&opts, test_name, sizeof(test_name));
+		ret = mt_run();
+		if (ret)
+			goto out;
+	}
+
+	ret = ft_finalize();
+out:
+	mt_free_res();
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	opts.options |= FT_OPT_BW;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt_long(argc, argv, "T:x:vW:h" CS_OPTS INFO_OPTS,
+				 long_opts, &lopt_idx)) != -1) {
+		switch (op) {
+		default:
+			if (!ft_parse_long_opts(op, optarg))
+				continue;
+			ft_parse_benchmark_opts(op, optarg);
+			ft_parseinfo(op, optarg, hints, &opts);
+			ft_parsecsopts(op, optarg, &opts);
+			break;
+		case 'T':
+			thread_cnt = atoi(optarg);
+			break;
+		case 'x':
+			for (mode = 0; mode < MT_MAX; mode++) {
+				if (!strcasecmp(optarg, mt_mode_name[mode]))
+					break;
+			}
+			break;
+		case '?':
+		case 'h':
+			ft_csusage(argv[0], "Multi-threaded message rate test "
+				   "for RDM endpoints using tagged messages.");
+			FT_PRINT_OPTS_USAGE("-T <threads>",
+					    "number of threads (default 4)");
+			FT_PRINT_OPTS_USAGE("-x <mode>",
+				"safe: threads share an FI_THREAD_SAFE endpoint\n"
+				"ep: each thread owns an endpoint (default)\n"
+				"sep: each thread owns scalable endpoint "
+				"contexts");
+			FT_PRINT_OPTS_USAGE("-v", "enables data_integrity checks");
+			FT_PRINT_OPTS_USAGE("-W", "window size per thread");
+			ft_longopts_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc)
+		opts.dst_addr = argv[optind];
+
+	if (thread_cnt < 1 || mode == MT_MAX || opts.window_size < 1 ||
+	    opts.iface != FI_HMEM_SYSTEM) {
+		fprintf(stderr, "Invalid thread count, mode or memory type\n");
+		return EXIT_FAILURE;
+	}
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->domain_attr->resource_mgmt = FI_RM_ENABLED;
+	hints->caps = FI_TAGGED;
+	hints->mode |= FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->tx_attr->tclass = FI_TC_BULK_DATA;
+	hints->addr_format = opts.address_format;
+	switch (mode) {
+	case MT_SAFE:
+		hints->domain_attr->threading = FI_THREAD_SAFE;
+		break;
+	case MT_EP:
+		hints->domain_attr->threading = FI_THREAD_ENDPOINT;
+		break;
+	case MT_SEP:
+		hints->caps |= FI_NAMED_RX_CTX;
+		hints->domain_attr->threading = FI_THREAD_FID;
+		break;
+	}
+
+	ret = run();
+
+	ft_free_res();
+	return ft_exit_code(ret);
+}
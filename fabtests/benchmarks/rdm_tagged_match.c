@@ -0,0 +1,607 @@
+/*
+ * Copyright (c) 2024 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tag matching benchmark.  The server keeps a number of receives posted
+ * that never match, and the client sends a number of messages that are
+ * never received, so both matching queues have a chosen depth before the
+ * test messages are added.  Test messages are then matched from the
+ * posted queue (the receive is posted before the message is sent) and
+ * from the unexpected queue (the message arrives before the receive is
+ * posted).  A fraction of the receives may use wildcard tags, and
+ * receives may be posted in the send order, reversed or shuffled, which
+ * changes how far a provider has to search.  The server reports the
+ * matching rate of both paths and the time spent in fi_trecv() to find
+ * an unexpected message.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include <shared.h>
+#include "benchmark_shared.h"
+
+#define MATCH_DATA_TAG		(1ULL << 40)
+#define MATCH_WILD_TAG		(1ULL << 41)
+#define MATCH_POSTED_TAG	(1ULL << 42)
+#define MATCH_UNEXP_TAG		(1ULL << 43)
+#define MATCH_INDEX_MASK	0xffffffffULL
+#define MATCH_PROGRESS_CNT	1000
+
+enum {
+	MATCH_SEQ,
+	MATCH_REV,
+	MATCH_RAND,
+	MATCH_ORDER_MAX,
+};
+
+static const char *match_order_name[MATCH_ORDER_MAX] = {
+	"seq",
+	"rev",
+	"rand",
+};
+
+static int posted_depth = 64;
+static int unexp_depth = 64;
+static int wild_pct;
+static int order = MATCH_SEQ;
+
+static struct fid_ep *data_ep;
+static struct fid_ep *fill_ep;
+static struct fid_cq *data_cq;
+static struct fid_mr *data_mr;
+static void *data_desc;
+static char *data_buf;
+static fi_addr_t data_addr;
+static struct fi_context2 *ctx;
+static int *perm;
+static uint64_t *post_ns;
+
+/* Message i is sent to a wildcard receive for wild_pct percent of i */
+static int match_is_wild(uint64_t i)
+{
+	return (i + 1) * wild_pct / 100 != i * wild_pct / 100;
+}
+
+static uint64_t match_tag(uint64_t i)
+{
+	return MATCH_DATA_TAG | (match_is_wild(i) ? MATCH_WILD_TAG : 0) |
+	       (i & MATCH_INDEX_MASK);
+}
+
+static int match_wait(uint64_t cnt)
+{
+	struct fi_cq_entry comp[16];
+	uint64_t start = ft_gettime_ms();
+	int ret;
+
+	while (cnt) {
+		ret = fi_cq_read(data_cq, comp, MIN(cnt, 16));
+		if (ret > 0) {
+			cnt -= ret;
+			start = ft_gettime_ms();
+		} else if (ret == -FI_EAVAIL) {
+			return ft_cq_readerr(data_cq);
+		} else if (ret != -FI_EAGAIN) {
+			FT_PRINTERR("fi_cq_read", ret);
+			return ret;
+		} else if (timeout >= 0 &&
+			   ft_gettime_ms() - start > timeout * 1000) {
+			fprintf(stderr, "%ds timeout expired\n", timeout);
+			return -FI_ENODATA;
+		}
+	}
+	return 0;
+}
+
+static int match_tsend(struct fid_ep *ep, size_t size, uint64_t tag,
+		       void *context)
+{
+	int ret;
+
+	do {
+		ret = fi_tsend(ep, data_buf, size, data_desc, data_addr,
+			       tag, context);
+		if (ret == -FI_EAGAIN)
+			(void) fi_cq_read(data_cq, NULL, 0);
+	} while (ret == -FI_EAGAIN);
+
+	if (ret)
+		FT_PRINTERR("fi_tsend", ret);
+	return ret;
+}
+
+static int match_trecv(size_t size, uint64_t tag, uint64_t ignore,
+		       void *context)
+{
+	int ret;
+
+	do {
+		ret = fi_trecv(data_ep, data_buf, size, data_desc,
+			       FI_ADDR_UNSPEC, tag, ignore, context);
+		if (ret == -FI_EAGAIN)
+			(void) fi_cq_read(data_cq, NULL, 0);
+	} while (ret == -FI_EAGAIN);
+
+	if (ret)
+		FT_PRINTERR("fi_trecv", ret);
+	return ret;
+}
+
+static int match_post_test_recv(uint64_t i, void *context)
+{
+	if (match_is_wild(i))
+		return match_trecv(opts.transfer_size,
+				   MATCH_DATA_TAG | MATCH_WILD_TAG,
+				   MATCH_INDEX_MASK, context);
+
+	return match_trecv(opts.transfer_size, match_tag(i), 0, context);
+}
+
+/* Receives for messages base..base+n-1 are posted in perm[] order */
+static void match_set_order(int n)
+{
+	int i, j, tmp;
+
+	for (i = 0; i < n; i++)
+		perm[i] = order == MATCH_REV ? n - 1 - i : i;
+
+	if (order != MATCH_RAND)
+		return;
+
+	for (i = n - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = perm[i];
+		perm[i] = perm[j];
+		perm[j] = tmp;
+	}
+}
+
+/* Fills both matching queues with entries that never match */
+static int match_fill_queues(void)
+{
+	struct fi_context2 *fill_ctx = &ctx[opts.window_size];
+	int i, ret = 0;
+
+	if (opts.dst_addr) {
+		for (i = 0; i < unexp_depth; i++) {
+			ret = match_tsend(fill_ep, 0, MATCH_UNEXP_TAG | i,
+					  &fill_ctx[i]);
+			if (ret)
+				return ret;
+		}
+		ret = match_wait(unexp_depth);
+	} else {
+		for (i = 0; i < posted_depth; i++) {
+			ret = match_trecv(0, MATCH_POSTED_TAG | i, 0,
+					  &fill_ctx[i]);
+			if (ret)
+				return ret;
+		}
+	}
+	if (ret)
+		return ret;
+
+	return ft_sync();
+}
+
+static int match_send_window(uint64_t base, int n, int unexp)
+{
+	int i, ret;
+
+	if (!unexp) {
+		ret = ft_sync();
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = match_tsend(data_ep, opts.transfer_size,
+				  match_tag(base + i), &ctx[i]);
+		if (ret)
+			return ret;
+	}
+
+	ret = match_wait(n);
+	if (ret)
+		return ret;
+
+	return unexp ? ft_sync() : 0;
+}
+
+static int match_recv_window(uint64_t base, int n, int unexp,
+			     uint64_t *elapsed, uint64_t *samples)
+{
+	uint64_t start, now;
+	int i, ret;
+
+	match_set_order(n);
+	if (!unexp) {
+		for (i = 0; i < n; i++) {
+			ret = match_post_test_recv(base + perm[i], &ctx[i]);
+			if (ret)
+				return ret;
+		}
+	}
+
+	ret = ft_sync();
+	if (ret)
+		return ret;
+
+	if (unexp) {
+		/* let the provider queue the messages that have arrived */
+		for (i = 0; i < MATCH_PROGRESS_CNT; i++)
+			(void) fi_cq_read(data_cq, NULL, 0);
+	}
+
+	start = ft_gettime_ns();
+	if (unexp) {
+		for (i = 0; i < n; i++) {
+			now = ft_gettime_ns();
+			ret = match_post_test_recv(base + perm[i], &ctx[i]);
+			if (ret)
+				return ret;
+			if (samples)
+				samples[i] = ft_gettime_ns() - now;
+		}
+	}
+
+	ret = match_wait(n);
+	if (ret)
+		return ret;
+
+	*elapsed += ft_gettime_ns() - start;
+	return 0;
+}
+
+static int match_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void match_show_perf(char *name, uint64_t elapsed)
+{
+	struct timespec a = { 0 }, b;
+
+	b.tv_sec = elapsed / 1000000000;
+	b.tv_nsec = elapsed % 1000000000;
+	show_perf(name, opts.transfer_size, opts.iterations, &a, &b, 1);
+}
+
+static void match_show_post(void)
+{
+	uint64_t sum = 0;
+	int i;
+
+	qsort(post_ns, opts.iterations, sizeof(*post_ns), match_cmp);
+	for (i = 0; i < opts.iterations; i++)
+		sum += post_ns[i];
+
+	printf("fi_trecv with an unexpected match: avg %.2f p50 %.2f "
+	       "p99 %.2f max %.2f usec\n",
+	       sum / 1000.0 / opts.iterations,
+	       post_ns[opts.iterations / 2] / 1000.0,
+	       post_ns[(opts.iterations * 99 + 99) / 100 - 1] / 1000.0,
+	       post_ns[opts.iterations - 1] / 1000.0);
+}
+
+/* Runs warmup, then timed windows of the expected or unexpected path */
+static int match_phase(int unexp, uint64_t *elapsed)
+{
+	uint64_t i, total, warmup_elapsed = 0;
+	int n, ret;
+
+	*elapsed = 0;
+	total = (uint64_t) opts.warmup_iterations + opts.iterations;
+	for (i = 0; i < total; i += n) {
+		n = MIN(opts.window_size, total - i);
+		if (i < opts.warmup_iterations)
+			n = MIN(n, opts.warmup_iterations - i);
+
+		if (opts.dst_addr)
+			ret = match_send_window(i, n, unexp);
+		else if (i < opts.warmup_iterations)
+			ret = match_recv_window(i, n, unexp, &warmup_elapsed,
+						NULL);
+		else
+			ret = match_recv_window(i, n, unexp, elapsed,
+					&post_ns[i - opts.warmup_iterations]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int match_run(void)
+{
+	uint64_t elapsed;
+	int ret;
+
+	ret = match_fill_queues();
+	if (ret)
+		return ret;
+
+	if (!opts.dst_addr)
+		printf("posted depth %d, unexpected depth %d, %d%% wildcard, "
+		       "%s order, window %d\n", posted_depth, unexp_depth,
+		       wild_pct, match_order_name[order], opts.window_size);
+
+	ret = match_phase(0, &elapsed);
+	if (ret)
+		return ret;
+	if (!opts.dst_addr)
+		match_show_perf("expected", elapsed);
+
+	ret = match_phase(1, &elapsed);
+	if (ret)
+		return ret;
+	if (!opts.dst_addr) {
+		match_show_perf("unexpected", elapsed);
+		match_show_post();
+	}
+	return 0;
+}
+
+static int match_open_ep(struct fi_info *info, struct fid_ep **ep)
+{
+	int ret;
+
+	ret = fi_endpoint(domain, info, ep, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_endpoint", ret);
+		return ret;
+	}
+
+	ret = fi_ep_bind(*ep, &av->fid, 0);
+	if (ret) {
+		FT_PRINTERR("fi_ep_bind", ret);
+		return ret;
+	}
+
+	ret = fi_ep_bind(*ep, &data_cq->fid, FI_TRANSMIT | FI_RECV);
+	if (ret) {
+		FT_PRINTERR("fi_ep_bind", ret);
+		return ret;
+	}
+
+	ret = fi_enable(*ep);
+	if (ret)
+		FT_PRINTERR("fi_enable", ret);
+	return ret;
+}
+
+/*
+ * Data endpoints take any address, the control endpoint owns src_addr.
+ * The client sends the messages that are never received from a separate
+ * endpoint, as providers that leave unexpected messages in the stream
+ * would otherwise stall the test messages behind them.
+ */
+static int match_alloc_eps(void)
+{
+	struct fi_info *info = NULL, *ep_hints;
+	int ret;
+
+	ep_hints = fi_dupinfo(fi);
+	if (!ep_hints)
+		return -FI_ENOMEM;
+
+	free(ep_hints->src_addr);
+	free(ep_hints->dest_addr);
+	ep_hints->src_addr = NULL;
+	ep_hints->dest_addr = NULL;
+	ep_hints->src_addrlen = 0;
+	ep_hints->dest_addrlen = 0;
+
+	ret = fi_getinfo(FT_FIVERSION, NULL, NULL, 0, ep_hints, &info);
+	fi_freeinfo(ep_hints);
+	if (ret) {
+		FT_PRINTERR("fi_getinfo", ret);
+		return ret;
+	}
+
+	ret = match_open_ep(info, &data_ep);
+	if (!ret && opts.dst_addr)
+		ret = match_open_ep(info, &fill_ep);
+	fi_freeinfo(info);
+	if (ret)
+		return ret;
+
+	return ft_init_av_addr(av, data_ep, &data_addr);
+}
+
+static int match_alloc_res(void)
+{
+	struct fi_cq_attr attr = {
+		.format = FI_CQ_FORMAT_CONTEXT,
+		.wait_obj = FI_WAIT_NONE,
+	};
+	size_t ctx_cnt;
+	int ret;
+
+	if (fi->domain_attr->mr_mode & FI_MR_ENDPOINT) {
+		fprintf(stderr, "FI_MR_ENDPOINT is not supported\n");
+		return -FI_ENODATA;
+	}
+
+	if (fi->rx_attr->size < (size_t) posted_depth + opts.window_size) {
+		fprintf(stderr, "Receive queue size %zu is below the posted "
+			"depth and window\n", fi->rx_attr->size);
+		return -FI_ENODATA;
+	}
+
+	ctx_cnt = MAX(posted_depth, unexp_depth) + opts.window_size;
+	ctx = calloc(ctx_cnt, sizeof(*ctx));
+	perm = calloc(opts.window_size, sizeof(*perm));
+	post_ns = calloc(opts.iterations, sizeof(*post_ns));
+	data_buf = calloc(1, opts.transfer_size);
+	if (!ctx || !perm || !post_ns || !data_buf)
+		return -FI_ENOMEM;
+
+	ret = ft_reg_mr(fi, data_buf, opts.transfer_size,
+			ft_info_to_mr_access(fi), FT_MR_KEY + 1,
+			FI_HMEM_SYSTEM, 0, &data_mr, &data_desc);
+	if (ret) {
+		FT_PRINTERR("ft_reg_mr", ret);
+		return ret;
+	}
+
+	attr.size = MAX(ctx_cnt, fi->rx_attr->size);
+	ret = fi_cq_open(domain, &attr, &data_cq, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_cq_open", ret);
+		return ret;
+	}
+
+	return match_alloc_eps();
+}
+
+static void match_free_res(void)
+{
+	FT_CLOSE_FID(fill_ep);
+	FT_CLOSE_FID(data_ep);
+	FT_CLOSE_FID(data_cq);
+	FT_CLOSE_FID(data_mr);
+	free(data_buf);
+	free(post_ns);
+	free(perm);
+	free(ctx);
+}
+
+static int run(void)
+{
+	int ret;
+
+	ret = ft_init_fabric();
+	if (ret)
+		return ret;
+
+	ret = match_alloc_res();
+	if (ret)
+		goto out;
+
+	ret = match_run();
+	if (ret)
+		goto out;
+
+	ret = ft_finalize();
+out:
+	match_free_res();
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	opts.options |= FT_OPT_SIZE;
+	opts.transfer_size = 64;
+	opts.iterations = 10000;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt_long(argc, argv, "q:u:x:r:W:h" CS_OPTS INFO_OPTS,
+				 long_opts, &lopt_idx)) != -1) {
+		switch (op) {
+		default:
+			if (!ft_parse_long_opts(op, optarg))
+				continue;
+			ft_parse_benchmark_opts(op, optarg);
+			ft_parseinfo(op, optarg, hints, &opts);
+			ft_parsecsopts(op, optarg, &opts);
+			break;
+		case 'q':
+			posted_depth = atoi(optarg);
+			break;
+		case 'u':
+			unexp_depth = atoi(optarg);
+			break;
+		case 'x':
+			wild_pct = atoi(optarg);
+			break;
+		case 'r':
+			for (order = 0; order < MATCH_ORDER_MAX; order++) {
+				if (!strcasecmp(optarg, match_order_name[order]))
+					break;
+			}
+			break;
+		case '?':
+		case 'h':
+			ft_csusage(argv[0], "Tag matching test for RDM endpoints.");
+			FT_PRINT_OPTS_USAGE("-q <depth>", "receives kept posted "
+					    "that never match (default 64)");
+			FT_PRINT_OPTS_USAGE("-u <depth>", "messages kept unexpected "
+					    "that never match (default 64)");
+			FT_PRINT_OPTS_USAGE("-x <percent>", "receives posted with "
+					    "a wildcard tag (default 0)");
+			FT_PRINT_OPTS_USAGE("-r <order>", "receive posting order: "
+					    "seq, rev or rand (default seq)");
+			FT_PRINT_OPTS_USAGE("-W", "test messages outstanding at "
+					    "once (default 64)");
+			ft_longopts_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc)
+		opts.dst_addr = argv[optind];
+
+	if (posted_depth < 0 || unexp_depth < 0 || wild_pct < 0 ||
+	    wild_pct > 100 || order == MATCH_ORDER_MAX ||
+	    opts.window_size < 1 || opts.iterations < 1 ||
+	    opts.iface != FI_HMEM_SYSTEM) {
+		fprintf(stderr, "Invalid depth, wildcard percentage, order, "
+			"window, iterations or memory type\n");
+		return EXIT_FAILURE;
+	}
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->caps = FI_TAGGED;
+	hints->mode |= FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->domain_attr->threading = FI_THREAD_DOMAIN;
+	hints->rx_attr->size = posted_depth + opts.window_size;
+	hints->addr_format = opts.address_format;
+
+	srand(1);
+	ret = run();
+
+	ft_free_res();
+	return ft_exit_code(ret);
+}
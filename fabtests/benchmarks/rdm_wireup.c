@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2024 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Start-up and wire-up benchmark.  A single process opens one endpoint
+ * that stands in for a rank and N peer endpoints that stand in for the
+ * rest of the job.  Each start-up phase is timed separately: fi_getinfo,
+ * opening the fabric, domain and first endpoint, opening the peer
+ * endpoints, inserting the peer addresses into the AV, and sending a
+ * first message to every peer, which is where connection-oriented RDM
+ * providers (rxm over tcp or verbs) set up their connections.  A second
+ * round of messages shows the steady state cost for comparison.  The
+ * resident set size is sampled around every phase to report the memory
+ * each peer costs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#include <rdma/fi_cm.h>
+#include <rdma/fi_errno.h>
+
+#include <shared.h>
+
+#define WIREUP_CQ_BATCH	16
+
+struct wireup_phase {
+	const char *name;
+	uint64_t start_ns;
+	long start_rss;
+	bool per_peer;
+};
+
+static int peer_cnt = 64;
+static struct fid_ep **peer_eps;
+static struct fid_cq *peer_cq;
+static struct fid_mr *wireup_mr;
+static void *wireup_desc;
+static char *wireup_buf;
+static char *peer_names;
+static fi_addr_t *peer_addrs;
+
+/* Resident set size in bytes, or 0 when it cannot be read */
+static long wireup_rss(void)
+{
+	long pages, resident = 0;
+	FILE *file;
+
+	file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+
+	if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+		resident = 0;
+	fclose(file);
+
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void phase_start(struct wireup_phase *phase, const char *name,
+			bool per_peer)
+{
+	phase->name = name;
+	phase->per_peer = per_peer;
+	phase->start_rss = wireup_rss();
+	phase->start_ns = ft_gettime_ns();
+}
+
+static void phase_end(struct wireup_phase *phase)
+{
+	double usec;
+	long rss;
+
+	usec = (ft_gettime_ns() - phase->start_ns) / 1000.0;
+	rss = wireup_rss() - phase->start_rss;
+
+	if (phase->per_peer)
+		printf("%-12s %12.2f %12.2f %12ld %12.2f\n", phase->name, usec,
+		       usec / peer_cnt, rss / 1024, rss / 1024.0 / peer_cnt);
+	else
+		printf("%-12s %12.2f %12s %12ld %12s\n", phase->name, usec,
+		       "--", rss / 1024, "--");
+}
+
+/*
+ * Socket addresses keep their host with the port cleared.  Wildcard
+ * hosts and other formats are dropped, leaving the choice of address to
+ * the provider.
+ */
+static void wireup_clear_port(struct fi_info *info)
+{
+	struct sockaddr_in6 *sin6 = info->src_addr;
+	struct sockaddr_in *sin = info->src_addr;
+
+	if (info->src_addr && info->src_addrlen >= sizeof(*sin)) {
+		if (sin->sin_family == AF_INET &&
+		    sin->sin_addr.s_addr != htonl(INADDR_ANY)) {
+			sin->sin_port = 0;
+			return;
+		}
+		if (sin6->sin6_family == AF_INET6 &&
+		    info->src_addrlen >= sizeof(*sin6) &&
+		    !IN6_IS_ADDR_UNSPECIFIED(&sin6->sin6_addr)) {
+			sin6->sin6_port = 0;
+			return;
+		}
+	}
+
+	free(info->src_addr);
+	info->src_addr = NULL;
+	info->src_addrlen = 0;
+}
+
+/*
+ * Peer endpoints are opened from an fi_info without the source port,
+ * so that the provider picks a distinct address for each of them.
+ */
+static struct fi_info *wireup_getinfo(void)
+{
+	struct fi_info *info = NULL, *ep_hints;
+	int ret;
+
+	ep_hints = fi_dupinfo(fi);
+	if (!ep_hints)
+		return NULL;
+
+	free(ep_hints->dest_addr);
+	ep_hints->dest_addr = NULL;
+	ep_hints->dest_addrlen = 0;
+	wireup_clear_port(ep_hints);
+
+	ret = fi_getinfo(FT_FIVERSION, NULL, NULL, 0, ep_hints, &info);
+	if (ret)
+		FT_PRINTERR("fi_getinfo", ret);
+	fi_freeinfo(ep_hints);
+	return info;
+}
+
+static int wireup_open_peers(void)
+{
+	size_t len, names_len = 0;
+	char name[FT_MAX_CTRL_MSG], *names;
+	struct fi_info *info;
+	int i, ret;
+
+	ret = fi_cq_open(domain, &cq_attr, &peer_cq, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_cq_open", ret);
+		return ret;
+	}
+
+	peer_eps = calloc(peer_cnt, sizeof(*peer_eps));
+	info = wireup_getinfo();
+	if (!peer_eps || !info) {
+		fi_freeinfo(info);
+		return -FI_ENODATA;
+	}
+
+	for (i = 0; i < peer_cnt; i++) {
+		ret = fi_endpoint(domain, info, &peer_eps[i], NULL);
+		if (ret) {
+			FT_PRINTERR("fi_endpoint", ret);
+			break;
+		}
+
+		ret = ft_enable_ep(peer_eps[i], NULL, av, peer_cq, peer_cq,
+				   NULL, NULL);
+		if (ret)
+			break;
+
+		len = sizeof(name);
+		ret = fi_getname(&peer_eps[i]->fid, name, &len);
+		if (ret) {
+			FT_PRINTERR("fi_getname", ret);
+			break;
+		}
+
+		/* names are packed back to back, as fi_av_insert expects */
+		names = realloc(peer_names, names_len + len);
+		if (!names) {
+			ret = -FI_ENOMEM;
+			break;
+		}
+		peer_names = names;
+		memcpy(&peer_names[names_len], name, len);
+		names_len += len;
+	}
+
+	fi_freeinfo(info);
+	return ret;
+}
+
+static int wireup_av_insert(void)
+{
+	int ret;
+
+	peer_addrs = calloc(peer_cnt, sizeof(*peer_addrs));
+	if (!peer_addrs)
+		return -FI_ENOMEM;
+
+	ret = fi_av_insert(av, peer_names, peer_cnt, peer_addrs, 0, NULL);
+	if (ret != peer_cnt) {
+		FT_PRINTERR("fi_av_insert", ret);
+		return ret < 0 ? ret : -FI_EOTHER;
+	}
+
+	return 0;
+}
+
+static int wireup_read_cq(struct fid_cq *cq, int *cnt)
+{
+	struct fi_cq_entry comp[WIREUP_CQ_BATCH];
+	int ret;
+
+	ret = fi_cq_read(cq, comp, WIREUP_CQ_BATCH);
+	if (ret > 0) {
+		*cnt += ret;
+		return 0;
+	}
+
+	if (ret == -FI_EAVAIL)
+		return ft_cq_readerr(cq);
+
+	return ret == -FI_EAGAIN ? 0 : ret;
+}
+
+/*
+ * Send one message to every peer and wait until all of them have been
+ * received.  The receives are posted before the clock starts.
+ */
+static int wireup_xfer(struct wireup_phase *phase, const char *name)
+{
+	size_t size = opts.transfer_size;
+	int i, tx_cnt = 0, tx_done = 0, rx_done = 0;
+	uint64_t start_ms = ft_gettime_ms();
+	int ret;
+
+	for (i = 0; i < peer_cnt; i++) {
+		do {
+			ret = fi_recv(peer_eps[i], &wireup_buf[(i + 1) * size],
+				      size, wireup_desc, FI_ADDR_UNSPEC, NULL);
+			if (ret == -FI_EAGAIN)
+				(void) fi_cq_read(peer_cq, NULL, 0);
+		} while (ret == -FI_EAGAIN);
+		if (ret) {
+			FT_PRINTERR("fi_recv", ret);
+			return ret;
+		}
+	}
+
+	phase_start(phase, name, true);
+	while (tx_done < peer_cnt || rx_done < peer_cnt) {
+		if (tx_cnt < peer_cnt) {
+			ret = fi_send(ep, wireup_buf, size, wireup_desc,
+				      peer_addrs[tx_cnt], NULL);
+			if (!ret)
+				tx_cnt++;
+			else if (ret != -FI_EAGAIN) {
+				FT_PRINTERR("fi_send", ret);
+				return ret;
+			}
+		}
+
+		ret = wireup_read_cq(txcq, &tx_done);
+		if (!ret)
+			ret = wireup_read_cq(peer_cq, &rx_done);
+		if (ret)
+			return ret;
+
+		if (timeout >= 0 &&
+		    ft_gettime_ms() - start_ms > timeout * 1000) {
+			FT_ERR("%s timed out: %d sent, %d received\n", name,
+			       tx_done, rx_done);
+			return -FI_ETIMEDOUT;
+		}
+	}
+	phase_end(phase);
+
+	return 0;
+}
+
+static int run(void)
+{
+	struct wireup_phase phase;
+	size_t size = opts.transfer_size;
+	int ret;
+
+	printf("%-12s %12s %12s %12s %12s\n", "phase", "usec", "usec/peer",
+	       "rss_KB", "KB/peer");
+
+	phase_start(&phase, "getinfo", false);
+	ret = ft_getinfo(hints, &fi);
+	if (ret)
+		return ret;
+	phase_end(&phase);
+
+	opts.av_size = peer_cnt + 1;
+	phase_start(&phase, "open", false);
+	ret = ft_open_fabric_res();
+	if (ret)
+		return ret;
+
+	ret = ft_alloc_active_res(fi);
+	if (ret)
+		return ret;
+
+	ret = ft_enable_ep(ep, eq, av, txcq, rxcq, txcntr, rxcntr);
+	if (ret)
+		return ret;
+	phase_end(&phase);
+
+	phase_start(&phase, "ep_open", true);
+	ret = wireup_open_peers();
+	if (ret)
+		return ret;
+	phase_end(&phase);
+
+	phase_start(&phase, "av_insert", true);
+	ret = wireup_av_insert();
+	if (ret)
+		return ret;
+	phase_end(&phase);
+
+	wireup_buf = calloc(peer_cnt + 1, size);
+	if (!wireup_buf)
+		return -FI_ENOMEM;
+
+	ret = ft_reg_mr(fi, wireup_buf, (peer_cnt + 1) * size,
+			ft_info_to_mr_access(fi), FT_MR_KEY + 1,
+			FI_HMEM_SYSTEM, 0, &wireup_mr, &wireup_desc);
+	if (ret) {
+		FT_PRINTERR("ft_reg_mr", ret);
+		return ret;
+	}
+
+	ret = wireup_xfer(&phase, "connect");
+	if (ret)
+		return ret;
+
+	return wireup_xfer(&phase, "steady");
+}
+
+static void wireup_free_res(void)
+{
+	FT_CLOSE_FID(wireup_mr);
+	if (peer_eps) {
+		FT_CLOSEV_FID(peer_eps, peer_cnt);
+		free(peer_eps);
+	}
+	FT_CLOSE_FID(peer_cq);
+	free(wireup_buf);
+	free(peer_names);
+	free(peer_addrs);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "  %s [OPTIONS]\n", name);
+	fprintf(stderr, "\nStart-up and wire-up benchmark for RDM "
+		"endpoints.\n");
+	fprintf(stderr, "\nOptions:\n");
+	FT_PRINT_OPTS_USAGE("-f <fabric>", "fabric name");
+	FT_PRINT_OPTS_USAGE("-d <domain>", "domain name");
+	FT_PRINT_OPTS_USAGE("-p <provider>", "specific provider name eg "
+			    "tcp, verbs");
+	FT_PRINT_OPTS_USAGE("-s <address>", "source address, needed by "
+			    "providers that bind to the wildcard address");
+	FT_PRINT_OPTS_USAGE("-n <peers>", "number of peer endpoints "
+			    "(default 64)");
+	FT_PRINT_OPTS_USAGE("-S <size>", "message size (default 64)");
+	FT_PRINT_OPTS_USAGE("-T <timeout>", "seconds to wait for the "
+			    "messages of a phase");
+	FT_PRINT_OPTS_USAGE("-h", "display this help output");
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	opts.options |= FT_OPT_SIZE;
+	opts.transfer_size = 64;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "n:S:T:h" ADDR_OPTS INFO_OPTS)) != -1) {
+		switch (op) {
+		default:
+			ft_parse_addr_opts(op, optarg, &opts);
+			ft_parseinfo(op, optarg, hints, &opts);
+			break;
+		case 'n':
+			peer_cnt = atoi(optarg);
+			break;
+		case 'S':
+			opts.transfer_size = atol(optarg);
+			break;
+		case 'T':
+			timeout = atoi(optarg);
+			break;
+		case '?':
+		case 'h':
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (peer_cnt < 1 || !opts.transfer_size) {
+		fprintf(stderr, "Invalid peer count or message size\n");
+		return EXIT_FAILURE;
+	}
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->caps = FI_MSG;
+	hints->mode |= FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->domain_attr->threading = FI_THREAD_DOMAIN;
+	hints->addr_format = opts.address_format;
+
+	ret = run();
+
+	wireup_free_res();
+	ft_free_res();
+	return ft_exit_code(ret);
+}
@@ -41,3 +41,11 @@ struct coll_test {
 	enum fi_op op;
 	enum fi_datatype datatype;
 };
+
+struct coll_bench {
+	char *name;
+	int (*post)(void *buf, void *result, size_t count, void *context);
+	enum fi_collective_op coll_op;
+	enum fi_op op;
+	enum fi_datatype datatype;
+};
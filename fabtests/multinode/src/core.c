@@ -462,6 +462,7 @@ int multinode_run_tests(int argc, char **argv)
 	int ret = FI_SUCCESS;
 	int i;
 
+	opts.options |= FT_OPT_SIZE;
 	ret = multi_setup_fabric(argc, argv);
 	if (ret)
 		return ret;
@@ -519,6 +519,240 @@ struct coll_test tests[] = {
 	},
 };
 
+static fi_addr_t bench_root = 0;
+
+static int bench_barrier(void *buf, void *result, size_t count, void *context)
+{
+	return fi_barrier(ep, coll_addr, context);
+}
+
+static int bench_broadcast(void *buf, void *result, size_t count,
+			   void *context)
+{
+	return fi_broadcast(ep, buf, count, NULL, coll_addr, bench_root,
+			    FI_UINT64, 0, context);
+}
+
+static int bench_alltoall(void *buf, void *result, size_t count,
+			  void *context)
+{
+	return fi_alltoall(ep, buf, count, NULL, result, NULL, coll_addr,
+			   FI_UINT64, 0, context);
+}
+
+static int bench_allreduce(void *buf, void *result, size_t count,
+			   void *context)
+{
+	return fi_allreduce(ep, buf, count, NULL, result, NULL, coll_addr,
+			    FI_UINT64, FI_SUM, 0, context);
+}
+
+static int bench_allgather(void *buf, void *result, size_t count,
+			   void *context)
+{
+	return fi_allgather(ep, buf, count, NULL, result, NULL, coll_addr,
+			    FI_UINT64, 0, context);
+}
+
+static int bench_reduce_scatter(void *buf, void *result, size_t count,
+				void *context)
+{
+	return fi_reduce_scatter(ep, buf, count, NULL, result, NULL, coll_addr,
+				 FI_UINT64, FI_SUM, 0, context);
+}
+
+static int bench_reduce(void *buf, void *result, size_t count, void *context)
+{
+	return fi_reduce(ep, buf, count, NULL, result, NULL, coll_addr,
+			 bench_root, FI_UINT64, FI_SUM, 0, context);
+}
+
+static int bench_scatter(void *buf, void *result, size_t count, void *context)
+{
+	return fi_scatter(ep, pm_job.my_rank == bench_root ? buf : NULL, count,
+			  NULL, result, NULL, coll_addr, bench_root, FI_UINT64,
+			  0, context);
+}
+
+static int bench_gather(void *buf, void *result, size_t count, void *context)
+{
+	return fi_gather(ep, buf, count, NULL, result, NULL, coll_addr,
+			 bench_root, FI_UINT64, 0, context);
+}
+
+struct coll_bench benches[] = {
+	{ "barrier", bench_barrier, FI_BARRIER, FI_NOOP, FI_VOID },
+	{ "broadcast", bench_broadcast, FI_BROADCAST, FI_NOOP, FI_UINT64 },
+	{ "alltoall", bench_alltoall, FI_ALLTOALL, FI_NOOP, FI_UINT64 },
+	{ "allreduce", bench_allreduce, FI_ALLREDUCE, FI_SUM, FI_UINT64 },
+	{ "allgather", bench_allgather, FI_ALLGATHER, FI_NOOP, FI_UINT64 },
+	{ "reduce_scatter", bench_reduce_scatter, FI_REDUCE_SCATTER, FI_SUM,
+	  FI_UINT64 },
+	{ "reduce", bench_reduce, FI_REDUCE, FI_SUM, FI_UINT64 },
+	{ "scatter", bench_scatter, FI_SCATTER, FI_NOOP, FI_UINT64 },
+	{ "gather", bench_gather, FI_GATHER, FI_NOOP, FI_UINT64 },
+	{ NULL },
+};
+
+static int bench_post_wait(struct coll_bench *bench, void *buf, void *result,
+			   size_t count)
+{
+	uint64_t done_flag;
+	int ret;
+
+	ret = bench->post(buf, result, count, &done_flag);
+	if (ret) {
+		FT_ERR("%s failed: %d (%s)\n", bench->name, ret,
+		       fi_strerror(-ret));
+		return ret;
+	}
+
+	return wait_for_comp(&done_flag);
+}
+
+/*
+ * Run one collective at one size and report the per-iteration latency
+ * across all ranks.  Algorithm bandwidth is the per-rank payload divided
+ * by the latency of the slowest rank, as the operation is not complete
+ * until every rank has finished it.
+ */
+static int bench_run_size(struct coll_bench *bench, size_t size)
+{
+	uint64_t *buf, *result, *elapsed;
+	uint64_t start, min, max, sum;
+	size_t count, i;
+	int ret;
+
+	count = size / sizeof(*buf);
+	buf = calloc(count * pm_job.num_ranks + 1, sizeof(*buf));
+	result = calloc(count * pm_job.num_ranks + 1, sizeof(*result));
+	elapsed = calloc(pm_job.num_ranks, sizeof(*elapsed));
+	if (!buf || !result || !elapsed) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < count * pm_job.num_ranks; i++)
+		buf[i] = pm_job.my_rank + i;
+
+	for (i = 0; i < opts.warmup_iterations; i++) {
+		ret = bench_post_wait(bench, buf, result, count);
+		if (ret)
+			goto out;
+	}
+
+	pm_barrier();
+	start = ft_gettime_ns();
+	for (i = 0; i < opts.iterations; i++) {
+		ret = bench_post_wait(bench, buf, result, count);
+		if (ret)
+			goto out;
+	}
+	start = ft_gettime_ns() - start;
+
+	ret = pm_allgather(&start, elapsed, sizeof(start));
+	if (ret) {
+		FT_PRINTERR("pm_allgather", ret);
+		goto out;
+	}
+
+	if (pm_job.my_rank)
+		goto out;
+
+	min = max = sum = elapsed[0];
+	for (i = 1; i < pm_job.num_ranks; i++) {
+		min = MIN(min, elapsed[i]);
+		max = MAX(max, elapsed[i]);
+		sum += elapsed[i];
+	}
+
+	printf("%-10zu %-8d %-12.2f %-12.2f %-12.2f ", size, opts.iterations,
+	       sum / 1000.0 / pm_job.num_ranks / opts.iterations,
+	       min / 1000.0 / opts.iterations, max / 1000.0 / opts.iterations);
+	if (size)
+		printf("%.2f\n", (double) size * opts.iterations * 1000.0 / max);
+	else
+		printf("--\n");
+out:
+	free(elapsed);
+	free(result);
+	free(buf);
+	return ret;
+}
+
+static int bench_run(struct coll_bench *bench)
+{
+	size_t max_size = fi->ep_attr->max_msg_size / pm_job.num_ranks;
+	int i, ret;
+
+	if (pm_job.my_rank == 0) {
+		printf("# %s: %zu ranks\n", bench->name, pm_job.num_ranks);
+		printf("%-10s %-8s %-12s %-12s %-12s %s\n", "bytes", "iters",
+		       "avg_usec", "min_usec", "max_usec", "algbw_MB/sec");
+	}
+
+	if (bench->coll_op == FI_BARRIER)
+		return bench_run_size(bench, 0);
+
+	if (opts.options & FT_OPT_SIZE) {
+		if (opts.transfer_size < sizeof(uint64_t)) {
+			FT_ERR("transfer size must be at least %zu bytes\n",
+			       sizeof(uint64_t));
+			return -FI_EINVAL;
+		}
+		return bench_run_size(bench, opts.transfer_size);
+	}
+
+	for (i = 0; i < TEST_CNT; i++) {
+		if (!ft_use_size(i, opts.sizes_enabled) ||
+		    test_size[i].size < sizeof(uint64_t) ||
+		    test_size[i].size > max_size)
+			continue;
+
+		ret = bench_run_size(bench, test_size[i].size);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Benchmark mode (-T): sweep message sizes for every collective that the
+ * provider reports support for, instead of checking correctness.
+ */
+static int multinode_run_bench(void)
+{
+	struct coll_bench *bench;
+	int ret;
+
+	ret = coll_setup();
+	if (ret)
+		return ret;
+
+	coll_addr = fi_mc_addr(coll_mc);
+	for (bench = benches; bench->name; bench++) {
+		ret = test_query(bench->coll_op, bench->op, bench->datatype);
+		if (ret) {
+			if (pm_job.my_rank == 0)
+				printf("# %s: not supported\n", bench->name);
+			ret = FI_SUCCESS;
+			continue;
+		}
+
+		ret = bench_run(bench);
+		if (ret)
+			break;
+	}
+
+	pm_barrier();
+	if (ret)
+		coll_teardown();
+	else
+		ret = coll_teardown();
+	return ret;
+}
+
 static inline void setup_hints()
 {
 	hints->ep_attr->type = FI_EP_RDM;
@@ -613,6 +847,11 @@ int multinode_run_tests(int argc, char **argv)
 	if (ret)
 		return ret;
 
+	if (ft_check_opts(FT_OPT_PERF)) {
+		ret = multinode_run_bench();
+		goto out;
+	}
+
 	for (test = tests; test->run && !ret; test++) {
 		FT_DEBUG("Running Test: %s", test->name);
 		ret = test_query(test->coll_op, test->op, test->datatype);
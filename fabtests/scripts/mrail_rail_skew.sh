@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Check that the ofi_mrail adaptive policy moves traffic away from a slow
+# rail. Two tcp rails are opened on 127.0.0.1 and 127.0.0.2 over loopback,
+# and the traffic to 127.0.0.2 is rate limited with an htb class. The
+# bandwidth test is run with the striping and the adaptive policies, and
+# the share of bytes carried by the slow rail is reported for each.
+#
+# Requires root (tc) and the fabtests binaries in PATH. The qdisc on lo is
+# replaced while the test runs and removed on exit.
+
+rate=200mbit
+size=1048576
+iters=40
+policies="striping adaptive"
+bin=fi_rdm_tagged_bw
+prov="tcp;ofi_rxm;ofi_mrail"
+tmo=180
+
+usage() {
+	echo "usage: $0 [-r slow_rail_rate] [-S size] [-I iterations] [-t timeout]"
+	echo "  -r  tc rate of the second rail (default $rate)"
+	echo "  -S  message size (default $size)"
+	echo "  -I  iterations (default $iters)"
+	echo "  -t  per run timeout in seconds (default $tmo)"
+	exit 1
+}
+
+while getopts "r:S:I:t:h" opt; do
+	case $opt in
+	r) rate=$OPTARG ;;
+	S) size=$OPTARG ;;
+	I) iters=$OPTARG ;;
+	t) tmo=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+
+cleanup() {
+	tc qdisc del dev lo root 2> /dev/null
+}
+
+class_bytes() {
+	tc -s class show dev lo | \
+		awk -v c=$1 '$3 == c {f = 1} f && /Sent/ {print $2; exit}'
+}
+
+run_policy() {
+	local r0 r1 d0 d1 srv_rc cli_rc
+
+	export FI_OFI_MRAIL_CONFIG="-1:$1"
+	r0=$(class_bytes 1:10)
+	r1=$(class_bytes 1:20)
+
+	timeout $tmo $bin -p "$prov" -E -S $size -I $iters -W 8 > /dev/null 2>&1 &
+	sleep 1
+	timeout $tmo $bin -p "$prov" -E -S $size -I $iters -W 8 127.0.0.1 | tail -1
+	cli_rc=${PIPESTATUS[0]}
+	wait $!
+	srv_rc=$?
+
+	d0=$(($(class_bytes 1:10) - r0))
+	d1=$(($(class_bytes 1:20) - r1))
+	if [ $srv_rc -ne 0 ] || [ $cli_rc -ne 0 ] || [ $((d0 + d1)) -eq 0 ]; then
+		echo "$1: run failed (server $srv_rc, client $cli_rc)"
+		return 1
+	fi
+	echo "$1: rail0 $((d0 >> 20)) MiB, rail1 $((d1 >> 20)) MiB," \
+	     "rail1 share $((100 * d1 / (d0 + d1)))%"
+	eval share_$1=$((100 * d1 / (d0 + d1)))
+}
+
+trap cleanup EXIT
+cleanup
+tc qdisc add dev lo root handle 1: htb default 10 || exit 1
+tc class add dev lo parent 1: classid 1:10 htb rate 10gbit
+tc class add dev lo parent 1: classid 1:20 htb rate $rate ceil $rate
+tc filter add dev lo parent 1: protocol ip prio 1 u32 \
+	match ip dst 127.0.0.2/32 flowid 1:20
+
+export FI_OFI_MRAIL_ADDR=127.0.0.1,127.0.0.2
+
+for p in $policies; do
+	run_policy $p || exit 1
+done
+
+if [ $share_adaptive -ge $share_striping ]; then
+	echo "FAIL: adaptive did not move traffic off the slow rail"
+	exit 1
+fi
+echo "PASS"
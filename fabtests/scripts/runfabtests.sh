@@ -63,6 +63,7 @@ declare C_ARGS=""
 declare S_ARGS=""
 declare PIN_CORE=""
 declare PROVIDER_TESTS=0
+declare cs_check=""
 declare gdb_cmd=""
 
 declare cur_excludes=""
@@ -179,6 +180,9 @@ short_tests=(
 	"fi_rdm_tagged_bw -I 5 -U"
 	"fi_rdm_tagged_bw -I 5 -v"
 	"fi_rdm_tagged_bw -I 5 -v -U"
+	"fi_rdm_mt_bw -I 5 -v"
+	"fi_rdm_mt_bw -I 5 -v -x safe"
+	"fi_rdm_tagged_match -I 5 -x 50 -r rand"
 	"fi_dgram_pingpong -I 5"
 )
 
@@ -219,6 +223,10 @@ standard_tests=(
 	"fi_rdm_tagged_bw -U"
 	"fi_rdm_tagged_bw -v"
 	"fi_rdm_tagged_bw -v -U"
+	"fi_rdm_mt_bw -v"
+	"fi_rdm_mt_bw -v -x safe"
+	"fi_rdm_tagged_match"
+	"fi_rdm_tagged_match -x 50 -r rand"
 	"fi_dgram_pingpong"
 	"fi_dgram_pingpong -k"
 )
@@ -233,6 +241,9 @@ unit_tests=(
 	"fi_mr_test"
 	"fi_cntr_test"
 	"fi_setopt_test"
+	"fi_rdm_wireup -n 16 -s SERVER_ADDR"
+	"fi_rdm_incast -n 4 -I 100 -s SERVER_ADDR"
+	"fi_mr_perf -I 100"
 )
 
 regression_tests=(
@@ -247,6 +258,8 @@ multinode_tests=(
 	"fi_multinode -C msg"
 	"fi_multinode -C rma"
 	"fi_multinode_coll"
+	"fi_multinode_coll -T -S 65536 -I 5"
+	"fi_multinode_coll -T -S 1048576 -I 5"
 )
 
 prov_efa_tests=( \
@@ -279,6 +292,16 @@ prov_efa_tests=( \
 	"fi_efa_rnr_queue_resend -c 1 -A write -U -S 4"
 )
 
+# Run with FI_OFI_RXD_DROP_RATE set, see prov_ofi_rxd_test
+prov_ofi_rxd_tests=(
+	"fi_rdm_tagged_pingpong -v -I 100"
+	"fi_rdm_tagged_bw -v -I 100"
+	"fi_rdm_tagged_bw -v -I 20 -S 65536"
+	"fi_rma_bw -e rdm -o write -v -I 20"
+	"fi_rma_bw -e rdm -o read -v -I 20"
+	"fi_rma_bw -e rdm -o writedata -v -I 20"
+)
+
 function errcho {
 	>&2 echo $*
 }
@@ -536,6 +559,10 @@ function cs_test {
 	wait $s_pid
 	s_ret=$?
 
+	if [[ $s_ret -eq 0 && $c_ret -eq 0 && -n $cs_check ]]; then
+		$cs_check || c_ret=1
+	fi
+
 	end_time=$(date '+%s')
 	test_time=$(compute_duration "$start_time" "$end_time")
 
@@ -750,6 +777,38 @@ function prov_efa_test {
 	done
 }
 
+# rxd drops every Nth received packet.  The tests verify the data they
+# receive, and the endpoint close log must show that packets were resent.
+function rxd_retrans_check {
+	grep -qE "retransmitted [1-9]" $s_outp $c_outp
+}
+
+function prov_ofi_rxd_test {
+	local export_env=$EXPORT_ENV
+	local test_exe
+
+	# FI_OFI_RXD_DROP_RATE only exists in debug builds of libfabric
+	if ! ${SERVER_CMD} "${EXPORT_ENV} fi_info -e" 2> /dev/null |
+	     grep -q FI_OFI_RXD_DROP_RATE; then
+		for test in "${prov_ofi_rxd_tests[@]}"; do
+			test_exe="${test} -p \"${PROV}\""
+			print_results "$test_exe" "Notrun" "0" "" ""
+			skip_count+=1
+		done
+		return
+	fi
+
+	EXPORT_ENV="$export_env export FI_OFI_RXD_DROP_RATE=7 ;"
+	EXPORT_ENV="$EXPORT_ENV export FI_LOG_LEVEL=info ;"
+	EXPORT_ENV="$EXPORT_ENV export FI_LOG_PROV=ofi_rxd ;"
+	cs_check=rxd_retrans_check
+	for test in "${prov_ofi_rxd_tests[@]}"; do
+		cs_test "$test"
+	done
+	cs_check=""
+	EXPORT_ENV=$export_env
+}
+
 function set_core_util {
 	prov_arr=$(echo $PROV | tr ";" " ")
 	CORE=""
@@ -845,7 +904,11 @@ function main {
 	done
 
 	if [[ $PROVIDER_TESTS -eq 1 ]]; then
-		prov_${PROV}_test
+		if [[ -n $UTIL ]]; then
+			prov_${UTIL}_test
+		else
+			prov_${PROV}_test
+		fi
 	fi
 
 	total=$(( $pass_count + $fail_count ))
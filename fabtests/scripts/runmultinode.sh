@@ -1,7 +1,7 @@
 #!/bin/bash
 
-Options=$(getopt --options h:,n:,p:,I:,C:,z: \
-		  		--longoptions hosts:,processes-per-node:,provider:,capability:,iterations:,ci:,cleanup,help \
+Options=$(getopt --options h:,n:,p:,I:,C:,z:,S: \
+		  		--longoptions hosts:,processes-per-node:,provider:,capability:,iterations:,pattern:,size:,ci:,cleanup,help \
 				-- "$@")
 
 eval set -- "$Options"
@@ -10,6 +10,7 @@ hosts=[]
 ppn=1
 iterations=1
 pattern=""
+size=""
 capability="msg"
 cleanup=false
 help=false
@@ -27,6 +28,8 @@ while true; do
 			iterations=$2; shift 2 ;;
 		-z|--pattern)
 			pattern="-z $2"; shift 2 ;;
+		-S|--size)
+			size="-S $2"; shift 2 ;;
 		--cleanup)
 			cleanup=true; shift ;;
 		-C|--capability)
@@ -48,13 +51,27 @@ if $help ; then
 	echo "\t-n,--processes-per-node number of processes to be run on each node.\
 				Total number of fi_mulinode tests run will be n*number of hosts"
 	echo "\t-p,--provider libfabric provider to run the multinode tests on"
-	echo "\t-C,--cabability multinode cabability to use (rma or default: msg)"
+	echo "\t-C,--cabability multinode cabability to use (rma, coll or default: msg)"
+	echo "\t\tcoll sweeps sizes for every supported collective (-S all for all sizes)"
 	echo "\t-I,-- iterations number of iterations for the multinode test \
 				to run each pattern on"
+	echo "\t-z,--pattern run a single pattern (full_mesh, ring, gather, broadcast)"
+	echo "\t-S,--size transfer size in bytes for each send"
 	echo "\t--cleanup end straggling processes. Does not rerun tests"
 	echo "\t--help show this message"
 	exit 1
 fi
+
+# Run a command on a node, locally when the node is this host
+run_on() {
+	local node=$1
+	shift
+	if [ "$node" == "localhost" ] || [ "$node" == "127.0.0.1" ]; then
+		bash -c "$*"
+	else
+		ssh $node "$*"
+	fi
+}
 		
 num_hosts=${#hosts[@]}
 max_ranks=$(($num_hosts*$ppn))
@@ -65,16 +82,20 @@ output="multinode_server_${num_hosts}_${ppn}.log"
 ret=0
 
 if ! $cleanup ; then
-	cmd="${ci}fi_multinode -n $ranks -s $server -p '$provider' -C $capability $pattern -I $iterations -T"
+	if [ "$capability" == "coll" ]; then
+		cmd="${ci}fi_multinode_coll -n $ranks -s $server -p '$provider' $size -I $iterations -T"
+	else
+		cmd="${ci}fi_multinode -n $ranks -s $server -p '$provider' -C $capability $pattern $size -I $iterations -T"
+	fi
 	echo $cmd
 	for node in "${hosts[@]}"; do
 		for i in $(seq 1 $ppn); do
 			if [ $start_server -eq 0 ]; then
 				echo STARTING SERVER
 				if [ "$ci" == "" ]; then
-					ssh $node $cmd &> $output &
+					run_on $node $cmd &> $output &
 				else 
-					ssh $node $cmd | tee $output &
+					run_on $node $cmd | tee $output &
 				fi
 				server_pid=$!
 				start_server=1
@@ -84,7 +105,7 @@ if ! $cleanup ; then
 				if [ "$ci" == "" ]; then
 					tput cuu1
 				fi
-				ssh $node $cmd &> /dev/null &
+				run_on $node $cmd &> /dev/null &
 			fi
 			sleep .05
 		done
@@ -97,7 +118,7 @@ fi
 
 echo Cleaning up
 for node in "${hosts[@]}"; do
-	ssh $node "ps -eo comm,pid | grep '^fi_multinode' | awk '{print \$2}' | xargs kill -9" >& /dev/null
+	run_on $node "ps -eo comm,pid | grep '^fi_multinode' | awk '{print \$2}' | xargs kill -9" >& /dev/null
 done;
 
 if ! $cleanup ; then
@@ -49,6 +49,7 @@
 char *good_address;
 int num_good_addr;
 char *bad_address;
+static size_t bench_count;
 
 static enum fi_av_type av_type;
 
@@ -1029,6 +1030,93 @@ fail:
 	return TEST_RET_VAL(ret, testret);
 }
 
+/*
+ * Times inserting bench_count addresses one per call against a single
+ * vector insert, then checks that both AVs assigned the same fi_addr and
+ * that the vector inserted AV returns every address.
+ */
+static int
+av_insert_bench(void)
+{
+	struct sockaddr_in base, *addrs = NULL, addr;
+	fi_addr_t *one = NULL, *vec = NULL;
+	struct fid_av *av_one = NULL, *av_vec = NULL;
+	struct fi_av_attr attr;
+	uint64_t start, t_one, t_vec;
+	size_t i, addrlen;
+	int ret, failed = 1;
+
+	if (av_get_addrlen(fi) != sizeof(base) ||
+	    av_create_addr_sockaddr_in(good_address, 0, &base)) {
+		printf("AV insert benchmark: %s\n", err_buf);
+		return 1;
+	}
+
+	addrs = calloc(bench_count, sizeof(*addrs));
+	one = calloc(bench_count, sizeof(*one));
+	vec = calloc(bench_count, sizeof(*vec));
+	if (!addrs || !one || !vec)
+		goto out;
+
+	for (i = 0; i < bench_count; i++) {
+		addrs[i] = base;
+		addrs[i].sin_addr.s_addr = htonl(ntohl(base.sin_addr.s_addr) +
+						 (uint32_t) (i / 60000));
+		addrs[i].sin_port = htons(1024 + i % 60000);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = av_type;
+	attr.count = bench_count;
+	ret = fi_av_open(domain, &attr, &av_one, NULL);
+	if (!ret)
+		ret = fi_av_open(domain, &attr, &av_vec, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_av_open", ret);
+		goto out;
+	}
+
+	start = ft_gettime_ns();
+	for (i = 0; i < bench_count; i++) {
+		ret = fi_av_insert(av_one, &addrs[i], 1, &one[i], 0, NULL);
+		if (ret != 1) {
+			FT_PRINTERR("fi_av_insert", ret);
+			goto out;
+		}
+	}
+	t_one = ft_gettime_ns() - start;
+
+	start = ft_gettime_ns();
+	ret = fi_av_insert(av_vec, addrs, bench_count, vec, 0, NULL);
+	t_vec = ft_gettime_ns() - start;
+	if (ret != (int) bench_count) {
+		FT_PRINTERR("fi_av_insert", ret);
+		goto out;
+	}
+
+	for (i = 0; i < bench_count; i++) {
+		addrlen = sizeof(addr);
+		if (one[i] != vec[i] ||
+		    fi_av_lookup(av_vec, vec[i], &addr, &addrlen) ||
+		    memcmp(&addr, &addrs[i], sizeof(addr))) {
+			printf("AV insert benchmark: address %zu differs\n", i);
+			goto out;
+		}
+	}
+
+	printf("AV insert of %zu addresses: %.2f ns/addr one per call, "
+	       "%.2f ns/addr as one vector\n", bench_count,
+	       (double) t_one / bench_count, (double) t_vec / bench_count);
+	failed = 0;
+out:
+	FT_CLOSE_FID(av_one);
+	FT_CLOSE_FID(av_vec);
+	free(vec);
+	free(one);
+	free(addrs);
+	return failed;
+}
+
 struct test_entry test_array_good[] = {
 	TEST_ENTRY(av_open_close, "Test open and close AVs of varying sizes"),
 	TEST_ENTRY(av_good_sync, "Test sync AV insert with good address"),
@@ -1070,6 +1158,9 @@ run_test_set()
 	printf("\nTesting with invalid address\n");
 	failed += run_tests(test_array_bad, err_buf);
 
+	if (bench_count)
+		failed += av_insert_bench();
+
 	return failed;
 }
 
@@ -1081,6 +1172,8 @@ static void usage(char *name)
 	fprintf(stderr, FT_OPTS_USAGE_FORMAT " (max=%d)\n", "-n <num_good_addr>",
 			"Number of good addresses", MAX_ADDR - 1);
 	FT_PRINT_OPTS_USAGE("-s <source_address>", "");
+	FT_PRINT_OPTS_USAGE("-b <count>",
+			    "Benchmark inserting count addresses");
 }
 
 int main(int argc, char **argv)
@@ -1096,7 +1189,7 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 
 	hints->ep_attr->type = FI_EP_RDM;
-	while ((op = getopt(argc, argv, INFO_OPTS "g:G:n:s:h")) != -1) {
+	while ((op = getopt(argc, argv, INFO_OPTS "g:G:n:s:b:h")) != -1) {
 		switch (op) {
 		case 'g':
 			good_address = optarg;
@@ -1110,6 +1203,9 @@ int main(int argc, char **argv)
 		case 's':
 			opts.src_addr = optarg;
 			break;
+		case 'b':
+			bench_count = strtoul(optarg, NULL, 0);
+			break;
 		default:
 			ft_parseinfo(op, optarg, hints, &opts);
 			break;
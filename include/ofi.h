@@ -260,12 +260,24 @@ struct fid_nic *ofi_nic_dup(const struct fid_nic *nic);
 
 void fi_log_init(void);
 void fi_log_fini(void);
+/* Stops queuing log messages and writes out those already queued */
+void fi_log_drain(void);
 void fi_param_init(void);
 void fi_param_fini(void);
 void fi_param_undefine(const struct fi_provider *provider);
 void ofi_remove_comma(char *buffer);
 void ofi_dump_sysconfig(void);
 
+void ofi_load_lazy_provs(char **names);
+void ofi_getinfo_cache_init(uint64_t prov_id);
+int ofi_getinfo_cache_get(uint32_t version, const char *node,
+			  const char *service, uint64_t flags,
+			  const struct fi_info *hints, struct fi_info **info);
+void ofi_getinfo_cache_put(uint32_t version, const char *node,
+			   const char *service, uint64_t flags,
+			   const struct fi_info *hints,
+			   const struct fi_info *info);
+
 const char *ofi_hex_str(const uint8_t *data, size_t len);
 
 #define MAX_IPC_HANDLE_SIZE	64
@@ -325,10 +325,27 @@ enum {
 	OFI_BUFPOOL_NO_TRACK		= 1 << 2,
 	OFI_BUFPOOL_HUGEPAGES		= 1 << 3,
 	OFI_BUFPOOL_NONSHARED		= 1 << 4,
+	OFI_BUFPOOL_THREAD_CACHE	= 1 << 5,
 };
 
 struct ofi_bufpool_region;
 
+/*
+ * With OFI_BUFPOOL_THREAD_CACHE, free buffers are also kept in per-thread
+ * caches, selected by hashing the thread, which are refilled from and
+ * drained to the pool's free list in batches.  Buffers may then be
+ * allocated and freed without serializing the calls.  Cached pools cannot
+ * be indexed.
+ */
+#define OFI_BUFPOOL_CACHE_MAX	32
+#define OFI_BUFPOOL_CACHE_ALIGN	64
+
+struct ofi_bufpool_cache {
+	ofi_spin_t			lock;
+	struct slist			free_list;
+	size_t				cnt;
+} __attribute__((aligned(OFI_BUFPOOL_CACHE_ALIGN)));
+
 struct ofi_bufpool_attr {
 	size_t 		size;
 	size_t 		alignment;
@@ -355,6 +372,11 @@ struct ofi_bufpool {
 	size_t				alloc_size;
 	size_t				region_size;
 	struct ofi_bufpool_attr		attr;
+
+	/* protect the free list and growth of cached pools */
+	ofi_mutex_t			lock;
+	struct ofi_bufpool_cache	*cache;
+	size_t				cache_mask;
 };
 
 struct ofi_bufpool_region {
@@ -406,6 +428,8 @@ ofi_bufpool_create(struct ofi_bufpool **buf_pool,
 void ofi_bufpool_destroy(struct ofi_bufpool *pool);
 
 int ofi_bufpool_grow(struct ofi_bufpool *pool);
+void *ofi_bufpool_cache_alloc(struct ofi_bufpool *pool);
+void ofi_bufpool_cache_free(struct ofi_bufpool *pool, void *buf);
 
 static inline struct ofi_bufpool_hdr *ofi_buf_hdr(void *buf)
 {
@@ -437,6 +461,11 @@ static inline void ofi_buf_free(void *buf)
 	assert(ofi_buf_hdr(buf)->magic == OFI_MAGIC_SIZE_T);
 	assert(ofi_buf_hdr(buf)->ftr->magic == OFI_MAGIC_SIZE_T);
 
+	if (ofi_buf_pool(buf)->attr.flags & OFI_BUFPOOL_THREAD_CACHE) {
+		ofi_bufpool_cache_free(ofi_buf_pool(buf), buf);
+		return;
+	}
+
 	slist_insert_head(&ofi_buf_hdr(buf)->entry.slist,
 			  &ofi_buf_pool(buf)->free_list.entries);
 }
@@ -495,6 +524,9 @@ static inline void *ofi_buf_alloc(struct ofi_bufpool *pool)
 	struct ofi_bufpool_hdr *buf_hdr;
 
 	assert(!(pool->attr.flags & OFI_BUFPOOL_INDEXED));
+	if (pool->attr.flags & OFI_BUFPOOL_THREAD_CACHE)
+		return ofi_bufpool_cache_alloc(pool);
+
 	if (ofi_bufpool_empty(pool)) {
 		if (ofi_bufpool_grow(pool))
 			return NULL;
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Live metrics.  When FI_METRICS is enabled, counters and gauges
+ * registered by providers are kept in a shared memory segment,
+ * /dev/shm/fi_metrics.<pid>.<n>, which fi_top reads while the process
+ * runs.  Each copy of the util code, i.e. libfabric itself and every
+ * provider built as a DSO, owns its own segment.  Each value sits in its
+ * own cache line and is updated without locked instructions, and readers
+ * get no ordering between values.  When metrics are disabled or the
+ * segment is full, a metric is backed by its local field and updates
+ * cost the same.
+ */
+
+#ifndef _OFI_METRICS_H_
+#define _OFI_METRICS_H_
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ofi_osd.h>
+#include <rdma/providers/fi_prov.h>
+
+#define OFI_METRICS_MAGIC	0x5343495254454d46ULL	/* "FMETRICS" */
+#define OFI_METRICS_VERSION	1
+#define OFI_METRICS_SLOTS	1024
+#define OFI_METRICS_NAME_MAX	48
+#define OFI_METRICS_PREFIX	"fi_metrics."
+
+enum ofi_metric_type {
+	OFI_METRIC_COUNTER,	/* monotonic, fi_top reports a rate */
+	OFI_METRIC_GAUGE,	/* current level */
+};
+
+/*
+ * gen is odd while the slot is in use and advances whenever the slot is
+ * claimed or released, so a reader can tell a reused slot apart.
+ */
+struct ofi_metrics_slot {
+	uint64_t	value;
+	uint32_t	gen;
+	uint16_t	type;
+	uint16_t	resv;
+	char		name[OFI_METRICS_NAME_MAX];
+};
+
+struct ofi_metrics_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	slot_size;
+	uint32_t	slot_cnt;
+	uint32_t	pid;
+	/* slots below used have been claimed at least once */
+	uint32_t	used;
+	uint8_t		resv[36];
+};
+
+struct ofi_metric {
+	uint64_t		*value;
+	struct ofi_metrics_slot	*slot;
+	uint64_t		local;
+};
+
+void ofi_metrics_init(void);
+void ofi_metrics_cleanup(void);
+
+/* name is reported as <prov name>/<name> */
+void ofi_metric_init(struct ofi_metric *metric, const struct fi_provider *prov,
+		     const char *name, enum ofi_metric_type type);
+void ofi_metric_fini(struct ofi_metric *metric);
+
+/*
+ * Each metric has a single writer at a time, normally the holder of the
+ * lock protecting the object that owns it.  Updates are a relaxed load
+ * and store, which compile to plain moves on common architectures.
+ */
+static inline void ofi_metric_add(struct ofi_metric *metric, uint64_t n)
+{
+	ofi_atomic_store_explicit(64, metric->value,
+		ofi_atomic_load_explicit(64, metric->value,
+					 memory_order_relaxed) + n,
+		memory_order_relaxed);
+}
+
+static inline void ofi_metric_sub(struct ofi_metric *metric, uint64_t n)
+{
+	ofi_metric_add(metric, -n);
+}
+
+static inline void ofi_metric_inc(struct ofi_metric *metric)
+{
+	ofi_metric_add(metric, 1);
+}
+
+static inline void ofi_metric_dec(struct ofi_metric *metric)
+{
+	ofi_metric_sub(metric, 1);
+}
+
+static inline void ofi_metric_set(struct ofi_metric *metric, uint64_t value)
+{
+	ofi_atomic_store_explicit(64, metric->value, value,
+				  memory_order_relaxed);
+}
+
+static inline uint64_t ofi_metric_get(struct ofi_metric *metric)
+{
+	return ofi_atomic_load_explicit(64, metric->value, memory_order_relaxed);
+}
+
+#endif /* _OFI_METRICS_H_ */
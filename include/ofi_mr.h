@@ -47,6 +47,7 @@
 #include <ofi_atom.h>
 #include <ofi_lock.h>
 #include <ofi_list.h>
+#include <ofi_metrics.h>
 #include <ofi_tree.h>
 
 int ofi_open_mr_cache(uint32_t version, void *attr, size_t attr_len,
@@ -329,10 +330,10 @@ struct ofi_mr_cache {
 	size_t				cached_size;
 	size_t				uncached_cnt;
 	size_t				uncached_size;
-	size_t				search_cnt;
-	size_t				delete_cnt;
-	size_t				hit_cnt;
-	size_t				notify_cnt;
+	struct ofi_metric		search_cnt;
+	struct ofi_metric		delete_cnt;
+	struct ofi_metric		hit_cnt;
+	struct ofi_metric		notify_cnt;
 	struct ofi_bufpool		*entry_pool;
 
 	int				(*add_region)(struct ofi_mr_cache *cache,
@@ -314,6 +314,28 @@ HOOK_DMABUF_PEER_MEM_INI ;
 #  define HOOK_DMABUF_PEER_MEM_INIT NULL
 #endif
 
+#if (HAVE_HOOK_LATENCY) && (HAVE_HOOK_LATENCY_DL)
+#  define HOOK_LATENCY_INI FI_EXT_INI
+#  define HOOK_LATENCY_INIT NULL
+#elif (HAVE_HOOK_LATENCY)
+#  define HOOK_LATENCY_INI INI_SIG(fi_hook_latency_ini)
+#  define HOOK_LATENCY_INIT fi_hook_latency_ini()
+HOOK_LATENCY_INI ;
+#else
+#  define HOOK_LATENCY_INIT NULL
+#endif
+
+#if (HAVE_HOOK_NETEM) && (HAVE_HOOK_NETEM_DL)
+#  define HOOK_NETEM_INI FI_EXT_INI
+#  define HOOK_NETEM_INIT NULL
+#elif (HAVE_HOOK_NETEM)
+#  define HOOK_NETEM_INI INI_SIG(fi_hook_netem_ini)
+#  define HOOK_NETEM_INIT fi_hook_netem_ini()
+HOOK_NETEM_INI ;
+#else
+#  define HOOK_NETEM_INIT NULL
+#endif
+
 #  define HOOK_NOOP_INI INI_SIG(fi_hook_noop_ini)
 #  define HOOK_NOOP_INIT fi_hook_noop_ini()
 HOOK_NOOP_INI ;
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Reliable datagram engine.  Keeps the per peer state needed to deliver
+ * packets in order over an unreliable datagram transport: sequence
+ * numbers, the list of unacked packets, cumulative and range acks, RTT
+ * based retransmission and the set of packets held ahead of a gap.
+ *
+ * The engine does no I/O and does not define a wire format.  The owner
+ * embeds struct ofi_rdg_pkt in its packets and struct ofi_rdg_peer at the
+ * start of its per peer state, writes the sequence numbers and acks into
+ * its own headers, and calls back into the engine as packets are sent,
+ * completed and received.  Retransmissions, releases and batched acks are
+ * requested from the owner through struct ofi_rdg_ops.
+ *
+ * A packet may cover several consecutive sequence numbers, such as a
+ * window of segments sent from one buffer, and is acked segment by segment.
+ *
+ * The engine is not thread safe; the owner must serialize all calls.
+ */
+
+#ifndef _OFI_RDGRAM_H_
+#define _OFI_RDGRAM_H_
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ofi.h>
+#include <ofi_list.h>
+#include <ofi_util.h>
+
+#define OFI_RDG_RX_WORDS	4
+#define OFI_RDG_RX_BITS		(OFI_RDG_RX_WORDS * 64)
+#define OFI_RDG_MAX_SEGS	64
+#define OFI_RDG_INIT_RTO	1000	/* usec */
+#define OFI_RDG_MAX_RTO		4000000	/* usec */
+
+#define OFI_RDG_PKT_IN_USE	(1 << 0)
+#define OFI_RDG_PKT_ACKED	(1 << 1)
+#define OFI_RDG_PKT_RETRANS	(1 << 2)
+#define OFI_RDG_PKT_SACKED	(1 << 3)
+
+/*
+ * seg_cnt sequence numbers starting at seq_no, up to OFI_RDG_MAX_SEGS.
+ * The first acked_cnt have been cumulatively acked, and sacked has a bit
+ * set for each later one reported in a range ack.  send_cnt counts the
+ * sends the transport has not completed; the packet is in use until then.
+ */
+struct ofi_rdg_pkt {
+	struct dlist_entry	entry;
+	uint64_t		seq_no;
+	uint64_t		timestamp;
+	uint64_t		sacked;
+	uint32_t		seg_cnt;
+	uint32_t		acked_cnt;
+	uint32_t		send_cnt;
+	uint32_t		flags;
+};
+
+/*
+ * Packets received past the cumulative ack: seq_no + start through
+ * seq_no + start + len - 1, where seq_no is the next expected.
+ */
+struct ofi_rdg_range {
+	uint32_t	start;
+	uint32_t	len;
+};
+
+struct ofi_rdg_peer {
+	/* tx: next sequence number, cumulative ack from the peer */
+	uint64_t		tx_seq_no;
+	uint64_t		last_rx_ack;
+	struct dlist_entry	unacked;
+	uint32_t		unacked_cnt;
+	int			retry_cnt;
+
+	/* RTT estimation (usec): smoothed RTT, variance, retransmit timeout */
+	uint64_t		srtt;
+	uint64_t		rttvar;
+	uint64_t		rto;
+
+	/* rx: next sequence number expected, last one acked to the peer */
+	uint64_t		rx_seq_no;
+	uint64_t		last_tx_ack;
+
+	/* Sequence numbers held ahead of rx_seq_no, one bit per sequence
+	 * number modulo OFI_RDG_RX_BITS */
+	uint64_t		rx_held[OFI_RDG_RX_WORDS];
+	uint32_t		rx_held_cnt;
+
+	uint32_t		ack_pending;
+	struct dlist_entry	ack_entry;
+};
+
+struct ofi_rdg;
+
+struct ofi_rdg_ops {
+	/* Resend the segments of pkt given by ofi_rdg_pkt_todo().  A non
+	 * zero return stops further retransmissions for now. */
+	ssize_t	(*resend)(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt);
+	/* pkt was acked and the transport is done with it */
+	void	(*release)(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt);
+	/* Send an ack to the peer, which must call ofi_rdg_ack_sent() */
+	void	(*send_ack)(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer);
+	/* Congestion control events, optional */
+	void	(*ack)(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+		       uint32_t acked);
+	void	(*loss)(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			int timeout);
+};
+
+struct ofi_rdg_attr {
+	/* size of the owner's per peer state, which starts with
+	 * struct ofi_rdg_peer */
+	size_t			peer_size;
+	/* usec */
+	uint64_t		min_rto;
+	/* retransmission timeouts without progress before the peer is
+	 * reported as failed */
+	int			max_retry;
+	/* ack requests for a peer before its ack is sent without waiting
+	 * for ofi_rdg_flush_acks(), 1 to ack immediately */
+	uint32_t		ack_batch;
+	const struct ofi_rdg_ops *ops;
+};
+
+/* Per peer state is indexed by peer number, allocated on first use */
+struct ofi_rdg {
+	struct ofi_rdg_attr	attr;
+	struct ofi_rdg_peer	**peers;
+	size_t			peer_cnt;
+	struct dlist_entry	ack_list;
+};
+
+int ofi_rdg_init(struct ofi_rdg *rdg, const struct ofi_rdg_attr *attr);
+void ofi_rdg_close(struct ofi_rdg *rdg);
+
+static inline struct ofi_rdg_peer *ofi_rdg_peer(struct ofi_rdg *rdg,
+						uint64_t index)
+{
+	return index < rdg->peer_cnt ? rdg->peers[index] : NULL;
+}
+
+/* Allocates zeroed per peer state of attr.peer_size bytes */
+int ofi_rdg_peer_create(struct ofi_rdg *rdg, uint64_t index,
+			struct ofi_rdg_peer **peer);
+/* Releases every unacked packet, as when the peer fails or is closed */
+void ofi_rdg_peer_flush(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer);
+
+static inline uint64_t ofi_rdg_win_mask(uint32_t cnt)
+{
+	return cnt >= 64 ? ~0ULL : (1ULL << cnt) - 1;
+}
+
+static inline void ofi_rdg_pkt_init(struct ofi_rdg_pkt *pkt, uint32_t seg_cnt)
+{
+	pkt->seg_cnt = seg_cnt;
+	pkt->acked_cnt = 0;
+	pkt->sacked = 0;
+	pkt->send_cnt = 0;
+	pkt->flags = 0;
+}
+
+/* Sequence numbers of the packet still counted against the tx window */
+static inline uint32_t ofi_rdg_pkt_unacked(struct ofi_rdg_pkt *pkt)
+{
+	return pkt->seg_cnt - pkt->acked_cnt;
+}
+
+/*
+ * Segments to resend: those neither acked nor in a range ack, or the
+ * first unacked one if all of them are, since the cumulative ack that
+ * would have covered it may have been lost.
+ */
+static inline uint64_t ofi_rdg_pkt_todo(struct ofi_rdg_pkt *pkt)
+{
+	uint64_t todo;
+
+	todo = ofi_rdg_win_mask(pkt->seg_cnt) &
+	       ~ofi_rdg_win_mask(pkt->acked_cnt) & ~pkt->sacked;
+	return todo ? todo : 1ULL << pkt->acked_cnt;
+}
+
+/* One send of the packet was posted to the transport */
+static inline void ofi_rdg_pkt_sent(struct ofi_rdg_pkt *pkt)
+{
+	pkt->send_cnt++;
+	pkt->flags |= OFI_RDG_PKT_IN_USE;
+}
+
+/* Adds a sent packet, with seq_no and timestamp set, to the unacked list */
+static inline void ofi_rdg_insert(struct ofi_rdg_peer *peer,
+				  struct ofi_rdg_pkt *pkt)
+{
+	dlist_insert_tail(&pkt->entry, &peer->unacked);
+	peer->unacked_cnt += ofi_rdg_pkt_unacked(pkt);
+}
+
+/*
+ * A send of the packet completed.  Returns 1 if that released an acked
+ * packet, in which case pkt must no longer be accessed.
+ */
+int ofi_rdg_send_done(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt);
+
+/* Acks the whole packet outside of the sequence, such as a handshake */
+void ofi_rdg_pkt_acked(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+		       struct ofi_rdg_pkt *pkt);
+
+/* Oldest sequence number of an unacked packet that may still be in use */
+static inline uint64_t ofi_rdg_head_seq(struct ofi_rdg_peer *peer)
+{
+	struct ofi_rdg_pkt *pkt;
+
+	if (dlist_empty(&peer->unacked))
+		return peer->last_rx_ack;
+
+	pkt = container_of(peer->unacked.next, struct ofi_rdg_pkt, entry);
+	return pkt->flags & OFI_RDG_PKT_IN_USE ?
+	       pkt->seq_no : pkt->seq_no + pkt->acked_cnt;
+}
+
+/*
+ * Processes an ack from the peer: seq_no is the next sequence number it
+ * expects, followed by range_cnt ranges received beyond it.  Returns 0 if
+ * the ack carried nothing new.
+ */
+int ofi_rdg_recv_ack(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+		     uint64_t seq_no, const struct ofi_rdg_range *range,
+		     uint32_t range_cnt);
+
+/*
+ * Resends timed out packets.  Returns -FI_ETIMEDOUT once the peer has
+ * made no progress for attr.max_retry timeouts.
+ */
+int ofi_rdg_progress_peer(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			  uint64_t now);
+
+enum {
+	OFI_RDG_RX_NEXT,	/* the next sequence number expected */
+	OFI_RDG_RX_DUP,		/* already received or held */
+	OFI_RDG_RX_AHEAD,	/* past a gap, and can be held */
+	OFI_RDG_RX_BEYOND,	/* too far past a gap to be held */
+};
+
+static inline int ofi_rdg_rx_held(struct ofi_rdg_peer *peer, uint64_t seq_no)
+{
+	uint64_t bit = seq_no % OFI_RDG_RX_BITS;
+
+	return peer->rx_held[bit / 64] & (1ULL << (bit % 64)) ? 1 : 0;
+}
+
+static inline int ofi_rdg_rx_check(struct ofi_rdg_peer *peer, uint64_t seq_no)
+{
+	if (seq_no == peer->rx_seq_no)
+		return OFI_RDG_RX_NEXT;
+	if (ofi_before(seq_no, peer->rx_seq_no) ||
+	    ofi_rdg_rx_held(peer, seq_no))
+		return OFI_RDG_RX_DUP;
+	if (!ofi_before(seq_no, peer->rx_seq_no + OFI_RDG_RX_BITS))
+		return OFI_RDG_RX_BEYOND;
+	return OFI_RDG_RX_AHEAD;
+}
+
+/* The owner holds the packet, or its data, until the gap is filled */
+static inline void ofi_rdg_rx_hold(struct ofi_rdg_peer *peer, uint64_t seq_no)
+{
+	uint64_t bit = seq_no % OFI_RDG_RX_BITS;
+
+	peer->rx_held[bit / 64] |= 1ULL << (bit % 64);
+	peer->rx_held_cnt++;
+}
+
+static inline void ofi_rdg_rx_unhold(struct ofi_rdg_peer *peer,
+				     uint64_t seq_no)
+{
+	uint64_t bit = seq_no % OFI_RDG_RX_BITS;
+
+	if (!ofi_rdg_rx_held(peer, seq_no))
+		return;
+	peer->rx_held[bit / 64] &= ~(1ULL << (bit % 64));
+	peer->rx_held_cnt--;
+}
+
+/* The next expected sequence number was delivered */
+static inline void ofi_rdg_rx_next(struct ofi_rdg_peer *peer)
+{
+	ofi_rdg_rx_unhold(peer, peer->rx_seq_no);
+	peer->rx_seq_no++;
+}
+
+/* Everything before seq_no was delivered */
+void ofi_rdg_rx_skip(struct ofi_rdg_peer *peer, uint64_t seq_no);
+
+/* Fills in up to max ranges of held sequence numbers, returns the count */
+uint32_t ofi_rdg_ack_ranges(struct ofi_rdg_peer *peer,
+			    struct ofi_rdg_range *range, uint32_t max);
+
+/*
+ * Asks for an ack to be sent to the peer.  Requests are batched until
+ * ofi_rdg_flush_acks() or until attr.ack_batch of them are pending, so
+ * that a burst of received packets is covered by a single ack.
+ */
+void ofi_rdg_ack_req(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer);
+void ofi_rdg_flush_acks(struct ofi_rdg *rdg);
+
+/* Called by the owner whenever it sends an ack, batched or not */
+void ofi_rdg_ack_sent(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer);
+
+#endif /* _OFI_RDGRAM_H_ */
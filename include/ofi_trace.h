@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Binary trace rings.  Every thread that records an event gets its own
+ * file backed ring of fixed size records, <dir>/fi_trace.<pid>.<tid>,
+ * mapped shared so the data survives the process.  The owning thread is
+ * the only writer, so recording an event takes no locks: the record is
+ * filled in place and published by advancing head.  Once the ring wraps
+ * the oldest records are overwritten.  The files are converted to text
+ * or a Chrome trace by fi_tracedump.
+ */
+
+#ifndef _OFI_TRACE_H_
+#define _OFI_TRACE_H_
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ofi.h>
+
+#define OFI_TRACE_MAGIC		0x45434152544f4649ULL	/* "OFITRACE" */
+#define OFI_TRACE_VERSION	1
+#define OFI_TRACE_DEF_RECORDS	(1 << 16)
+
+enum ofi_trace_clock {
+	OFI_TRACE_CLOCK_MONO,	/* CLOCK_MONOTONIC, nsec */
+	OFI_TRACE_CLOCK_TSC,	/* invariant time stamp counter, ticks */
+};
+
+enum ofi_trace_op {
+	OFI_TRACE_RECV,
+	OFI_TRACE_RECVV,
+	OFI_TRACE_RECVMSG,
+	OFI_TRACE_SEND,
+	OFI_TRACE_SENDV,
+	OFI_TRACE_SENDMSG,
+	OFI_TRACE_INJECT,
+	OFI_TRACE_SENDDATA,
+	OFI_TRACE_INJECTDATA,
+	OFI_TRACE_READ,
+	OFI_TRACE_READV,
+	OFI_TRACE_READMSG,
+	OFI_TRACE_WRITE,
+	OFI_TRACE_WRITEV,
+	OFI_TRACE_WRITEMSG,
+	OFI_TRACE_INJECT_WRITE,
+	OFI_TRACE_WRITEDATA,
+	OFI_TRACE_INJECT_WRITEDATA,
+	OFI_TRACE_TRECV,
+	OFI_TRACE_TRECVV,
+	OFI_TRACE_TRECVMSG,
+	OFI_TRACE_TSEND,
+	OFI_TRACE_TSENDV,
+	OFI_TRACE_TSENDMSG,
+	OFI_TRACE_TINJECT,
+	OFI_TRACE_TSENDDATA,
+	OFI_TRACE_TINJECTDATA,
+	OFI_TRACE_CQ_ENTRY,
+	OFI_TRACE_CQ_ERROR,
+	OFI_TRACE_OP_MAX,
+};
+
+/*
+ * One event.  tag holds the tag for tagged operations and the target
+ * address for RMA.  For completions fid is the CQ, count the number of
+ * entries returned by the read that produced the event, and ret the
+ * error for OFI_TRACE_CQ_ERROR.
+ */
+struct ofi_trace_rec {
+	uint64_t	ts;
+	uint64_t	fid;
+	uint64_t	context;
+	uint64_t	len;
+	uint64_t	addr;
+	uint64_t	tag;
+	uint64_t	flags;
+	uint16_t	op;
+	int16_t		ret;
+	uint32_t	count;
+};
+
+/*
+ * File header, followed by capacity records.  For OFI_TRACE_CLOCK_TSC,
+ * a time stamp converts to nsec as sync_ns[0] + (ts - sync_tsc[0]) *
+ * tsc_mult / 2^32.  sync_*[1] is filled in when the ring is closed and
+ * gives a more precise rate for the run.
+ */
+struct ofi_trace_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	rec_size;
+	uint64_t	capacity;
+	/* total records written, the newest is at (head - 1) % capacity */
+	uint64_t	head;
+	uint32_t	pid;
+	uint32_t	tid;
+	uint32_t	clock;
+	uint32_t	resv;
+	uint64_t	tsc_mult;
+	uint64_t	sync_tsc[2];
+	uint64_t	sync_ns[2];
+	uint8_t		pad[40];
+};
+
+struct ofi_trace_ring {
+	struct dlist_entry	entry;
+	struct ofi_trace_hdr	*hdr;
+	struct ofi_trace_rec	*recs;
+	uint64_t		mask;
+	size_t			size;
+};
+
+static inline const char *ofi_trace_op_str(unsigned op)
+{
+	static const char *str[OFI_TRACE_OP_MAX] = {
+		"recv", "recvv", "recvmsg", "send", "sendv", "sendmsg",
+		"inject", "senddata", "injectdata",
+		"read", "readv", "readmsg", "write", "writev", "writemsg",
+		"inject_write", "writedata", "inject_writedata",
+		"trecv", "trecvv", "trecvmsg", "tsend", "tsendv", "tsendmsg",
+		"tinject", "tsenddata", "tinjectdata",
+		"cq_entry", "cq_error",
+	};
+
+	return op < OFI_TRACE_OP_MAX ? str[op] : "unknown";
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+static inline uint64_t ofi_trace_rdtsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+#else
+#define ofi_trace_rdtsc() 0
+#endif
+
+/*
+ * Rings are created under dir with room for records entries, rounded up
+ * to a power of two.  OFI_TRACE_CLOCK_TSC falls back to the monotonic
+ * clock if the processor does not have an invariant TSC.
+ */
+int ofi_trace_open(const char *dir, size_t records, enum ofi_trace_clock clock);
+void ofi_trace_close(void);
+int ofi_trace_enabled(void);
+
+/* Returns the calling thread's ring, creating it on first use */
+struct ofi_trace_ring *ofi_trace_ring_get(void);
+
+static inline uint64_t ofi_trace_now(struct ofi_trace_ring *ring)
+{
+	return ring->hdr->clock == OFI_TRACE_CLOCK_TSC ?
+	       ofi_trace_rdtsc() : ofi_gettime_ns();
+}
+
+/*
+ * The caller fills in the returned slot, except for the time stamp, and
+ * then publishes it with ofi_trace_commit().
+ */
+static inline struct ofi_trace_rec *
+ofi_trace_reserve(struct ofi_trace_ring *ring)
+{
+	return &ring->recs[ring->hdr->head & ring->mask];
+}
+
+static inline void
+ofi_trace_commit(struct ofi_trace_ring *ring, struct ofi_trace_rec *rec)
+{
+	rec->ts = ofi_trace_now(ring);
+	__atomic_store_n(&ring->hdr->head, ring->hdr->head + 1,
+			 __ATOMIC_RELEASE);
+}
+
+#endif /* _OFI_TRACE_H_ */
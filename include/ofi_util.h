@@ -411,6 +411,17 @@ struct util_wait;
 typedef void (*fi_wait_signal_func)(struct util_wait *wait);
 typedef int (*fi_wait_try_func)(struct util_wait *wait);
 
+/*
+ * An adaptive wait spins on progress before blocking, for up to twice the
+ * average time recent waits took, and does not spin at all once that
+ * exceeds spin_max.  See FI_WAIT_POLICY and FI_WAIT_SPIN_MAX.
+ */
+enum ofi_wait_policy {
+	OFI_WAIT_ADAPTIVE,
+	OFI_WAIT_SPIN,
+	OFI_WAIT_BLOCK,
+};
+
 struct util_wait {
 	struct fid_wait		wait_fid;
 	struct util_fabric	*fabric;
@@ -422,6 +433,11 @@ struct util_wait {
 	fi_wait_signal_func	signal;
 	fi_wait_try_func	wait_try;
 
+	enum ofi_wait_policy	policy;
+	/* in ns, wait_avg is updated without locking by each waiter */
+	uint64_t		spin_max;
+	uint64_t		wait_avg;
+
 	struct dlist_entry	fid_list;
 	ofi_mutex_t		lock;
 };
@@ -833,9 +849,14 @@ struct util_av {
 	ofi_mutex_t		ep_list_lock;
 	void			(*remove_handler)(struct util_ep *util_ep,
 						  struct util_peer_addr *peer);
+	/* set for named AVs, which are kept in shared memory */
+	struct util_shm		shm;
+	struct util_av_shm_hdr	*shm_hdr;
 };
 
 #define OFI_AV_DYN_ADDRLEN (1 << 0)
+/* addresses are only resolved through util_av, so the AV may be shared */
+#define OFI_AV_NAMED (1 << 1)
 
 struct util_av_attr {
 	/* Must be a multiple of 8 bytes */
@@ -914,6 +935,11 @@ int ofi_av_close_lightweight(struct util_av *av);
 
 size_t ofi_av_size(struct util_av *av);
 int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr);
+/* vector inserts of at least this many addresses use ofi_av_insert_addrs */
+#define OFI_AV_BULK_MIN 64
+size_t ofi_av_insert_addrs(struct util_av *av, const void *addr,
+			   size_t addrlen, size_t count, fi_addr_t *fi_addr,
+			   int *errs);
 int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr);
 fi_addr_t ofi_av_lookup_fi_addr_unsafe(struct util_av *av, const void *addr);
 fi_addr_t ofi_av_lookup_fi_addr(struct util_av *av, const void *addr);
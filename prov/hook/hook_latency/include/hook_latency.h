@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HOOK_LATENCY_H_
+#define _HOOK_LATENCY_H_
+
+#include "ofi_hook.h"
+#include "hook_ctx.h"
+#include "ofi_list.h"
+#include "ofi_lock.h"
+#include "ofi_mem.h"
+#include "ofi.h"
+
+/*
+ * Log-linear histogram: values below 2 * HOOK_LAT_SUB_BUCKETS get their own
+ * bucket, every power of two above that is split into HOOK_LAT_SUB_BUCKETS
+ * buckets, bounding the relative error of a reported value by
+ * 1 / HOOK_LAT_SUB_BUCKETS.  Values are in nsec and saturate at
+ * 2^HOOK_LAT_MAX_MSB (about 73 minutes).
+ */
+#define HOOK_LAT_SUB_BITS	5
+#define HOOK_LAT_SUB_BUCKETS	(1 << HOOK_LAT_SUB_BITS)
+#define HOOK_LAT_MAX_MSB	42
+#define HOOK_LAT_BUCKETS	(2 * HOOK_LAT_SUB_BUCKETS + \
+				 (HOOK_LAT_MAX_MSB - HOOK_LAT_SUB_BITS - 1) * \
+				 HOOK_LAT_SUB_BUCKETS)
+
+/* Message sizes are grouped by power of two, the last class is open ended */
+#define HOOK_LAT_SIZE_CLASSES	32
+
+struct hook_lat_hist {
+	uint64_t	min;
+	uint64_t	max;
+	uint64_t	bucket[HOOK_LAT_BUCKETS];
+};
+
+/*
+ * Histograms are only written by the owning thread, so recording a sample
+ * takes no locks.  Rows are allocated on first use.
+ */
+struct hook_lat_thread {
+	struct dlist_entry	entry;
+	struct hook_lat_hist	*hist[HOOK_CTX_OP_MAX][HOOK_LAT_SIZE_CLASSES];
+};
+
+/* Context of an operation, stamped with the time it was posted */
+struct hook_lat_entry {
+	struct hook_ctx		ctx;
+	uint64_t		start;
+	uint8_t			size_class;
+};
+
+struct hook_lat_cq {
+	struct hook_cq	hook_cq;
+	size_t		entry_size;
+};
+
+#endif /* _HOOK_LATENCY_H_ */
@@ -0,0 +1,668 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Completion latency hook.  Every data transfer that will generate a CQ
+ * entry has its context replaced by a hook_lat_entry stamped with the post
+ * time.  When the completion is read the original context is restored and
+ * the time from post to completion is added to a histogram for the
+ * operation type and message size.  Histograms are dumped when a fabric is
+ * closed, or whenever the configured signal is received.
+ */
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "ofi.h"
+#include "ofi_mem.h"
+#include "ofi_prov.h"
+#include "ofi_hook.h"
+#include "hook_prov.h"
+#include "ofi_enosys.h"
+
+#include "hook_latency.h"
+
+struct hook_prov_ctx hook_lat_prov_ctx;
+
+static const char *hook_lat_op_str[HOOK_CTX_OP_MAX] = {
+	[HOOK_CTX_SEND]		= "send",
+	[HOOK_CTX_RECV]		= "recv",
+	[HOOK_CTX_TSEND]	= "tsend",
+	[HOOK_CTX_TRECV]	= "trecv",
+	[HOOK_CTX_WRITE]	= "write",
+	[HOOK_CTX_READ]		= "read",
+	[HOOK_CTX_ATOMIC]	= "atomic",
+	[HOOK_CTX_FETCH]	= "fatomic",
+};
+
+static pthread_mutex_t hook_lat_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t hook_lat_key;
+static int hook_lat_initialized;
+static struct hook_ctx_pool hook_lat_pool;
+static struct dlist_entry hook_lat_threads =
+	{ &hook_lat_threads, &hook_lat_threads };
+static volatile sig_atomic_t hook_lat_dump_pending;
+static char *hook_lat_file;
+
+/*
+ * Histograms
+ */
+
+static inline int hook_lat_msb(uint64_t value)
+{
+	return 63 - __builtin_clzll(value);
+}
+
+static inline size_t hook_lat_bucket(uint64_t value)
+{
+	int shift;
+
+	if (value < 2 * HOOK_LAT_SUB_BUCKETS)
+		return (size_t) value;
+
+	value = MIN(value, (1ULL << HOOK_LAT_MAX_MSB) - 1);
+	shift = hook_lat_msb(value) - HOOK_LAT_SUB_BITS;
+	return 2 * HOOK_LAT_SUB_BUCKETS + (shift - 1) * HOOK_LAT_SUB_BUCKETS +
+	       (size_t) (value >> shift) - HOOK_LAT_SUB_BUCKETS;
+}
+
+/* Highest value that maps to the bucket */
+static uint64_t hook_lat_bucket_value(size_t bucket)
+{
+	uint64_t sub;
+	int shift;
+
+	if (bucket < 2 * HOOK_LAT_SUB_BUCKETS)
+		return bucket;
+
+	bucket -= 2 * HOOK_LAT_SUB_BUCKETS;
+	shift = (int) (bucket / HOOK_LAT_SUB_BUCKETS) + 1;
+	sub = bucket % HOOK_LAT_SUB_BUCKETS + HOOK_LAT_SUB_BUCKETS;
+	return ((sub + 1) << shift) - 1;
+}
+
+static inline uint8_t hook_lat_size_class(size_t len)
+{
+	if (!len)
+		return 0;
+
+	return (uint8_t) MIN(hook_lat_msb(len) + 1, HOOK_LAT_SIZE_CLASSES - 1);
+}
+
+static struct hook_lat_thread *hook_lat_thread_get(void)
+{
+	struct hook_lat_thread *thread;
+
+	thread = pthread_getspecific(hook_lat_key);
+	if (OFI_LIKELY(thread != NULL))
+		return thread;
+
+	thread = calloc(1, sizeof(*thread));
+	if (!thread)
+		return NULL;
+
+	pthread_mutex_lock(&hook_lat_lock);
+	dlist_insert_tail(&thread->entry, &hook_lat_threads);
+	pthread_mutex_unlock(&hook_lat_lock);
+	pthread_setspecific(hook_lat_key, thread);
+	return thread;
+}
+
+static void hook_lat_record(struct hook_lat_thread *thread, uint8_t op,
+			    uint8_t size_class, uint64_t value)
+{
+	struct hook_lat_hist *hist;
+
+	hist = thread->hist[op][size_class];
+	if (OFI_UNLIKELY(!hist)) {
+		hist = calloc(1, sizeof(*hist));
+		if (!hist)
+			return;
+		hist->min = UINT64_MAX;
+		thread->hist[op][size_class] = hist;
+	}
+
+	hist->bucket[hook_lat_bucket(value)]++;
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+static void hook_lat_size_str(uint8_t size_class, char *buf, size_t len)
+{
+	static const char *suffix[] = { "", "K", "M", "G" };
+	uint64_t size;
+	int i;
+
+	size = size_class ? 1ULL << (size_class - 1) : 0;
+	for (i = 0; size >= 1024 && i < 3; i++)
+		size /= 1024;
+
+	snprintf(buf, len, "%s%" PRIu64 "%s",
+		 size_class == HOOK_LAT_SIZE_CLASSES - 1 ? ">=" : "",
+		 size, suffix[i]);
+}
+
+static double hook_lat_percentile(struct hook_lat_hist *hist, uint64_t count,
+				  double percentile)
+{
+	uint64_t target, sum = 0;
+	size_t i;
+
+	target = (uint64_t) (count * percentile / 100);
+	target = MAX(target, 1);
+	for (i = 0; i < HOOK_LAT_BUCKETS; i++) {
+		sum += hist->bucket[i];
+		if (sum >= target)
+			break;
+	}
+
+	return (double) MIN(hook_lat_bucket_value(i), hist->max) / 1000;
+}
+
+static void hook_lat_dump(void)
+{
+	static const double percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+	struct hook_lat_thread *thread;
+	struct hook_lat_hist total, *hist;
+	uint64_t count;
+	char size[16];
+	FILE *out;
+	size_t i;
+	int op, sc, found;
+
+	out = hook_lat_file ? fopen(hook_lat_file, "a") : stderr;
+	if (!out) {
+		FI_WARN(&hook_lat_prov_ctx.prov, FI_LOG_CORE,
+			"unable to open %s\n", hook_lat_file);
+		return;
+	}
+
+	fprintf(out, "%s: pid %d completion latency (usec)\n",
+		hook_lat_prov_ctx.prov.name, getpid());
+	fprintf(out, "%-7s %8s %12s %10s %10s %10s %10s %10s %10s %10s\n",
+		"op", "size", "count", "min", "p50", "p90", "p99",
+		"p99.9", "p99.99", "max");
+
+	pthread_mutex_lock(&hook_lat_lock);
+	for (op = 0; op < HOOK_CTX_OP_MAX; op++) {
+		for (sc = 0; sc < HOOK_LAT_SIZE_CLASSES; sc++) {
+			memset(&total, 0, sizeof(total));
+			total.min = UINT64_MAX;
+			found = 0;
+
+			dlist_foreach_container(&hook_lat_threads,
+						struct hook_lat_thread,
+						thread, entry) {
+				hist = thread->hist[op][sc];
+				if (!hist)
+					continue;
+
+				found = 1;
+				for (i = 0; i < HOOK_LAT_BUCKETS; i++)
+					total.bucket[i] += hist->bucket[i];
+				total.min = MIN(total.min, hist->min);
+				total.max = MAX(total.max, hist->max);
+			}
+			if (!found)
+				continue;
+
+			for (i = 0, count = 0; i < HOOK_LAT_BUCKETS; i++)
+				count += total.bucket[i];
+			if (!count)
+				continue;
+
+			hook_lat_size_str((uint8_t) sc, size, sizeof(size));
+			fprintf(out, "%-7s %8s %12" PRIu64 " %10.2f",
+				hook_lat_op_str[op], size, count,
+				(double) total.min / 1000);
+			for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+				fprintf(out, " %10.2f",
+					hook_lat_percentile(&total, count,
+							    percentiles[i]));
+			fprintf(out, " %10.2f\n", (double) total.max / 1000);
+		}
+	}
+	pthread_mutex_unlock(&hook_lat_lock);
+
+	if (out == stderr)
+		fflush(out);
+	else
+		fclose(out);
+}
+
+static void hook_lat_signal_handler(int signum)
+{
+	hook_lat_dump_pending = 1;
+}
+
+/* Called from fabric open, so nothing is installed unless FI_HOOK asks */
+static void hook_lat_init(void)
+{
+	struct sigaction action;
+	int sig = 0;
+
+	pthread_mutex_lock(&hook_lat_lock);
+	if (hook_lat_initialized)
+		goto unlock;
+
+	if (pthread_key_create(&hook_lat_key, NULL))
+		goto unlock;
+
+	if (hook_ctx_pool_create(&hook_lat_pool,
+				 sizeof(struct hook_lat_entry))) {
+		pthread_key_delete(hook_lat_key);
+		goto unlock;
+	}
+
+	fi_param_get_str(&hook_lat_prov_ctx.prov, "file", &hook_lat_file);
+	fi_param_get_int(&hook_lat_prov_ctx.prov, "signal", &sig);
+	if (sig > 0) {
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = hook_lat_signal_handler;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(sig, &action, NULL))
+			FI_WARN(&hook_lat_prov_ctx.prov, FI_LOG_CORE,
+				"unable to install handler for signal %d\n",
+				sig);
+	}
+	hook_lat_initialized = 1;
+unlock:
+	pthread_mutex_unlock(&hook_lat_lock);
+}
+
+/*
+ * Operation tracking
+ */
+
+static void hook_lat_start(struct hook_ctx *ctx, fi_addr_t addr, size_t len)
+{
+	struct hook_lat_entry *entry = container_of(ctx, struct hook_lat_entry,
+						    ctx);
+
+	entry->size_class = hook_lat_size_class(len);
+	entry->start = ofi_gettime_ns();
+}
+
+/*
+ * Restores the application's context and records the sample.  len is the
+ * received length for receive completions, or 0 to use the posted size.
+ */
+static void hook_lat_complete(struct hook_lat_thread *thread, void **op_context,
+			      uint64_t flags, size_t len, uint64_t now, int err)
+{
+	struct hook_lat_entry *entry;
+	struct hook_ctx *ctx;
+	uint8_t size_class;
+
+	ctx = hook_ctx_unwrap(&hook_lat_pool, op_context, err);
+	if (!ctx)
+		return;
+
+	entry = container_of(ctx, struct hook_lat_entry, ctx);
+	if (!ctx->multi_recv && !err && thread) {
+		size_class = (flags & FI_RECV) && len ?
+			     hook_lat_size_class(len) : entry->size_class;
+		hook_lat_record(thread, ctx->op, size_class,
+				now - entry->start);
+	}
+	hook_ctx_release(ctx, flags, err);
+}
+
+/*
+ * CQ
+ */
+
+static void hook_lat_cq_process(struct hook_lat_cq *cq, char *buf,
+				ssize_t count)
+{
+	struct hook_lat_thread *thread;
+	struct fi_cq_tagged_entry *entry;
+	uint64_t now;
+	ssize_t i;
+
+	if (OFI_UNLIKELY(hook_lat_dump_pending)) {
+		hook_lat_dump_pending = 0;
+		hook_lat_dump();
+	}
+
+	if (count <= 0)
+		return;
+
+	thread = hook_lat_thread_get();
+	now = ofi_gettime_ns();
+	for (i = 0; i < count; i++, buf += cq->entry_size) {
+		entry = (struct fi_cq_tagged_entry *) buf;
+		if (cq->hook_cq.format == FI_CQ_FORMAT_CONTEXT)
+			hook_lat_complete(thread, &entry->op_context, 0, 0,
+					  now, 0);
+		else
+			hook_lat_complete(thread, &entry->op_context,
+					  entry->flags, entry->len, now, 0);
+	}
+}
+
+static ssize_t hook_lat_cq_read(struct fid_cq *cq, void *buf, size_t count)
+{
+	struct hook_lat_cq *mycq = container_of(cq, struct hook_lat_cq,
+						hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_read(mycq->hook_cq.hcq, buf, count);
+	hook_lat_cq_process(mycq, buf, ret);
+	return ret;
+}
+
+static ssize_t
+hook_lat_cq_readfrom(struct fid_cq *cq, void *buf, size_t count,
+		     fi_addr_t *src_addr)
+{
+	struct hook_lat_cq *mycq = container_of(cq, struct hook_lat_cq,
+						hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_readfrom(mycq->hook_cq.hcq, buf, count, src_addr);
+	hook_lat_cq_process(mycq, buf, ret);
+	return ret;
+}
+
+static ssize_t
+hook_lat_cq_readerr(struct fid_cq *cq, struct fi_cq_err_entry *buf,
+		    uint64_t flags)
+{
+	struct hook_lat_cq *mycq = container_of(cq, struct hook_lat_cq,
+						hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_readerr(mycq->hook_cq.hcq, buf, flags);
+	if (ret > 0)
+		hook_lat_complete(NULL, &buf->op_context, buf->flags, 0, 0, 1);
+	return ret;
+}
+
+static ssize_t
+hook_lat_cq_sread(struct fid_cq *cq, void *buf, size_t count,
+		  const void *cond, int timeout)
+{
+	struct hook_lat_cq *mycq = container_of(cq, struct hook_lat_cq,
+						hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_sread(mycq->hook_cq.hcq, buf, count, cond, timeout);
+	hook_lat_cq_process(mycq, buf, ret);
+	return ret;
+}
+
+static ssize_t
+hook_lat_cq_sreadfrom(struct fid_cq *cq, void *buf, size_t count,
+		      fi_addr_t *src_addr, const void *cond, int timeout)
+{
+	struct hook_lat_cq *mycq = container_of(cq, struct hook_lat_cq,
+						hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_sreadfrom(mycq->hook_cq.hcq, buf, count, src_addr,
+			      cond, timeout);
+	hook_lat_cq_process(mycq, buf, ret);
+	return ret;
+}
+
+static struct fi_ops_cq hook_lat_cq_ops;
+
+static int hook_lat_cq_close(struct fid *fid)
+{
+	struct hook_lat_cq *mycq = container_of(fid, struct hook_lat_cq,
+						hook_cq.cq.fid);
+	int ret = 0;
+
+	if (mycq->hook_cq.hcq)
+		ret = fi_close(&mycq->hook_cq.hcq->fid);
+	if (!ret)
+		free(mycq);
+	return ret;
+}
+
+static struct fi_ops hook_lat_cq_fid_ops;
+
+static size_t hook_lat_cq_entry_size[] = {
+	[FI_CQ_FORMAT_UNSPEC] = 0,
+	[FI_CQ_FORMAT_CONTEXT] = sizeof(struct fi_cq_entry),
+	[FI_CQ_FORMAT_MSG] = sizeof(struct fi_cq_msg_entry),
+	[FI_CQ_FORMAT_DATA] = sizeof(struct fi_cq_data_entry),
+	[FI_CQ_FORMAT_TAGGED] = sizeof(struct fi_cq_tagged_entry)
+};
+
+static int
+hook_lat_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		 struct fid_cq **cq, void *context)
+{
+	struct hook_lat_cq *mycq;
+	int ret;
+
+	mycq = calloc(1, sizeof(*mycq));
+	if (!mycq)
+		return -FI_ENOMEM;
+
+	ret = hook_cq_init(domain, attr, cq, context, &mycq->hook_cq);
+	if (ret) {
+		free(mycq);
+		return ret;
+	}
+
+	mycq->hook_cq.cq.fid.ops = &hook_lat_cq_fid_ops;
+	mycq->hook_cq.cq.ops = &hook_lat_cq_ops;
+	mycq->entry_size = hook_lat_cq_entry_size[mycq->hook_cq.format];
+	assert(mycq->entry_size);
+	return 0;
+}
+
+/*
+ * EP
+ */
+
+static int hook_lat_ep_close(struct fid *fid)
+{
+	struct hook_ctx_ep *myep = container_of(fid, struct hook_ctx_ep,
+						hook_ep.ep.fid);
+	int ret = 0;
+
+	if (myep->hook_ep.hep)
+		ret = fi_close(&myep->hook_ep.hep->fid);
+	if (ret)
+		return ret;
+
+	hook_ctx_ep_cleanup(myep);
+	free(myep);
+	return 0;
+}
+
+static struct fi_ops hook_lat_ep_fid_ops;
+
+static int
+hook_lat_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep, void *context)
+{
+	struct hook_ctx_ep *myep;
+	int ret;
+
+	myep = calloc(1, sizeof(*myep));
+	if (!myep)
+		return -FI_ENOMEM;
+
+	ret = hook_ctx_ep_init(domain, info, ep, context, myep, &hook_lat_pool,
+			       hook_lat_start);
+	if (ret) {
+		free(myep);
+		return ret;
+	}
+
+	myep->hook_ep.ep.fid.ops = &hook_lat_ep_fid_ops;
+	return 0;
+}
+
+/* Operations posted through these would complete with unwrapped contexts */
+static int
+hook_lat_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		     struct fid_ep **sep, void *context)
+{
+	FI_WARN(&hook_lat_prov_ctx.prov, FI_LOG_EP_CTRL,
+		"scalable endpoints are not supported\n");
+	return -FI_ENOSYS;
+}
+
+static int
+hook_lat_srx_ctx(struct fid_domain *domain, struct fi_rx_attr *attr,
+		 struct fid_ep **rx_ep, void *context)
+{
+	FI_WARN(&hook_lat_prov_ctx.prov, FI_LOG_EP_CTRL,
+		"shared receive contexts are not supported\n");
+	return -FI_ENOSYS;
+}
+
+static struct fi_ops_domain hook_lat_domain_ops;
+
+static int hook_lat_domain_init(struct fid *fid)
+{
+	struct fid_domain *domain = container_of(fid, struct fid_domain, fid);
+
+	domain->ops = &hook_lat_domain_ops;
+	return 0;
+}
+
+/*
+ * Fabric
+ */
+
+static int hook_lat_fabric_close(struct fid *fid)
+{
+	hook_lat_dump();
+	return hook_close(fid);
+}
+
+static struct fi_ops hook_lat_fabric_fid_ops;
+
+static int hook_lat_fabric(struct fi_fabric_attr *attr,
+			   struct fid_fabric **fabric, void *context)
+{
+	struct fi_provider *hprov = context;
+	struct hook_fabric *fab;
+
+	FI_TRACE(hprov, FI_LOG_FABRIC, "Installing latency hook\n");
+	hook_lat_init();
+	if (!hook_lat_initialized)
+		return -FI_ENOMEM;
+
+	fab = calloc(1, sizeof *fab);
+	if (!fab)
+		return -FI_ENOMEM;
+
+	hook_fabric_init(fab, HOOK_LATENCY, attr->fabric, hprov,
+			 &hook_lat_fabric_fid_ops, &hook_lat_prov_ctx);
+	*fabric = &fab->fabric;
+	return 0;
+}
+
+static void hook_lat_cleanup(void)
+{
+	struct hook_lat_thread *thread;
+	int op, sc;
+
+	pthread_mutex_lock(&hook_lat_lock);
+	while (!dlist_empty(&hook_lat_threads)) {
+		dlist_pop_front(&hook_lat_threads, struct hook_lat_thread,
+				thread, entry);
+		for (op = 0; op < HOOK_CTX_OP_MAX; op++) {
+			for (sc = 0; sc < HOOK_LAT_SIZE_CLASSES; sc++)
+				free(thread->hist[op][sc]);
+		}
+		free(thread);
+	}
+	if (hook_lat_initialized) {
+		hook_ctx_pool_destroy(&hook_lat_pool);
+		pthread_key_delete(hook_lat_key);
+		hook_lat_initialized = 0;
+	}
+	pthread_mutex_unlock(&hook_lat_lock);
+}
+
+struct hook_prov_ctx hook_lat_prov_ctx = {
+	.prov = {
+		.version = OFI_VERSION_DEF_PROV,
+		/* We're a pass-through provider, so the fi_version is always the latest */
+		.fi_version = OFI_VERSION_LATEST,
+		.name = "ofi_hook_latency",
+		.getinfo = NULL,
+		.fabric = hook_lat_fabric,
+		.cleanup = hook_lat_cleanup,
+	},
+};
+
+HOOK_LATENCY_INI
+{
+	fi_param_define(&hook_lat_prov_ctx.prov, "file", FI_PARAM_STRING,
+			"File that latency histograms are appended to "
+			"(default: stderr)");
+	fi_param_define(&hook_lat_prov_ctx.prov, "signal", FI_PARAM_INT,
+			"Dump latency histograms when this signal is "
+			"received, 0 to disable (default: 0)");
+
+	hook_lat_fabric_fid_ops = hook_fid_ops;
+	hook_lat_fabric_fid_ops.close = hook_lat_fabric_close;
+
+	hook_lat_domain_ops = hook_domain_ops;
+	hook_lat_domain_ops.cq_open = hook_lat_cq_open;
+	hook_lat_domain_ops.endpoint = hook_lat_endpoint;
+	hook_lat_domain_ops.scalable_ep = hook_lat_scalable_ep;
+	hook_lat_domain_ops.srx_ctx = hook_lat_srx_ctx;
+
+	hook_lat_cq_fid_ops = hook_fid_ops;
+	hook_lat_cq_fid_ops.close = hook_lat_cq_close;
+
+	hook_lat_cq_ops = hook_cq_ops;
+	hook_lat_cq_ops.read = hook_lat_cq_read;
+	hook_lat_cq_ops.readfrom = hook_lat_cq_readfrom;
+	hook_lat_cq_ops.readerr = hook_lat_cq_readerr;
+	hook_lat_cq_ops.sread = hook_lat_cq_sread;
+	hook_lat_cq_ops.sreadfrom = hook_lat_cq_sreadfrom;
+
+	hook_lat_ep_fid_ops = hook_fid_ops;
+	hook_lat_ep_fid_ops.close = hook_lat_ep_close;
+	hook_lat_ep_fid_ops.bind = hook_ctx_ep_bind;
+
+	hook_ctx_ini();
+
+	hook_lat_prov_ctx.ini_fid[FI_CLASS_DOMAIN] = hook_lat_domain_init;
+	return &hook_lat_prov_ctx.prov;
+}
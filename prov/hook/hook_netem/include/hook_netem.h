@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HOOK_NETEM_H_
+#define _HOOK_NETEM_H_
+
+#include "ofi_hook.h"
+#include "hook_ctx.h"
+#include "ofi_list.h"
+#include "ofi_lock.h"
+#include "ofi_mem.h"
+#include "ofi.h"
+
+/* Peers are tracked by fi_addr_t, addresses above this share one state */
+#define HOOK_NETEM_MAX_PEERS	(1 << 16)
+/* Consecutive losses of one message beyond this are not modeled */
+#define HOOK_NETEM_MAX_LOSSES	16
+/* Completions read from the provider per call */
+#define HOOK_NETEM_READ_CNT	64
+
+enum hook_netem_op {
+	HOOK_NETEM_TX,		/* send, write or atomic: one way */
+	HOOK_NETEM_RX,
+	HOOK_NETEM_RT,		/* read or fetching atomic: round trip */
+};
+
+/*
+ * Emulated link towards a peer.  Times are in nsec, bandwidth in Mbit/s,
+ * where 0 means unlimited.  loss is the probability that a message is
+ * lost, scaled by 2^32, and each loss delays its completion by rto.
+ */
+struct hook_netem_model {
+	uint64_t	latency;
+	uint64_t	jitter;
+	uint64_t	bandwidth;
+	uint64_t	loss;
+	uint64_t	rto;
+};
+
+/*
+ * busy is when the emulated link finishes serializing the data queued so
+ * far, last the latest release time handed out, which keeps completions
+ * from one peer in order when jitter or losses are applied.
+ */
+struct hook_netem_link {
+	uint64_t	busy;
+	uint64_t	last;
+};
+
+struct hook_netem_peer {
+	const struct hook_netem_model	*model;
+	struct hook_netem_link		tx;
+	struct hook_netem_link		rx;
+};
+
+/* Extends the context wrapping an operation with what the model needs */
+struct hook_netem_entry {
+	struct hook_ctx		ctx;
+	fi_addr_t		addr;
+	size_t			len;
+	uint64_t		post;
+};
+
+struct hook_netem_ep {
+	struct hook_ctx_ep	ctx_ep;
+	/* protects the peer state */
+	struct ofi_genlock	lock;
+	struct hook_netem_peer	*peers;
+	size_t			peer_cnt;
+	/* peer for FI_ADDR_UNSPEC, unknown sources and large addresses */
+	struct hook_netem_peer	any_peer;
+	uint32_t		seed;
+};
+
+/* A completion held back until the emulated network would deliver it */
+struct hook_netem_comp {
+	struct dlist_entry		entry;
+	uint64_t			release;
+	fi_addr_t			src_addr;
+	struct fi_cq_tagged_entry	cqe;
+};
+
+struct hook_netem_cq {
+	struct hook_cq		hook_cq;
+	size_t			entry_size;
+	struct ofi_genlock	lock;
+	struct ofi_bufpool	*comp_pool;
+	/* held completions, ordered by release time */
+	struct dlist_entry	comp_list;
+	uint8_t			no_readfrom;
+};
+
+#endif /* _HOOK_NETEM_H_ */
@@ -0,0 +1,856 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Network emulation hook.  Completions are held back until an emulated
+ * link to the peer would have delivered them, so that protocols can be
+ * evaluated on one node against the latency, bandwidth, jitter and loss
+ * of a slower fabric.  Each operation that will generate a CQ entry has
+ * its context replaced by a hook_netem_entry recording the post time and
+ * size.  When the provider completes it, a release time is computed:
+ *
+ *   send, write, atomic	post time plus serialization on the link
+ *   read, fetching atomic	the same, plus twice the one way latency
+ *   receive			arrival time plus serialization on the
+ *				receive link and the one way latency
+ *
+ * Jitter is added to each transfer and every emulated loss delays it by
+ * a retransmission timeout.  Completions from a peer are never reordered.
+ * Both sides of a loopback transfer run the hook, so the sender is paced
+ * by its transmit link and the receiver by its receive link.
+ */
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+
+#include "ofi.h"
+#include "ofi_mem.h"
+#include "ofi_prov.h"
+#include "ofi_hook.h"
+#include "hook_prov.h"
+#include "ofi_enosys.h"
+
+#include "hook_netem.h"
+
+/* Waits shorter than this are spun rather than blocked on the provider */
+#define HOOK_NETEM_SPIN_NS	1000000
+
+struct hook_netem_override {
+	fi_addr_t		addr;
+	struct hook_netem_model	model;
+};
+
+struct hook_prov_ctx hook_netem_prov_ctx;
+
+static pthread_mutex_t hook_netem_lock = PTHREAD_MUTEX_INITIALIZER;
+static int hook_netem_initialized;
+static struct hook_ctx_pool hook_netem_pool;
+static struct hook_netem_model hook_netem_default;
+static struct hook_netem_override *hook_netem_overrides;
+static size_t hook_netem_override_cnt;
+static uint32_t hook_netem_seed;
+
+/*
+ * Configuration
+ */
+
+static uint64_t hook_netem_loss(double percent)
+{
+	if (percent <= 0)
+		return 0;
+	if (percent >= 100)
+		return 1ULL << 32;
+	return (uint64_t) (percent / 100 * (1ULL << 32));
+}
+
+/*
+ * Parses one peer override, "<fi_addr>=<latency>/<bandwidth>/<jitter>/
+ * <loss>", where trailing or empty fields keep the default value.
+ */
+static int hook_netem_parse_peer(char *str, struct hook_netem_override *ovr)
+{
+	char *field, *end;
+	double loss;
+	int i;
+
+	ovr->model = hook_netem_default;
+	ovr->addr = strtoull(str, &end, 0);
+	if (end == str || *end != '=')
+		return -FI_EINVAL;
+
+	for (i = 0, field = end + 1; *field && i < 4; i++) {
+		if (*field == '/') {
+			field++;
+			continue;
+		}
+
+		if (i == 3) {
+			loss = strtod(field, &end);
+			ovr->model.loss = hook_netem_loss(loss);
+		} else {
+			uint64_t value = strtoull(field, &end, 0);
+
+			if (i == 0)
+				ovr->model.latency = value * 1000;
+			else if (i == 1)
+				ovr->model.bandwidth = value;
+			else
+				ovr->model.jitter = value * 1000;
+		}
+		if (end == field || (*end && *end != '/'))
+			return -FI_EINVAL;
+		field = *end ? end + 1 : end;
+	}
+	return *field ? -FI_EINVAL : 0;
+}
+
+static void hook_netem_parse_peers(char *peers)
+{
+	struct hook_netem_override *ovr;
+	char *str, *tok, *saveptr;
+	size_t cnt = 1;
+
+	for (tok = peers; *tok; tok++)
+		cnt += *tok == ';';
+
+	str = strdup(peers);
+	hook_netem_overrides = calloc(cnt, sizeof(*hook_netem_overrides));
+	if (!str || !hook_netem_overrides) {
+		FI_WARN(&hook_netem_prov_ctx.prov, FI_LOG_CORE,
+			"unable to allocate peer overrides\n");
+		goto out;
+	}
+
+	for (tok = strtok_r(str, ";", &saveptr); tok;
+	     tok = strtok_r(NULL, ";", &saveptr)) {
+		ovr = &hook_netem_overrides[hook_netem_override_cnt];
+		if (hook_netem_parse_peer(tok, ovr)) {
+			FI_WARN(&hook_netem_prov_ctx.prov, FI_LOG_CORE,
+				"ignoring invalid peer setting '%s'\n", tok);
+			continue;
+		}
+		hook_netem_override_cnt++;
+	}
+out:
+	free(str);
+}
+
+/* Called from fabric open, so nothing is read unless FI_HOOK asks */
+static void hook_netem_init(void)
+{
+	struct fi_provider *prov = &hook_netem_prov_ctx.prov;
+	int latency = 0, jitter = 0, bandwidth = 0, rto = 1000, seed = 0;
+	char *loss = NULL, *peers = NULL;
+
+	pthread_mutex_lock(&hook_netem_lock);
+	if (hook_netem_initialized)
+		goto unlock;
+
+	if (hook_ctx_pool_create(&hook_netem_pool,
+				 sizeof(struct hook_netem_entry)))
+		goto unlock;
+
+	fi_param_get_int(prov, "latency", &latency);
+	fi_param_get_int(prov, "jitter", &jitter);
+	fi_param_get_int(prov, "bandwidth", &bandwidth);
+	fi_param_get_int(prov, "rto", &rto);
+	fi_param_get_int(prov, "seed", &seed);
+	fi_param_get_str(prov, "loss", &loss);
+	fi_param_get_str(prov, "peers", &peers);
+
+	hook_netem_default.latency = (uint64_t) MAX(latency, 0) * 1000;
+	hook_netem_default.jitter = (uint64_t) MAX(jitter, 0) * 1000;
+	hook_netem_default.bandwidth = (uint64_t) MAX(bandwidth, 0);
+	hook_netem_default.rto = (uint64_t) MAX(rto, 0) * 1000;
+	if (loss)
+		hook_netem_default.loss = hook_netem_loss(strtod(loss, NULL));
+	if (peers)
+		hook_netem_parse_peers(peers);
+
+	hook_netem_seed = seed ? (uint32_t) seed : (uint32_t) ofi_gettime_ns();
+	hook_netem_seed |= 1;
+
+	FI_INFO(prov, FI_LOG_CORE, "latency %" PRIu64 " ns, jitter %" PRIu64
+		" ns, bandwidth %" PRIu64 " Mbit/s, loss %.4f%%, rto %" PRIu64
+		" ns, %zu peer overrides\n", hook_netem_default.latency,
+		hook_netem_default.jitter, hook_netem_default.bandwidth,
+		(double) hook_netem_default.loss * 100 / (1ULL << 32),
+		hook_netem_default.rto, hook_netem_override_cnt);
+	hook_netem_initialized = 1;
+unlock:
+	pthread_mutex_unlock(&hook_netem_lock);
+}
+
+static const struct hook_netem_model *hook_netem_model(fi_addr_t addr)
+{
+	size_t i;
+
+	for (i = 0; i < hook_netem_override_cnt; i++) {
+		if (hook_netem_overrides[i].addr == addr)
+			return &hook_netem_overrides[i].model;
+	}
+	return &hook_netem_default;
+}
+
+/*
+ * Link model
+ */
+
+/* Caller holds the endpoint lock */
+static struct hook_netem_peer *
+hook_netem_peer(struct hook_netem_ep *ep, fi_addr_t addr)
+{
+	struct hook_netem_peer *peers;
+	size_t cnt;
+
+	if (addr >= HOOK_NETEM_MAX_PEERS)
+		return &ep->any_peer;
+
+	if (addr >= ep->peer_cnt) {
+		cnt = MAX(roundup_power_of_two(addr + 1), 16);
+		peers = realloc(ep->peers, cnt * sizeof(*peers));
+		if (!peers)
+			return &ep->any_peer;
+
+		memset(&peers[ep->peer_cnt], 0,
+		       (cnt - ep->peer_cnt) * sizeof(*peers));
+		ep->peers = peers;
+		ep->peer_cnt = cnt;
+	}
+
+	if (!ep->peers[addr].model)
+		ep->peers[addr].model = hook_netem_model(addr);
+	return &ep->peers[addr];
+}
+
+/* Uniform in [0, max] */
+static inline uint64_t hook_netem_random(struct hook_netem_ep *ep, uint64_t max)
+{
+	uint64_t rand = ofi_xorshift_random_r(&ep->seed);
+
+	return max < UINT32_MAX ? (rand * (max + 1)) >> 32 : rand * (max >> 32);
+}
+
+/* Reads and fetching atomics wait for the response from the peer */
+static inline enum hook_netem_op hook_netem_op(uint8_t op)
+{
+	switch (op) {
+	case HOOK_CTX_RECV:
+	case HOOK_CTX_TRECV:
+		return HOOK_NETEM_RX;
+	case HOOK_CTX_READ:
+	case HOOK_CTX_FETCH:
+		return HOOK_NETEM_RT;
+	default:
+		return HOOK_NETEM_TX;
+	}
+}
+
+/*
+ * Returns when the completion for entry may be reported.  src_addr is the
+ * source reported by the provider for receives, or FI_ADDR_NOTAVAIL.
+ */
+static uint64_t
+hook_netem_release(struct hook_netem_entry *entry, fi_addr_t src_addr,
+		   size_t len, uint64_t now)
+{
+	struct hook_netem_ep *ep = container_of(entry->ctx.ep,
+						struct hook_netem_ep, ctx_ep);
+	enum hook_netem_op op = hook_netem_op(entry->ctx.op);
+	const struct hook_netem_model *model;
+	struct hook_netem_peer *peer;
+	struct hook_netem_link *link;
+	uint64_t ser, release;
+	int losses = 0;
+
+	ofi_genlock_lock(&ep->lock);
+	if (op == HOOK_NETEM_RX && src_addr != FI_ADDR_NOTAVAIL)
+		peer = hook_netem_peer(ep, src_addr);
+	else
+		peer = hook_netem_peer(ep, entry->addr);
+	model = peer->model;
+
+	ser = model->bandwidth ? len * 8000 / model->bandwidth : 0;
+	if (op == HOOK_NETEM_RX) {
+		link = &peer->rx;
+		link->busy = MAX(now, link->busy) + ser;
+		release = link->busy + model->latency;
+	} else {
+		link = &peer->tx;
+		link->busy = MAX(entry->post, link->busy) + ser;
+		release = link->busy;
+		if (op == HOOK_NETEM_RT)
+			release += 2 * model->latency;
+	}
+
+	if (model->jitter)
+		release += hook_netem_random(ep, model->jitter);
+	while (model->loss && losses < HOOK_NETEM_MAX_LOSSES &&
+	       ofi_xorshift_random_r(&ep->seed) < model->loss) {
+		release += model->rto;
+		losses++;
+	}
+
+	release = MAX(release, link->last);
+	link->last = release;
+	ofi_genlock_unlock(&ep->lock);
+	return release;
+}
+
+/*
+ * Operation tracking
+ */
+
+static void hook_netem_start(struct hook_ctx *ctx, fi_addr_t addr, size_t len)
+{
+	struct hook_netem_entry *entry = container_of(ctx,
+						      struct hook_netem_entry,
+						      ctx);
+
+	entry->addr = addr;
+	entry->len = len;
+	entry->post = ofi_gettime_ns();
+}
+
+/*
+ * Restores the application's context and returns the release time of the
+ * completion.  len is the received length for receive completions, or 0
+ * to use the posted size.
+ */
+static uint64_t
+hook_netem_complete(void **op_context, uint64_t flags, size_t len,
+		    fi_addr_t src_addr, uint64_t now, int err)
+{
+	struct hook_netem_entry *entry;
+	struct hook_ctx *ctx;
+	uint64_t release = now;
+
+	ctx = hook_ctx_unwrap(&hook_netem_pool, op_context, err);
+	if (!ctx)
+		return now;
+
+	if (!err) {
+		entry = container_of(ctx, struct hook_netem_entry, ctx);
+		release = hook_netem_release(entry, src_addr,
+					     (flags & FI_RECV) && len ?
+					     len : entry->len, now);
+	}
+	hook_ctx_release(ctx, flags, err);
+	return release;
+}
+
+/*
+ * CQ
+ */
+
+/* Caller holds the CQ lock */
+static void hook_netem_cq_hold(struct hook_netem_cq *cq,
+			       struct hook_netem_comp *comp, uint64_t now)
+{
+	struct hook_netem_comp *prev;
+	struct dlist_entry *item;
+
+	if (cq->hook_cq.format == FI_CQ_FORMAT_CONTEXT)
+		comp->release = hook_netem_complete(&comp->cqe.op_context, 0, 0,
+						    comp->src_addr, now, 0);
+	else
+		comp->release = hook_netem_complete(&comp->cqe.op_context,
+						    comp->cqe.flags,
+						    comp->cqe.len,
+						    comp->src_addr, now, 0);
+
+	dlist_foreach_reverse(&cq->comp_list, item) {
+		prev = container_of(item, struct hook_netem_comp, entry);
+		if (prev->release <= comp->release)
+			break;
+	}
+	dlist_insert_after(&comp->entry, item);
+}
+
+/*
+ * Moves up to count completions from the provider onto the held list.
+ * Entries are allocated before reading, since a completion cannot be put
+ * back once read.  Caller holds the CQ lock.
+ */
+static ssize_t hook_netem_cq_drain(struct hook_netem_cq *cq, size_t count)
+{
+	struct hook_netem_comp *comp[HOOK_NETEM_READ_CNT];
+	struct fi_cq_tagged_entry buf[HOOK_NETEM_READ_CNT];
+	fi_addr_t src_addr[HOOK_NETEM_READ_CNT];
+	ssize_t ret, i, cnt;
+	uint64_t now;
+
+	count = MIN(count, HOOK_NETEM_READ_CNT);
+	for (cnt = 0; cnt < (ssize_t) count; cnt++) {
+		comp[cnt] = ofi_buf_alloc(cq->comp_pool);
+		if (!comp[cnt])
+			break;
+	}
+	if (!cnt)
+		return -FI_EAGAIN;
+
+	if (!cq->no_readfrom) {
+		ret = fi_cq_readfrom(cq->hook_cq.hcq, buf, cnt, src_addr);
+		if (ret == -FI_ENOSYS)
+			cq->no_readfrom = 1;
+	}
+	if (cq->no_readfrom) {
+		ret = fi_cq_read(cq->hook_cq.hcq, buf, cnt);
+		for (i = 0; i < ret; i++)
+			src_addr[i] = FI_ADDR_NOTAVAIL;
+	}
+
+	now = ofi_gettime_ns();
+	for (i = 0; i < cnt; i++) {
+		if (i >= ret) {
+			ofi_buf_free(comp[i]);
+			continue;
+		}
+		memcpy(&comp[i]->cqe, (char *) buf + i * cq->entry_size,
+		       cq->entry_size);
+		comp[i]->src_addr = src_addr[i];
+		hook_netem_cq_hold(cq, comp[i], now);
+	}
+	return ret;
+}
+
+static ssize_t
+hook_netem_cq_get(struct hook_netem_cq *cq, void *buf, size_t count,
+		  fi_addr_t *src_addr)
+{
+	struct hook_netem_comp *comp;
+	ssize_t ret;
+	uint64_t now;
+	size_t i;
+
+	ofi_genlock_lock(&cq->lock);
+	ret = hook_netem_cq_drain(cq, count);
+	now = ofi_gettime_ns();
+	for (i = 0; i < count && !dlist_empty(&cq->comp_list); i++) {
+		comp = container_of(cq->comp_list.next, struct hook_netem_comp,
+				    entry);
+		if (comp->release > now)
+			break;
+
+		memcpy((char *) buf + i * cq->entry_size, &comp->cqe,
+		       cq->entry_size);
+		if (src_addr)
+			src_addr[i] = comp->src_addr;
+		dlist_remove(&comp->entry);
+		ofi_buf_free(comp);
+	}
+	ofi_genlock_unlock(&cq->lock);
+
+	if (i)
+		return (ssize_t) i;
+	return ret < 0 ? ret : -FI_EAGAIN;
+}
+
+/*
+ * Blocks in the provider until either a new completion arrives or the
+ * next held one is due, spinning when that is too close to sleep for.
+ */
+static ssize_t
+hook_netem_cq_wait(struct hook_netem_cq *cq, void *buf, size_t count,
+		   fi_addr_t *src_addr, int timeout)
+{
+	struct hook_netem_comp *comp;
+	struct fi_cq_tagged_entry cqe;
+	fi_addr_t addr = FI_ADDR_NOTAVAIL;
+	uint64_t now, next, deadline;
+	ssize_t ret;
+	int wait;
+
+	now = ofi_gettime_ns();
+	deadline = timeout < 0 ? UINT64_MAX :
+		   now + (uint64_t) timeout * 1000000;
+	for (;;) {
+		ret = hook_netem_cq_get(cq, buf, count, src_addr);
+		if (ret != -FI_EAGAIN)
+			return ret;
+
+		ofi_genlock_lock(&cq->lock);
+		next = dlist_empty(&cq->comp_list) ? UINT64_MAX :
+		       container_of(cq->comp_list.next, struct hook_netem_comp,
+				    entry)->release;
+		ofi_genlock_unlock(&cq->lock);
+
+		now = ofi_gettime_ns();
+		next = MIN(next, deadline);
+		if (next <= now)
+			return deadline <= now ? -FI_EAGAIN : ret;
+		if (next - now < HOOK_NETEM_SPIN_NS)
+			continue;
+
+		wait = next == UINT64_MAX ? -1 :
+		       (int) MIN((next - now) / 1000000, INT_MAX);
+		if (!cq->no_readfrom) {
+			ret = fi_cq_sreadfrom(cq->hook_cq.hcq, &cqe, 1, &addr,
+					      NULL, wait);
+			if (ret == -FI_ENOSYS)
+				cq->no_readfrom = 1;
+		}
+		if (cq->no_readfrom)
+			ret = fi_cq_sread(cq->hook_cq.hcq, &cqe, 1, NULL, wait);
+		if (ret == -FI_EAGAIN)
+			continue;
+		if (ret < 0)
+			return ret;
+
+		ofi_genlock_lock(&cq->lock);
+		comp = ofi_buf_alloc(cq->comp_pool);
+		if (comp) {
+			memcpy(&comp->cqe, &cqe, cq->entry_size);
+			comp->src_addr = addr;
+			hook_netem_cq_hold(cq, comp, ofi_gettime_ns());
+		}
+		ofi_genlock_unlock(&cq->lock);
+		if (!comp)
+			return -FI_ENOMEM;
+	}
+}
+
+static ssize_t hook_netem_cq_read(struct fid_cq *cq, void *buf, size_t count)
+{
+	struct hook_netem_cq *mycq = container_of(cq, struct hook_netem_cq,
+						  hook_cq.cq);
+
+	return hook_netem_cq_get(mycq, buf, count, NULL);
+}
+
+static ssize_t
+hook_netem_cq_readfrom(struct fid_cq *cq, void *buf, size_t count,
+		       fi_addr_t *src_addr)
+{
+	struct hook_netem_cq *mycq = container_of(cq, struct hook_netem_cq,
+						  hook_cq.cq);
+
+	return hook_netem_cq_get(mycq, buf, count, src_addr);
+}
+
+/* Errors are reported as soon as the provider has them */
+static ssize_t
+hook_netem_cq_readerr(struct fid_cq *cq, struct fi_cq_err_entry *buf,
+		      uint64_t flags)
+{
+	struct hook_netem_cq *mycq = container_of(cq, struct hook_netem_cq,
+						  hook_cq.cq);
+	ssize_t ret;
+
+	ret = fi_cq_readerr(mycq->hook_cq.hcq, buf, flags);
+	if (ret > 0)
+		hook_netem_complete(&buf->op_context, buf->flags, 0,
+				    FI_ADDR_NOTAVAIL, 0, 1);
+	return ret;
+}
+
+/* cond is not applied, held completions are returned as they fall due */
+static ssize_t
+hook_netem_cq_sread(struct fid_cq *cq, void *buf, size_t count,
+		    const void *cond, int timeout)
+{
+	struct hook_netem_cq *mycq = container_of(cq, struct hook_netem_cq,
+						  hook_cq.cq);
+
+	return hook_netem_cq_wait(mycq, buf, count, NULL, timeout);
+}
+
+static ssize_t
+hook_netem_cq_sreadfrom(struct fid_cq *cq, void *buf, size_t count,
+			fi_addr_t *src_addr, const void *cond, int timeout)
+{
+	struct hook_netem_cq *mycq = container_of(cq, struct hook_netem_cq,
+						  hook_cq.cq);
+
+	return hook_netem_cq_wait(mycq, buf, count, src_addr, timeout);
+}
+
+static struct fi_ops_cq hook_netem_cq_ops;
+
+static int hook_netem_cq_close(struct fid *fid)
+{
+	struct hook_netem_cq *mycq = container_of(fid, struct hook_netem_cq,
+						  hook_cq.cq.fid);
+	int ret = 0;
+
+	if (mycq->hook_cq.hcq)
+		ret = fi_close(&mycq->hook_cq.hcq->fid);
+	if (ret)
+		return ret;
+
+	if (mycq->comp_pool)
+		ofi_bufpool_destroy(mycq->comp_pool);
+	ofi_genlock_destroy(&mycq->lock);
+	free(mycq);
+	return 0;
+}
+
+static struct fi_ops hook_netem_cq_fid_ops;
+
+static size_t hook_netem_cq_entry_size[] = {
+	[FI_CQ_FORMAT_UNSPEC] = 0,
+	[FI_CQ_FORMAT_CONTEXT] = sizeof(struct fi_cq_entry),
+	[FI_CQ_FORMAT_MSG] = sizeof(struct fi_cq_msg_entry),
+	[FI_CQ_FORMAT_DATA] = sizeof(struct fi_cq_data_entry),
+	[FI_CQ_FORMAT_TAGGED] = sizeof(struct fi_cq_tagged_entry)
+};
+
+static int
+hook_netem_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		   struct fid_cq **cq, void *context)
+{
+	struct hook_netem_cq *mycq;
+	int ret;
+
+	mycq = calloc(1, sizeof(*mycq));
+	if (!mycq)
+		return -FI_ENOMEM;
+
+	ret = ofi_genlock_init(&mycq->lock, OFI_LOCK_MUTEX);
+	if (ret)
+		goto err1;
+
+	ret = ofi_bufpool_create(&mycq->comp_pool,
+				 sizeof(struct hook_netem_comp), 16, 0,
+				 HOOK_NETEM_READ_CNT, 0);
+	if (ret)
+		goto err2;
+
+	dlist_init(&mycq->comp_list);
+	ret = hook_cq_init(domain, attr, cq, context, &mycq->hook_cq);
+	if (ret)
+		goto err3;
+
+	mycq->hook_cq.cq.fid.ops = &hook_netem_cq_fid_ops;
+	mycq->hook_cq.cq.ops = &hook_netem_cq_ops;
+	mycq->entry_size = hook_netem_cq_entry_size[mycq->hook_cq.format];
+	assert(mycq->entry_size);
+	return 0;
+
+err3:
+	ofi_bufpool_destroy(mycq->comp_pool);
+err2:
+	ofi_genlock_destroy(&mycq->lock);
+err1:
+	free(mycq);
+	return ret;
+}
+
+/*
+ * EP
+ */
+
+static int hook_netem_ep_close(struct fid *fid)
+{
+	struct hook_netem_ep *myep = container_of(fid, struct hook_netem_ep,
+						  ctx_ep.hook_ep.ep.fid);
+	int ret = 0;
+
+	if (myep->ctx_ep.hook_ep.hep)
+		ret = fi_close(&myep->ctx_ep.hook_ep.hep->fid);
+	if (ret)
+		return ret;
+
+	hook_ctx_ep_cleanup(&myep->ctx_ep);
+	ofi_genlock_destroy(&myep->lock);
+	free(myep->peers);
+	free(myep);
+	return 0;
+}
+
+static struct fi_ops hook_netem_ep_fid_ops;
+
+static int
+hook_netem_endpoint(struct fid_domain *domain, struct fi_info *info,
+		    struct fid_ep **ep, void *context)
+{
+	struct hook_netem_ep *myep;
+	int ret;
+
+	myep = calloc(1, sizeof(*myep));
+	if (!myep)
+		return -FI_ENOMEM;
+
+	ret = ofi_genlock_init(&myep->lock,
+			       info->domain_attr->threading == FI_THREAD_DOMAIN ?
+			       OFI_LOCK_NOOP : OFI_LOCK_MUTEX);
+	if (ret)
+		goto err1;
+
+	myep->any_peer.model = hook_netem_model(FI_ADDR_UNSPEC);
+	myep->seed = hook_netem_seed;
+
+	ret = hook_ctx_ep_init(domain, info, ep, context, &myep->ctx_ep,
+			       &hook_netem_pool, hook_netem_start);
+	if (ret)
+		goto err2;
+
+	myep->ctx_ep.hook_ep.ep.fid.ops = &hook_netem_ep_fid_ops;
+	return 0;
+
+err2:
+	ofi_genlock_destroy(&myep->lock);
+err1:
+	free(myep);
+	return ret;
+}
+
+/* Operations posted through these would complete with unwrapped contexts */
+static int
+hook_netem_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		       struct fid_ep **sep, void *context)
+{
+	FI_WARN(&hook_netem_prov_ctx.prov, FI_LOG_EP_CTRL,
+		"scalable endpoints are not supported\n");
+	return -FI_ENOSYS;
+}
+
+static int
+hook_netem_srx_ctx(struct fid_domain *domain, struct fi_rx_attr *attr,
+		   struct fid_ep **rx_ep, void *context)
+{
+	FI_WARN(&hook_netem_prov_ctx.prov, FI_LOG_EP_CTRL,
+		"shared receive contexts are not supported\n");
+	return -FI_ENOSYS;
+}
+
+static struct fi_ops_domain hook_netem_domain_ops;
+
+static int hook_netem_domain_init(struct fid *fid)
+{
+	struct fid_domain *domain = container_of(fid, struct fid_domain, fid);
+
+	domain->ops = &hook_netem_domain_ops;
+	return 0;
+}
+
+/*
+ * Fabric
+ */
+
+static int hook_netem_fabric(struct fi_fabric_attr *attr,
+			     struct fid_fabric **fabric, void *context)
+{
+	struct fi_provider *hprov = context;
+	struct hook_fabric *fab;
+
+	FI_TRACE(hprov, FI_LOG_FABRIC, "Installing netem hook\n");
+	hook_netem_init();
+	if (!hook_netem_initialized)
+		return -FI_ENOMEM;
+
+	fab = calloc(1, sizeof *fab);
+	if (!fab)
+		return -FI_ENOMEM;
+
+	hook_fabric_init(fab, HOOK_NETEM, attr->fabric, hprov,
+			 &hook_fid_ops, &hook_netem_prov_ctx);
+	*fabric = &fab->fabric;
+	return 0;
+}
+
+static void hook_netem_cleanup(void)
+{
+	pthread_mutex_lock(&hook_netem_lock);
+	free(hook_netem_overrides);
+	hook_netem_overrides = NULL;
+	hook_netem_override_cnt = 0;
+	if (hook_netem_initialized) {
+		hook_ctx_pool_destroy(&hook_netem_pool);
+		hook_netem_initialized = 0;
+	}
+	pthread_mutex_unlock(&hook_netem_lock);
+}
+
+struct hook_prov_ctx hook_netem_prov_ctx = {
+	.prov = {
+		.version = OFI_VERSION_DEF_PROV,
+		/* We're a pass-through provider, so the fi_version is always the latest */
+		.fi_version = OFI_VERSION_LATEST,
+		.name = "ofi_hook_netem",
+		.getinfo = NULL,
+		.fabric = hook_netem_fabric,
+		.cleanup = hook_netem_cleanup,
+	},
+};
+
+HOOK_NETEM_INI
+{
+	fi_param_define(&hook_netem_prov_ctx.prov, "latency", FI_PARAM_INT,
+			"One way latency added to each transfer, in usec "
+			"(default: 0)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "jitter", FI_PARAM_INT,
+			"Maximum random delay added to each transfer, in usec "
+			"(default: 0)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "bandwidth", FI_PARAM_INT,
+			"Link bandwidth in Mbit/s, 0 for unlimited "
+			"(default: 0)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "loss", FI_PARAM_STRING,
+			"Percentage of transfers lost and retransmitted "
+			"(default: 0)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "rto", FI_PARAM_INT,
+			"Delay added for each lost transfer, in usec "
+			"(default: 1000)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "seed", FI_PARAM_INT,
+			"Seed for jitter and loss, 0 to seed from the clock "
+			"(default: 0)");
+	fi_param_define(&hook_netem_prov_ctx.prov, "peers", FI_PARAM_STRING,
+			"Per peer settings, as a semicolon separated list of "
+			"<fi_addr>=<latency>/<bandwidth>/<jitter>/<loss>. "
+			"Empty fields keep the defaults above (default: none)");
+
+	hook_netem_domain_ops = hook_domain_ops;
+	hook_netem_domain_ops.cq_open = hook_netem_cq_open;
+	hook_netem_domain_ops.endpoint = hook_netem_endpoint;
+	hook_netem_domain_ops.scalable_ep = hook_netem_scalable_ep;
+	hook_netem_domain_ops.srx_ctx = hook_netem_srx_ctx;
+
+	hook_netem_cq_fid_ops = hook_fid_ops;
+	hook_netem_cq_fid_ops.close = hook_netem_cq_close;
+
+	hook_netem_cq_ops = hook_cq_ops;
+	hook_netem_cq_ops.read = hook_netem_cq_read;
+	hook_netem_cq_ops.readfrom = hook_netem_cq_readfrom;
+	hook_netem_cq_ops.readerr = hook_netem_cq_readerr;
+	hook_netem_cq_ops.sread = hook_netem_cq_sread;
+	hook_netem_cq_ops.sreadfrom = hook_netem_cq_sreadfrom;
+
+	hook_netem_ep_fid_ops = hook_fid_ops;
+	hook_netem_ep_fid_ops.close = hook_netem_ep_close;
+	hook_netem_ep_fid_ops.bind = hook_ctx_ep_bind;
+
+	hook_ctx_ini();
+
+	hook_netem_prov_ctx.ini_fid[FI_CLASS_DOMAIN] = hook_netem_domain_init;
+	return &hook_netem_prov_ctx.prov;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HOOK_CTX_H_
+#define _HOOK_CTX_H_
+
+#include "ofi_hook.h"
+#include "ofi_list.h"
+#include "ofi_lock.h"
+#include "ofi_mem.h"
+#include "ofi.h"
+
+/*
+ * Context wrapping for hooks that act on completions.  Every data transfer
+ * that will generate a CQ entry has its context replaced by an entry from
+ * the hook's pool, which the hook extends with its own fields.  The
+ * application's context is restored when the completion is read.
+ */
+
+enum hook_ctx_op {
+	HOOK_CTX_SEND,
+	HOOK_CTX_RECV,
+	HOOK_CTX_TSEND,
+	HOOK_CTX_TRECV,
+	HOOK_CTX_WRITE,
+	HOOK_CTX_READ,
+	HOOK_CTX_ATOMIC,
+	HOOK_CTX_FETCH,		/* fetching and compare atomics */
+	HOOK_CTX_OP_MAX,
+};
+
+/*
+ * The provider may use the leading fi_context2 when it requires FI_CONTEXT
+ * or FI_CONTEXT2.  magic is only set while the operation is outstanding.
+ */
+struct hook_ctx {
+	struct fi_context2	prov_ctx;
+	uint64_t		magic;
+	struct hook_ctx_ep	*ep;
+	void			*context;
+	uint8_t			op;
+	uint8_t			multi_recv;
+};
+
+/*
+ * Entries for all endpoints of a hook come from one pool with per-thread
+ * caches, so posting an operation takes no endpoint lock.  The pool's
+ * regions are recorded, so that a context can be checked against them
+ * and fi_cancel can find the entry for an application context.
+ */
+struct hook_ctx_pool {
+	struct ofi_bufpool	*pool;
+	ofi_mutex_t		lock;
+	struct dlist_entry	region_list;
+};
+
+typedef void (*hook_ctx_start_fn)(struct hook_ctx *ctx, fi_addr_t addr,
+				  size_t len);
+
+struct hook_ctx_ep {
+	struct hook_ep		hook_ep;
+	struct hook_ctx_pool	*pool;
+	/* sets the hook's fields of an entry for a new operation */
+	hook_ctx_start_fn	start;
+	uint64_t		tx_op_flags;
+	uint64_t		rx_op_flags;
+	uint8_t			tx_cq;
+	uint8_t			rx_cq;
+	uint8_t			tx_selective;
+	uint8_t			rx_selective;
+};
+
+void hook_ctx_ini(void);
+int hook_ctx_pool_create(struct hook_ctx_pool *pool, size_t size);
+void hook_ctx_pool_destroy(struct hook_ctx_pool *pool);
+int hook_ctx_owned(struct hook_ctx_pool *pool, void *context);
+
+/*
+ * hook_ctx_ep_init sets the data transfer and cancel ops of the endpoint.
+ * The hook sets the fid ops, using hook_ctx_ep_bind, and calls
+ * hook_ctx_ep_cleanup once the provider's endpoint has been closed.
+ */
+int hook_ctx_ep_init(struct fid_domain *domain, struct fi_info *info,
+		     struct fid_ep **ep, void *context,
+		     struct hook_ctx_ep *myep, struct hook_ctx_pool *pool,
+		     hook_ctx_start_fn start);
+void hook_ctx_ep_cleanup(struct hook_ctx_ep *ep);
+int hook_ctx_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags);
+
+static inline void hook_ctx_free(struct hook_ctx *ctx)
+{
+	ctx->magic = 0;
+	ofi_buf_free(ctx);
+}
+
+/*
+ * Restores the application's context of a completion and returns the
+ * entry, or NULL if the operation was not wrapped.  Successful completions
+ * are only generated for wrapped operations, but errors may be reported
+ * for operations that did not request a completion, so the context of an
+ * error is checked against the pool before it is used.
+ */
+static inline struct hook_ctx *
+hook_ctx_unwrap(struct hook_ctx_pool *pool, void **op_context, int err)
+{
+	struct hook_ctx *ctx = *op_context;
+
+	if (!ctx || (OFI_UNLIKELY(err) && !hook_ctx_owned(pool, ctx)))
+		return NULL;
+
+	assert(ctx->magic == OFI_MAGIC_64);
+	*op_context = ctx->context;
+	return ctx;
+}
+
+/* Frees the entry unless it is for a multi-receive buffer still in use */
+static inline void
+hook_ctx_release(struct hook_ctx *ctx, uint64_t flags, int err)
+{
+	if (!ctx->multi_recv || err || (flags & FI_MULTI_RECV))
+		hook_ctx_free(ctx);
+}
+
+#endif /* _HOOK_CTX_H_ */
@@ -0,0 +1,1053 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ofi.h"
+#include "ofi_atomic.h"
+#include "ofi_iov.h"
+#include "ofi_mem.h"
+#include "ofi_hook.h"
+#include "hook_prov.h"
+#include "hook_ctx.h"
+
+/* Range of a region of the entry pool */
+struct hook_ctx_region {
+	struct dlist_entry	entry;
+	char			*start;
+	char			*end;
+};
+
+static struct fi_ops_ep hook_ctx_ep_ops;
+
+static inline struct fi_provider *hook_ctx_prov(struct hook_ctx_ep *ep)
+{
+	return &ep->hook_ep.domain->fabric->prov_ctx->prov;
+}
+
+/*
+ * Pool
+ */
+
+static int hook_ctx_region_alloc(struct ofi_bufpool_region *region)
+{
+	struct hook_ctx_pool *pool = region->pool->attr.context;
+	struct hook_ctx_region *range;
+
+	range = malloc(sizeof(*range));
+	if (!range)
+		return -FI_ENOMEM;
+
+	range->start = region->mem_region;
+	range->end = region->mem_region + region->pool->region_size;
+	region->context = range;
+
+	ofi_mutex_lock(&pool->lock);
+	dlist_insert_tail(&range->entry, &pool->region_list);
+	ofi_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+static void hook_ctx_region_free(struct ofi_bufpool_region *region)
+{
+	struct hook_ctx_pool *pool = region->pool->attr.context;
+	struct hook_ctx_region *range = region->context;
+
+	ofi_mutex_lock(&pool->lock);
+	dlist_remove(&range->entry);
+	ofi_mutex_unlock(&pool->lock);
+	free(range);
+}
+
+int hook_ctx_pool_create(struct hook_ctx_pool *pool, size_t size)
+{
+	struct ofi_bufpool_attr attr = {
+		.size		= size,
+		.alignment	= 16,
+		.max_cnt	= 0,
+		.chunk_cnt	= 256,
+		.alloc_fn	= hook_ctx_region_alloc,
+		.free_fn	= hook_ctx_region_free,
+		.context	= pool,
+		/* operations still posted when an endpoint closes never
+		 * complete, so their entries are only freed with the pool */
+		.flags		= OFI_BUFPOOL_THREAD_CACHE | OFI_BUFPOOL_NO_TRACK,
+	};
+	int ret;
+
+	assert(size >= sizeof(struct hook_ctx));
+	ret = ofi_mutex_init(&pool->lock);
+	if (ret)
+		return -ret;
+
+	dlist_init(&pool->region_list);
+	ret = ofi_bufpool_create_attr(&attr, &pool->pool);
+	if (ret)
+		ofi_mutex_destroy(&pool->lock);
+	return ret;
+}
+
+void hook_ctx_pool_destroy(struct hook_ctx_pool *pool)
+{
+	ofi_bufpool_destroy(pool->pool);
+	ofi_mutex_destroy(&pool->lock);
+}
+
+/* Returns whether context is an outstanding entry from the pool */
+int hook_ctx_owned(struct hook_ctx_pool *pool, void *context)
+{
+	struct hook_ctx_region *range;
+	char *buf = context;
+	int ret = 0;
+
+	ofi_mutex_lock(&pool->lock);
+	dlist_foreach_container(&pool->region_list, struct hook_ctx_region,
+				range, entry) {
+		if (buf < range->start || buf >= range->end)
+			continue;
+
+		ret = !((size_t) (buf - range->start) % pool->pool->entry_size) &&
+		      ((struct hook_ctx *) buf)->magic == OFI_MAGIC_64;
+		break;
+	}
+	ofi_mutex_unlock(&pool->lock);
+	return ret;
+}
+
+/*
+ * Operation tracking
+ */
+
+static inline int
+hook_ctx_tracked(struct hook_ctx_ep *ep, int tx, uint64_t flags)
+{
+	if (tx)
+		return ep->tx_cq && (!ep->tx_selective || (flags & FI_COMPLETION));
+
+	return ep->rx_cq && (!ep->rx_selective || (flags & FI_COMPLETION));
+}
+
+/*
+ * Sets the context to pass to the provider: the application's own if the
+ * operation will not generate a completion, otherwise a new entry.  The
+ * application's context may be NULL, so failure is reported separately.
+ */
+static inline ssize_t
+hook_ctx_start(struct hook_ctx_ep *ep, enum hook_ctx_op op, uint64_t flags,
+	       fi_addr_t addr, size_t len, void *context, void **mycontext)
+{
+	struct hook_ctx *ctx;
+	int tx = op != HOOK_CTX_RECV && op != HOOK_CTX_TRECV;
+
+	if (!hook_ctx_tracked(ep, tx, flags)) {
+		*mycontext = context;
+		return 0;
+	}
+
+	ctx = ofi_buf_alloc(ep->pool->pool);
+	if (OFI_UNLIKELY(!ctx))
+		return -FI_EAGAIN;
+
+	ctx->ep = ep;
+	ctx->context = context;
+	ctx->op = (uint8_t) op;
+	ctx->multi_recv = !tx && (flags & FI_MULTI_RECV);
+	ep->start(ctx, addr, len);
+	ctx->magic = OFI_MAGIC_64;
+	*mycontext = ctx;
+	return 0;
+}
+
+static inline ssize_t hook_ctx_end(struct hook_ctx_ep *ep, ssize_t ret,
+				   void *context, void *mycontext)
+{
+	if (ret && mycontext != context)
+		hook_ctx_free(mycontext);
+	return ret;
+}
+
+/*
+ * Msg
+ */
+
+static ssize_t
+hook_ctx_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	      fi_addr_t src_addr, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_RECV, myep->rx_op_flags,
+			     src_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_recv(myep->hook_ep.hep, buf, len, desc,
+					  src_addr, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t src_addr, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_RECV, myep->rx_op_flags,
+			     src_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_recvv(myep->hook_ep.hep, iov, desc,
+					   count, src_addr, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_RECV, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_recvmsg(myep->hook_ep.hep, &mymsg,
+					     flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	      fi_addr_t dest_addr, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_SEND, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_send(myep->hook_ep.hep, buf, len, desc,
+					  dest_addr, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t dest_addr, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_SEND, myep->tx_op_flags,
+			     dest_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_sendv(myep->hook_ep.hep, iov, desc,
+					   count, dest_addr, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_sendmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_SEND, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_sendmsg(myep->hook_ep.hep, &mymsg,
+					     flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		  uint64_t data, fi_addr_t dest_addr, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_SEND, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_senddata(myep->hook_ep.hep, buf, len,
+					      desc, data, dest_addr,
+					      mycontext),
+			    context, mycontext);
+}
+
+static struct fi_ops_msg hook_ctx_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = hook_ctx_recv,
+	.recvv = hook_ctx_recvv,
+	.recvmsg = hook_ctx_recvmsg,
+	.send = hook_ctx_send,
+	.sendv = hook_ctx_sendv,
+	.sendmsg = hook_ctx_sendmsg,
+	.senddata = hook_ctx_senddata,
+};
+
+/*
+ * Tagged
+ */
+
+static ssize_t
+hook_ctx_trecv(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	       fi_addr_t src_addr, uint64_t tag, uint64_t ignore,
+	       void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TRECV, myep->rx_op_flags,
+			     src_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_trecv(myep->hook_ep.hep, buf, len, desc,
+					   src_addr, tag, ignore, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_trecvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+		size_t count, fi_addr_t src_addr, uint64_t tag,
+		uint64_t ignore, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TRECV, myep->rx_op_flags,
+			     src_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_trecvv(myep->hook_ep.hep, iov, desc,
+					    count, src_addr, tag, ignore,
+					    mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_trecvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
+		  uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_tagged mymsg = *msg;
+	ssize_t ret;
+
+	/* FI_CLAIM must pass the context used with FI_PEEK, which the
+	 * provider may have written to, so these cannot be wrapped. */
+	if (flags & (FI_PEEK | FI_CLAIM | FI_DISCARD)) {
+		FI_WARN(hook_ctx_prov(myep), FI_LOG_EP_DATA,
+			"FI_PEEK, FI_CLAIM and FI_DISCARD are not supported\n");
+		return -FI_ENOSYS;
+	}
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TRECV, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_trecvmsg(myep->hook_ep.hep, &mymsg,
+					      flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_tsend(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	       fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TSEND, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_tsend(myep->hook_ep.hep, buf, len, desc,
+					   dest_addr, tag, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_tsendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+		size_t count, fi_addr_t dest_addr, uint64_t tag,
+		void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TSEND, myep->tx_op_flags,
+			     dest_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_tsendv(myep->hook_ep.hep, iov, desc,
+					    count, dest_addr, tag, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
+		  uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_tagged mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TSEND, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_tsendmsg(myep->hook_ep.hep, &mymsg,
+					      flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_tsenddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		   uint64_t data, fi_addr_t dest_addr, uint64_t tag,
+		   void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_TSEND, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_tsenddata(myep->hook_ep.hep, buf, len,
+					       desc, data, dest_addr, tag,
+					       mycontext),
+			    context, mycontext);
+}
+
+static struct fi_ops_tagged hook_ctx_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = hook_ctx_trecv,
+	.recvv = hook_ctx_trecvv,
+	.recvmsg = hook_ctx_trecvmsg,
+	.send = hook_ctx_tsend,
+	.sendv = hook_ctx_tsendv,
+	.sendmsg = hook_ctx_tsendmsg,
+	.senddata = hook_ctx_tsenddata,
+};
+
+/*
+ * RMA
+ */
+
+static ssize_t
+hook_ctx_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	      fi_addr_t src_addr, uint64_t addr, uint64_t key, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_READ, myep->tx_op_flags,
+			     src_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_read(myep->hook_ep.hep, buf, len, desc,
+					  src_addr, addr, key, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t src_addr, uint64_t addr, uint64_t key,
+	       void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_READ, myep->tx_op_flags,
+			     src_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_readv(myep->hook_ep.hep, iov, desc,
+					   count, src_addr, addr, key,
+					   mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+		 uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_rma mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_READ, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_readmsg(myep->hook_ep.hep, &mymsg,
+					     flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	       fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+	       void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_WRITE, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_write(myep->hook_ep.hep, buf, len, desc,
+					   dest_addr, addr, key, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
+		size_t count, fi_addr_t dest_addr, uint64_t addr,
+		uint64_t key, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_WRITE, myep->tx_op_flags,
+			     dest_addr, ofi_total_iov_len(iov, count),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_writev(myep->hook_ep.hep, iov, desc,
+					    count, dest_addr, addr, key,
+					    mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+		  uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_rma mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_WRITE, flags, msg->addr,
+			     ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_writemsg(myep->hook_ep.hep, &mymsg,
+					      flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		   uint64_t data, fi_addr_t dest_addr, uint64_t addr,
+		   uint64_t key, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_WRITE, myep->tx_op_flags,
+			     dest_addr, len, context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_writedata(myep->hook_ep.hep, buf, len,
+					       desc, data, dest_addr, addr,
+					       key, mycontext),
+			    context, mycontext);
+}
+
+static struct fi_ops_rma hook_ctx_rma_ops = {
+	.size = sizeof(struct fi_ops_rma),
+	.read = hook_ctx_read,
+	.readv = hook_ctx_readv,
+	.readmsg = hook_ctx_readmsg,
+	.write = hook_ctx_write,
+	.writev = hook_ctx_writev,
+	.writemsg = hook_ctx_writemsg,
+	.writedata = hook_ctx_writedata,
+};
+
+/*
+ * Atomic
+ */
+
+static ssize_t
+hook_ctx_atomic_write(struct fid_ep *ep, const void *buf, size_t count,
+		      void *desc, fi_addr_t dest_addr, uint64_t addr,
+		      uint64_t key, enum fi_datatype datatype, enum fi_op op,
+		      void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_ATOMIC, myep->tx_op_flags,
+			     dest_addr, count * ofi_datatype_size(datatype),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_atomic(myep->hook_ep.hep, buf, count,
+					    desc, dest_addr, addr, key,
+					    datatype, op, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_writev(struct fid_ep *ep, const struct fi_ioc *iov,
+		       void **desc, size_t count, fi_addr_t dest_addr,
+		       uint64_t addr, uint64_t key, enum fi_datatype datatype,
+		       enum fi_op op, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_ATOMIC, myep->tx_op_flags,
+			     dest_addr,
+			     ofi_total_ioc_cnt(iov, count) *
+			     ofi_datatype_size(datatype), context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_atomicv(myep->hook_ep.hep, iov, desc,
+					     count, dest_addr, addr, key,
+					     datatype, op, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_writemsg(struct fid_ep *ep, const struct fi_msg_atomic *msg,
+			 uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_atomic mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_ATOMIC, flags, msg->addr,
+			     ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+			     ofi_datatype_size(msg->datatype),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_atomicmsg(myep->hook_ep.hep, &mymsg,
+					       flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_atomic_readwrite(struct fid_ep *ep, const void *buf, size_t count,
+			  void *desc, void *result, void *result_desc,
+			  fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+			  enum fi_datatype datatype, enum fi_op op,
+			  void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, myep->tx_op_flags,
+			     dest_addr, count * ofi_datatype_size(datatype),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_fetch_atomic(myep->hook_ep.hep, buf,
+						  count, desc, result,
+						  result_desc, dest_addr,
+						  addr, key, datatype, op,
+						  mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_readwritev(struct fid_ep *ep, const struct fi_ioc *iov,
+			   void **desc, size_t count, struct fi_ioc *resultv,
+			   void **result_desc, size_t result_count,
+			   fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+			   enum fi_datatype datatype, enum fi_op op,
+			   void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, myep->tx_op_flags,
+			     dest_addr,
+			     ofi_total_ioc_cnt(iov, count) *
+			     ofi_datatype_size(datatype), context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_fetch_atomicv(myep->hook_ep.hep, iov,
+						   desc, count, resultv,
+						   result_desc, result_count,
+						   dest_addr, addr, key,
+						   datatype, op, mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_readwritemsg(struct fid_ep *ep,
+			     const struct fi_msg_atomic *msg,
+			     struct fi_ioc *resultv, void **result_desc,
+			     size_t result_count, uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_atomic mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, flags, msg->addr,
+			     ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+			     ofi_datatype_size(msg->datatype),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_fetch_atomicmsg(myep->hook_ep.hep,
+						     &mymsg, resultv,
+						     result_desc,
+						     result_count, flags),
+			    msg->context, mymsg.context);
+}
+
+static ssize_t
+hook_ctx_atomic_compwrite(struct fid_ep *ep, const void *buf, size_t count,
+			  void *desc, const void *compare, void *compare_desc,
+			  void *result, void *result_desc,
+			  fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+			  enum fi_datatype datatype, enum fi_op op,
+			  void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, myep->tx_op_flags,
+			     dest_addr, count * ofi_datatype_size(datatype),
+			     context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_compare_atomic(myep->hook_ep.hep, buf,
+						    count, desc, compare,
+						    compare_desc, result,
+						    result_desc, dest_addr,
+						    addr, key, datatype, op,
+						    mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_compwritev(struct fid_ep *ep, const struct fi_ioc *iov,
+			   void **desc, size_t count,
+			   const struct fi_ioc *comparev, void **compare_desc,
+			   size_t compare_count, struct fi_ioc *resultv,
+			   void **result_desc, size_t result_count,
+			   fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+			   enum fi_datatype datatype, enum fi_op op,
+			   void *context)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	void *mycontext;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, myep->tx_op_flags,
+			     dest_addr,
+			     ofi_total_ioc_cnt(iov, count) *
+			     ofi_datatype_size(datatype), context, &mycontext);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_compare_atomicv(myep->hook_ep.hep, iov,
+						     desc, count, comparev,
+						     compare_desc,
+						     compare_count, resultv,
+						     result_desc,
+						     result_count, dest_addr,
+						     addr, key, datatype, op,
+						     mycontext),
+			    context, mycontext);
+}
+
+static ssize_t
+hook_ctx_atomic_compwritemsg(struct fid_ep *ep,
+			     const struct fi_msg_atomic *msg,
+			     const struct fi_ioc *comparev,
+			     void **compare_desc, size_t compare_count,
+			     struct fi_ioc *resultv, void **result_desc,
+			     size_t result_count, uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(ep, struct hook_ctx_ep,
+						hook_ep.ep);
+	struct fi_msg_atomic mymsg = *msg;
+	ssize_t ret;
+
+	ret = hook_ctx_start(myep, HOOK_CTX_FETCH, flags, msg->addr,
+			     ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+			     ofi_datatype_size(msg->datatype),
+			     msg->context, &mymsg.context);
+	if (ret)
+		return ret;
+
+	return hook_ctx_end(myep, fi_compare_atomicmsg(myep->hook_ep.hep,
+						       &mymsg, comparev,
+						       compare_desc,
+						       compare_count, resultv,
+						       result_desc,
+						       result_count, flags),
+			    msg->context, mymsg.context);
+}
+static struct fi_ops_atomic hook_ctx_atomic_ops;
+
+/*
+ * EP
+ */
+
+int hook_ctx_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
+{
+	struct hook_ctx_ep *myep = container_of(fid, struct hook_ctx_ep,
+						hook_ep.ep.fid);
+	int ret;
+
+	ret = hook_bind(fid, bfid, flags);
+	if (ret || bfid->fclass != FI_CLASS_CQ)
+		return ret;
+
+	if (flags & FI_TRANSMIT) {
+		myep->tx_cq = 1;
+		myep->tx_selective = !!(flags & FI_SELECTIVE_COMPLETION);
+	}
+	if (flags & FI_RECV) {
+		myep->rx_cq = 1;
+		myep->rx_selective = !!(flags & FI_SELECTIVE_COMPLETION);
+	}
+	return 0;
+}
+
+/* Looks through the pool, fi_cancel is too rare to track entries for */
+static ssize_t hook_ctx_ep_cancel(fid_t fid, void *context)
+{
+	struct hook_ctx_ep *myep = container_of(fid, struct hook_ctx_ep,
+						hook_ep.ep.fid);
+	struct hook_ctx_pool *pool = myep->pool;
+	struct hook_ctx_region *range;
+	struct hook_ctx *ctx;
+	void *mycontext = context;
+	char *buf;
+
+	ofi_mutex_lock(&pool->lock);
+	dlist_foreach_container(&pool->region_list, struct hook_ctx_region,
+				range, entry) {
+		for (buf = range->start; buf < range->end;
+		     buf += pool->pool->entry_size) {
+			ctx = (struct hook_ctx *) buf;
+			if (ctx->magic == OFI_MAGIC_64 && ctx->ep == myep &&
+			    ctx->context == context) {
+				mycontext = ctx;
+				goto out;
+			}
+		}
+	}
+out:
+	ofi_mutex_unlock(&pool->lock);
+
+	return fi_cancel(&myep->hook_ep.hep->fid, mycontext);
+}
+
+/*
+ * Operations still posted when the provider's endpoint was closed will not
+ * complete.  Their entries are collected first, as freeing one may grow
+ * into the pool, which takes the pool lock before ours.
+ */
+void hook_ctx_ep_cleanup(struct hook_ctx_ep *ep)
+{
+	struct hook_ctx_pool *pool = ep->pool;
+	struct hook_ctx_region *range;
+	struct slist_entry *item;
+	struct hook_ctx *ctx;
+	struct slist list;
+	char *buf;
+
+	slist_init(&list);
+	ofi_mutex_lock(&pool->lock);
+	dlist_foreach_container(&pool->region_list, struct hook_ctx_region,
+				range, entry) {
+		for (buf = range->start; buf < range->end;
+		     buf += pool->pool->entry_size) {
+			ctx = (struct hook_ctx *) buf;
+			if (ctx->magic != OFI_MAGIC_64 || ctx->ep != ep)
+				continue;
+
+			ctx->magic = 0;
+			slist_insert_tail((struct slist_entry *) &ctx->prov_ctx,
+					  &list);
+		}
+	}
+	ofi_mutex_unlock(&pool->lock);
+
+	while (!slist_empty(&list)) {
+		item = slist_remove_head(&list);
+		ofi_buf_free(container_of(item, struct hook_ctx, prov_ctx));
+	}
+}
+
+int hook_ctx_ep_init(struct fid_domain *domain, struct fi_info *info,
+		     struct fid_ep **ep, void *context,
+		     struct hook_ctx_ep *myep, struct hook_ctx_pool *pool,
+		     hook_ctx_start_fn start)
+{
+	int ret;
+
+	myep->pool = pool;
+	myep->start = start;
+	myep->tx_op_flags = info->tx_attr->op_flags;
+	myep->rx_op_flags = info->rx_attr->op_flags;
+
+	ret = hook_endpoint_init(domain, info, ep, context, &myep->hook_ep);
+	if (ret)
+		return ret;
+
+	myep->hook_ep.ep.ops = &hook_ctx_ep_ops;
+	myep->hook_ep.ep.msg = &hook_ctx_msg_ops;
+	myep->hook_ep.ep.tagged = &hook_ctx_tagged_ops;
+	myep->hook_ep.ep.rma = &hook_ctx_rma_ops;
+	myep->hook_ep.ep.atomic = &hook_ctx_atomic_ops;
+	return 0;
+}
+
+/* Called from the ini function of each hook using these ops */
+void hook_ctx_ini(void)
+{
+	hook_ctx_ep_ops = hook_ep_ops;
+	hook_ctx_ep_ops.cancel = hook_ctx_ep_cancel;
+
+	hook_ctx_msg_ops.inject = hook_msg_ops.inject;
+	hook_ctx_msg_ops.injectdata = hook_msg_ops.injectdata;
+	hook_ctx_tagged_ops.inject = hook_tagged_ops.inject;
+	hook_ctx_tagged_ops.injectdata = hook_tagged_ops.injectdata;
+	hook_ctx_rma_ops.inject = hook_rma_ops.inject;
+	hook_ctx_rma_ops.injectdata = hook_rma_ops.injectdata;
+
+	hook_ctx_atomic_ops = hook_atomic_ops;
+	hook_ctx_atomic_ops.write = hook_ctx_atomic_write;
+	hook_ctx_atomic_ops.writev = hook_ctx_atomic_writev;
+	hook_ctx_atomic_ops.writemsg = hook_ctx_atomic_writemsg;
+	hook_ctx_atomic_ops.readwrite = hook_ctx_atomic_readwrite;
+	hook_ctx_atomic_ops.readwritev = hook_ctx_atomic_readwritev;
+	hook_ctx_atomic_ops.readwritemsg = hook_ctx_atomic_readwritemsg;
+	hook_ctx_atomic_ops.compwrite = hook_ctx_atomic_compwrite;
+	hook_ctx_atomic_ops.compwritev = hook_ctx_atomic_compwritev;
+	hook_ctx_atomic_ops.compwritemsg = hook_ctx_atomic_compwritemsg;
+}
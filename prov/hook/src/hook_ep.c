@@ -75,7 +75,7 @@ static int hook_rx_ctx(struct fid_ep *sep, int index,
 	return hook_open_rx_ctx(sep, index, attr, rx_ep, context);
 }
 
-static struct fi_ops_ep hook_ep_ops = {
+struct fi_ops_ep hook_ep_ops = {
 	.size = sizeof(struct fi_ops_ep),
 	.cancel = hook_cancel,
 	.getopt = hook_getopt,
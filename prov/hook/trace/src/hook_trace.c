@@ -32,6 +32,7 @@
 #include "ofi_hook.h"
 #include "ofi_prov.h"
 #include "ofi_iov.h"
+#include "ofi_trace.h"
 
 #include <stdio.h>
 
@@ -58,26 +59,66 @@
 		                "addr", addr);	\
 	}
 
-#define TRACE_EP_MSG(ret, ep, buf, len, addr, data, flags, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+/*
+ * Binary mode replaces the text output for data transfers and completions
+ * with records written to per thread rings, see ofi_trace.h.  Failed
+ * calls, including -FI_EAGAIN, are recorded as well.
+ */
+static int trace_binary;
+
+static inline void
+trace_rec(ssize_t ret, int op, struct fid *fid, void *context, size_t len,
+	  fi_addr_t addr, uint64_t tag, uint64_t flags, uint32_t count)
+{
+	struct ofi_trace_ring *ring;
+	struct ofi_trace_rec *rec;
+
+	ring = ofi_trace_ring_get();
+	if (!ring)
+		return;
+
+	rec = ofi_trace_reserve(ring);
+	rec->fid = (uintptr_t) fid;
+	rec->context = (uintptr_t) context;
+	rec->len = len;
+	rec->addr = addr;
+	rec->tag = tag;
+	rec->flags = flags;
+	rec->op = (uint16_t) op;
+	rec->ret = (int16_t) ret;
+	rec->count = count;
+	ofi_trace_commit(ring, rec);
+}
+
+#define TRACE_EP_MSG(ret, op, myep, buf, len, addr, data, flags, context) \
+	if (trace_binary) { \
+		trace_rec(ret, op, &(myep)->ep.fid, context, len, addr, 0, \
+			  flags, 0); \
+	} else if (!(ret)) { \
+		FI_TRACE((myep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %zu data %lu " \
 			"flags 0x%zx ctx %p\n", \
 			buf, len, addr, (uint64_t)data, (uint64_t)flags, context); \
 	}
 
-#define TRACE_EP_RMA(ret, ep, buf, len, addr, raddr, data, flags, key, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+#define TRACE_EP_RMA(ret, op, myep, buf, len, addr, raddr, data, flags, key, context) \
+	if (trace_binary) { \
+		trace_rec(ret, op, &(myep)->ep.fid, context, len, addr, raddr, \
+			  flags, 0); \
+	} else if (!(ret)) { \
+		FI_TRACE((myep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %zu raddr %lu data %lu " \
 			"flags 0x%zx key 0x%zx ctx %p\n", \
 			buf, len, addr, (uint64_t)raddr, (uint64_t)data, \
 			(uint64_t)flags, (uint64_t)key, context); \
 	}
 
-#define TRACE_EP_TAGGED(ret, ep, buf, len, addr, data, flags, tag, ignore, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+#define TRACE_EP_TAGGED(ret, op, myep, buf, len, addr, data, flags, tag, ignore, context) \
+	if (trace_binary) { \
+		trace_rec(ret, op, &(myep)->ep.fid, context, len, addr, tag, \
+			  flags, 0); \
+	} else if (!(ret)) { \
+		FI_TRACE((myep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %zu data %lu " \
 			"flags 0x%zx tag 0x%lx ignore 0x%zx ctx %p\n", \
 			buf, len, addr, (uint64_t)data, (uint64_t)flags, \
@@ -196,14 +237,58 @@ static trace_cq_entry_fn trace_cq_entry[] = {
 	trace_cq_tagged_entry
 };
 
+static void
+trace_cq_rec(struct hook_cq *cq, int count, void *buf, fi_addr_t *src_addr)
+{
+	struct fi_cq_tagged_entry *entry;
+	size_t entry_size;
+	int i;
+
+	switch (cq->format) {
+	case FI_CQ_FORMAT_CONTEXT:
+		entry_size = sizeof(struct fi_cq_entry);
+		break;
+	case FI_CQ_FORMAT_MSG:
+		entry_size = sizeof(struct fi_cq_msg_entry);
+		break;
+	case FI_CQ_FORMAT_DATA:
+		entry_size = sizeof(struct fi_cq_data_entry);
+		break;
+	case FI_CQ_FORMAT_TAGGED:
+		entry_size = sizeof(struct fi_cq_tagged_entry);
+		break;
+	default:
+		return;
+	}
+
+	/* the formats share a common prefix with the tagged entry */
+	for (i = 0; i < count; i++) {
+		entry = (struct fi_cq_tagged_entry *)
+			((char *) buf + i * entry_size);
+		trace_rec(0, OFI_TRACE_CQ_ENTRY, &cq->cq.fid,
+			  entry->op_context,
+			  cq->format >= FI_CQ_FORMAT_MSG ? entry->len : 0,
+			  src_addr ? src_addr[i] : FI_ADDR_NOTAVAIL,
+			  cq->format == FI_CQ_FORMAT_TAGGED ? entry->tag : 0,
+			  cq->format >= FI_CQ_FORMAT_MSG ? entry->flags : 0,
+			  count);
+	}
+}
+
 static inline void
 trace_cq(struct hook_cq *cq, const char *func, int line,
-         int count, void *buf, uint64_t data)
+         int count, void *buf, fi_addr_t *src_addr)
 {
-	if ((count > 0) &&
-	    fi_log_enabled(cq->domain->fabric->hprov, FI_LOG_TRACE, FI_LOG_CQ)) {
+	if (count <= 0)
+		return;
+
+	if (trace_binary) {
+		trace_cq_rec(cq, count, buf, src_addr);
+	} else if (fi_log_enabled(cq->domain->fabric->hprov, FI_LOG_TRACE,
+				  FI_LOG_CQ)) {
 		trace_cq_entry[cq->format](cq->domain->fabric->hprov, func,
-		                           line, count, buf, data);
+		                           line, count, buf,
+		                           src_addr ? *src_addr : 0);
 	}
 }
 
@@ -213,6 +298,13 @@ trace_cq_err(struct hook_cq *cq, const char *func, int line,
 {
 	char err_buf[80];
 
+	if (trace_binary) {
+		trace_rec(-entry->err, OFI_TRACE_CQ_ERROR, &cq->cq.fid,
+			  entry->op_context, entry->len, FI_ADDR_NOTAVAIL,
+			  entry->tag, entry->flags, 1);
+		return;
+	}
+
 	if (!fi_log_enabled(cq->domain->fabric->hprov, FI_LOG_TRACE, FI_LOG_CQ))
 		return;
 
@@ -450,7 +542,7 @@ trace_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	ssize_t ret;
 
 	ret = fi_recv(myep->hep, buf, len, desc, src_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, src_addr, 0, 0, context);
+	TRACE_EP_MSG(ret, OFI_TRACE_RECV, myep, buf, len, src_addr, 0, 0, context);
 
 	return ret;
 }
@@ -463,7 +555,7 @@ trace_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	ssize_t ret;
 
 	ret = fi_recvv(myep->hep, iov, desc, count, src_addr, context);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_MSG(ret, OFI_TRACE_RECVV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	             src_addr, 0, 0, context);
 
 	return ret;
@@ -476,7 +568,7 @@ trace_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 	ssize_t ret;
 
 	ret = fi_recvmsg(myep->hep, msg, flags);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_MSG(ret, OFI_TRACE_RECVMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	             IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	             flags & FI_REMOTE_CQ_DATA ? msg->data : 0,
 	             flags, msg->context);
@@ -492,7 +584,7 @@ trace_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	ssize_t ret;
 
 	ret = fi_send(myep->hep, buf, len, desc, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, 0, 0, context);
+	TRACE_EP_MSG(ret, OFI_TRACE_SEND, myep, buf, len, dest_addr, 0, 0, context);
 
 	return ret;
 }
@@ -505,7 +597,7 @@ trace_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	ssize_t ret;
 
 	ret = fi_sendv(myep->hep, iov, desc, count, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_MSG(ret, OFI_TRACE_SENDV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	             dest_addr, 0, 0, context);
 
 	return ret;
@@ -518,7 +610,7 @@ trace_sendmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 	ssize_t ret;
 
 	ret = fi_sendmsg(myep->hep, msg, flags);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_MSG(ret, OFI_TRACE_SENDMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	             IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	             MSG_DATA(msg->data, flags), flags, msg->context);
 
@@ -533,7 +625,7 @@ trace_inject(struct fid_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ret = fi_inject(myep->hep, buf, len, dest_addr);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, 0, 0, NULL);
+	TRACE_EP_MSG(ret, OFI_TRACE_INJECT, myep, buf, len, dest_addr, 0, 0, NULL);
 
 	return ret;
 }
@@ -546,7 +638,7 @@ trace_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	ssize_t ret;
 
 	ret = fi_senddata(myep->hep, buf, len, desc, data, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, data, 0, context);
+	TRACE_EP_MSG(ret, OFI_TRACE_SENDDATA, myep, buf, len, dest_addr, data, 0, context);
 
 	return ret;
 }
@@ -559,7 +651,7 @@ trace_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ret = fi_injectdata(myep->hep, buf, len, data, dest_addr);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, data, 0,  NULL);
+	TRACE_EP_MSG(ret, OFI_TRACE_INJECTDATA, myep, buf, len, dest_addr, data, 0,  NULL);
 
 	return ret;
 }
@@ -586,7 +678,7 @@ trace_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	ssize_t ret;
 
 	ret = fi_read(myep->hep, buf, len, desc, src_addr, addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, src_addr, addr, 0, 0, key, context);
+	TRACE_EP_RMA(ret, OFI_TRACE_READ, myep, buf, len, src_addr, addr, 0, 0, key, context);
 
 	return ret;
 }
@@ -601,7 +693,7 @@ trace_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 
 	ret = fi_readv(myep->hep, iov, desc, count, src_addr,
 		       addr, key, context);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_RMA(ret, OFI_TRACE_READV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	             src_addr, addr, 0, 0, key, context);
 
 	return ret;
@@ -614,7 +706,7 @@ trace_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg, uint64_t flags)
 	ssize_t ret;
 
 	ret = fi_readmsg(myep->hep, msg, flags);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_RMA(ret, OFI_TRACE_READMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	             IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	             msg->rma_iov_count ? msg->rma_iov[0].addr : 0,
 	             MSG_DATA(msg->data, flags), flags,
@@ -633,7 +725,7 @@ trace_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 
 	ret = fi_write(myep->hep, buf, len, desc, dest_addr,
 		       addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, 0, 0, key, context);
+	TRACE_EP_RMA(ret, OFI_TRACE_WRITE, myep, buf, len, dest_addr, addr, 0, 0, key, context);
 
 	return ret;
 }
@@ -648,7 +740,7 @@ trace_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
 
 	ret = fi_writev(myep->hep, iov, desc, count, dest_addr,
 			addr, key, context);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_RMA(ret, OFI_TRACE_WRITEV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	             dest_addr, addr, 0, 0, key, context);
 
 	return ret;
@@ -661,7 +753,7 @@ trace_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg, uint64_t flags)
 	ssize_t ret;
 
 	ret = fi_writemsg(myep->hep, msg, flags);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_RMA(ret, OFI_TRACE_WRITEMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	             IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	             msg->rma_iov_count ? msg->rma_iov[0].addr : 0,
 	             MSG_DATA(msg->data, flags), flags,
@@ -679,7 +771,7 @@ trace_inject_write(struct fid_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ret = fi_inject_write(myep->hep, buf, len, dest_addr, addr, key);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, 0, 0, key, NULL);
+	TRACE_EP_RMA(ret, OFI_TRACE_INJECT_WRITE, myep, buf, len, dest_addr, addr, 0, 0, key, NULL);
 
 	return ret;
 }
@@ -694,7 +786,7 @@ trace_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 
 	ret = fi_writedata(myep->hep, buf, len, desc, data,
 			   dest_addr, addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, data, 0, key, context);
+	TRACE_EP_RMA(ret, OFI_TRACE_WRITEDATA, myep, buf, len, dest_addr, addr, data, 0, key, context);
 
 	return ret;
 }
@@ -709,7 +801,7 @@ trace_inject_writedata(struct fid_ep *ep, const void *buf, size_t len,
 
 	ret = fi_inject_writedata(myep->hep, buf, len, data, dest_addr,
 				  addr, key);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, data, 0, key, NULL);
+	TRACE_EP_RMA(ret, OFI_TRACE_INJECT_WRITEDATA, myep, buf, len, dest_addr, addr, data, 0, key, NULL);
 
 	return ret;
 }
@@ -738,7 +830,7 @@ trace_trecv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 
 	ret = fi_trecv(myep->hep, buf, len, desc, src_addr,
 		       tag, ignore, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, src_addr, 0, 0, tag, ignore, context);
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TRECV, myep, buf, len, src_addr, 0, 0, tag, ignore, context);
 
 	return ret;
 }
@@ -753,7 +845,7 @@ trace_trecvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 
 	ret = fi_trecvv(myep->hep, iov, desc, count, src_addr,
 			tag, ignore, context);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TRECVV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	                src_addr, 0, 0, tag, ignore, context);
 
 	return ret;
@@ -767,7 +859,7 @@ trace_trecvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 	ssize_t ret;
 
 	ret = fi_trecvmsg(myep->hep, msg, flags);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TRECVMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	                IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	                MSG_DATA(msg->data, flags), flags,
 	                msg->tag, msg->ignore, msg->context);
@@ -783,7 +875,7 @@ trace_tsend(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	ssize_t ret;
 
 	ret = fi_tsend(myep->hep, buf, len, desc, dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, 0, 0, tag, 0, context);
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TSEND, myep, buf, len, dest_addr, 0, 0, tag, 0, context);
 
 	return ret;
 }
@@ -796,7 +888,7 @@ trace_tsendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	ssize_t ret;
 
 	ret = fi_tsendv(myep->hep, iov, desc, count, dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TSENDV, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 	                dest_addr, 0, 0, tag, 0, context);
 
 	return ret;
@@ -810,7 +902,7 @@ trace_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 	ssize_t ret;
 
 	ret = fi_tsendmsg(myep->hep, msg, flags);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TSENDMSG, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 	                IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 	                MSG_DATA(msg->data, flags), flags,
 	                msg->tag, 0, msg->context);
@@ -826,7 +918,7 @@ trace_tinject(struct fid_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ret = fi_tinject(myep->hep, buf, len, dest_addr, tag);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, 0, 0, tag, 0, NULL);
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TINJECT, myep, buf, len, dest_addr, 0, 0, tag, 0, NULL);
 
 	return ret;
 }
@@ -841,7 +933,7 @@ trace_tsenddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 
 	ret = fi_tsenddata(myep->hep, buf, len, desc, data,
 			   dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, data, 0, tag, 0, context);
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TSENDDATA, myep, buf, len, dest_addr, data, 0, tag, 0, context);
 
 	return ret;
 }
@@ -854,7 +946,7 @@ trace_tinjectdata(struct fid_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ret = fi_tinjectdata(myep->hep, buf, len, data, dest_addr, tag);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, data, 0, tag, 0, NULL);
+	TRACE_EP_TAGGED(ret, OFI_TRACE_TINJECTDATA, myep, buf, len, dest_addr, data, 0, tag, 0, NULL);
 
 	return ret;
 }
@@ -1014,7 +1106,7 @@ static ssize_t trace_cq_read(struct fid_cq *cq, void *buf, size_t count)
 	ssize_t ret;
 
 	ret = fi_cq_read(mycq->hcq, buf, count);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, 0);
+	trace_cq(mycq, __func__, __LINE__, ret, buf, NULL);
 	return ret;
 }
 
@@ -1037,7 +1129,7 @@ trace_cq_readfrom(struct fid_cq *cq, void *buf, size_t count, fi_addr_t *src_add
 	ssize_t ret;
 
 	ret = fi_cq_readfrom(mycq->hcq, buf, count, src_addr);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr ? *src_addr : 0);
+	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr);
 	return ret;
 }
 
@@ -1049,7 +1141,7 @@ trace_cq_sread(struct fid_cq *cq, void *buf, size_t count,
 	ssize_t ret;
 
 	ret = fi_cq_sread(mycq->hcq, buf, count, cond, timeout);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, 0);
+	trace_cq(mycq, __func__, __LINE__, ret, buf, NULL);
 	return ret;
 }
 
@@ -1061,7 +1153,7 @@ trace_cq_sreadfrom(struct fid_cq *cq, void *buf, size_t count,
 	ssize_t ret;
 
 	ret = fi_cq_sreadfrom(mycq->hcq, buf, count, src_addr, cond, timeout);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr ? *src_addr : 0);
+	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr);
 	return ret;
 }
 
@@ -1422,6 +1514,39 @@ static struct fi_ops trace_fabric_fid_ops = {
 
 struct hook_prov_ctx hook_trace_ctx;
 
+static void trace_binary_init(void)
+{
+	char *dir = NULL, *clock = NULL;
+	size_t records = OFI_TRACE_DEF_RECORDS;
+	int ret;
+
+	fi_param_get_str(&hook_trace_ctx.prov, "dir", &dir);
+	if (!dir || trace_binary)
+		return;
+
+	fi_param_get_size_t(&hook_trace_ctx.prov, "records", &records);
+	fi_param_get_str(&hook_trace_ctx.prov, "clock", &clock);
+
+	ret = ofi_trace_open(dir, records,
+			     clock && !strcasecmp(clock, "tsc") ?
+			     OFI_TRACE_CLOCK_TSC : OFI_TRACE_CLOCK_MONO);
+	if (ret) {
+		FI_WARN(&hook_trace_ctx.prov, FI_LOG_FABRIC,
+			"unable to enable binary tracing: %s\n",
+			fi_strerror(-ret));
+		return;
+	}
+	trace_binary = 1;
+}
+
+static void hook_trace_cleanup(void)
+{
+	if (trace_binary) {
+		trace_binary = 0;
+		ofi_trace_close();
+	}
+}
+
 static int hook_trace_fabric(struct fi_fabric_attr *attr,
 			     struct fid_fabric **fabric, void *context)
 {
@@ -1429,6 +1554,7 @@ static int hook_trace_fabric(struct fi_fabric_attr *attr,
 	struct hook_fabric *fab;
 
 	FI_TRACE(hprov, FI_LOG_FABRIC, "Installing trace hook\n");
+	trace_binary_init();
 	fab = calloc(1, sizeof *fab);
 	if (!fab)
 		return -FI_ENOMEM;
@@ -1447,12 +1573,24 @@ struct hook_prov_ctx hook_trace_ctx = {
 		.name = "ofi_hook_trace",
 		.getinfo = NULL,
 		.fabric = hook_trace_fabric,
-		.cleanup = NULL,
+		.cleanup = hook_trace_cleanup,
 	},
 };
 
 HOOK_TRACE_INI
 {
+	fi_param_define(&hook_trace_ctx.prov, "dir", FI_PARAM_STRING,
+			"Write binary trace records for data transfers and "
+			"completions to per thread files in this directory "
+			"instead of logging them as text (default: none)");
+	fi_param_define(&hook_trace_ctx.prov, "records", FI_PARAM_SIZE_T,
+			"Records kept per thread in binary mode, rounded up "
+			"to a power of two (default: %d)",
+			OFI_TRACE_DEF_RECORDS);
+	fi_param_define(&hook_trace_ctx.prov, "clock", FI_PARAM_STRING,
+			"Time stamp source for binary mode, mono or tsc "
+			"(default: mono)");
+
 	hook_trace_ctx.ini_fid[FI_CLASS_DOMAIN] = trace_domain_init;
 	hook_trace_ctx.ini_fid[FI_CLASS_PEP] = trace_pep_init;
 
@@ -79,9 +79,19 @@ extern size_t mrail_num_info;
 enum {
 	MRAIL_POLICY_FIXED,
 	MRAIL_POLICY_ROUND_ROBIN,
-	MRAIL_POLICY_STRIPING
+	MRAIL_POLICY_STRIPING,
+	MRAIL_POLICY_ADAPTIVE
 };
 
+/* Messages up to this size are sent eagerly on a single rail by the adaptive
+ * policy. It is also the smallest stripe the adaptive policy hands to a rail.
+ */
+#define MRAIL_ADAPTIVE_STRIPE_SIZE	16384
+/* Completions smaller than this are latency bound and don't update the
+ * observed rail rate. */
+#define MRAIL_ADAPTIVE_MIN_SAMPLE	4096
+#define MRAIL_ANY_RAIL			UINT32_MAX
+
 #define MRAIL_MAX_CONFIG		8
 
 struct mrail_config {
@@ -92,6 +102,7 @@ struct mrail_config {
 extern struct mrail_config mrail_config[MRAIL_MAX_CONFIG];
 extern int mrail_num_config;
 extern int mrail_local_rank;
+extern int mrail_adaptive;
 
 extern struct fi_ops_rma mrail_ops_rma;
 
@@ -153,6 +164,14 @@ struct mrail_hdr {
 /* bit 60~63 are provider defined */
 #define MRAIL_RNDV_FLAG		(1ULL << 60)
 
+/* RMA operations, including rendezvous reads, are posted in chunks of at
+ * most this size, interleaved across the rails, so that a large transfer
+ * doesn't monopolize a rail and other traffic can slip in between chunks.
+ * The chunk size grows if a transfer would need more than
+ * MRAIL_RMA_MAX_CHUNKS chunks. */
+#define MRAIL_RMA_CHUNK_SIZE	(256 * 1024)
+#define MRAIL_RMA_MAX_CHUNKS	32
+
 struct mrail_rndv_hdr {
 	uint64_t		context;
 };
@@ -171,6 +190,12 @@ struct mrail_tx_buf {
 	 * util buf release */
 	void			*context;
 	struct mrail_ep		*ep;
+	/* control messages that couldn't be posted wait on the ep's
+	 * deferred_ctrl list */
+	struct slist_entry	entry;
+	fi_addr_t		addr;
+	/* bytes posted to the rail, tracked for the adaptive policy */
+	size_t			len;
 	/* flags would be used for both operation flags (FI_COMPLETION)
 	 * and completion flags (FI_MSG, FI_TAGGED, etc) */
 	uint64_t		flags;
@@ -178,6 +203,8 @@ struct mrail_tx_buf {
 	struct mrail_rndv_hdr	rndv_hdr;
 	struct mrail_rndv_req	*rndv_req;
 	fid_t			rndv_mr_fid;
+	/* send completion and ACK still to come for a rndv request */
+	int			rndv_refs;
 };
 
 struct mrail_pkt {
@@ -198,6 +225,8 @@ struct mrail_rndv_recv {
 	uint64_t		tag;
 	uint64_t		data;
 	size_t			len;
+	/* bytes of the message that did not fit the receive buffer */
+	size_t			olen;
 };
 
 struct mrail_recv {
@@ -233,6 +262,7 @@ struct mrail_domain {
 	struct fid_domain **domains;
 	size_t num_domains;
 	size_t addrlen;
+	uint64_t mr_key;
 };
 
 struct mrail_av {
@@ -270,6 +300,10 @@ struct mrail_ep {
 	struct {
 		struct fid_ep 		*ep;
 		struct fi_info		*info;
+		/* load tracking for the adaptive policy */
+		ofi_atomic64_t		pending_bytes;
+		uint64_t		busy_ts;
+		double			rate;	/* bytes per ns */
 	}			*rails;
 	size_t			num_eps;
 	ofi_atomic32_t		tx_rail;
@@ -284,6 +318,7 @@ struct mrail_ep {
 	struct ofi_bufpool 	*ooo_recv_pool;
 	struct ofi_bufpool 	*tx_buf_pool;
 	struct slist		deferred_reqs;
+	struct slist		deferred_ctrl;
 };
 
 struct mrail_addr_key {
@@ -294,6 +329,8 @@ struct mrail_addr_key {
 struct mrail_mr {
 	struct fid_mr mr_fid;
 	size_t num_mrs;
+	/* start of the region, for offset based addressing */
+	uint64_t addr;
 	struct {
 		uint64_t base_addr;
 		struct fid_mr *mr;
@@ -377,12 +414,107 @@ static inline int mrail_get_policy(size_t size)
 	return mrail_config[i].policy;
 }
 
-static inline size_t mrail_get_tx_rail(struct mrail_ep *mrail_ep, int policy)
+/*
+ * Rate used for rails that haven't completed a large enough transfer yet.
+ * Assume they are as fast as the fastest known rail so that they get traffic
+ * and a measurement.
+ */
+static inline double mrail_get_default_rate(struct mrail_ep *mrail_ep)
+{
+	double rate = 0;
+	size_t i;
+
+	for (i = 0; i < mrail_ep->num_eps; i++)
+		rate = MAX(rate, mrail_ep->rails[i].rate);
+
+	return rate ? rate : 1.0;
+}
+
+static inline double mrail_get_rail_rate(struct mrail_ep *mrail_ep,
+					 uint32_t rail, double default_rate)
+{
+	return mrail_ep->rails[rail].rate ? mrail_ep->rails[rail].rate :
+					    default_rate;
+}
+
+/* Pick the rail expected to finish a transfer of len bytes first */
+static inline size_t mrail_get_tx_rail_adaptive(struct mrail_ep *mrail_ep,
+						size_t len)
+{
+	double default_rate = mrail_get_default_rate(mrail_ep);
+	double eta, best_eta = 0;
+	size_t start, rail, best_rail, i;
+
+	/* Start from a rotating rail so that ties are spread evenly */
+	start = best_rail = mrail_get_tx_rail_rr(mrail_ep);
+	for (i = 0; i < mrail_ep->num_eps; i++) {
+		rail = (start + i) % mrail_ep->num_eps;
+		eta = (ofi_atomic_get64(&mrail_ep->rails[rail].pending_bytes) +
+		       len) / mrail_get_rail_rate(mrail_ep, rail, default_rate);
+		if (!i || eta < best_eta) {
+			best_eta = eta;
+			best_rail = rail;
+		}
+	}
+
+	return best_rail;
+}
+
+static inline size_t mrail_get_tx_rail(struct mrail_ep *mrail_ep, int policy,
+				       size_t len)
 {
-	return policy == MRAIL_POLICY_FIXED ?
-				mrail_ep->default_tx_rail :
-				mrail_get_tx_rail_rr(mrail_ep);
+	switch (policy) {
+	case MRAIL_POLICY_FIXED:
+		return mrail_ep->default_tx_rail;
+	case MRAIL_POLICY_ADAPTIVE:
+		return mrail_get_tx_rail_adaptive(mrail_ep, len);
+	default:
+		return mrail_get_tx_rail_rr(mrail_ep);
+	}
+}
+
+static inline void mrail_rail_post(struct mrail_ep *mrail_ep, uint32_t rail,
+				   size_t len)
+{
+	if (!mrail_adaptive)
+		return;
 
+	/* Rail was idle, start timing its drain from now */
+	if (ofi_atomic_add64(&mrail_ep->rails[rail].pending_bytes, len) == len)
+		mrail_ep->rails[rail].busy_ts = ofi_gettime_ns();
+}
+
+/* Undo mrail_rail_post() for a transfer the rail did not accept */
+static inline void mrail_rail_unpost(struct mrail_ep *mrail_ep, uint32_t rail,
+				     size_t len)
+{
+	if (mrail_adaptive)
+		ofi_atomic_sub64(&mrail_ep->rails[rail].pending_bytes, len);
+}
+
+/*
+ * Update the rail's observed rate with the time it took to drain len bytes
+ * since the rail's previous completion (or since it became busy).  This
+ * measures throughput rather than latency when transfers overlap.
+ */
+static inline void mrail_rail_complete(struct mrail_ep *mrail_ep, uint32_t rail,
+				       size_t len)
+{
+	uint64_t now, elapsed;
+	double sample;
+
+	if (!mrail_adaptive)
+		return;
+
+	now = ofi_gettime_ns();
+	elapsed = now - mrail_ep->rails[rail].busy_ts;
+	if (len >= MRAIL_ADAPTIVE_MIN_SAMPLE && elapsed) {
+		sample = (double) len / elapsed;
+		mrail_ep->rails[rail].rate = mrail_ep->rails[rail].rate ?
+			(mrail_ep->rails[rail].rate * 7 + sample) / 8 : sample;
+	}
+	mrail_ep->rails[rail].busy_ts = now;
+	ofi_atomic_sub64(&mrail_ep->rails[rail].pending_bytes, len);
 }
 
 struct mrail_subreq {
@@ -393,6 +525,8 @@ struct mrail_subreq {
 	struct fi_rma_iov rma_iov[MRAIL_IOV_LIMIT];
 	size_t iov_count;
 	size_t rma_iov_count;
+	size_t len;
+	uint32_t rail;
 };
 
 struct mrail_req {
@@ -439,7 +573,6 @@ static inline void mrail_cntr_incerr(struct util_cntr *cntr)
        }
 }
 
-int mrail_send_rndv_ack_blocking(struct mrail_ep *mrail_ep,
-				 struct mrail_cq *mrail_cq,
-				 fi_addr_t dest_addr,
-				 void *context);
+int mrail_send_rndv_ack(struct mrail_ep *mrail_ep, struct mrail_recv *recv);
+void mrail_progress_deferred_ctrl(struct mrail_ep *mrail_ep);
+void mrail_complete_rndv_recv(struct mrail_recv *recv, int err);
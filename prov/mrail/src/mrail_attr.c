@@ -59,6 +59,7 @@ struct fi_ep_attr mrail_ep_attr = {
 	.protocol_version 	= 1,
 	.max_msg_size 		= SIZE_MAX,
 	.msg_prefix_size	= SIZE_MAX,
+	.mem_tag_format		= FI_TAG_GENERIC,
 	.max_order_raw_size 	= SIZE_MAX,
 	.max_order_war_size 	= SIZE_MAX,
 	.max_order_waw_size 	= SIZE_MAX,
@@ -55,7 +55,8 @@ static int mrail_cq_write_send_comp(struct util_cq *cq,
 	if (tx_buf->hdr.protocol == MRAIL_PROTO_RNDV &&
 	    tx_buf->hdr.protocol_cmd == MRAIL_RNDV_REQ) {
 		free(tx_buf->rndv_req);
-		fi_close(tx_buf->rndv_mr_fid);
+		if (tx_buf->rndv_mr_fid)
+			fi_close(tx_buf->rndv_mr_fid);
 	}
 
 	ofi_ep_lock_acquire(&tx_buf->ep->util_ep);
@@ -65,6 +66,25 @@ static int mrail_cq_write_send_comp(struct util_cq *cq,
 	return ret;
 }
 
+/*
+ * A rndv send completes once both the send of the request and the peer's
+ * ACK have been processed. They come from different rails, so either may
+ * be first.
+ */
+static int mrail_cq_release_rndv_req(struct mrail_tx_buf *tx_buf)
+{
+	struct mrail_ep *mrail_ep = tx_buf->ep;
+	int refs;
+
+	ofi_ep_lock_acquire(&mrail_ep->util_ep);
+	refs = --tx_buf->rndv_refs;
+	ofi_ep_lock_release(&mrail_ep->util_ep);
+	if (refs)
+		return 0;
+
+	return mrail_cq_write_send_comp(mrail_ep->util_ep.tx_cq, tx_buf);
+}
+
 int mrail_cq_write_recv_comp(struct mrail_ep *mrail_ep, struct mrail_hdr *hdr,
 			     struct fi_cq_tagged_entry *comp,
 			     struct mrail_recv *recv)
@@ -87,6 +107,14 @@ static int mrail_cq_write_rndv_recv_comp(struct mrail_ep *mrail_ep,
 {
 	FI_DBG(&mrail_prov, FI_LOG_CQ, "finish rndv recv: length: %zu "
 	       "tag: 0x%" PRIx64 "\n", recv->rndv.len, recv->rndv.tag);
+	if (recv->rndv.olen) {
+		mrail_cntr_incerr(mrail_ep->util_ep.rx_cntr);
+		return ofi_cq_write_error_trunc(mrail_ep->util_ep.rx_cq,
+				recv->context,
+				recv->comp_flags | recv->rndv.flags,
+				recv->rndv.len, NULL, recv->rndv.data,
+				recv->rndv.tag, recv->rndv.olen);
+	}
 	ofi_ep_rx_cntr_inc(&mrail_ep->util_ep);
 	if (!(recv->flags & FI_COMPLETION))
 		return 0;
@@ -96,33 +124,58 @@ static int mrail_cq_write_rndv_recv_comp(struct mrail_ep *mrail_ep,
 			   recv->rndv.tag);
 }
 
-static void mrail_finish_rndv_recv(struct util_cq *cq,
-				   struct mrail_req *req,
-				   struct fi_cq_tagged_entry *comp)
+/*
+ * The sender only completes its send when the ACK arrives, so a receive
+ * whose ACK cannot be sent fails rather than leaving the peer waiting
+ * unnoticed.
+ */
+void mrail_complete_rndv_recv(struct mrail_recv *recv, int err)
 {
-	struct mrail_cq *mrail_cq = container_of(cq, struct mrail_cq, util_cq);
-	struct mrail_recv *recv = req->comp.op_context;
+	struct mrail_ep *mrail_ep = recv->ep;
+	struct fi_cq_err_entry err_entry = {
+		.op_context	= recv->context,
+		.flags		= recv->comp_flags | recv->rndv.flags,
+		.len		= recv->rndv.len,
+		.data		= recv->rndv.data,
+		.tag		= recv->rndv.tag,
+		.err		= -err,
+		.prov_errno	= err,
+	};
 	int ret;
 
-	ret = mrail_cq_write_rndv_recv_comp(req->mrail_ep, recv);
-	if (ret) {
+	if (err) {
 		FI_WARN(&mrail_prov, FI_LOG_CQ,
-			"Cannot write to recv cq\n");
-		assert(0);
+			"Cannot send rndv ack: %s\n", fi_strerror(-err));
+		ret = ofi_cq_write_error(mrail_ep->util_ep.rx_cq, &err_entry);
+		mrail_cntr_incerr(mrail_ep->util_ep.rx_cntr);
+	} else {
+		ret = mrail_cq_write_rndv_recv_comp(mrail_ep, recv);
 	}
-
-	ret = mrail_send_rndv_ack_blocking(req->mrail_ep, mrail_cq, recv->addr,
-					   (void *)recv->rndv.context);
 	if (ret) {
 		FI_WARN(&mrail_prov, FI_LOG_CQ,
-			"Cannot send rndv ack: %s\n", fi_strerror(-ret));
+			"Cannot write to recv cq\n");
 		assert(0);
 	}
 
-	mrail_free_req(req->mrail_ep, req);
 	mrail_push_recv(recv);
 }
 
+static void mrail_finish_rndv_recv(struct util_cq *cq,
+				   struct mrail_req *req,
+				   struct fi_cq_tagged_entry *comp)
+{
+	struct mrail_recv *recv = req->comp.op_context;
+	struct mrail_ep *mrail_ep = req->mrail_ep;
+	int ret;
+
+	mrail_free_req(mrail_ep, req);
+
+	/* A deferred ACK completes the receive from the ep progress */
+	ret = mrail_send_rndv_ack(mrail_ep, recv);
+	if (ret != -FI_EAGAIN)
+		mrail_complete_rndv_recv(recv, ret);
+}
+
 static int mrail_cq_process_rndv_req(struct fi_cq_tagged_entry *comp,
 				     struct mrail_recv *recv)
 {
@@ -138,6 +191,8 @@ static int mrail_cq_process_rndv_req(struct fi_cq_tagged_entry *comp,
 	uint64_t *base_addrs;
 	size_t key_size;
 	size_t offset;
+	size_t iov_count, rma_iov_count;
+	size_t len;
 	int ret, retv = 0;
 	int i;
 
@@ -147,10 +202,31 @@ static int mrail_cq_process_rndv_req(struct fi_cq_tagged_entry *comp,
 	rndv_req = (struct mrail_rndv_req *)&rndv_hdr[1];
 	recv->rndv.context = (void *)rndv_hdr->context;
 	recv->rndv.flags = comp->flags & FI_REMOTE_CQ_DATA;
-	recv->rndv.len = rndv_req->len;
 	recv->rndv.tag = mrail_pkt->hdr.tag;
 	recv->rndv.data = comp->data;
 
+	/* Read no more than both the message and the receive buffer hold */
+	iov_count = recv->count - 1;
+	rma_iov_count = rndv_req->count;
+	len = ofi_total_iov_len(&recv->iov[1], iov_count);
+	if (len >= rndv_req->len) {
+		ofi_truncate_iov(&recv->iov[1], &iov_count, rndv_req->len);
+		len = rndv_req->len;
+	} else {
+		FI_WARN(&mrail_prov, FI_LOG_CQ, "Message truncated recv buf "
+			"size: %zu message length: %zu\n", len, rndv_req->len);
+		for (i = 0, offset = 0; i < rma_iov_count; i++) {
+			if (offset + rndv_req->rma_iov[i].len >= len) {
+				rndv_req->rma_iov[i].len = len - offset;
+				break;
+			}
+			offset += rndv_req->rma_iov[i].len;
+		}
+		rma_iov_count = i + 1;
+	}
+	recv->rndv.len = len;
+	recv->rndv.olen = rndv_req->len - len;
+
 	base_addrs = (uint64_t *)(rndv_req->rawkey + rndv_req->rawkey_size);
 	for (offset = 0, i = 0; i < rndv_req->count; i++) {
 		if (i < rndv_req->mr_count) {
@@ -170,10 +246,10 @@ static int mrail_cq_process_rndv_req(struct fi_cq_tagged_entry *comp,
 
 	rma_msg.msg_iov		= recv->iov + 1;
 	rma_msg.desc		= recv->desc + 1;
-	rma_msg.iov_count	= recv->count - 1;
+	rma_msg.iov_count	= iov_count;
 	rma_msg.addr		= recv->addr;
 	rma_msg.rma_iov		= rndv_req->rma_iov;
-	rma_msg.rma_iov_count	= rndv_req->count;
+	rma_msg.rma_iov_count	= rma_iov_count;
 	rma_msg.context		= recv;
 
 	ret = fi_readmsg(&mrail_ep->util_ep.ep_fid, &rma_msg,
@@ -205,7 +281,7 @@ static int mrail_cq_process_rndv_ack(struct fi_cq_tagged_entry *comp)
 	mrail_pkt = (struct mrail_pkt *)comp->buf;
 	rndv_hdr = (struct mrail_rndv_hdr *)&mrail_pkt[1];
 	tx_buf = (struct mrail_tx_buf *)rndv_hdr->context;
-	ret = mrail_cq_write_send_comp(tx_buf->ep->util_ep.tx_cq, tx_buf);
+	ret = mrail_cq_release_rndv_req(tx_buf);
 	if (ret)
 		retv = ret;
 
@@ -311,6 +387,10 @@ static struct mrail_recv *mrail_match_recv(struct mrail_ep *mrail_ep,
 						     sizeof(*comp), NULL);
 	}
 
+	/* The rendezvous read goes to the sender, whatever the receive
+	 * was posted for */
+	if (recv)
+		recv->addr = src_addr;
 	return recv;
 }
 
@@ -509,7 +589,7 @@ static struct fi_ops_cq mrail_cq_ops = {
 };
 
 static void mrail_handle_rma_completion(struct util_cq *cq,
-		struct fi_cq_tagged_entry *comp)
+		struct fi_cq_tagged_entry *comp, size_t rail)
 {
 	int ret;
 	struct mrail_req *req;
@@ -517,6 +597,7 @@ static void mrail_handle_rma_completion(struct util_cq *cq,
 
 	subreq = comp->op_context;
 	req = subreq->parent;
+	mrail_rail_complete(req->mrail_ep, rail, subreq->len);
 
 	if (ofi_atomic_dec32(&req->expected_subcomps) == 0) {
 		if (req->comp.flags & MRAIL_RNDV_FLAG) {
@@ -575,12 +656,15 @@ void mrail_poll_cq(struct util_cq *cq)
 			if (ret)
 				goto err;
 		} else if (comp.flags & (FI_READ | FI_WRITE)) {
-			mrail_handle_rma_completion(cq, &comp);
+			mrail_handle_rma_completion(cq, &comp, idx);
 		} else if (comp.flags & FI_SEND) {
 			tx_buf = comp.op_context;
+			mrail_rail_complete(tx_buf->ep, idx, tx_buf->len);
 			if (tx_buf->hdr.protocol == MRAIL_PROTO_RNDV) {
 				if (tx_buf->hdr.protocol_cmd == MRAIL_RNDV_REQ) {
-					/* buf will be freed when ACK comes */
+					ret = mrail_cq_release_rndv_req(tx_buf);
+					if (ret)
+						goto err;
 				} else if (tx_buf->hdr.protocol_cmd == MRAIL_RNDV_ACK) {
 					ofi_ep_lock_acquire(&tx_buf->ep->util_ep);
 					ofi_buf_free(tx_buf);
@@ -205,6 +205,7 @@ static int mrail_mr_reg(struct fid *domain_fid, const void *buf, size_t len,
 	mrail_mr->mr_fid.mem_desc = mrail_mr;
 	mrail_mr->mr_fid.key = FI_KEY_NOTAVAIL;
 	mrail_mr->num_mrs = mrail_domain->num_domains;
+	mrail_mr->addr = (uint64_t)buf;
 	*mr = &mrail_mr->mr_fid;
 
 	return 0;
@@ -256,6 +257,7 @@ static int mrail_mr_regv(struct fid *domain_fid, const struct iovec *iov,
 	mrail_mr->mr_fid.mem_desc = mrail_mr;
 	mrail_mr->mr_fid.key = FI_KEY_NOTAVAIL;
 	mrail_mr->num_mrs = mrail_domain->num_domains;
+	mrail_mr->addr = (uint64_t)iov[0].iov_base;
 	*mr = &mrail_mr->mr_fid;
 
 	return 0;
@@ -304,6 +306,7 @@ static int mrail_mr_regattr(struct fid *domain_fid, const struct fi_mr_attr *att
 	mrail_mr->mr_fid.mem_desc = mrail_mr;
 	mrail_mr->mr_fid.key = FI_KEY_NOTAVAIL;
 	mrail_mr->num_mrs = mrail_domain->num_domains;
+	mrail_mr->addr = (uint64_t)attr->mr_iov[0].iov_base;
 	*mr = &mrail_mr->mr_fid;
 
 	return 0;
@@ -253,6 +253,7 @@ mrail_recv_common(struct mrail_ep *mrail_ep, struct mrail_recv_queue *recv_queue
 	       "0x%" PRIx64 " found in unexpected msg queue\n",
 	       recv->addr, recv->tag, recv->ignore);
 
+	recv->addr = unexp_msg_entry->addr;
 	return mrail_cq_process_buf_recv((struct fi_cq_tagged_entry *)
 					 unexp_msg_entry->data, recv);
 }
@@ -339,64 +340,160 @@ static struct mrail_tx_buf *mrail_get_tx_buf(struct mrail_ep *mrail_ep,
 }
 
 /*
- * This is an internal send that doesn't use seq_no and doesn't update
- * the counters. The call doesn't return -FI_EAGAIN.
+ * Control messages don't use seq_no, so they can go out on any rail. Start
+ * with the rail picked by the policy and fall back to the others if it is
+ * out of resources.
  */
-int mrail_send_rndv_ack_blocking(struct mrail_ep *mrail_ep,
-				 struct mrail_cq *mrail_cq,
-				 fi_addr_t dest_addr, void *context)
+static ssize_t mrail_post_ctrl(struct mrail_ep *mrail_ep,
+			       struct mrail_tx_buf *tx_buf)
 {
 	struct iovec iov_dest;
-	struct mrail_tx_buf *tx_buf;
-	size_t rndv_pkt_size = sizeof(tx_buf->hdr) + sizeof(tx_buf->rndv_hdr);
-	int policy = mrail_get_policy(rndv_pkt_size);
-	uint32_t i = mrail_get_tx_rail(mrail_ep, policy);
 	struct fi_msg msg;
-	ssize_t ret;
-	uint64_t flags = FI_COMPLETION;
-
-	ofi_ep_lock_acquire(&mrail_ep->util_ep);
-
-	tx_buf = mrail_get_tx_buf(mrail_ep, context, 0, ofi_op_tagged, 0);
-	if (OFI_UNLIKELY(!tx_buf))
-		return -FI_ENOMEM;
-
-	tx_buf->hdr.protocol = MRAIL_PROTO_RNDV;
-	tx_buf->hdr.protocol_cmd = MRAIL_RNDV_ACK;
-	tx_buf->rndv_hdr.context = (uint64_t)context;
+	int policy = mrail_get_policy(tx_buf->len);
+	uint32_t rail = mrail_get_tx_rail(mrail_ep, policy, tx_buf->len);
+	uint64_t flags;
+	ssize_t ret = -FI_EAGAIN;
+	size_t i;
 
 	iov_dest.iov_base = &tx_buf->hdr;
-	iov_dest.iov_len = rndv_pkt_size;
+	iov_dest.iov_len = tx_buf->len;
 
 	msg.msg_iov 	= &iov_dest;
 	msg.desc    	= NULL;
 	msg.iov_count	= 1;
-	msg.addr	= dest_addr;
+	msg.addr	= tx_buf->addr;
 	msg.context	= tx_buf;
 
-	if (iov_dest.iov_len < mrail_ep->rails[i].info->tx_attr->inject_size)
-		flags |= FI_INJECT;
+	for (i = 0; i < mrail_ep->num_eps; i++) {
+		flags = FI_COMPLETION;
+		if (iov_dest.iov_len <
+		    mrail_ep->rails[rail].info->tx_attr->inject_size)
+			flags |= FI_INJECT;
+
+		FI_DBG(&mrail_prov, FI_LOG_EP_DATA, "Posting ctrl msg "
+		       " dest_addr: 0x%" PRIx64 " on rail: %d\n",
+		       tx_buf->addr, rail);
+
+		mrail_rail_post(mrail_ep, rail, tx_buf->len);
+		ret = fi_sendmsg(mrail_ep->rails[rail].ep, &msg, flags);
+		if (!ret)
+			break;
+
+		mrail_rail_unpost(mrail_ep, rail, tx_buf->len);
+		if (ret != -FI_EAGAIN) {
+			FI_WARN(&mrail_prov, FI_LOG_EP_DATA,
+				"Unable to fi_sendmsg on rail: %" PRIu32 "\n",
+				rail);
+			break;
+		}
+		rail = (rail + 1) % mrail_ep->num_eps;
+	}
+	return ret;
+}
 
-	FI_DBG(&mrail_prov, FI_LOG_EP_DATA, "Posting rdnv ack "
-	       " dest_addr: 0x%" PRIx64 " on rail: %d\n", dest_addr, i);
+/*
+ * Post the rndv ACKs that were deferred for lack of resources, in the order
+ * they were queued, and complete their receives. Called from the ep
+ * progress. The ep lock is dropped before completing each receive, since
+ * that takes the CQ lock and the ep lock again.
+ */
+void mrail_progress_deferred_ctrl(struct mrail_ep *mrail_ep)
+{
+	struct mrail_tx_buf *tx_buf;
+	struct mrail_recv *recv;
+	ssize_t ret;
 
-	do {
-		ret = fi_sendmsg(mrail_ep->rails[i].ep, &msg, flags);
-		if (ret == -FI_EAGAIN) {
-			FI_DBG(&mrail_prov, FI_LOG_EP_DATA,
-			        "Resource busy when trying to fi_sendmsg on rail: %"
-				PRIu32 ", retrying.\n", i);
-			fi_cq_read(mrail_cq->cqs[i], NULL, 0);
+	for (;;) {
+		ofi_ep_lock_acquire(&mrail_ep->util_ep);
+		if (slist_empty(&mrail_ep->deferred_ctrl)) {
+			ofi_ep_lock_release(&mrail_ep->util_ep);
+			break;
 		}
-	} while (ret == -FI_EAGAIN);
 
-	if (ret) {
-		FI_WARN(&mrail_prov, FI_LOG_EP_DATA,
-			"Unable to fi_sendmsg on rail: %" PRIu32 "\n", i);
-		ofi_buf_free(tx_buf);
+		tx_buf = container_of(mrail_ep->deferred_ctrl.head,
+				      struct mrail_tx_buf, entry);
+		/* the buffer belongs to the rail once posted */
+		recv = tx_buf->context;
+		ret = mrail_post_ctrl(mrail_ep, tx_buf);
+		if (ret != -FI_EAGAIN) {
+			slist_remove_head(&mrail_ep->deferred_ctrl);
+			if (ret)
+				ofi_buf_free(tx_buf);
+		}
+		ofi_ep_lock_release(&mrail_ep->util_ep);
+
+		if (ret == -FI_EAGAIN)
+			break;
+		mrail_complete_rndv_recv(recv, (int) ret);
+	}
+}
+
+/*
+ * This is an internal send that doesn't use seq_no and doesn't update
+ * the counters. The tx_buf context is the receive being acknowledged, which
+ * the caller completes once the ACK is posted or has failed. If no rail can
+ * take the ACK right away, it is queued and -FI_EAGAIN returned: the ep
+ * progress sends it and completes the receive, so the completion path
+ * never waits on a busy rail.
+ */
+int mrail_send_rndv_ack(struct mrail_ep *mrail_ep, struct mrail_recv *recv)
+{
+	struct mrail_tx_buf *tx_buf;
+	ssize_t ret = 0;
+
+	ofi_ep_lock_acquire(&mrail_ep->util_ep);
+
+	tx_buf = mrail_get_tx_buf(mrail_ep, recv, 0, ofi_op_tagged, 0);
+	if (OFI_UNLIKELY(!tx_buf)) {
+		ret = -FI_ENOMEM;
+		goto out;
 	}
 
+	tx_buf->hdr.protocol = MRAIL_PROTO_RNDV;
+	tx_buf->hdr.protocol_cmd = MRAIL_RNDV_ACK;
+	tx_buf->rndv_hdr.context = (uint64_t)recv->rndv.context;
+	tx_buf->addr = recv->addr;
+	tx_buf->len = sizeof(tx_buf->hdr) + sizeof(tx_buf->rndv_hdr);
+
+	/* Don't overtake ACKs that are already waiting */
+	if (slist_empty(&mrail_ep->deferred_ctrl))
+		ret = mrail_post_ctrl(mrail_ep, tx_buf);
+	else
+		ret = -FI_EAGAIN;
+
+	if (ret == -FI_EAGAIN) {
+		FI_DBG(&mrail_prov, FI_LOG_EP_DATA,
+		       "Rails busy, deferring rndv ack\n");
+		slist_insert_tail(&tx_buf->entry, &mrail_ep->deferred_ctrl);
+	} else if (ret) {
+		ofi_buf_free(tx_buf);
+	}
+out:
 	ofi_ep_lock_release(&mrail_ep->util_ep);
+	return (int) ret;
+}
+
+/*
+ * Rails that do not use FI_MR_PROV_KEY need a distinct key for each
+ * registration, take them from the provider specific key space.
+ */
+static int mrail_rndv_mr_regv(struct mrail_ep *mrail_ep,
+			      const struct iovec *iov, size_t count,
+			      struct fid_mr **mr)
+{
+	struct mrail_domain *mrail_domain =
+		container_of(mrail_ep->util_ep.domain, struct mrail_domain,
+			     util_domain);
+	int ret, tries = 0;
+
+	/* If we can't get a key within 1024 tries, give up */
+	do {
+		ret = fi_mr_regv(&mrail_domain->util_domain.domain_fid, iov,
+				 count, FI_REMOTE_READ, 0,
+				 mrail_domain->mr_key++ | FI_PROV_SPECIFIC,
+				 0, mr, NULL);
+	} while (ret == -FI_ENOKEY && tries++ < 1024);
+
 	return ret;
 }
 
@@ -417,10 +514,11 @@ mrail_prepare_rndv_req(struct mrail_ep *mrail_ep, struct mrail_tx_buf *tx_buf,
 	tx_buf->hdr.protocol_cmd = MRAIL_RNDV_REQ;
 	tx_buf->rndv_hdr.context = (uint64_t)tx_buf;
 	tx_buf->rndv_req = NULL;
+	tx_buf->rndv_mr_fid = NULL;
+	tx_buf->rndv_refs = 2;
 
 	if (!desc || !desc[0]) {
-		ret = fi_mr_regv(&mrail_ep->util_ep.domain->domain_fid,
-				 iov, count, FI_REMOTE_READ, 0, 0, 0, &mr, 0);
+		ret = mrail_rndv_mr_regv(mrail_ep, iov, count, &mr);
 		if (ret)
 			return ret;
 		total_key_size = 0;
@@ -463,7 +561,12 @@ mrail_prepare_rndv_req(struct mrail_ep *mrail_ep, struct mrail_tx_buf *tx_buf,
 			assert(!ret);
 			offset += key_size;
 		}
+		/* The peer reads with the same addressing mode the rails use:
+		 * virtual addresses, or offsets from the start of the region */
 		tx_buf->rndv_req->rma_iov[i].addr = (uint64_t)iov[i].iov_base;
+		if (!(mrail_ep->util_ep.domain->mr_map.mode & FI_MR_VIRT_ADDR))
+			tx_buf->rndv_req->rma_iov[i].addr -=
+				container_of(mr, struct mrail_mr, mr_fid)->addr;
 		tx_buf->rndv_req->rma_iov[i].len = iov[i].iov_len;
 		tx_buf->rndv_req->rma_iov[i].key = key_size; /* otherwise unused */
 	}
@@ -488,7 +591,7 @@ mrail_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 	struct iovec *iov_dest = alloca(sizeof(*iov_dest) * (count + 1));
 	struct mrail_tx_buf *tx_buf;
 	int policy = mrail_get_policy(len);
-	uint32_t rail = mrail_get_tx_rail(mrail_ep, policy);
+	uint32_t rail = mrail_get_tx_rail(mrail_ep, policy, len);
 	struct fi_msg msg;
 	ssize_t ret;
 	size_t total_len;
@@ -498,14 +601,17 @@ mrail_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 	ofi_ep_lock_acquire(&mrail_ep->util_ep);
 
 	tx_buf = mrail_get_tx_buf(mrail_ep, context, peer_info->seq_no++,
-				  ofi_op_tagged, flags | op);
+				  op == FI_MSG ? ofi_op_msg : ofi_op_tagged,
+				  flags | op);
 	if (OFI_UNLIKELY(!tx_buf)) {
 		ret = -FI_ENOMEM;
 		goto err1;
 	}
 	tx_buf->hdr.tag = tag;
 
-	if (policy == MRAIL_POLICY_STRIPING) {
+	if (policy == MRAIL_POLICY_STRIPING ||
+	    (policy == MRAIL_POLICY_ADAPTIVE &&
+	     len > MRAIL_ADAPTIVE_STRIPE_SIZE)) {
 		ret = mrail_prepare_rndv_req(mrail_ep, tx_buf, iov, desc,
 					     count, len, iov_dest);
 		if (ret)
@@ -531,6 +637,7 @@ mrail_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 		total_len = len + iov_dest[0].iov_len;
 	}
 
+	tx_buf->len = total_len;
 	if (total_len < mrail_ep->rails[rail].info->tx_attr->inject_size)
 		flags |= FI_INJECT;
 
@@ -538,10 +645,12 @@ mrail_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 	       " dest_addr: 0x%" PRIx64 " tag: 0x%" PRIx64 " seq: %d"
 	       " on rail: %d\n", len, dest_addr, tag, peer_info->seq_no - 1, rail);
 
+	mrail_rail_post(mrail_ep, rail, total_len);
 	ret = fi_sendmsg(mrail_ep->rails[rail].ep, &msg, flags | FI_COMPLETION);
 	if (ret) {
 		FI_WARN(&mrail_prov, FI_LOG_EP_DATA,
 			"Unable to fi_sendmsg on rail: %" PRIu32 "\n", rail);
+		mrail_rail_unpost(mrail_ep, rail, total_len);
 		goto err2;
 	} else if (!(flags & FI_COMPLETION)) {
 		ofi_ep_tx_cntr_inc(&mrail_ep->util_ep);
@@ -551,7 +660,8 @@ mrail_send_common(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 err2:
 	if (tx_buf->hdr.protocol == MRAIL_PROTO_RNDV) {
 		free(tx_buf->rndv_req);
-		fi_close(tx_buf->rndv_mr_fid);
+		if (tx_buf->rndv_mr_fid)
+			fi_close(tx_buf->rndv_mr_fid);
 	}
 	ofi_buf_free(tx_buf);
 err1:
@@ -715,6 +825,14 @@ static void mrail_tx_buf_init(struct ofi_bufpool_region *region, void *buf)
 
 static void mrail_ep_free_bufs(struct mrail_ep *mrail_ep)
 {
+	struct mrail_tx_buf *tx_buf;
+
+	while (!slist_empty(&mrail_ep->deferred_ctrl)) {
+		slist_remove_head_container(&mrail_ep->deferred_ctrl,
+				struct mrail_tx_buf, tx_buf, entry);
+		ofi_buf_free(tx_buf);
+	}
+
 	if (mrail_ep->req_pool)
 		ofi_bufpool_destroy(mrail_ep->req_pool);
 
@@ -736,6 +854,9 @@ static int mrail_ep_alloc_bufs(struct mrail_ep *mrail_ep)
 		.chunk_cnt	= 64,
 		.init_fn	= mrail_tx_buf_init,
 		.context	= mrail_ep,
+		/* sends without completion may still be on the rails
+		 * when the ep is closed */
+		.flags		= OFI_BUFPOOL_NO_TRACK,
 	};
 	size_t buf_size, rxq_total_size = 0;
 	struct fi_info *fi;
@@ -760,7 +881,8 @@ static int mrail_ep_alloc_bufs(struct mrail_ep *mrail_ep)
 		goto err;
 
 	buf_size = (sizeof(struct mrail_req) +
-		    (mrail_ep->num_eps * sizeof(struct mrail_subreq)));
+		    ((mrail_ep->num_eps + MRAIL_RMA_MAX_CHUNKS) *
+		     sizeof(struct mrail_subreq)));
 
 	ret = ofi_bufpool_create(&mrail_ep->req_pool, buf_size,
 				 sizeof(void *), 0, 64, OFI_BUFPOOL_HUGEPAGES);
@@ -965,6 +1087,19 @@ void mrail_ep_progress(struct util_ep *ep)
 {
 	struct mrail_ep *mrail_ep;
 	mrail_ep = container_of(ep, struct mrail_ep, util_ep);
+
+	/* The rendezvous reads complete on the tx rails and the ACKs arrive
+	 * on the rx rails, so a send or receive waiting on one CQ depends on
+	 * the other. Poll both, as the app may only be reading one of them.
+	 */
+	if (ep->tx_cq != ep->rx_cq) {
+		if (ep->tx_cq)
+			mrail_poll_cq(ep->tx_cq);
+		if (ep->rx_cq)
+			mrail_poll_cq(ep->rx_cq);
+	}
+
+	mrail_progress_deferred_ctrl(mrail_ep);
 	mrail_progress_deferred_reqs(mrail_ep);
 }
 
@@ -1019,6 +1154,7 @@ int mrail_ep_open(struct fid_domain *domain_fid, struct fi_info *info,
 			goto err;
 		}
 		mrail_ep->rails[i].info = fi;
+		ofi_atomic_initialize64(&mrail_ep->rails[i].pending_bytes, 0);
 	}
 
 	ret = mrail_ep_alloc_bufs(mrail_ep);
@@ -1026,6 +1162,7 @@ int mrail_ep_open(struct fid_domain *domain_fid, struct fi_info *info,
 		goto err;
 
 	slist_init(&mrail_ep->deferred_reqs);
+	slist_init(&mrail_ep->deferred_ctrl);
 
 	if (mrail_ep->info->caps & FI_DIRECTED_RECV) {
 		mrail_recv_queue_init(&mrail_prov, &mrail_ep->recv_queue,
@@ -72,9 +72,12 @@ static ssize_t mrail_post_subreq(uint32_t rail,
 	struct mrail_req *req = subreq->parent;
 	struct mrail_ep *mrail_ep = req->mrail_ep;
 
-	uint64_t flags = req->flags;
+	/* MRAIL_RNDV_FLAG is internal to mrail, and may clash with the rail's
+	 * own internal flags */
+	uint64_t flags = req->flags & ~MRAIL_RNDV_FLAG;
 
 	mrail_subreq_to_rail(subreq, rail, rail_iov, rail_descs, rail_rma_iov);
+	mrail_rail_post(mrail_ep, rail, subreq->len);
 
 	msg.msg_iov		= rail_iov;
 	msg.desc		= rail_descs;
@@ -98,6 +101,8 @@ static ssize_t mrail_post_subreq(uint32_t rail,
 		ret = fi_writemsg(mrail_ep->rails[rail].ep, &msg, flags);
 	}
 
+	if (ret)
+		mrail_rail_unpost(mrail_ep, rail, subreq->len);
 	return ret;
 }
 
@@ -106,19 +111,25 @@ static ssize_t mrail_post_req(struct mrail_req *req)
 	size_t i;
 	uint32_t rail;
 	ssize_t ret = 0;
+	struct mrail_subreq *subreq;
 
 	while (req->pending_subreq >= 0) {
-		/* Try all rails before giving up */
-		for (i = 0; i < req->mrail_ep->num_eps; ++i) {
-			rail = mrail_get_tx_rail_rr(req->mrail_ep);
-
-			ret = mrail_post_subreq(rail,
-					&req->subreqs[req->pending_subreq]);
-			if (ret != -FI_EAGAIN) {
-				break;
-			} else {
-				/* One of the rails is busy. Try progressing. */
-				mrail_poll_cq(req->mrail_ep->util_ep.tx_cq);
+		subreq = &req->subreqs[req->pending_subreq];
+		/* Busy rails are not polled from here: this is also called
+		 * from the completion path, for rendezvous reads. The req is
+		 * retried from the ep progress once the rails have drained.
+		 */
+		if (subreq->rail != MRAIL_ANY_RAIL) {
+			/* The subreq was sized for this rail, wait for it */
+			ret = mrail_post_subreq(subreq->rail, subreq);
+		} else {
+			/* Try all rails before giving up */
+			for (i = 0; i < req->mrail_ep->num_eps; ++i) {
+				rail = mrail_get_tx_rail_rr(req->mrail_ep);
+
+				ret = mrail_post_subreq(rail, subreq);
+				if (ret != -FI_EAGAIN)
+					break;
 			}
 		}
 
@@ -180,31 +191,135 @@ void mrail_progress_deferred_reqs(struct mrail_ep *mrail_ep)
 	}
 }
 
+/*
+ * Size each rail's stripe so that all rails are expected to drain their
+ * pending bytes plus their stripe at the same time, based on the observed
+ * rail rates.  Rails whose stripe would be too small to be worth a separate
+ * transfer are dropped, one at a time, and the remaining stripes resized.
+ * Fills in the rail and length of each stripe and returns the stripe count.
+ */
+static size_t mrail_get_stripes(struct mrail_ep *mrail_ep, size_t total_len,
+				uint32_t *stripe_rails, size_t *stripe_lens)
+{
+	double rate[MRAIL_MAX_INFO], pending[MRAIL_MAX_INFO];
+	double default_rate, sum_rate, sum_pending, eta, len, min_len;
+	size_t i, count, assigned, min_idx, max_idx;
+
+	if (total_len <= MRAIL_ADAPTIVE_STRIPE_SIZE) {
+		stripe_rails[0] = mrail_get_tx_rail_adaptive(mrail_ep, total_len);
+		stripe_lens[0] = total_len;
+		return 1;
+	}
+
+	default_rate = mrail_get_default_rate(mrail_ep);
+	for (i = 0; i < mrail_ep->num_eps; i++) {
+		stripe_rails[i] = i;
+		rate[i] = mrail_get_rail_rate(mrail_ep, i, default_rate);
+		pending[i] = ofi_atomic_get64(&mrail_ep->rails[i].pending_bytes);
+	}
+	count = mrail_ep->num_eps;
+
+	for (;;) {
+		sum_rate = sum_pending = 0;
+		for (i = 0; i < count; i++) {
+			sum_rate += rate[stripe_rails[i]];
+			sum_pending += pending[stripe_rails[i]];
+		}
+		eta = (total_len + sum_pending) / sum_rate;
+
+		min_idx = 0;
+		min_len = eta * rate[stripe_rails[0]] - pending[stripe_rails[0]];
+		for (i = 1; i < count; i++) {
+			len = eta * rate[stripe_rails[i]] - pending[stripe_rails[i]];
+			if (len < min_len) {
+				min_len = len;
+				min_idx = i;
+			}
+		}
+
+		if (count == 1 || min_len >= MRAIL_ADAPTIVE_STRIPE_SIZE)
+			break;
+		stripe_rails[min_idx] = stripe_rails[--count];
+	}
+
+	assigned = 0;
+	max_idx = 0;
+	for (i = 0; i < count; i++) {
+		len = eta * rate[stripe_rails[i]] - pending[stripe_rails[i]];
+		stripe_lens[i] = MIN((size_t) len, total_len);
+		assigned += stripe_lens[i];
+		if (stripe_lens[i] > stripe_lens[max_idx])
+			max_idx = i;
+	}
+
+	/* Settle the rounding error on the largest stripe */
+	if (assigned > total_len)
+		stripe_lens[max_idx] -= assigned - total_len;
+	else
+		stripe_lens[max_idx] += total_len - assigned;
+	return count;
+}
+
 static ssize_t mrail_prepare_rma_subreqs(struct mrail_ep *mrail_ep,
 		const struct fi_msg_rma *msg, struct mrail_req *req)
 {
-	ssize_t ret;
+	ssize_t ret = 0;
 	struct mrail_subreq *subreq;
 	size_t subreq_count;
+	size_t share_count;
 	size_t total_len;
-	size_t chunk_len;
-	size_t subreq_len;
+	size_t remaining;
+	size_t chunk_size;
+	size_t max_idx;
 	size_t iov_index;
 	size_t iov_offset;
 	size_t rma_iov_index;
 	size_t rma_iov_offset;
-	int i;
+	size_t share_lens[MRAIL_MAX_INFO];
+	uint32_t share_rails[MRAIL_MAX_INFO];
+	size_t chunk_lens[MRAIL_MAX_INFO + MRAIL_RMA_MAX_CHUNKS];
+	uint32_t chunk_rails[MRAIL_MAX_INFO + MRAIL_RMA_MAX_CHUNKS];
+	size_t i;
+
+	total_len = ofi_total_iov_len(msg->msg_iov, msg->iov_count);
 
-	/* For now, stripe across all rails.
-	 * This could be determined by a dynamic scheduler instead.
+	/* Share the transfer across all rails, evenly unless the adaptive
+	 * policy sizes the shares from the rails' load.
 	 */
-	subreq_count = mrail_ep->num_eps;
+	if (mrail_get_policy(total_len) == MRAIL_POLICY_ADAPTIVE) {
+		share_count = mrail_get_stripes(mrail_ep, total_len,
+						share_rails, share_lens);
+	} else {
+		share_count = mrail_ep->num_eps;
+		for (i = 0; i < share_count; i++) {
+			share_rails[i] = MRAIL_ANY_RAIL;
+			share_lens[i] = total_len / share_count;
+		}
+		/* The first share is the longest */
+		share_lens[0] += total_len % share_count;
+	}
 
-	total_len = ofi_total_iov_len(msg->msg_iov, msg->iov_count); 
-	chunk_len = total_len / subreq_count;
+	/* Cut the shares into chunks, each taken from the share with the most
+	 * bytes left, so that consecutive chunks alternate between the rails
+	 * and every rail gets going as early as possible.
+	 */
+	chunk_size = MAX(MRAIL_RMA_CHUNK_SIZE,
+			 ofi_div_ceil(total_len, MRAIL_RMA_MAX_CHUNKS));
+	remaining = total_len;
+	subreq_count = 0;
+	do {
+		max_idx = 0;
+		for (i = 1; i < share_count; i++) {
+			if (share_lens[i] > share_lens[max_idx])
+				max_idx = i;
+		}
+		chunk_lens[subreq_count] = MIN(share_lens[max_idx], chunk_size);
+		chunk_rails[subreq_count] = share_rails[max_idx];
+		share_lens[max_idx] -= chunk_lens[subreq_count];
+		remaining -= chunk_lens[subreq_count];
+		subreq_count++;
+	} while (remaining);
 
-	/* The first chunk is the longest */
-	subreq_len =  chunk_len + (total_len % subreq_count);
 	iov_index = 0;
 	iov_offset = 0;
 	rma_iov_index = 0;
@@ -218,16 +333,18 @@ static ssize_t mrail_prepare_rma_subreqs(struct mrail_ep *mrail_ep,
 	 * track of which subreq to post next, starting at the end of the
 	 * array.
 	 */
-	for (i = (subreq_count - 1); i >= 0; --i) {
-		subreq = &req->subreqs[i];
+	for (i = 0; i < subreq_count; i++) {
+		subreq = &req->subreqs[subreq_count - 1 - i];
 
 		subreq->parent = req;
+		subreq->rail = chunk_rails[i];
+		subreq->len = chunk_lens[i];
 
 		ret = ofi_copy_iov_desc(subreq->iov, subreq->descs,
 				&subreq->iov_count,
 				(struct iovec *)msg->msg_iov, msg->desc,
 				msg->iov_count, &iov_index, &iov_offset,
-				subreq_len);
+				subreq->len);
 		if (ret) {
 			goto out;
 		}
@@ -235,13 +352,10 @@ static ssize_t mrail_prepare_rma_subreqs(struct mrail_ep *mrail_ep,
 		ret = ofi_copy_rma_iov(subreq->rma_iov, &subreq->rma_iov_count,
 				(struct fi_rma_iov *)msg->rma_iov,
 				msg->rma_iov_count, &rma_iov_index,
-				&rma_iov_offset, subreq_len);
+				&rma_iov_offset, subreq->len);
 		if (ret) {
 			goto out;
 		}
-
-		/* All the other chunks have the same length */
-		subreq_len = chunk_len;
 	}
 
 	ofi_atomic_initialize32(&req->expected_subcomps, subreq_count);
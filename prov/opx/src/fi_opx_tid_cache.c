@@ -172,8 +172,8 @@ int opx_setup_tid_cache(struct ofi_mr_cache **cache, struct fi_opx_tid_domain *d
 
 	FI_DBG(&fi_opx_provider, FI_LOG_MR, "OPX TID cache enabled, max_cnt: %zu max_size: %zu\n",
 		 cache_params.max_cnt, cache_params.max_size);
-	FI_DBG(&fi_opx_provider, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %zu, delete_cnt    %zu, hit_cnt       %zu, notify_cnt    %zu\n",
-		(*cache)->cached_cnt      ,(*cache)->cached_size     ,(*cache)->uncached_cnt    ,(*cache)->uncached_size   ,(*cache)->search_cnt      ,(*cache)->delete_cnt      ,(*cache)->hit_cnt         ,(*cache)->notify_cnt      );
+	FI_DBG(&fi_opx_provider, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %" PRIu64 ", delete_cnt    %" PRIu64 ", hit_cnt       %" PRIu64 ", notify_cnt    %" PRIu64 "\n",
+		(*cache)->cached_cnt      ,(*cache)->cached_size     ,(*cache)->uncached_cnt    ,(*cache)->uncached_size   ,ofi_metric_get(&(*cache)->search_cnt)      ,ofi_metric_get(&(*cache)->delete_cnt)      ,ofi_metric_get(&(*cache)->hit_cnt)         ,ofi_metric_get(&(*cache)->notify_cnt)      );
 
 	return 0;
 }
@@ -202,8 +202,8 @@ int opx_tid_cache_add_region(struct ofi_mr_cache *cache,
 			"Unable to insert MR entry (%#lX) into util map (%d)\n", key, err);
 	}
 */
-	FI_DBG(cache->domain->prov, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %zu, delete_cnt    %zu, hit_cnt       %zu, notify_cnt    %zu\n",
-		(cache)->cached_cnt      ,(cache)->cached_size     ,(cache)->uncached_cnt    ,(cache)->uncached_size   ,(cache)->search_cnt      ,(cache)->delete_cnt      ,(cache)->hit_cnt         ,(cache)->notify_cnt      );
+	FI_DBG(cache->domain->prov, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %" PRIu64 ", delete_cnt    %" PRIu64 ", hit_cnt       %" PRIu64 ", notify_cnt    %" PRIu64 "\n",
+		(cache)->cached_cnt      ,(cache)->cached_size     ,(cache)->uncached_cnt    ,(cache)->uncached_size   ,ofi_metric_get(&(cache)->search_cnt)      ,ofi_metric_get(&(cache)->delete_cnt)      ,ofi_metric_get(&(cache)->hit_cnt)         ,ofi_metric_get(&(cache)->notify_cnt)      );
 	return ret;
 }
 
@@ -243,6 +243,6 @@ void opx_tid_cache_delete_region(struct ofi_mr_cache *cache,
 	}
 */
 	memset(opx_mr, 0x00, sizeof(*opx_mr));
-	FI_DBG(cache->domain->prov, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %zu, delete_cnt    %zu, hit_cnt       %zu, notify_cnt    %zu\n",
-		(cache)->cached_cnt      ,(cache)->cached_size     ,(cache)->uncached_cnt    ,(cache)->uncached_size   ,(cache)->search_cnt      ,(cache)->delete_cnt      ,(cache)->hit_cnt         ,(cache)->notify_cnt      );
+	FI_DBG(cache->domain->prov, FI_LOG_MR, "cached_cnt    %zu, cached_size   %zu, uncached_cnt  %zu, uncached_size %zu, search_cnt    %" PRIu64 ", delete_cnt    %" PRIu64 ", hit_cnt       %" PRIu64 ", notify_cnt    %" PRIu64 "\n",
+		(cache)->cached_cnt      ,(cache)->cached_size     ,(cache)->uncached_cnt    ,(cache)->uncached_size   ,ofi_metric_get(&(cache)->search_cnt)      ,ofi_metric_get(&(cache)->delete_cnt)      ,ofi_metric_get(&(cache)->hit_cnt)         ,ofi_metric_get(&(cache)->notify_cnt)      );
 }
@@ -89,6 +89,7 @@ static psm2_error_t udp_open_dev(psm2_ep_t ep, int unit, int port, psm2_uuid_t c
 static psm2_error_t tcp_open_dev(psm2_ep_t ep, int unit, int port, psm2_uuid_t const job_key);
 static psm2_error_t psm3_update_mtu(psm2_ep_t ep);
 static psm2_error_t psm3_update_subnet(psm2_ep_t ep);
+static psm2_error_t udp_alloc_rx_batch(psm2_ep_t ep);
 
 void psm3_ep_free_sockets(psm2_ep_t ep);
 void psm3_ep_sockets_free_buffers(psm2_ep_t ep);
@@ -104,7 +105,7 @@ psm3_ep_open_udp_internal(psm2_ep_t ep, int unit, int port,
 	psm3_sockaddr_in_t loc_addr;
 	socklen_t addr_len;
 	union psmi_envvar_val env_bdev;
-	union psmi_envvar_val env_gso, env_gro;
+	union psmi_envvar_val env_gso, env_gro, env_batch;
 	union psmi_envvar_val env_zerocopy;
 	union psmi_envvar_val env_prate;
 	union psmi_envvar_val env_rbuf, env_sbuf;
@@ -197,7 +198,7 @@ psm3_ep_open_udp_internal(psm2_ep_t ep, int unit, int port,
 		if (ep->sockets_ep.udp_gro) {
 			int gro;
 			socklen_t optlen = sizeof(gro);
-			if (!getsockopt(ep->sockets_ep.udp_tx_fd, SOL_UDP, UDP_GRO, &gro, &optlen)) {
+			if (!getsockopt(ep->sockets_ep.udp_rx_fd, SOL_UDP, UDP_GRO, &gro, &optlen)) {
 				_HFI_PRDBG("UDP GRO supported and enabled\n");
 			} else {
 				ep->sockets_ep.udp_gro = 0;
@@ -205,6 +206,12 @@ psm3_ep_open_udp_internal(psm2_ep_t ep, int unit, int port,
 			}
 		}
 
+		psm3_getenv("PSM3_UDP_RECV_BATCH",
+				"Max UDP datagrams received per recvmmsg() call (1 disables batching)",
+				PSMI_ENVVAR_LEVEL_USER, PSMI_ENVVAR_TYPE_UINT,
+				(union psmi_envvar_val) UDP_RECV_BATCH, &env_batch);
+		ep->sockets_ep.udp_rx_batch = max(env_batch.e_uint, 1);
+
 		// additional stuff related to udp_gso
 		if (ep->sockets_ep.udp_gso) {
 			int val = IP_PMTUDISC_DO;
@@ -217,7 +224,7 @@ psm3_ep_open_udp_internal(psm2_ep_t ep, int unit, int port,
 		// additional stuff related to gro
 		if (ep->sockets_ep.udp_gro) {
 			int val = 1;
-			if (-1 == setsockopt(ep->sockets_ep.udp_tx_fd, SOL_IP, UDP_GRO, &val, sizeof(val))) {
+			if (-1 == setsockopt(ep->sockets_ep.udp_rx_fd, SOL_UDP, UDP_GRO, &val, sizeof(val))) {
 				_HFI_ERROR("Failed setsockopt GRO for %s: %s\n", ep->dev_name, strerror(errno));
 				goto fail;
 			}
@@ -1008,6 +1015,11 @@ psm3_sockets_ips_proto_init(struct ips_proto *proto, uint32_t cksum_sz)
 		_HFI_ERROR( "Unable to allocate UDP buffers pools\n");
 		goto fail;
 	}
+	if (ep->sockets_ep.sockets_mode == PSM3_SOCKETS_UDP
+		&& PSM2_OK != udp_alloc_rx_batch(ep)) {
+		_HFI_ERROR( "Unable to allocate UDP receive batch\n");
+		goto fail;
+	}
 
 #ifdef PSM_BYTE_FLOW_CREDITS
 	if (ep->sockets_ep.sockets_mode == PSM3_SOCKETS_TCP) {
@@ -1273,6 +1285,27 @@ void psm3_ep_sockets_free_buffers(psm2_ep_t ep)
 		psmi_free(ep->sockets_ep.rbuf);
 		ep->sockets_ep.rbuf = NULL;
 	}
+
+	if (ep->sockets_ep.rbuf_udp_batch) {
+		psmi_free(ep->sockets_ep.rbuf_udp_batch);
+		ep->sockets_ep.rbuf_udp_batch = NULL;
+	}
+	if (ep->sockets_ep.udp_rx_msgs) {
+		psmi_free(ep->sockets_ep.udp_rx_msgs);
+		ep->sockets_ep.udp_rx_msgs = NULL;
+	}
+	if (ep->sockets_ep.udp_rx_iovs) {
+		psmi_free(ep->sockets_ep.udp_rx_iovs);
+		ep->sockets_ep.udp_rx_iovs = NULL;
+	}
+	if (ep->sockets_ep.udp_rx_addrs) {
+		psmi_free(ep->sockets_ep.udp_rx_addrs);
+		ep->sockets_ep.udp_rx_addrs = NULL;
+	}
+	if (ep->sockets_ep.udp_rx_cmsgs) {
+		psmi_free(ep->sockets_ep.udp_rx_cmsgs);
+		ep->sockets_ep.udp_rx_cmsgs = NULL;
+	}
 }
 
 void
@@ -1280,6 +1313,58 @@ psm3_hfp_sockets_context_initstats(psm2_ep_t ep)
 {
 }
 
+// allocate the UDP receive ring used with recvmmsg()
+// with GRO a datagram may hold several PSM packets, so buffers must
+// be large enough for the biggest coalesced datagram
+static psm2_error_t udp_alloc_rx_batch(psm2_ep_t ep)
+{
+	uint32_t batch = ep->sockets_ep.udp_rx_batch;
+	uint32_t size;
+	uint32_t i;
+
+	size = ep->sockets_ep.udp_gro ? UDP_GRO_MAX_SIZE : ep->sockets_ep.buf_size;
+	ep->sockets_ep.udp_rx_buf_size = size;
+	ep->sockets_ep.rbuf_udp_batch = (uint8_t *)psmi_calloc(ep, NETWORK_BUFFERS,
+							batch, size);
+	ep->sockets_ep.udp_rx_msgs = (struct mmsghdr *)psmi_calloc(ep, NETWORK_BUFFERS,
+							batch, sizeof(struct mmsghdr));
+	ep->sockets_ep.udp_rx_iovs = (struct iovec *)psmi_calloc(ep, NETWORK_BUFFERS,
+							batch, sizeof(struct iovec));
+	ep->sockets_ep.udp_rx_addrs = (struct sockaddr_storage *)psmi_calloc(ep,
+							NETWORK_BUFFERS, batch,
+							sizeof(struct sockaddr_storage));
+	if (! ep->sockets_ep.rbuf_udp_batch || ! ep->sockets_ep.udp_rx_msgs
+		|| ! ep->sockets_ep.udp_rx_iovs || ! ep->sockets_ep.udp_rx_addrs)
+		return PSM2_NO_MEMORY;
+	if (ep->sockets_ep.udp_gro) {
+		ep->sockets_ep.udp_rx_cmsgs = (uint8_t *)psmi_calloc(ep, NETWORK_BUFFERS,
+							batch, UDP_GRO_CMSG_SIZE);
+		if (! ep->sockets_ep.udp_rx_cmsgs)
+			return PSM2_NO_MEMORY;
+	}
+
+	for (i = 0; i < batch; i++) {
+		struct msghdr *hdr = &ep->sockets_ep.udp_rx_msgs[i].msg_hdr;
+
+		ep->sockets_ep.udp_rx_iovs[i].iov_base =
+				ep->sockets_ep.rbuf_udp_batch + (size_t)i * size;
+		ep->sockets_ep.udp_rx_iovs[i].iov_len = size;
+		hdr->msg_name = &ep->sockets_ep.udp_rx_addrs[i];
+		hdr->msg_namelen = sizeof(ep->sockets_ep.udp_rx_addrs[i]);
+		hdr->msg_iov = &ep->sockets_ep.udp_rx_iovs[i];
+		hdr->msg_iovlen = 1;
+		if (ep->sockets_ep.udp_gro) {
+			hdr->msg_control = ep->sockets_ep.udp_rx_cmsgs
+						+ (size_t)i * UDP_GRO_CMSG_SIZE;
+			hdr->msg_controllen = UDP_GRO_CMSG_SIZE;
+		}
+	}
+	ep->sockets_ep.udp_rx_cnt = 0;
+	ep->sockets_ep.udp_rx_next = 0;
+	ep->sockets_ep.udp_rx_seg_off = 0;
+	return PSM2_OK;
+}
+
 static psm2_error_t udp_open_dev(psm2_ep_t ep, int unit, int port, psm2_uuid_t const job_key)
 {
 	int err = PSM2_OK;
@@ -95,6 +95,13 @@
 #define UDP_MAX_SEGMENTS (1 << 6UL)
 #endif
 
+// default max datagrams received per recvmmsg() call in UDP mode
+#define UDP_RECV_BATCH 32
+// largest datagram UDP GRO may hand us, several coalesced packets
+#define UDP_GRO_MAX_SIZE UINT16_MAX
+// control buffer size to receive the UDP GRO segment size
+#define UDP_GRO_CMSG_SIZE CMSG_SPACE(sizeof(int))
+
 /* mode for EP as selected by PSM3_SOCKETS */
 #define PSM3_SOCKETS_TCP 0
 #define PSM3_SOCKETS_UDP 1
@@ -188,7 +195,20 @@ struct psm3_sockets_ep {
 	int udp_gso;	// is GSO enabled for UDP
 	uint8_t *sbuf_udp_gso;	// buffer to compose UDP GSO packet sequence
 	int udp_gso_zerocopy;	// is UDP GSO Zero copy option enabled
-	int udp_gro; // will be used later
+	int udp_gro; // is GRO enabled for UDP
+	// UDP receive ring, filled by recvmmsg() and consumed one PSM
+	// packet (GRO segment) at a time by the recvhdrq progress
+	uint32_t udp_rx_batch;	// max datagrams per recvmmsg()
+	uint32_t udp_rx_buf_size;	// size of each buffer in rbuf_udp_batch
+	uint8_t *rbuf_udp_batch;	// udp_rx_batch receive buffers
+	struct mmsghdr *udp_rx_msgs;	// one per receive buffer
+	struct iovec *udp_rx_iovs;	// one per receive buffer
+	struct sockaddr_storage *udp_rx_addrs;	// sender of each datagram
+	uint8_t *udp_rx_cmsgs;	// GRO segment size of each datagram
+	uint32_t udp_rx_cnt;	// datagrams received by last recvmmsg()
+	uint32_t udp_rx_next;	// next datagram to process
+	uint32_t udp_rx_seg_off;	// offset of next packet in the datagram
+	uint32_t udp_rx_seg_len;	// length of packet being processed
 	/* fields used for both UDP and TCP */
 	uint8_t *sbuf;
 	uint8_t *rbuf;
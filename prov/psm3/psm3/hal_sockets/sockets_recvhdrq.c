@@ -1225,15 +1225,78 @@ psm3_sockets_udp_process_packet(struct ips_recvhdrq_event *rcv_ev,
 	return ret;
 }
 
+// receive up to udp_rx_batch datagrams into the UDP receive ring
+// returns number of datagrams received, or -1 with errno set
+static __inline__ int
+psm3_sockets_udp_recv_batch(psm2_ep_t ep)
+{
+	uint32_t i;
+	int ret;
+
+	// recvmmsg() updates the lengths of the entries it filled
+	for (i = 0; i < ep->sockets_ep.udp_rx_cnt; i++) {
+		struct msghdr *hdr = &ep->sockets_ep.udp_rx_msgs[i].msg_hdr;
+
+		hdr->msg_namelen = sizeof(ep->sockets_ep.udp_rx_addrs[i]);
+		if (ep->sockets_ep.udp_gro)
+			hdr->msg_controllen = UDP_GRO_CMSG_SIZE;
+	}
+	ep->sockets_ep.udp_rx_cnt = 0;
+	ep->sockets_ep.udp_rx_next = 0;
+	ep->sockets_ep.udp_rx_seg_off = 0;
+
+	// MSG_DONTWAIT is redundant since we set O_NONBLOCK
+	// MSG_TRUNC reports the real length of truncated datagrams
+	ret = recvmmsg(ep->sockets_ep.udp_rx_fd, ep->sockets_ep.udp_rx_msgs,
+			ep->sockets_ep.udp_rx_batch, MSG_DONTWAIT|MSG_TRUNC, NULL);
+	if (ret > 0)
+		ep->sockets_ep.udp_rx_cnt = ret;
+	return ret;
+}
+
+// size of the PSM packets coalesced in a datagram by UDP GRO, or the
+// datagram length when it holds a single packet
+static __inline__ uint32_t
+psm3_sockets_udp_seg_size(psm2_ep_t ep, struct mmsghdr *msg)
+{
+	struct cmsghdr *cmsg;
+
+	if (ep->sockets_ep.udp_gro) {
+		for (cmsg = CMSG_FIRSTHDR(&msg->msg_hdr); cmsg;
+				cmsg = CMSG_NXTHDR(&msg->msg_hdr, cmsg)) {
+			if (cmsg->cmsg_level == SOL_UDP
+				&& cmsg->cmsg_type == UDP_GRO) {
+				int seg_size;
+
+				memcpy(&seg_size, CMSG_DATA(cmsg), sizeof(seg_size));
+				if (seg_size > 0)
+					return seg_size;
+			}
+		}
+	}
+	return msg->msg_len;
+}
+
+// done with the current packet, move to the next one in the datagram
+// or the next datagram in the batch
+static __inline__ void
+psm3_sockets_udp_rx_advance(psm2_ep_t ep)
+{
+	struct mmsghdr *msg = &ep->sockets_ep.udp_rx_msgs[ep->sockets_ep.udp_rx_next];
+
+	ep->sockets_ep.udp_rx_seg_off += ep->sockets_ep.udp_rx_seg_len;
+	if (ep->sockets_ep.udp_rx_seg_off >= msg->msg_len) {
+		ep->sockets_ep.udp_rx_next++;
+		ep->sockets_ep.udp_rx_seg_off = 0;
+	}
+}
+
 psm2_error_t psm3_sockets_udp_recvhdrq_progress(struct ips_recvhdrq *recvq, bool force)
 {
 	GENERIC_PERF_BEGIN(PSM_RX_SPEEDPATH_CTR); /* perf stats */
 
 	int ret = IPS_RECVHDRQ_CONTINUE;
-	int recvlen = 0;
 	psm2_ep_t ep = recvq->proto->ep;
-	struct sockaddr_storage rem_addr;
-	socklen_t len_addr = sizeof(rem_addr);
 	PSMI_CACHEALIGN struct ips_recvhdrq_event rcv_ev = {
 		.proto = recvq->proto,
 		.recvq = recvq,
@@ -1241,8 +1304,33 @@ psm2_error_t psm3_sockets_udp_recvhdrq_progress(struct ips_recvhdrq *recvq, bool
 	};
 	uint32_t num_done = 0;
 
+	// Datagrams are received in batches with recvmmsg() and each batch
+	// is processed here one PSM packet at a time. Packets left when we
+	// stop early (BREAK or REVISIT) stay in the ring for the next call.
 	while (1) {
 		uint8_t *buf;
+		struct mmsghdr *msg;
+		struct sockaddr_storage *rem_addr;
+		uint32_t seg_size;
+
+		if (ep->sockets_ep.udp_rx_next == ep->sockets_ep.udp_rx_cnt) {
+			// a pending revisit_buf is always in the current batch
+			psmi_assert(! ep->sockets_ep.revisit_buf);
+			if (psm3_sockets_udp_recv_batch(ep) < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					break;
+				} else {
+					// TBD - how to best handle errors
+					_HFI_ERROR("failed recv '%s' (%d) on %s epid %s\n",
+						strerror(errno), errno, ep->dev_name, psm3_epid_fmt_internal(ep->epid, 0));
+					GENERIC_PERF_END(PSM_RX_SPEEDPATH_CTR); /* perf stats */
+					return PSM2_INTERNAL_ERR;
+				}
+			}
+		}
+		msg = &ep->sockets_ep.udp_rx_msgs[ep->sockets_ep.udp_rx_next];
+		rem_addr = &ep->sockets_ep.udp_rx_addrs[ep->sockets_ep.udp_rx_next];
+
 		// TBD really only need to check this on 1st loop
 		if_pf (ep->sockets_ep.revisit_buf) {
 			buf = ep->sockets_ep.revisit_buf;
@@ -1250,57 +1338,51 @@ psm2_error_t psm3_sockets_udp_recvhdrq_progress(struct ips_recvhdrq *recvq, bool
 			rcv_ev.payload_size = ep->sockets_ep.revisit_payload_size;
 			ep->sockets_ep.revisit_payload_size = 0;
 		} else {
-			buf = ep->sockets_ep.rbuf;
-			// TBD - do we need rem_addr?  if not, can use recv
-			// MSG_DONTWAIT is redundant since we set O_NONBLOCK
-			recvlen = recvfrom(ep->sockets_ep.udp_rx_fd, buf, ep->sockets_ep.buf_size,
-								MSG_DONTWAIT|MSG_TRUNC,
-								(struct sockaddr *)&rem_addr, &len_addr);
-			if (recvlen < 0) {
-				if (errno == EAGAIN || errno == EWOULDBLOCK) {
-					break;
-				} else {
+			if (! ep->sockets_ep.udp_rx_seg_off) {
+				socklen_t len_addr = msg->msg_hdr.msg_namelen;
+
+				if_pf (len_addr > sizeof(*rem_addr) ||
+					rem_addr->ss_family != psm3_socket_domain
+					) {
 					// TBD - how to best handle errors
-					_HFI_ERROR("failed recv '%s' (%d) on %s epid %s\n",
-						strerror(errno), errno, ep->dev_name, psm3_epid_fmt_internal(ep->epid, 0));
+					_HFI_ERROR("unexpected rem_addr type (%u) on %s epid %s\n",
+						rem_addr->ss_family, ep->dev_name, psm3_epid_fmt_internal(ep->epid, 0));
 					GENERIC_PERF_END(PSM_RX_SPEEDPATH_CTR); /* perf stats */
 					return PSM2_INTERNAL_ERR;
 				}
-			}
-			// coverity[uninit_use] - rem_addr initialized in recvfrom() call above
-			if_pf (len_addr > sizeof(rem_addr) ||
-				rem_addr.ss_family != psm3_socket_domain
-				) {
-				// TBD - how to best handle errors
-				// coverity[uninit_use_in_call] - rem_addr initialized in recvfrom() call above
-				_HFI_ERROR("unexpected rem_addr type (%u) on %s epid %s\n",
-					rem_addr.ss_family, ep->dev_name, psm3_epid_fmt_internal(ep->epid, 0));
-				GENERIC_PERF_END(PSM_RX_SPEEDPATH_CTR); /* perf stats */
-				return PSM2_INTERNAL_ERR;
-			}
-			if_pf (_HFI_VDBG_ON) {
-				if (len_addr) {
-					_HFI_VDBG("got recv %u bytes from IP %s payload_size=%d opcode=%x\n", recvlen,
-						psm3_sockaddr_fmt((struct sockaddr *)&rem_addr, 0),
-						rcv_ev.payload_size,
-						_get_proto_hfi_opcode((struct ips_message_header *)buf));
-				} else {
-					_HFI_VDBG("got recv %u bytes from IP n/a\n", recvlen);
+				if_pf (_HFI_VDBG_ON) {
+					if (len_addr) {
+						_HFI_VDBG("got recv %u bytes from IP %s opcode=%x\n", msg->msg_len,
+							psm3_sockaddr_fmt((struct sockaddr *)rem_addr, 0),
+							_get_proto_hfi_opcode((struct ips_message_header *)msg->msg_hdr.msg_iov->iov_base));
+					} else {
+						_HFI_VDBG("got recv %u bytes from IP n/a\n", msg->msg_len);
+					}
+				}
+				if_pf (_HFI_PDBG_ON)
+					_HFI_PDBG_DUMP_ALWAYS(msg->msg_hdr.msg_iov->iov_base,
+						min(msg->msg_len, ep->sockets_ep.udp_rx_buf_size));
+				if_pf (msg->msg_len > ep->sockets_ep.udp_rx_buf_size) {
+					_HFI_ERROR( "unexpected large recv: %u on %s\n", msg->msg_len, ep->dev_name);
+					ep->sockets_ep.udp_rx_seg_len = msg->msg_len;
+					goto processed;
 				}
 			}
-			if_pf (_HFI_PDBG_ON)
-				_HFI_PDBG_DUMP_ALWAYS(buf, recvlen);
-			if_pf (recvlen < MSG_HDR_SIZE) {
-				_HFI_ERROR( "unexpected small recv: %u on %s\n", recvlen, ep->dev_name);
+			seg_size = psm3_sockets_udp_seg_size(ep, msg);
+			buf = (uint8_t *)msg->msg_hdr.msg_iov->iov_base + ep->sockets_ep.udp_rx_seg_off;
+			ep->sockets_ep.udp_rx_seg_len = min(seg_size,
+					msg->msg_len - ep->sockets_ep.udp_rx_seg_off);
+			if_pf (ep->sockets_ep.udp_rx_seg_len < MSG_HDR_SIZE) {
+				_HFI_ERROR( "unexpected small recv: %u on %s\n", ep->sockets_ep.udp_rx_seg_len, ep->dev_name);
 				goto processed;
-			} else if_pf (recvlen > ep->sockets_ep.buf_size) {
-				_HFI_ERROR( "unexpected large recv: %u on %s\n", recvlen, ep->dev_name);
+			} else if_pf (ep->sockets_ep.udp_rx_seg_len > ep->sockets_ep.buf_size) {
+				_HFI_ERROR( "unexpected large recv: %u on %s\n", ep->sockets_ep.udp_rx_seg_len, ep->dev_name);
 				goto processed;
 			}
-			rcv_ev.payload_size = recvlen - MSG_HDR_SIZE;
+			rcv_ev.payload_size = ep->sockets_ep.udp_rx_seg_len - MSG_HDR_SIZE;
 		}
 		ret = psm3_sockets_udp_process_packet(&rcv_ev, ep, buf,
-						(psm3_sockaddr_in_t *)&rem_addr,
+						(psm3_sockaddr_in_t *)rem_addr,
 						recvq);
 		if_pf (ret == IPS_RECVHDRQ_REVISIT)
 		{
@@ -1308,6 +1390,7 @@ psm2_error_t psm3_sockets_udp_recvhdrq_progress(struct ips_recvhdrq *recvq, bool
 			return PSM2_OK_NO_PROGRESS;
 		}
 processed:
+		psm3_sockets_udp_rx_advance(ep);
 		num_done++;
 		// if we can't process this now (such as an RTS we revisited and
 		// ended up queueing on unexpected queue) we're told
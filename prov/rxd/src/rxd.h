@@ -55,12 +55,14 @@
 #include <ofi_tree.h>
 #include <ofi_atomic.h>
 #include <ofi_indexer.h>
+#include <ofi_metrics.h>
+#include <ofi_rdgram.h>
 #include "rxd_proto.h"
 
 #ifndef _RXD_H_
 #define _RXD_H_
 
-#define RXD_PROTOCOL_VERSION 	(2)
+#define RXD_PROTOCOL_VERSION 	(4)
 
 #define RXD_MAX_MTU_SIZE	4096
 
@@ -74,8 +76,11 @@
 #define RXD_MAX_PKT_RETRY	50
 #define RXD_ADDR_INVALID	0
 
-#define RXD_PKT_IN_USE		(1 << 0)
-#define RXD_PKT_ACKED		(1 << 1)
+/* Initial congestion window in packets */
+#define RXD_CC_INIT_CWND	10
+
+/* Maximum number of data segments described by one bulk RMA window */
+#define RXD_BULK_SEGS		OFI_RDG_MAX_SEGS
 
 #define RXD_REMOTE_CQ_DATA	(1 << 0)
 #define RXD_NO_TX_COMP		(1 << 1)
@@ -84,6 +89,8 @@
 #define RXD_TAG_HDR		(1 << 4)
 #define RXD_INLINE		(1 << 5)
 #define RXD_MULTI_RECV		(1 << 6)
+#define RXD_ACK_REQ		(1 << 7)
+#define RXD_BULK_DATA		(1 << 8)
 
 #define RXD_IDX_OFFSET(x)	(x + 1)	
 
@@ -92,6 +99,13 @@ struct rxd_env {
 	int retry;
 	int max_peers;
 	int max_unacked;
+	int min_rto;
+	char *cc;
+	int pacing;
+	int bulk_rma;
+#if ENABLE_DEBUG
+	int drop_rate;
+#endif
 };
 
 extern struct rxd_env rxd_env;
@@ -121,18 +135,23 @@ struct rxd_domain {
 	struct ofi_mr_map mr_map;//TODO use util_domain mr_map instead
 };
 
+/* Sequence numbers, acks and retransmissions are kept by the reliable
+ * datagram engine in rdg */
 struct rxd_peer {
+	struct ofi_rdg_peer rdg;
 	struct dlist_entry entry;
+	fi_addr_t rxd_addr;
 	fi_addr_t peer_addr;
-	uint64_t tx_seq_no;
-	uint64_t rx_seq_no;
-	uint64_t last_rx_ack;
-	uint64_t last_tx_ack;
 	uint16_t rx_window;
 	uint16_t tx_window;
-	int retry_cnt;
 
-	uint16_t unacked_cnt;
+	/* Congestion control state, managed by rxd_cc_ops */
+	uint32_t cwnd;
+	uint32_t ssthresh;
+	uint32_t cwnd_cnt;
+	uint64_t recover_seq;
+	uint64_t next_tx;
+
 	uint8_t active;
 
 	uint16_t curr_rx_id;
@@ -142,7 +161,6 @@ struct rxd_peer {
 	struct dlist_entry tx_list;
 	struct dlist_entry rx_list;
 	struct dlist_entry rma_rx_list;
-	struct dlist_entry unacked;
 	struct dlist_entry buf_pkts;
 };
 
@@ -193,6 +211,9 @@ struct rxd_ep {
 	size_t rx_prefix_size;
 	size_t min_multi_recv_size;
 	int do_local_mr;
+	int bulk_tx;
+	uint32_t bulk_segs;
+	size_t dg_iov_limit;
 	int next_retry;
 	int dg_cq_fd;
 	uint32_t tx_flags;
@@ -206,6 +227,12 @@ struct rxd_ep {
 	struct rxd_buf_pool tx_pkt_pool;
 	struct rxd_buf_pool rx_pkt_pool;
 	struct slist rx_pkt_list;
+#if ENABLE_DEBUG
+	uint64_t rx_pkt_cnt;
+#endif
+
+	struct ofi_metric tx_pkts;
+	struct ofi_metric retrans_pkts;
 
 	struct rxd_buf_pool tx_entry_pool;
 	struct rxd_buf_pool rx_entry_pool;
@@ -218,13 +245,15 @@ struct rxd_ep {
 	struct dlist_entry rts_sent_list;
 	struct dlist_entry ctrl_pkts;
 
-	struct index_map peers_idm;
+	/* Peers are indexed by rxd_addr */
+	struct ofi_rdg rdg;
 };
 /* ensure ep lock is held before this function is called */
 static inline struct rxd_peer *rxd_peer(struct rxd_ep *ep, fi_addr_t rxd_addr)
 {
-	return ofi_idm_lookup(&ep->peers_idm, (int) rxd_addr);
+	struct ofi_rdg_peer *peer = ofi_rdg_peer(&ep->rdg, rxd_addr);
 
+	return peer ? container_of(peer, struct rxd_peer, rdg) : NULL;
 }
 static inline struct rxd_domain *rxd_ep_domain(struct rxd_ep *ep)
 {
@@ -300,13 +329,18 @@ static inline uint32_t rxd_rx_flags(uint64_t fi_flags)
 struct rxd_pkt_entry {
 	struct dlist_entry d_entry;
 	struct slist_entry s_entry;//TODO - keep both or make separate tx/rx pkt structs
-	uint8_t flags;
+	struct ofi_rdg_pkt rdg;
 	size_t pkt_size;
-	uint64_t timestamp;
 	struct fi_context context;
 	struct fid_mr *mr;
 	void *desc;
 	fi_addr_t peer;
+
+	/* Bulk RMA window: rdg.seg_cnt data segments of x_entry, starting
+	 * at byte offset, each sent with its own header from the packet
+	 * buffer and its payload from the transfer's iov */
+	struct rxd_x_entry *x_entry;
+	uint64_t offset;
 	void *pkt;
 };
 
@@ -335,7 +369,7 @@ static inline struct rxd_base_hdr *rxd_get_base_hdr(struct rxd_pkt_entry *pkt_en
 static inline uint64_t rxd_set_pkt_seq(struct rxd_peer *peer,
 				       struct rxd_pkt_entry *pkt_entry)
 {
-	rxd_get_base_hdr(pkt_entry)->seq_no = peer->tx_seq_no++;
+	rxd_get_base_hdr(pkt_entry)->seq_no = peer->rdg.tx_seq_no++;
 
 	return rxd_get_base_hdr(pkt_entry)->seq_no;
 }
@@ -368,6 +402,19 @@ static inline void *rxd_pkt_start(struct rxd_pkt_entry *pkt_entry)
 	return (void *) ((char *) pkt_entry + sizeof(*pkt_entry));
 }
 
+static inline size_t rxd_bulk_hdr_size(struct rxd_ep *ep)
+{
+	return ep->tx_prefix_size + sizeof(struct rxd_data_pkt);
+}
+
+static inline struct rxd_data_pkt *rxd_bulk_hdr(struct rxd_ep *ep,
+						struct rxd_pkt_entry *pkt_entry,
+						uint32_t seg)
+{
+	return (struct rxd_data_pkt *) ((char *) pkt_entry->pkt +
+					seg * rxd_bulk_hdr_size(ep));
+}
+
 static inline size_t rxd_pkt_size(struct rxd_ep *ep, struct rxd_base_hdr *base_hdr,
 				   void *ptr)
 {
@@ -435,6 +482,7 @@ struct rxd_pkt_entry *rxd_get_tx_pkt(struct rxd_ep *ep);
 struct rxd_x_entry *rxd_get_tx_entry(struct rxd_ep *ep, uint32_t op);
 struct rxd_x_entry *rxd_get_rx_entry(struct rxd_ep *ep, uint32_t op);
 ssize_t rxd_ep_send_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry);
+ssize_t rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry);
 ssize_t rxd_ep_post_data_pkts(struct rxd_ep *ep, struct rxd_x_entry *tx_entry);
 void rxd_insert_unacked(struct rxd_ep *ep, fi_addr_t peer,
 			struct rxd_pkt_entry *pkt_entry);
@@ -474,8 +522,30 @@ struct rxd_x_entry *rxd_rx_entry_init(struct rxd_ep *ep,
 			uint32_t op, uint32_t flags);
 void rxd_tx_entry_free(struct rxd_ep *ep, struct rxd_x_entry *tx_entry);
 void rxd_rx_entry_free(struct rxd_ep *ep, struct rxd_x_entry *rx_entry);
-int rxd_get_timeout(int retry_cnt);
-uint64_t rxd_get_retry_time(uint64_t start, int retry_cnt);
+
+/* Congestion control */
+struct rxd_cc_ops {
+	const char *name;
+	void (*init)(struct rxd_peer *peer);
+	void (*ack)(struct rxd_peer *peer, uint32_t acked);
+	void (*loss)(struct rxd_peer *peer, int timeout);
+};
+
+extern struct rxd_cc_ops *rxd_cc_ops;
+void rxd_cc_select(const char *name);
+
+static inline uint16_t rxd_peer_tx_limit(struct rxd_peer *peer)
+{
+	return (uint16_t) MIN(peer->tx_window, peer->cwnd);
+}
+
+static inline int rxd_peer_tx_full(struct rxd_peer *peer)
+{
+	if (peer->rdg.unacked_cnt >= rxd_peer_tx_limit(peer))
+		return 1;
+
+	return peer->next_tx && ofi_gettime_us() < peer->next_tx;
+}
 
 /* Generic message functions */
 ssize_t rxd_ep_generic_recvmsg(struct rxd_ep *rxd_ep, const struct iovec *iov,
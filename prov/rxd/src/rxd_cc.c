@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 The libfabric contributors.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "rxd.h"
+
+/*
+ * Congestion control
+ *
+ * Each peer carries a congestion window (cwnd, in packets) that further
+ * limits the number of unacked packets allowed by the peer's receive window.
+ * Algorithms are selected through FI_OFI_RXD_CC and update the window on
+ * acknowledgements and detected losses.
+ */
+
+static void rxd_cc_none_init(struct rxd_peer *peer)
+{
+	peer->cwnd = (uint32_t) rxd_env.max_unacked;
+	peer->ssthresh = (uint32_t) rxd_env.max_unacked;
+	peer->cwnd_cnt = 0;
+	peer->recover_seq = 0;
+}
+
+static void rxd_cc_none_ack(struct rxd_peer *peer, uint32_t acked)
+{
+}
+
+static void rxd_cc_none_loss(struct rxd_peer *peer, int timeout)
+{
+}
+
+/*
+ * Additive increase, multiplicative decrease (TCP Reno style).  The window
+ * grows by one packet per acked packet during slow start and by one packet
+ * per window afterwards.  A loss halves the window, a retransmission
+ * timeout collapses it to a single packet.  Only one reduction is made per
+ * window of data.
+ */
+static void rxd_cc_aimd_init(struct rxd_peer *peer)
+{
+	peer->cwnd = MIN(RXD_CC_INIT_CWND, (uint32_t) rxd_env.max_unacked);
+	peer->ssthresh = (uint32_t) rxd_env.max_unacked;
+	peer->cwnd_cnt = 0;
+	peer->recover_seq = 0;
+}
+
+static void rxd_cc_aimd_ack(struct rxd_peer *peer, uint32_t acked)
+{
+	if (peer->cwnd < peer->ssthresh) {
+		peer->cwnd = MIN(peer->cwnd + acked, peer->ssthresh);
+	} else {
+		peer->cwnd_cnt += acked;
+		if (peer->cwnd_cnt >= peer->cwnd) {
+			peer->cwnd_cnt -= peer->cwnd;
+			peer->cwnd++;
+		}
+	}
+
+	peer->cwnd = MIN(peer->cwnd, (uint32_t) rxd_env.max_unacked);
+}
+
+static void rxd_cc_aimd_loss(struct rxd_peer *peer, int timeout)
+{
+	/* Without an RTT sample the initial timeout is only a guess */
+	if (!peer->rdg.srtt)
+		return;
+
+	if (ofi_before(peer->rdg.last_rx_ack, peer->recover_seq)) {
+		if (timeout)
+			peer->cwnd = 1;
+		return;
+	}
+
+	peer->ssthresh = MAX(peer->cwnd / 2, 2);
+	peer->cwnd = timeout ? 1 : peer->ssthresh;
+	peer->cwnd_cnt = 0;
+	peer->recover_seq = peer->rdg.tx_seq_no;
+}
+
+static struct rxd_cc_ops rxd_cc_none = {
+	.name = "none",
+	.init = rxd_cc_none_init,
+	.ack = rxd_cc_none_ack,
+	.loss = rxd_cc_none_loss,
+};
+
+static struct rxd_cc_ops rxd_cc_aimd = {
+	.name = "aimd",
+	.init = rxd_cc_aimd_init,
+	.ack = rxd_cc_aimd_ack,
+	.loss = rxd_cc_aimd_loss,
+};
+
+static struct rxd_cc_ops *rxd_cc_list[] = {
+	&rxd_cc_aimd,
+	&rxd_cc_none,
+};
+
+struct rxd_cc_ops *rxd_cc_ops = &rxd_cc_none;
+
+void rxd_cc_select(const char *name)
+{
+	int i;
+
+	if (!name)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(rxd_cc_list); i++) {
+		if (!strcasecmp(name, rxd_cc_list[i]->name)) {
+			rxd_cc_ops = rxd_cc_list[i];
+			return;
+		}
+	}
+
+	FI_WARN(&rxd_prov, FI_LOG_CORE,
+		"unknown congestion control algorithm %s, using %s\n",
+		name, rxd_cc_ops->name);
+}
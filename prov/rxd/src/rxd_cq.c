@@ -162,11 +162,17 @@ static int rxd_comp_pkt_seq_no(struct dlist_entry *item, const void *arg)
 	new_hdr = rxd_get_base_hdr(container_of((struct dlist_entry *) arg,
 				  struct rxd_pkt_entry, d_entry));
 
-	return new_hdr->seq_no > list_hdr->seq_no;
+	return ofi_before(new_hdr->seq_no, list_hdr->seq_no);
 }
 
-void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
-		      struct rxd_data_pkt *pkt, size_t size)
+static int rxd_peer_rx_held(struct rxd_peer *peer)
+{
+	return !dlist_empty(&peer->buf_pkts) || peer->rdg.rx_held_cnt;
+}
+
+/* Returns 1 once the last segment of the transfer has been received */
+static int rxd_copy_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
+			 struct rxd_data_pkt *pkt, size_t size)
 {
 	struct rxd_domain *rxd_domain = rxd_ep_domain(ep);
 	uint64_t done;
@@ -189,67 +195,163 @@ void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
 	x_entry->bytes_done += done;
 	x_entry->next_seg_no++;
 
-	if (x_entry->next_seg_no < x_entry->num_segs) {
-		if (!(rxd_peer(ep, pkt->base_hdr.peer)->rx_seq_no %
-		    rxd_peer(ep, pkt->base_hdr.peer)->rx_window))
-			rxd_ep_send_ack(ep, pkt->base_hdr.peer);
-		return;
-	}
-	rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+	return x_entry->next_seg_no == x_entry->num_segs;
+}
 
+static void rxd_complete_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry)
+{
 	if (x_entry->cq_entry.flags & FI_READ)
 		rxd_complete_tx(ep, x_entry);
 	else
 		rxd_complete_rx(ep, x_entry);
 }
 
+void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
+		      struct rxd_data_pkt *pkt, size_t size)
+{
+	struct rxd_peer *peer = rxd_peer(ep, pkt->base_hdr.peer);
+
+	if (!rxd_copy_data(ep, x_entry, pkt, size)) {
+		if (pkt->base_hdr.flags & RXD_ACK_REQ ||
+		    !(peer->rdg.rx_seq_no % peer->rx_window))
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		return;
+	}
+	ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+	rxd_complete_data(ep, x_entry);
+}
+
+/*
+ * Find the RMA transfer that an out of order data packet belongs to.  Write
+ * data can only be placed once the op packet that set up the rx entry has
+ * been processed, while read responses name the local tx entry directly.
+ */
+static struct rxd_x_entry *rxd_get_place_entry(struct rxd_ep *ep,
+			struct rxd_peer *peer, struct rxd_data_pkt *pkt)
+{
+	struct rxd_x_entry *x_entry;
+
+	if (pkt->base_hdr.type == RXD_DATA_READ) {
+		x_entry = ofi_bufpool_get_ibuf(ep->tx_entry_pool.pool,
+					       pkt->ext_hdr.tx_id);
+		if (x_entry->op != RXD_READ_REQ ||
+		    x_entry->peer != pkt->base_hdr.peer ||
+		    pkt->ext_hdr.seg_no >= x_entry->num_segs)
+			return NULL;
+		return x_entry;
+	}
+
+	dlist_foreach_container(&peer->rx_list, struct rxd_x_entry,
+				x_entry, entry) {
+		if (x_entry->op == RXD_WRITE &&
+		    pkt->ext_hdr.seg_no + 1 < x_entry->num_segs &&
+		    pkt->base_hdr.seq_no == x_entry->start_seq +
+					    pkt->ext_hdr.seg_no + 1)
+			return x_entry;
+	}
+	return NULL;
+}
+
+/*
+ * Copy out of order RMA data straight into the target buffer, since its
+ * offset is known from the segment number, and only remember the sequence
+ * number until the gap in front of it is filled.
+ */
+static int rxd_place_data(struct rxd_ep *ep, struct rxd_peer *peer,
+			  struct rxd_pkt_entry *pkt_entry)
+{
+	struct rxd_data_pkt *pkt = (struct rxd_data_pkt *) (pkt_entry->pkt);
+	struct rxd_x_entry *x_entry;
+
+	if (!rxd_env.bulk_rma || (pkt->base_hdr.type != RXD_DATA &&
+	    pkt->base_hdr.type != RXD_DATA_READ))
+		return 0;
+
+	x_entry = rxd_get_place_entry(ep, peer, pkt);
+	if (!x_entry || x_entry->cq_entry.flags & FI_ATOMIC)
+		return 0;
+
+	ofi_rdg_rx_hold(&peer->rdg, pkt->base_hdr.seq_no);
+	if (rxd_copy_data(ep, x_entry, pkt, pkt_entry->pkt_size))
+		rxd_complete_data(ep, x_entry);
+	return 1;
+}
+
+/*
+ * Hold packets that arrive ahead of a gap so that only the missing packets
+ * need to be retransmitted.  Duplicates and packets beyond the range that
+ * can be reported in a selective ack are not buffered.  RMA data is placed
+ * directly instead of being held.
+ */
+static int rxd_buffer_pkt(struct rxd_ep *ep, struct rxd_peer *peer,
+			  struct rxd_pkt_entry *pkt_entry)
+{
+	uint64_t seq_no = rxd_get_base_hdr(pkt_entry)->seq_no;
+
+	if (ofi_rdg_rx_check(&peer->rdg, seq_no) != OFI_RDG_RX_AHEAD)
+		return 0;
+
+	if (rxd_place_data(ep, peer, pkt_entry))
+		return 0;
+
+	ofi_rdg_rx_hold(&peer->rdg, seq_no);
+	dlist_insert_order(&peer->buf_pkts, &rxd_comp_pkt_seq_no,
+			   &pkt_entry->d_entry);
+	return 1;
+}
+
 static void rxd_verify_active(struct rxd_ep *ep, fi_addr_t addr, fi_addr_t peer_addr)
 {
+	struct rxd_peer *peer = rxd_peer(ep, addr);
 	struct rxd_pkt_entry *pkt_entry;
 
-	if (rxd_peer(ep, addr)->peer_addr != RXD_ADDR_INVALID &&
-	    rxd_peer(ep, addr)->peer_addr != peer_addr)
+	if (peer->peer_addr != RXD_ADDR_INVALID &&
+	    peer->peer_addr != peer_addr)
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
 			"overwriting active peer - unexpected behavior\n");
 
-	rxd_peer(ep, addr)->peer_addr = peer_addr;
+	peer->peer_addr = peer_addr;
 
-	if (!dlist_empty(&(rxd_peer(ep, addr)->unacked)) &&
-	    rxd_get_base_hdr(container_of((&(rxd_peer(ep, addr)->unacked))->next,
-			     struct rxd_pkt_entry, d_entry))->type == RXD_RTS) {
-		dlist_pop_front(&(rxd_peer(ep, addr)->unacked),
-				struct rxd_pkt_entry, pkt_entry, d_entry);
-		if (pkt_entry->flags & RXD_PKT_IN_USE) {
-			dlist_insert_tail(&pkt_entry->d_entry, &ep->ctrl_pkts);
-			pkt_entry->flags |= RXD_PKT_ACKED;
-		} else {
-			ofi_buf_free(pkt_entry);
-			rxd_peer(ep, addr)->unacked_cnt--;
+	if (!dlist_empty(&peer->rdg.unacked)) {
+		pkt_entry = container_of(peer->rdg.unacked.next,
+					 struct rxd_pkt_entry, rdg.entry);
+		if (rxd_get_base_hdr(pkt_entry)->type == RXD_RTS &&
+		    !(pkt_entry->rdg.flags & OFI_RDG_PKT_ACKED)) {
+			ofi_rdg_pkt_acked(&ep->rdg, &peer->rdg, &pkt_entry->rdg);
+			dlist_remove(&peer->entry);
 		}
-		dlist_remove(&(rxd_peer(ep, addr)->entry));
 	}
 
-	if (!rxd_peer(ep, addr)->active) {
-		dlist_insert_tail(&(rxd_peer(ep, addr)->entry),
-				  &ep->active_peers);
-		rxd_peer(ep, addr)->retry_cnt = 0;
-		rxd_peer(ep, addr)->active = 1;
+	if (!peer->active) {
+		dlist_insert_tail(&peer->entry, &ep->active_peers);
+		peer->rdg.retry_cnt = 0;
+		peer->active = 1;
 	}
 }
 
 int rxd_start_xfer(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 {
 	struct rxd_base_hdr *hdr = rxd_get_base_hdr(tx_entry->pkt);
+	struct rxd_peer *peer = rxd_peer(ep, tx_entry->peer);
+	struct rxd_x_entry *prev;
 
-	if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-	    rxd_peer(ep, tx_entry->peer)->tx_window)
+	if (rxd_peer_tx_full(peer))
 		return 0;
 
+	/* Pacing may reopen the window before an earlier transfer has posted
+	 * all of its data, which must go out first to keep sequence order. */
+	if (tx_entry->entry.prev != &peer->tx_list) {
+		prev = container_of(tx_entry->entry.prev, struct rxd_x_entry,
+				    entry);
+		if (prev->pkt || prev->bytes_done != prev->cq_entry.len)
+			return 0;
+	}
+
 	tx_entry->start_seq = rxd_set_pkt_seq(rxd_peer(ep, tx_entry->peer),
 					      tx_entry->pkt);
 	if (tx_entry->op != RXD_READ_REQ && tx_entry->num_segs > 1) {
-		rxd_peer(ep, tx_entry->peer)->tx_seq_no = tx_entry->start_seq +
-						      tx_entry->num_segs;
+		rxd_peer(ep, tx_entry->peer)->rdg.tx_seq_no =
+					tx_entry->start_seq + tx_entry->num_segs;
 	}
 	hdr->peer = (uint32_t) rxd_peer(ep, tx_entry->peer)->peer_addr;
 	rxd_ep_send_pkt(ep, tx_entry->pkt);
@@ -263,23 +365,16 @@ int rxd_start_xfer(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 				  &(rxd_peer(ep, tx_entry->peer)->rma_rx_list));
 	}
 
-	return rxd_peer(ep, tx_entry->peer)->unacked_cnt <
-	       rxd_peer(ep,tx_entry->peer)->tx_window;
+	return !rxd_peer_tx_full(rxd_peer(ep, tx_entry->peer));
 }
 
 void rxd_progress_tx_list(struct rxd_ep *ep, struct rxd_peer *peer)
 {
 	struct dlist_entry *tmp_entry;
 	struct rxd_x_entry *tx_entry;
-	uint64_t head_seq = peer->last_rx_ack;
+	uint64_t head_seq = ofi_rdg_head_seq(&peer->rdg);
 	ssize_t ret = 0;
-	int inc = 0;
-
-	if (!dlist_empty(&peer->unacked)) {
-		head_seq = rxd_get_base_hdr(container_of(
-					    (&peer->unacked)->next,
-					    struct rxd_pkt_entry, d_entry))->seq_no;
-	}
+	int inc;
 
 	if (peer->peer_addr == RXD_ADDR_INVALID)
 		return;
@@ -305,28 +400,26 @@ void rxd_progress_tx_list(struct rxd_ep *ep, struct rxd_peer *peer)
 			continue;
 		}
 
+		inc = 0;
 		if (tx_entry->op == RXD_DATA_READ && !tx_entry->bytes_done) {
-			if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-		    	    rxd_peer(ep, tx_entry->peer)->tx_window) {
+			if (rxd_peer_tx_full(rxd_peer(ep, tx_entry->peer)))
 				break;
-			}
-			tx_entry->start_seq = rxd_peer(ep,tx_entry->peer)->tx_seq_no;
-			rxd_peer(ep, tx_entry->peer)->tx_seq_no = tx_entry->start_seq +
-							      tx_entry->num_segs;
+			tx_entry->start_seq = peer->rdg.tx_seq_no;
+			peer->rdg.tx_seq_no = tx_entry->start_seq +
+					      tx_entry->num_segs;
 			inc = 1;
 		}
 
 		ret = rxd_ep_post_data_pkts(ep, tx_entry);
 		if (ret) {
-			if (ret == -FI_ENOMEM && inc)
-				rxd_peer(ep, tx_entry->peer)->tx_seq_no -=
-							  tx_entry->num_segs;
+			if (inc && !tx_entry->bytes_done)
+				peer->rdg.tx_seq_no -= tx_entry->num_segs;
 			break;
 		}
 	}
 
 	if (dlist_empty(&peer->tx_list))
-		peer->retry_cnt = 0;
+		peer->rdg.retry_cnt = 0;
 }
 
 static void rxd_update_peer(struct rxd_ep *ep, fi_addr_t peer, fi_addr_t peer_addr)
@@ -677,7 +770,7 @@ static struct rxd_x_entry *rxd_rx_atomic_fetch(struct rxd_ep *ep,
 
 	dlist_insert_tail(&rx_entry->entry, &(rxd_peer(ep, rx_entry->peer)->tx_list));
 
-	rxd_ep_send_ack(ep, base_hdr->peer);
+	ofi_rdg_ack_req(&ep->rdg, &rxd_peer(ep, base_hdr->peer)->rdg);
 
 	rxd_progress_tx_list(ep, rxd_peer(ep, rx_entry->peer));
 
@@ -897,6 +990,34 @@ static struct rxd_x_entry *rxd_get_data_x_entry(struct rxd_ep *ep,
 	return ofi_bufpool_get_ibuf(ep->tx_entry_pool.pool, data_pkt->ext_hdr.tx_id);
 }
 
+/*
+ * Returns 1 if the packet was queued on an unexpected message, in which
+ * case the caller must not release it.
+ */
+static int rxd_recv_data_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
+{
+	struct rxd_data_pkt *pkt = (struct rxd_data_pkt *) (pkt_entry->pkt);
+	struct rxd_peer *peer = rxd_peer(ep, pkt->base_hdr.peer);
+	struct rxd_unexp_msg *unexp_msg;
+
+	ofi_rdg_rx_next(&peer->rdg);
+	if (pkt->base_hdr.type == RXD_DATA && peer->curr_unexp) {
+		unexp_msg = peer->curr_unexp;
+		dlist_insert_tail(&pkt_entry->d_entry, &unexp_msg->pkt_list);
+		if (pkt->ext_hdr.seg_no + 1 == unexp_msg->sar_hdr->num_segs - 1) {
+			peer->curr_unexp = NULL;
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		} else if (pkt->base_hdr.flags & RXD_ACK_REQ) {
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		}
+		return 1;
+	}
+
+	rxd_ep_recv_data(ep, rxd_get_data_x_entry(ep, pkt), pkt,
+			 pkt_entry->pkt_size);
+	return 0;
+}
+
 static void rxd_progress_buf_pkts(struct rxd_ep *ep, fi_addr_t peer)
 {
 	struct fi_cq_err_entry err_entry;
@@ -911,61 +1032,91 @@ static void rxd_progress_buf_pkts(struct rxd_ep *ep, fi_addr_t peer)
 	int ret;
 	size_t msg_size;
 	struct rxd_x_entry *rx_entry = NULL;
-	struct rxd_data_pkt *data_pkt;
+	struct ofi_rdg_peer *rdg_peer = &rxd_peer(ep, peer)->rdg;
 	struct dlist_entry *bufpkts;
 
 	bufpkts = &(rxd_peer(ep, peer)->buf_pkts);
-	while (!dlist_empty(bufpkts)) {
-		pkt_entry = container_of(bufpkts->next, struct rxd_pkt_entry,
+	for (;;) {
+		pkt_entry = dlist_empty(bufpkts) ? NULL :
+			    container_of(bufpkts->next, struct rxd_pkt_entry,
 					 d_entry);
+		if (pkt_entry && ofi_before(rxd_get_base_hdr(pkt_entry)->seq_no,
+					    rdg_peer->rx_seq_no)) {
+			/* Skipped by a discarded message */
+			dlist_remove(&pkt_entry->d_entry);
+			ofi_buf_free(pkt_entry);
+			continue;
+		}
+		if (!pkt_entry ||
+		    rxd_get_base_hdr(pkt_entry)->seq_no != rdg_peer->rx_seq_no) {
+			/* Held but not buffered: RMA data already placed */
+			if (!ofi_rdg_rx_held(rdg_peer, rdg_peer->rx_seq_no))
+				return;
+			ofi_rdg_rx_next(rdg_peer);
+			continue;
+		}
+
 		base_hdr = rxd_get_base_hdr(pkt_entry);
-		if (base_hdr->seq_no != rxd_peer(ep, peer)->rx_seq_no)
-			return;
+
+		dlist_remove(&pkt_entry->d_entry);
 		if (base_hdr->type == RXD_DATA || base_hdr->type == RXD_DATA_READ) {
-			data_pkt = (struct rxd_data_pkt *) pkt_entry->pkt;
-			rx_entry = rxd_get_data_x_entry(ep, data_pkt);
-			rxd_ep_recv_data(ep, rx_entry, data_pkt, pkt_entry->pkt_size);
-		} else {
-			ret = rxd_unpack_init_rx(ep, &rx_entry, pkt_entry, base_hdr, &sar_hdr,
-					      &tag_hdr, &data_hdr, &rma_hdr, &atom_hdr,
-					      &msg, &msg_size);
-			if (ret) {
-				memset(&err_entry, 0, sizeof(err_entry));
-				err_entry.err = FI_ETRUNC;
-				err_entry.prov_errno = 0;
-				ret = ofi_cq_write_error(&rxd_ep_rx_cq(ep)->util_cq,
-							 &err_entry);
-				if (ret)
-					FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
-						"could not write error entry\n");
-				rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
-				rxd_remove_free_pkt_entry(pkt_entry);
+			if (!rxd_recv_data_pkt(ep, pkt_entry))
+				ofi_buf_free(pkt_entry);
+			continue;
+		}
+
+		ret = rxd_unpack_init_rx(ep, &rx_entry, pkt_entry, base_hdr, &sar_hdr,
+				      &tag_hdr, &data_hdr, &rma_hdr, &atom_hdr,
+				      &msg, &msg_size);
+		if (ret) {
+			memset(&err_entry, 0, sizeof(err_entry));
+			err_entry.err = FI_ETRUNC;
+			err_entry.prov_errno = 0;
+			ret = ofi_cq_write_error(&rxd_ep_rx_cq(ep)->util_cq,
+						 &err_entry);
+			if (ret)
+				FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+					"could not write error entry\n");
+			ofi_rdg_rx_next(rdg_peer);
+			ofi_buf_free(pkt_entry);
+			continue;
+		}
+
+		if (!rx_entry) {
+			/* Unexpected messages take ownership of the packet.
+			 * On any other failure the packet is released (and no
+			 * longer reported in selective acks) so that the peer
+			 * retransmits it. */
+			if ((base_hdr->type == RXD_MSG ||
+			     base_hdr->type == RXD_TAGGED) &&
+			    rxd_peer(ep, peer)->curr_unexp) {
+				ofi_rdg_rx_next(rdg_peer);
+				if (!sar_hdr)
+					rxd_peer(ep, peer)->curr_unexp = NULL;
 				continue;
 			}
-			if (!rx_entry) {
-				if (base_hdr->type == RXD_MSG ||
-				    base_hdr->type == RXD_TAGGED) {
-					rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
-					continue;
-				}
-				break;
-			}
-
-			rxd_progress_op(ep, rx_entry, pkt_entry, base_hdr,
-					sar_hdr, tag_hdr, data_hdr, rma_hdr,
-					atom_hdr, &msg, msg_size);
+			if (base_hdr->type != RXD_MSG &&
+			    base_hdr->type != RXD_TAGGED)
+				rxd_peer(ep, peer)->rx_window = 0;
+			ofi_rdg_rx_unhold(rdg_peer, base_hdr->seq_no);
+			ofi_buf_free(pkt_entry);
+			return;
 		}
 
-		rxd_peer(ep,base_hdr->peer)->rx_seq_no++;
-		rxd_remove_free_pkt_entry(pkt_entry);
+		ofi_rdg_rx_next(rdg_peer);
+		rxd_peer(ep, peer)->rx_window = (uint16_t) rxd_env.max_unacked;
+		rxd_progress_op(ep, rx_entry, pkt_entry, base_hdr,
+				sar_hdr, tag_hdr, data_hdr, rma_hdr,
+				atom_hdr, &msg, msg_size);
+		ofi_buf_free(pkt_entry);
 	}
 }
 
 static void rxd_handle_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 {
 	struct rxd_data_pkt *pkt = (struct rxd_data_pkt *) (pkt_entry->pkt);
-	struct rxd_x_entry *x_entry;
-	struct rxd_unexp_msg *unexp_msg;
+	struct rxd_peer *peer;
+	int ret, held, ack;
 
 	if (pkt_entry->pkt_size < sizeof(*pkt) + ep->rx_prefix_size) {
 		FI_WARN(&rxd_prov, FI_LOG_CQ,
@@ -973,32 +1124,31 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 		goto free;
 	}
 
-	if (pkt->base_hdr.seq_no == rxd_peer(ep,
-				    pkt->base_hdr.peer)->rx_seq_no) {
-		rxd_peer(ep, pkt->base_hdr.peer)->rx_seq_no++;
-		if (pkt->base_hdr.type == RXD_DATA &&
-		    rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp) {
-			unexp_msg = rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp;
-			dlist_insert_tail(&pkt_entry->d_entry, &unexp_msg->pkt_list);
-			if (pkt->ext_hdr.seg_no + 1 == unexp_msg->sar_hdr->num_segs - 1) {
-				rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp = NULL;
-				rxd_ep_send_ack(ep, pkt->base_hdr.peer);
-			}
-			return;
-		}
-		x_entry = rxd_get_data_x_entry(ep, pkt);
-		rxd_ep_recv_data(ep, x_entry, pkt, pkt_entry->pkt_size);
-		if (!dlist_empty(&(rxd_peer(ep,
-				   pkt->base_hdr.peer)->buf_pkts)))
+	peer = rxd_peer(ep, pkt->base_hdr.peer);
+	if (pkt->base_hdr.seq_no == peer->rdg.rx_seq_no) {
+		ret = rxd_recv_data_pkt(ep, pkt_entry);
+		if (rxd_peer_rx_held(peer)) {
 			rxd_progress_buf_pkts(ep, pkt->base_hdr.peer);
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		}
+		if (ret)
+			return;
 	} else if (!rxd_env.retry) {
-		dlist_insert_order(&(rxd_peer(ep,
-				     pkt->base_hdr.peer)->buf_pkts),
-				   &rxd_comp_pkt_seq_no, &pkt_entry->d_entry);
+		dlist_insert_order(&peer->buf_pkts, &rxd_comp_pkt_seq_no,
+				   &pkt_entry->d_entry);
 		return;
-	} else if (rxd_peer(ep, pkt->base_hdr.peer)->peer_addr !=
-		   RXD_ADDR_INVALID) {
-		rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+	} else if (peer->peer_addr != RXD_ADDR_INVALID) {
+		/* Out of order segments of a bulk window are acked together
+		 * at the end of the window, after the one that showed the
+		 * gap. */
+		held = rxd_peer_rx_held(peer);
+		ack = !(pkt->base_hdr.flags & RXD_BULK_DATA) ||
+		      pkt->base_hdr.flags & RXD_ACK_REQ || !held;
+		ret = rxd_buffer_pkt(ep, peer, pkt_entry);
+		if (ack)
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		if (ret)
+			return;
 	}
 free:
 	ofi_buf_free(pkt_entry);
@@ -1013,20 +1163,26 @@ static void rxd_handle_op(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 	struct rxd_data_hdr *data_hdr;
 	struct rxd_rma_hdr *rma_hdr;
 	struct rxd_atom_hdr *atom_hdr;
+	struct rxd_peer *peer = rxd_peer(ep, base_hdr->peer);
 	void *msg;
 	size_t msg_size;
 	int ret;
 
-	if (base_hdr->seq_no != rxd_peer(ep, base_hdr->peer)->rx_seq_no) {
+	if (base_hdr->seq_no != peer->rdg.rx_seq_no) {
 		if (!rxd_env.retry) {
 			dlist_insert_order(&(rxd_peer(ep, base_hdr->peer)->buf_pkts),
 					   &rxd_comp_pkt_seq_no, &pkt_entry->d_entry);
 			return;
 		}
 
-		if (rxd_peer(ep, base_hdr->peer)->peer_addr != RXD_ADDR_INVALID)
+		if (rxd_peer(ep, base_hdr->peer)->peer_addr == RXD_ADDR_INVALID)
+			goto release;
+
+		if (!rxd_buffer_pkt(ep, peer, pkt_entry))
 			goto ack;
-		goto release;
+
+		ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
+		return;
 	}
 
 	if (rxd_peer(ep, base_hdr->peer)->peer_addr == RXD_ADDR_INVALID)
@@ -1043,28 +1199,28 @@ static void rxd_handle_op(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 			if (!rxd_peer(ep, base_hdr->peer)->curr_unexp)
 				goto ack;
 
-			rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
+			ofi_rdg_rx_next(&peer->rdg);
 
 			if (!sar_hdr)
 				rxd_peer(ep, base_hdr->peer)->curr_unexp = NULL;
 
-			rxd_ep_send_ack(ep, base_hdr->peer);
+			ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
 			return;
 		}
 		rxd_peer(ep, base_hdr->peer)->rx_window = 0;
 		goto ack;
 	}
 
-	rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
+	ofi_rdg_rx_next(&peer->rdg);
 	rxd_peer(ep, base_hdr->peer)->rx_window = (uint16_t) rxd_env.max_unacked;
 	rxd_progress_op(ep, rx_entry, pkt_entry, base_hdr, sar_hdr, tag_hdr,
 			data_hdr, rma_hdr, atom_hdr, &msg, msg_size);
 
-	if (!dlist_empty(&(rxd_peer(ep, base_hdr->peer)->buf_pkts)))
+	if (rxd_peer_rx_held(peer))
 		rxd_progress_buf_pkts(ep, base_hdr->peer);
 
 ack:
-	rxd_ep_send_ack(ep, base_hdr->peer);
+	ofi_rdg_ack_req(&ep->rdg, &peer->rdg);
 release:
 	ofi_buf_free(pkt_entry);
 }
@@ -1085,45 +1241,30 @@ static void rxd_handle_cts(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 static void rxd_handle_ack(struct rxd_ep *ep, struct rxd_pkt_entry *ack_entry)
 {
 	struct rxd_ack_pkt *ack = (struct rxd_ack_pkt *) (ack_entry->pkt);
-	struct rxd_pkt_entry *pkt_entry;
-	fi_addr_t peer = ack->base_hdr.peer;
-	struct rxd_base_hdr *hdr;
-
-	rxd_peer(ep, peer)->tx_window = (uint16_t) ack->ext_hdr.rx_id;
-
-	if (rxd_peer(ep, peer)->last_rx_ack == ack->base_hdr.seq_no)
-		return;
-
-	rxd_peer(ep, peer)->last_rx_ack = ack->base_hdr.seq_no;
-
-	if (dlist_empty(&(rxd_peer(ep, peer)->unacked)))
+	struct ofi_rdg_range range[RXD_ACK_RANGES];
+	struct rxd_peer *peer;
+	uint32_t i, range_cnt;
+	size_t size;
+
+	size = sizeof(*ack) - sizeof(ack->range) + ep->rx_prefix_size;
+	range_cnt = (uint32_t) ack->ext_hdr.seg_no;
+	if (ack_entry->pkt_size < size || range_cnt > RXD_ACK_RANGES ||
+	    ack_entry->pkt_size < size + range_cnt * sizeof(*ack->range)) {
+		FI_WARN(&rxd_prov, FI_LOG_CQ,
+			"Cannot process ack smaller than minimum size\n");
 		return;
+	}
 
-	pkt_entry = container_of((&(rxd_peer(ep,
-				    peer)->unacked))->next,
-				 struct rxd_pkt_entry, d_entry);
-
-	while (&pkt_entry->d_entry != &(rxd_peer(ep,
-				        peer)->unacked)) {
-		hdr = rxd_get_base_hdr(pkt_entry);
-		if (ofi_after_eq(hdr->seq_no, ack->base_hdr.seq_no))
-			break;
+	peer = rxd_peer(ep, ack->base_hdr.peer);
+	peer->tx_window = (uint16_t) ack->ext_hdr.rx_id;
 
-		if (pkt_entry->flags & RXD_PKT_IN_USE) {
-			pkt_entry->flags |= RXD_PKT_ACKED;
-			pkt_entry = container_of((&pkt_entry->d_entry)->next,
-						 struct rxd_pkt_entry, d_entry);
-			continue;
-		}
-		rxd_remove_free_pkt_entry(pkt_entry);
-		rxd_peer(ep, peer)->unacked_cnt--;
-		rxd_peer(ep, peer)->retry_cnt = 0;
-
-		pkt_entry = container_of((&(rxd_peer(ep, peer)->unacked))->next,
-					struct rxd_pkt_entry, d_entry);
+	for (i = 0; i < range_cnt; i++) {
+		range[i].start = ack->range[i].start;
+		range[i].len = ack->range[i].len;
 	}
-
-	rxd_progress_tx_list(ep, rxd_peer(ep, ack->base_hdr.peer));
+	if (ofi_rdg_recv_ack(&ep->rdg, &peer->rdg, ack->base_hdr.seq_no,
+			     range, range_cnt))
+		rxd_progress_tx_list(ep, peer);
 }
 
 void rxd_handle_send_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
@@ -1142,14 +1283,9 @@ void rxd_handle_send_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 		rxd_remove_free_pkt_entry(pkt_entry);
 		break;
 	default:
-		if (pkt_entry->flags & RXD_PKT_ACKED) {
-			peer = pkt_entry->peer;
-			rxd_remove_free_pkt_entry(pkt_entry);
-			rxd_peer(ep, peer)->unacked_cnt--;
+		peer = pkt_entry->peer;
+		if (ofi_rdg_send_done(&ep->rdg, &pkt_entry->rdg))
 			rxd_progress_tx_list(ep, rxd_peer(ep, peer));
-		} else {
-			pkt_entry->flags &= ~RXD_PKT_IN_USE;
-		}
 	}
 }
 
@@ -1165,6 +1301,14 @@ void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 	rxd_ep_post_buf(ep);
 	rxd_remove_rx_pkt(ep, pkt_entry);
 
+#if ENABLE_DEBUG
+	if (rxd_env.drop_rate > 0 && !(++ep->rx_pkt_cnt % rxd_env.drop_rate)) {
+		FI_DBG(&rxd_prov, FI_LOG_EP_DATA, "dropping packet\n");
+		ofi_buf_free(pkt_entry);
+		return;
+	}
+#endif
+
 	pkt_entry->pkt_size = comp->len;
 	switch (rxd_pkt_type(pkt_entry)) {
 	case RXD_RTS:
@@ -1270,7 +1414,7 @@ ssize_t rxd_cq_sreadfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 		ofi_mutex_unlock(&cq->ep_list_lock);
 
 		ret = fi_wait(&cq->wait->wait_fid, ep_retry == -1 ?
-			      timeout : rxd_get_timeout(ep_retry));
+			      timeout : ep_retry);
 
 		if (ep_retry != -1 && ret == -FI_ETIMEDOUT)
 			ret = 0;
@@ -45,7 +45,8 @@ struct rxd_pkt_entry *rxd_get_tx_pkt(struct rxd_ep *ep)
 	if (!pkt_entry)
 		return NULL;
 
-	pkt_entry->flags = 0;
+	ofi_rdg_pkt_init(&pkt_entry->rdg, 1);
+	pkt_entry->x_entry = NULL;
 
 	return pkt_entry;
 }
@@ -273,16 +274,103 @@ static int rxd_ep_enable(struct rxd_ep *ep)
 }
 
 /*
- * Exponential back-off starting at 1ms, max 4s.
+ * Describe the payload of a bulk segment as a slice of the transfer's iov.
+ * Returns the number of iovs in the slice, or 0 if it cannot be sent along
+ * with its header in a single send to the base provider.
  */
-int rxd_get_timeout(int retry_cnt)
+static size_t rxd_bulk_seg_iov(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
+			       uint64_t offset, size_t len, struct iovec *iov)
 {
-	return MIN(1 << retry_cnt, 4000);
+	size_t index, iov_offset, iov_count;
+	int iov_idx;
+
+	if (ofi_iov_locate(x_entry->iov, x_entry->iov_count, offset,
+			   &iov_idx, &iov_offset))
+		return 0;
+
+	index = iov_idx;
+	if (ofi_copy_iov_desc(iov, NULL, &iov_count, x_entry->iov, NULL,
+			      x_entry->iov_count, &index, &iov_offset, len) ||
+	    iov_count >= ep->dg_iov_limit)
+		return 0;
+
+	return iov_count;
 }
 
-uint64_t rxd_get_retry_time(uint64_t start, int retry_cnt)
+static size_t rxd_bulk_seg_len(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
+			       uint64_t offset)
 {
-	return start + rxd_get_timeout(retry_cnt);
+	return (size_t) MIN(rxd_ep_domain(ep)->max_seg_sz,
+			    x_entry->cq_entry.len - offset);
+}
+
+/*
+ * Number of segments, starting at the next unsent one, that the transfer
+ * can send as a bulk window.  Segments are sent straight from the source
+ * buffer, which stays valid until the transfer completes, and that waits
+ * for every segment to be acked.
+ */
+static uint32_t rxd_bulk_win_segs(struct rxd_ep *ep,
+				  struct rxd_x_entry *tx_entry, uint32_t max)
+{
+	struct iovec iov[RXD_IOV_LIMIT];
+	uint64_t offset = tx_entry->bytes_done;
+	uint32_t cnt;
+
+	if (!ep->bulk_tx || (tx_entry->op != RXD_WRITE &&
+	    tx_entry->op != RXD_DATA_READ))
+		return 0;
+
+	max = MIN(max, ep->bulk_segs);
+	for (cnt = 0; cnt < max && offset < tx_entry->cq_entry.len; cnt++) {
+		if (!rxd_bulk_seg_iov(ep, tx_entry, offset,
+				      rxd_bulk_seg_len(ep, tx_entry, offset),
+				      iov))
+			break;
+		offset += rxd_ep_domain(ep)->max_seg_sz;
+	}
+	return cnt;
+}
+
+/*
+ * A bulk window describes seg_cnt consecutive data segments of a transfer
+ * with a single tx packet entry.  The packet buffer holds one header per
+ * segment, and the payload of each segment is sent from the transfer's iov.
+ */
+static void rxd_init_bulk_win(struct rxd_ep *ep, struct rxd_x_entry *tx_entry,
+			      struct rxd_pkt_entry *pkt_entry, uint32_t seg_cnt)
+{
+	struct rxd_data_pkt *hdr;
+	uint64_t seq_no;
+	uint32_t i;
+
+	ofi_rdg_pkt_init(&pkt_entry->rdg, seg_cnt);
+	pkt_entry->x_entry = tx_entry;
+	pkt_entry->offset = tx_entry->bytes_done;
+	pkt_entry->peer = tx_entry->peer;
+	pkt_entry->pkt_size = rxd_bulk_hdr_size(ep);
+
+	seq_no = tx_entry->start_seq + tx_entry->next_seg_no;
+	if (tx_entry->op != RXD_DATA_READ)
+		seq_no++;
+
+	for (i = 0; i < seg_cnt; i++) {
+		hdr = rxd_bulk_hdr(ep, pkt_entry, i);
+		hdr->base_hdr.version = RXD_PROTOCOL_VERSION;
+		hdr->base_hdr.type = tx_entry->op == RXD_DATA_READ ?
+				     RXD_DATA_READ : RXD_DATA;
+		hdr->base_hdr.flags = RXD_BULK_DATA;
+		hdr->base_hdr.peer = (uint32_t) rxd_peer(ep,
+						tx_entry->peer)->peer_addr;
+		hdr->base_hdr.seq_no = seq_no + i;
+		hdr->ext_hdr.rx_id = tx_entry->rx_id;
+		hdr->ext_hdr.tx_id = tx_entry->tx_id;
+		hdr->ext_hdr.seg_no = tx_entry->next_seg_no++;
+	}
+	hdr->base_hdr.flags |= RXD_ACK_REQ;
+
+	tx_entry->bytes_done = MIN(tx_entry->cq_entry.len, tx_entry->bytes_done +
+				   seg_cnt * rxd_ep_domain(ep)->max_seg_sz);
 }
 
 void rxd_init_data_pkt(struct rxd_ep *ep, struct rxd_x_entry *tx_entry,
@@ -374,25 +462,56 @@ void rxd_tx_entry_free(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 void rxd_insert_unacked(struct rxd_ep *ep, fi_addr_t peer,
 			struct rxd_pkt_entry *pkt_entry)
 {
-	dlist_insert_tail(&pkt_entry->d_entry,
-			  &(rxd_peer(ep, peer)->unacked));
-	rxd_peer(ep, peer)->unacked_cnt++;
+	struct rxd_peer *peer_entry = rxd_peer(ep, peer);
+	uint32_t cnt = pkt_entry->rdg.seg_cnt;
+
+	pkt_entry->rdg.seq_no = rxd_get_base_hdr(pkt_entry)->seq_no;
+	ofi_rdg_insert(&peer_entry->rdg, &pkt_entry->rdg);
+	ofi_metric_add(&ep->tx_pkts, cnt);
+
+	/* Spread a congestion window across half an RTT, so pacing smooths
+	 * out bursts without limiting the rate below cwnd / srtt. */
+	if (rxd_env.pacing && peer_entry->rdg.srtt)
+		peer_entry->next_tx = pkt_entry->rdg.timestamp + cnt *
+				      peer_entry->rdg.srtt /
+				      (2 * peer_entry->cwnd);
 }
 
 ssize_t rxd_ep_post_data_pkts(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 {
+	struct rxd_peer *peer = rxd_peer(ep, tx_entry->peer);
 	struct rxd_pkt_entry *pkt_entry;
 	struct rxd_data_pkt *data;
+	uint32_t seg_cnt, avail;
 
 	while (tx_entry->bytes_done != tx_entry->cq_entry.len) {
-		if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-		    rxd_peer(ep, tx_entry->peer)->tx_window)
-			return 0;
+		if (rxd_peer_tx_full(peer))
+			return 1;
 
 		pkt_entry = rxd_get_tx_pkt(ep);
 		if (!pkt_entry)
 			return -FI_ENOMEM;
 
+		avail = rxd_peer_tx_limit(peer) - peer->rdg.unacked_cnt;
+		seg_cnt = rxd_bulk_win_segs(ep, tx_entry, avail);
+
+		/* Wait for a few acks rather than trickle out windows of a
+		 * segment or two as each ack opens the tx window */
+		if (seg_cnt && seg_cnt == avail &&
+		    avail < MIN(ep->bulk_segs, rxd_peer_tx_limit(peer) / 4) &&
+		    tx_entry->bytes_done + avail *
+		    rxd_ep_domain(ep)->max_seg_sz < tx_entry->cq_entry.len) {
+			ofi_buf_free(pkt_entry);
+			return 1;
+		}
+
+		if (seg_cnt) {
+			rxd_init_bulk_win(ep, tx_entry, pkt_entry, seg_cnt);
+			rxd_ep_send_pkt(ep, pkt_entry);
+			rxd_insert_unacked(ep, tx_entry->peer, pkt_entry);
+			continue;
+		}
+
 		rxd_init_data_pkt(ep, tx_entry, pkt_entry);
 
 		data = (struct rxd_data_pkt *) (pkt_entry->pkt);
@@ -401,22 +520,94 @@ ssize_t rxd_ep_post_data_pkts(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 		if (data->base_hdr.type != RXD_DATA_READ)
 			data->base_hdr.seq_no++;
 
+		/* Ask for an immediate ack when this fills the window */
+		if (peer->rdg.unacked_cnt + 1 >= rxd_peer_tx_limit(peer))
+			data->base_hdr.flags |= RXD_ACK_REQ;
+
 		rxd_ep_send_pkt(ep, pkt_entry);
 		rxd_insert_unacked(ep, tx_entry->peer, pkt_entry);
 	}
 
-	return rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-	       rxd_peer(ep, tx_entry->peer)->tx_window;
+	return rxd_peer_tx_full(peer);
+}
+
+/*
+ * Resent data packets request an immediate ack, otherwise the receiver
+ * may not respond until the end of its receive window.
+ */
+ssize_t rxd_ep_retry_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
+{
+	struct rxd_base_hdr *hdr = rxd_get_base_hdr(pkt_entry);
+
+	if (pkt_entry->x_entry)
+		return rxd_ep_send_pkt(ep, pkt_entry);
+
+	if (hdr->type == RXD_DATA || hdr->type == RXD_DATA_READ)
+		hdr->flags |= RXD_ACK_REQ;
+
+	ofi_metric_inc(&ep->retrans_pkts);
+	return rxd_ep_send_pkt(ep, pkt_entry);
+}
+
+/*
+ * Send the segments of a bulk window that the peer has not acked, each
+ * from its own header.  The last segment sent asks for an ack, which then
+ * covers the whole window.
+ */
+static ssize_t rxd_ep_send_bulk_win(struct rxd_ep *ep,
+				    struct rxd_pkt_entry *pkt_entry,
+				    fi_addr_t dg_addr)
+{
+	struct iovec iov[RXD_IOV_LIMIT + 1];
+	void *desc[RXD_IOV_LIMIT + 1] = { 0 };
+	struct rxd_data_pkt *hdr;
+	uint64_t todo, offset;
+	uint32_t seg, last, sent = 0;
+	size_t iov_count;
+	ssize_t ret = 0;
+
+	todo = ofi_rdg_pkt_todo(&pkt_entry->rdg);
+	last = ofi_msb(todo) - 1;
+	desc[0] = pkt_entry->desc;
+	for (; todo; todo &= todo - 1) {
+		seg = ofi_lsb(todo) - 1;
+		hdr = rxd_bulk_hdr(ep, pkt_entry, seg);
+		if (seg == last)
+			hdr->base_hdr.flags |= RXD_ACK_REQ;
+
+		offset = pkt_entry->offset +
+			 seg * rxd_ep_domain(ep)->max_seg_sz;
+		iov_count = rxd_bulk_seg_iov(ep, pkt_entry->x_entry, offset,
+				rxd_bulk_seg_len(ep, pkt_entry->x_entry, offset),
+				&iov[1]);
+		iov[0].iov_base = (char *) hdr - ep->tx_prefix_size;
+		iov[0].iov_len = rxd_bulk_hdr_size(ep);
+
+		ret = fi_sendv(ep->dg_ep, iov, desc, iov_count + 1, dg_addr,
+			       &pkt_entry->context);
+		if (ret)
+			break;
+
+		ofi_rdg_pkt_sent(&pkt_entry->rdg);
+		sent++;
+		if (pkt_entry->rdg.flags & OFI_RDG_PKT_RETRANS)
+			ofi_metric_inc(&ep->retrans_pkts);
+	}
+
+	return sent ? 0 : ret;
 }
 
 ssize_t rxd_ep_send_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 {
 	ssize_t ret;
 	fi_addr_t dg_addr;
-	pkt_entry->timestamp = ofi_gettime_ms();
+	pkt_entry->rdg.timestamp = ofi_gettime_us();
 
 	dg_addr = (intptr_t) ofi_idx_lookup(&(rxd_ep_av(ep)->rxdaddr_dg_idx),
 					    (int)pkt_entry->peer);
+	if (pkt_entry->x_entry)
+		return rxd_ep_send_bulk_win(ep, pkt_entry, dg_addr);
+
 	ret = fi_send(ep->dg_ep, (const void *) rxd_pkt_start(pkt_entry),
 		      pkt_entry->pkt_size, pkt_entry->desc, dg_addr,
 		      &pkt_entry->context);
@@ -425,7 +616,7 @@ ssize_t rxd_ep_send_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 			(int) ret, fi_strerror((int) -ret));
 		return ret;
 	}
-	pkt_entry->flags |= RXD_PKT_IN_USE;
+	ofi_rdg_pkt_sent(&pkt_entry->rdg);
 
 	return 0;
 }
@@ -447,6 +638,7 @@ static ssize_t rxd_ep_send_rts(struct rxd_ep *rxd_ep, fi_addr_t rxd_addr)
 
 	rts_pkt->base_hdr.version = RXD_PROTOCOL_VERSION;
 	rts_pkt->base_hdr.type = RXD_RTS;
+	rts_pkt->base_hdr.seq_no = rxd_peer(rxd_ep, rxd_addr)->rdg.tx_seq_no;
 	rts_pkt->rts_addr = rxd_addr;
 
 	addrlen = RXD_NAME_LENGTH;
@@ -474,7 +666,7 @@ ssize_t rxd_send_rts_if_needed(struct rxd_ep *ep, fi_addr_t addr)
 	}
 
 	if (rxd_peer(ep, addr)->peer_addr == RXD_ADDR_INVALID &&
-	    dlist_empty(&(rxd_peer(ep, addr)->unacked)))
+	    dlist_empty(&(rxd_peer(ep, addr)->rdg.unacked)))
 		return rxd_ep_send_rts(ep, addr);
 	return 0;
 }
@@ -557,10 +749,17 @@ size_t rxd_init_msg(void **ptr, const struct iovec *iov, size_t iov_count,
 	return done;
 }
 
+/*
+ * The ack carries the next sequence number expected and the packets held
+ * past it as ranges; anything past the last range is resent by the peer.
+ */
 void rxd_ep_send_ack(struct rxd_ep *rxd_ep, fi_addr_t peer)
 {
+	struct ofi_rdg_range range[RXD_ACK_RANGES];
 	struct rxd_pkt_entry *pkt_entry;
+	struct rxd_peer *peer_entry = rxd_peer(rxd_ep, peer);
 	struct rxd_ack_pkt *ack;
+	uint32_t i;
 
 	pkt_entry = rxd_get_tx_pkt(rxd_ep);
 	if (!pkt_entry) {
@@ -569,15 +768,23 @@ void rxd_ep_send_ack(struct rxd_ep *rxd_ep, fi_addr_t peer)
 	}
 
 	ack = (struct rxd_ack_pkt *) (pkt_entry->pkt);
-	pkt_entry->pkt_size = sizeof(*ack) + rxd_ep->tx_prefix_size;
 	pkt_entry->peer = peer;
 
 	ack->base_hdr.version = RXD_PROTOCOL_VERSION;
 	ack->base_hdr.type = RXD_ACK;
-	ack->base_hdr.peer = (uint32_t) rxd_peer(rxd_ep, peer)->peer_addr;
-	ack->base_hdr.seq_no = rxd_peer(rxd_ep, peer)->rx_seq_no;
-	ack->ext_hdr.rx_id = rxd_peer(rxd_ep, peer)->rx_window;
-	rxd_peer(rxd_ep, peer)->last_tx_ack = ack->base_hdr.seq_no;
+	ack->base_hdr.peer = (uint32_t) peer_entry->peer_addr;
+	ack->base_hdr.seq_no = peer_entry->rdg.rx_seq_no;
+	ack->ext_hdr.rx_id = peer_entry->rx_window;
+	ack->ext_hdr.seg_no = ofi_rdg_ack_ranges(&peer_entry->rdg, range,
+						 RXD_ACK_RANGES);
+	for (i = 0; i < ack->ext_hdr.seg_no; i++) {
+		ack->range[i].start = range[i].start;
+		ack->range[i].len = range[i].len;
+	}
+	pkt_entry->pkt_size = sizeof(*ack) - sizeof(ack->range) +
+			      ack->ext_hdr.seg_no * sizeof(*ack->range) +
+			      rxd_ep->tx_prefix_size;
+	ofi_rdg_ack_sent(&rxd_ep->rdg, &peer_entry->rdg);
 
 	dlist_insert_tail(&pkt_entry->d_entry, &rxd_ep->ctrl_pkts);
 	if (rxd_ep_send_pkt(rxd_ep, pkt_entry))
@@ -601,15 +808,9 @@ static void rxd_ep_free_res(struct rxd_ep *ep)
 
 static void rxd_close_peer(struct rxd_ep *ep, struct rxd_peer *peer)
 {
-	struct rxd_pkt_entry *pkt_entry;
 	struct rxd_x_entry *x_entry;
 
-	while (!dlist_empty(&peer->unacked)) {
-		dlist_pop_front(&peer->unacked, struct rxd_pkt_entry,
-				pkt_entry, d_entry);
-		ofi_buf_free(pkt_entry);
-		peer->unacked_cnt--;
-	}
+	ofi_rdg_peer_flush(&ep->rdg, &peer->rdg);
 
 	while (!dlist_empty(&peer->tx_list)) {
 		dlist_pop_front(&peer->tx_list, struct rxd_x_entry,
@@ -666,11 +867,15 @@ static int rxd_ep_close(struct fid *fid)
 
 	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
 
+	FI_INFO(&rxd_prov, FI_LOG_EP_CTRL, "cc %s: sent %" PRIu64
+		" packets, retransmitted %" PRIu64 "\n", rxd_cc_ops->name,
+		ofi_metric_get(&ep->tx_pkts), ofi_metric_get(&ep->retrans_pkts));
+
 	dlist_foreach_container(&ep->active_peers, struct rxd_peer, peer, entry)
 		rxd_close_peer(ep, peer);
 	dlist_foreach_container(&ep->rts_sent_list, struct rxd_peer, peer, entry)
 		rxd_close_peer(ep, peer);
-	ofi_idm_reset(&(ep->peers_idm), free);
+	ofi_rdg_close(&ep->rdg);
 
 	ret = fi_close(&ep->dg_ep->fid);
 	if (ret)
@@ -698,6 +903,8 @@ static int rxd_ep_close(struct fid *fid)
 	}
 
 	rxd_ep_free_res(ep);
+	ofi_metric_fini(&ep->retrans_pkts);
+	ofi_metric_fini(&ep->tx_pkts);
 	ofi_endpoint_close(&ep->util_ep);
 	free(ep);
 	return 0;
@@ -888,7 +1095,6 @@ static void rxd_peer_timeout(struct rxd_ep *rxd_ep, struct rxd_peer *peer)
 {
 	struct fi_cq_err_entry err_entry;
 	struct rxd_x_entry *tx_entry;
-	struct rxd_pkt_entry *pkt_entry;
 	int ret;
 
 	while (!dlist_empty(&peer->tx_list)) {
@@ -904,46 +1110,24 @@ static void rxd_peer_timeout(struct rxd_ep *rxd_ep, struct rxd_peer *peer)
 			FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "could not write error entry\n");
 	}
 
-	while (!dlist_empty(&peer->unacked)) {
-		dlist_pop_front(&peer->unacked, struct rxd_pkt_entry, pkt_entry,
-				d_entry);
-		ofi_buf_free(pkt_entry);
-	     	peer->unacked_cnt--;
-	}
-
+	ofi_rdg_peer_flush(&rxd_ep->rdg, &peer->rdg);
 	dlist_remove(&peer->entry);
 }
 
 static void rxd_progress_pkt_list(struct rxd_ep *ep, struct rxd_peer *peer)
 {
-	struct rxd_pkt_entry *pkt_entry;
-	uint64_t current;
-	ssize_t ret;
-	int retry = 0;
+	int timeout;
 
-	current = ofi_gettime_ms();
-	if (peer->retry_cnt > RXD_MAX_PKT_RETRY) {
+	if (ofi_rdg_progress_peer(&ep->rdg, &peer->rdg, ofi_gettime_us())) {
 		rxd_peer_timeout(ep, peer);
 		return;
 	}
 
-	dlist_foreach_container(&peer->unacked, struct rxd_pkt_entry,
-				pkt_entry, d_entry) {
-		if (pkt_entry->flags & (RXD_PKT_IN_USE | RXD_PKT_ACKED) ||
-		    current < rxd_get_retry_time(pkt_entry->timestamp,
-						 (uint8_t) peer->retry_cnt))
-			break;
-		retry = 1;
-		ret = rxd_ep_send_pkt(ep, pkt_entry);
-		if (ret)
-			break;
+	if (!dlist_empty(&peer->rdg.unacked)) {
+		timeout = (int) ofi_div_ceil(peer->rdg.rto, 1000);
+		ep->next_retry = ep->next_retry == -1 ? timeout :
+				 MIN(ep->next_retry, timeout);
 	}
-	if (retry)
-		peer->retry_cnt++;
-
-	if (!dlist_empty(&peer->unacked))
-		ep->next_retry = ep->next_retry == -1 ? peer->retry_cnt :
-				 MIN(ep->next_retry, peer->retry_cnt);
 }
 
 void rxd_ep_progress(struct util_ep *util_ep)
@@ -975,6 +1159,7 @@ void rxd_ep_progress(struct util_ep *util_ep)
 		else
 			rxd_handle_send_comp(ep, &cq_entry);
 	}
+	ofi_rdg_flush_acks(&ep->rdg);
 
 	if (!rxd_env.retry)
 		goto out;
@@ -987,8 +1172,22 @@ void rxd_ep_progress(struct util_ep *util_ep)
 	dlist_foreach_container_safe(&ep->active_peers, struct rxd_peer,
 				     peer, entry, tmp) {
 		rxd_progress_pkt_list(ep, peer);
-		if (dlist_empty(&peer->unacked))
-			rxd_progress_tx_list(ep, peer);
+
+		/* A paced peer may be held back with no ack outstanding to
+		 * restart it, so poll until the pacing delay has passed. */
+		if (peer->next_tx) {
+			if (ofi_gettime_us() < peer->next_tx) {
+				ep->next_retry = 0;
+				continue;
+			}
+			peer->next_tx = 0;
+		} else if (!dlist_empty(&peer->rdg.unacked)) {
+			continue;
+		}
+
+		rxd_progress_tx_list(ep, peer);
+		if (peer->next_tx)
+			ep->next_retry = 0;
 	}
 
 out:
@@ -1148,41 +1347,70 @@ err:
 
 int rxd_create_peer(struct rxd_ep *ep, uint64_t rxd_addr)
 {
-
+	struct ofi_rdg_peer *rdg_peer;
 	struct rxd_peer *peer;
+	int ret;
 
-	peer = calloc(1, sizeof(struct rxd_peer));
-	if (!peer)
-		return -FI_ENOMEM;
+	ret = ofi_rdg_peer_create(&ep->rdg, rxd_addr, &rdg_peer);
+	if (ret)
+		return ret;
 
+	peer = container_of(rdg_peer, struct rxd_peer, rdg);
+	peer->rxd_addr = rxd_addr;
 	peer->peer_addr = RXD_ADDR_INVALID;
-	peer->tx_seq_no = 0;
-	peer->rx_seq_no = 0;
-	peer->last_rx_ack = 0;
-	peer->last_tx_ack = 0;
 	peer->rx_window = (uint16_t) rxd_env.max_unacked;
 	peer->tx_window = (uint16_t) rxd_env.max_unacked;
-	peer->unacked_cnt = 0;
-	peer->retry_cnt = 0;
+	peer->next_tx = 0;
+	rxd_cc_ops->init(peer);
 	peer->active = 0;
-	dlist_init(&(peer->unacked));
 	dlist_init(&(peer->tx_list));
 	dlist_init(&(peer->rx_list));
 	dlist_init(&(peer->rma_rx_list));
 	dlist_init(&(peer->buf_pkts));
+	return 0;
+}
 
-	if (ofi_idm_set(&(ep->peers_idm), (int) rxd_addr, peer) < 0)
-		goto err;
+static ssize_t rxd_rdg_resend(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt)
+{
+	return rxd_ep_retry_pkt(container_of(rdg, struct rxd_ep, rdg),
+				container_of(pkt, struct rxd_pkt_entry, rdg));
+}
 
-	return 0;
-err:
-	free(peer);
-	return -FI_ENOMEM;
+static void rxd_rdg_release(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt)
+{
+	ofi_buf_free(container_of(pkt, struct rxd_pkt_entry, rdg));
+}
+
+static void rxd_rdg_send_ack(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer)
+{
+	rxd_ep_send_ack(container_of(rdg, struct rxd_ep, rdg),
+			container_of(peer, struct rxd_peer, rdg)->rxd_addr);
+}
+
+static void rxd_rdg_ack(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			uint32_t acked)
+{
+	rxd_cc_ops->ack(container_of(peer, struct rxd_peer, rdg), acked);
+}
+
+static void rxd_rdg_loss(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			 int timeout)
+{
+	rxd_cc_ops->loss(container_of(peer, struct rxd_peer, rdg), timeout);
 }
 
+static const struct ofi_rdg_ops rxd_rdg_ops = {
+	.resend = rxd_rdg_resend,
+	.release = rxd_rdg_release,
+	.send_ack = rxd_rdg_send_ack,
+	.ack = rxd_rdg_ack,
+	.loss = rxd_rdg_loss,
+};
+
 int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 		 struct fid_ep **ep, void *context)
 {
+	struct ofi_rdg_attr rdg_attr = { 0 };
 	struct fi_info *dg_info;
 	struct rxd_domain *rxd_domain;
 	struct rxd_ep *rxd_ep;
@@ -1208,6 +1436,9 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 
 	memcpy(dg_info->src_addr, info->src_addr, info->src_addrlen);
 	rxd_ep->do_local_mr = ofi_mr_local(dg_info);
+	rxd_ep->dg_iov_limit = dg_info->tx_attr->iov_limit;
+	rxd_ep->bulk_tx = rxd_env.bulk_rma && !rxd_ep->do_local_mr &&
+			  rxd_ep->dg_iov_limit > 1;
 
 	ret = fi_endpoint(rxd_domain->dg_domain, dg_info, &rxd_ep->dg_ep, rxd_ep);
 	if (ret)
@@ -1215,6 +1446,8 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 
 	rxd_ep->tx_prefix_size = dg_info->tx_attr->mode & FI_MSG_PREFIX ?
 				 dg_info->ep_attr->msg_prefix_size : 0;
+	rxd_ep->bulk_segs = (uint32_t) MIN(RXD_BULK_SEGS,
+				rxd_domain->max_mtu_sz / rxd_bulk_hdr_size(rxd_ep));
 	rxd_ep->rx_prefix_size = dg_info->rx_attr->mode & FI_MSG_PREFIX ?
 				 dg_info->ep_attr->msg_prefix_size : 0;
 	rxd_ep->rx_size = MIN(dg_info->rx_attr->size, info->rx_attr->size);
@@ -1230,7 +1463,19 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 	if (ret)
 		goto err3;
 
-	memset(&(rxd_ep->peers_idm), 0, sizeof(rxd_ep->peers_idm));
+	rdg_attr.peer_size = sizeof(struct rxd_peer);
+	rdg_attr.min_rto = rxd_env.min_rto;
+	rdg_attr.max_retry = RXD_MAX_PKT_RETRY;
+	rdg_attr.ack_batch = (uint32_t) MAX(rxd_env.max_unacked / 4, 1);
+	rdg_attr.ops = &rxd_rdg_ops;
+	ret = ofi_rdg_init(&rxd_ep->rdg, &rdg_attr);
+	if (ret)
+		goto err4;
+
+	ofi_metric_init(&rxd_ep->tx_pkts, &rxd_prov, "tx_pkts",
+			OFI_METRIC_COUNTER);
+	ofi_metric_init(&rxd_ep->retrans_pkts, &rxd_prov, "retrans_pkts",
+			OFI_METRIC_COUNTER);
 
 	rxd_ep->util_ep.ep_fid.fid.ops = &rxd_ep_fi_ops;
 	rxd_ep->util_ep.ep_fid.cm = &rxd_ep_cm;
@@ -1243,6 +1488,8 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 	*ep = &rxd_ep->util_ep.ep_fid;
 	return 0;
 
+err4:
+	rxd_ep_free_res(rxd_ep);
 err3:
 	fi_close(&rxd_ep->dg_ep->fid);
 err2:
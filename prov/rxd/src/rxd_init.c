@@ -43,6 +43,8 @@ struct rxd_env rxd_env = {
 	.retry		= 1,
 	.max_peers	= 1024,
 	.max_unacked	= 128,
+	.min_rto	= 1000,
+	.bulk_rma	= 1,
 };
 
 char *rxd_pkt_type_str[] = {
@@ -55,6 +57,14 @@ static void rxd_init_env(void)
 	fi_param_get_bool(&rxd_prov, "retry", &rxd_env.retry);
 	fi_param_get_int(&rxd_prov, "max_peers", &rxd_env.max_peers);
 	fi_param_get_int(&rxd_prov, "max_unacked", &rxd_env.max_unacked);
+	fi_param_get_int(&rxd_prov, "min_rto", &rxd_env.min_rto);
+	fi_param_get_str(&rxd_prov, "cc", &rxd_env.cc);
+	fi_param_get_bool(&rxd_prov, "pacing", &rxd_env.pacing);
+	fi_param_get_bool(&rxd_prov, "bulk_rma", &rxd_env.bulk_rma);
+	rxd_cc_select(rxd_env.cc);
+#if ENABLE_DEBUG
+	fi_param_get_int(&rxd_prov, "drop_rate", &rxd_env.drop_rate);
+#endif
 }
 
 void rxd_info_to_core_mr_modes(uint32_t version, const struct fi_info *hints,
@@ -147,6 +157,22 @@ RXD_INI
 			"Maximum number of peers to track (default: 1024)");
 	fi_param_define(&rxd_prov, "max_unacked", FI_PARAM_INT,
 			"Maximum number of packets to send at once (default: 128)");
+	fi_param_define(&rxd_prov, "min_rto", FI_PARAM_INT,
+			"Minimum retransmission timeout in usec (default: 1000)");
+	fi_param_define(&rxd_prov, "cc", FI_PARAM_STRING,
+			"Congestion control algorithm: aimd or none "
+			"(default: none)");
+	fi_param_define(&rxd_prov, "pacing", FI_PARAM_BOOL,
+			"Pace packets across the round trip time (default: no)");
+	fi_param_define(&rxd_prov, "bulk_rma", FI_PARAM_BOOL,
+			"Send RMA data in windows from the user buffer and "
+			"place out of order RMA data directly into the target "
+			"buffer (default: yes)");
+#if ENABLE_DEBUG
+	fi_param_define(&rxd_prov, "drop_rate", FI_PARAM_INT,
+			"Test only: drop every Nth received packet "
+			"(debug builds only, default: 0)");
+#endif
 
 	rxd_init_env();
 
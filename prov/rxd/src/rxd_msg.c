@@ -143,9 +143,7 @@ static int rxd_ep_discard_recv(struct rxd_ep *rxd_ep, void *context,
 	assert(unexp_msg->tag_hdr);
 	seq += unexp_msg->sar_hdr ? unexp_msg->sar_hdr->num_segs : 1;
 
-	rxd_peer(rxd_ep, unexp_msg->base_hdr->peer)->rx_seq_no =
-			MAX(seq, rxd_peer(rxd_ep,
-				 unexp_msg->base_hdr->peer)->rx_seq_no);
+	ofi_rdg_rx_skip(&rxd_peer(rxd_ep, unexp_msg->base_hdr->peer)->rdg, seq);
 	rxd_ep_send_ack(rxd_ep, unexp_msg->base_hdr->peer);
 
 	ret = ofi_cq_write(rxd_ep->util_ep.rx_cq, context, FI_TAGGED | FI_RECV,
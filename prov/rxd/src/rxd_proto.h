@@ -42,6 +42,7 @@
 
 #define RXD_IOV_LIMIT		4
 #define RXD_NAME_LENGTH		64
+#define RXD_ACK_RANGES		8
 
 /* Values below are part of the wire protocol
    Reserved values are unused but defined for compatibility */
@@ -118,13 +119,27 @@ struct rxd_cts_pkt {
 	uint64_t		cts_addr;
 };
 
+/*
+ * Range of packets received out of order, relative to the cumulative ack:
+ * sequence numbers seq_no + start through seq_no + start + len - 1
+ */
+struct rxd_ack_range {
+	uint32_t	start;
+	uint32_t	len;
+};
+
 /*
  * ACK: to signal received packets and send tx/rx id info
+ * 	- base_hdr.seq_no: next in-order sequence number expected (cumulative)
+ * 	- ext_hdr.rx_id: receive window available at the peer
+ * 	- ext_hdr.seg_no: number of ranges that follow
+ * 	- range: packets already received beyond the cumulative ack, in
+ * 		 increasing order; only the ranges in use are sent
  */
 struct rxd_ack_pkt {
 	struct rxd_base_hdr	base_hdr;
 	struct rxd_ext_hdr	ext_hdr;
-	//TODO fill in more fields? Selective ack?
+	struct rxd_ack_range	range[RXD_ACK_RANGES];
 };
 
 /*
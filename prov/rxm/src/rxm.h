@@ -56,6 +56,7 @@
 #include <ofi_proto.h>
 #include <ofi_iov.h>
 #include <ofi_hmem.h>
+#include <ofi_metrics.h>
 
 #ifndef _RXM_H_
 #define _RXM_H_
@@ -271,7 +272,6 @@ struct rxm_domain {
 	bool passthru;
 	struct ofi_ops_flow_ctrl *flow_ctrl_ops;
 	struct ofi_bufpool *amo_bufpool;
-	ofi_mutex_t amo_bufpool_lock;
 	struct fid_domain *util_coll_domain;
 	struct fid_domain *offload_coll_domain;
 	uint64_t offload_coll_mask;
@@ -708,6 +708,8 @@ struct rxm_ep {
 	struct rxm_pkt		*inject_pkt;
 
 	struct dlist_entry	deferred_queue;
+	/* transfers waiting in the deferred queues of all connections */
+	struct ofi_metric	deferred_depth;
 	struct dlist_entry	rndv_wait_list;
 
 	struct rxm_recv_queue	recv_queue;
@@ -817,6 +819,7 @@ rxm_queue_deferred_tx(struct rxm_deferred_tx_entry *tx_entry,
 {
 	struct rxm_conn *conn = tx_entry->rxm_conn;
 
+	ofi_metric_inc(&conn->ep->deferred_depth);
 	if (dlist_empty(&conn->deferred_tx_queue))
 		dlist_insert_tail(&conn->deferred_entry,
 				  &conn->ep->deferred_queue);
@@ -835,6 +838,7 @@ rxm_dequeue_deferred_tx(struct rxm_deferred_tx_entry *tx_entry)
 	struct rxm_conn *conn = tx_entry->rxm_conn;
 
 	assert(!dlist_empty(&conn->deferred_tx_queue));
+	ofi_metric_dec(&conn->ep->deferred_depth);
 	dlist_remove(&tx_entry->entry);
 	if (dlist_empty(&conn->deferred_tx_queue))
 		dlist_remove_init(&conn->deferred_entry);
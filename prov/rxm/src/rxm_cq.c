@@ -191,6 +191,24 @@ rxm_cq_write_tx_comp(struct rxm_ep *rxm_ep, uint64_t comp_flags,
 	}
 }
 
+/* Route completions of peer transfers issued by util_coll back to it */
+static void
+rxm_cq_write_tx_comp_tag(struct rxm_ep *rxm_ep, uint64_t comp_flags,
+			 void *app_context, uint64_t flags, uint64_t tag)
+{
+	if (rxm_ep->util_coll_ep && (tag & RXM_PEER_XFER_TAG_FLAG)) {
+		struct fi_cq_tagged_entry cqe = {
+			.tag = tag,
+			.op_context = app_context,
+		};
+		rxm_ep->util_coll_peer_xfer_ops->
+			complete(rxm_ep->util_coll_ep, &cqe, 0);
+		return;
+	}
+
+	rxm_cq_write_tx_comp(rxm_ep, comp_flags, app_context, flags);
+}
+
 static void rxm_finish_rma(struct rxm_ep *rxm_ep, struct rxm_tx_buf *rma_buf,
 			  uint64_t comp_flags)
 {
@@ -249,16 +267,18 @@ static void rxm_handle_sar_comp(struct rxm_ep *rxm_ep,
 				struct rxm_tx_buf *tx_buf)
 {
 	void *app_context;
-	uint64_t comp_flags, tx_flags;
+	uint64_t comp_flags, tx_flags, tag;
 
 	app_context = tx_buf->app_context;
 	comp_flags = ofi_tx_cq_flags(tx_buf->pkt.hdr.op);
 	tx_flags = tx_buf->flags;
+	tag = tx_buf->pkt.hdr.tag;
 
 	if (!rxm_complete_sar(rxm_ep, tx_buf))
 		return;
 
-	rxm_cq_write_tx_comp(rxm_ep, comp_flags, app_context, tx_flags);
+	rxm_cq_write_tx_comp_tag(rxm_ep, comp_flags, app_context, tx_flags,
+				 tag);
 	ofi_ep_tx_cntr_inc(&rxm_ep->util_ep);
 }
 
@@ -287,8 +307,9 @@ static void rxm_rndv_tx_finish(struct rxm_ep *rxm_ep,
 	if (!rxm_ep->rdm_mr_local)
 		rxm_msg_mr_closev(tx_buf->rma.mr, tx_buf->rma.count);
 
-	rxm_cq_write_tx_comp(rxm_ep, ofi_tx_cq_flags(tx_buf->pkt.hdr.op),
-			     tx_buf->app_context, tx_buf->flags);
+	rxm_cq_write_tx_comp_tag(rxm_ep, ofi_tx_cq_flags(tx_buf->pkt.hdr.op),
+				 tx_buf->app_context, tx_buf->flags,
+				 tx_buf->pkt.hdr.tag);
 
 	if (rxm_ep->rndv_ops == &rxm_rndv_ops_write &&
 	    tx_buf->write_rndv.done_buf) {
@@ -1121,10 +1142,7 @@ static int rxm_do_device_mem_atomic(struct rxm_mr *dev_mr, uint8_t op,
 		.iov_len = amo_op_size,
 	};
 
-	ofi_mutex_lock(&dom->amo_bufpool_lock);
 	tx_buf = ofi_buf_alloc(dom->amo_bufpool);
-	ofi_mutex_unlock(&dom->amo_bufpool_lock);
-
 	if (!tx_buf)
 		return -FI_ENOMEM;
 
@@ -1142,10 +1160,7 @@ static int rxm_do_device_mem_atomic(struct rxm_mr *dev_mr, uint8_t op,
 
 	ofi_mutex_unlock(&dev_mr->amo_lock);
 
-	ofi_mutex_lock(&dom->amo_bufpool_lock);
 	ofi_buf_free(tx_buf);
-	ofi_mutex_unlock(&dom->amo_bufpool_lock);
-
 	return FI_SUCCESS;
 }
 
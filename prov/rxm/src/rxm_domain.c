@@ -400,7 +400,6 @@ static int rxm_domain_close(fid_t fid)
 
 	rxm_domain = container_of(fid, struct rxm_domain, util_domain.domain_fid.fid);
 
-	ofi_mutex_destroy(&rxm_domain->amo_bufpool_lock);
 	ofi_bufpool_destroy(rxm_domain->amo_bufpool);
 
 	ret = fi_close(&rxm_domain->msg_domain->fid);
@@ -946,13 +945,13 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 	(*domain)->fid.ops = &rxm_domain_fi_ops;
 	(*domain)->ops = &rxm_domain_ops;
 
+	/* Shared by all endpoints of the domain, which may run on any thread */
 	ret = ofi_bufpool_create(&rxm_domain->amo_bufpool,
-				 rxm_domain->max_atomic_size, 64, 0, 0, 0);
+				 rxm_domain->max_atomic_size, 64, 0, 0,
+				 OFI_BUFPOOL_THREAD_CACHE);
 	if (ret)
 		goto err5;
 
-	ofi_mutex_init(&rxm_domain->amo_bufpool_lock);
-
 	rxm_domain->passthru = rxm_passthru_info(info);
 	if (rxm_domain->passthru)
 		(*domain)->mr = &rxm_domain_mr_thru_ops;
@@ -969,7 +968,6 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 	return 0;
 
 err6:
-	ofi_mutex_destroy(&rxm_domain->amo_bufpool_lock);
 	ofi_bufpool_destroy(rxm_domain->amo_bufpool);
 err5:
 	if (rxm_domain->offload_coll_domain)
@@ -349,6 +349,7 @@ static void rxm_ep_txrx_res_close(struct rxm_ep *ep)
 {
 	rxm_recv_queue_close(&ep->trecv_queue);
 	rxm_recv_queue_close(&ep->recv_queue);
+	ofi_metric_fini(&ep->deferred_depth);
 
 	if (ep->multi_recv_pool) {
 		ofi_bufpool_destroy(ep->multi_recv_pool);
@@ -1526,6 +1527,8 @@ static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
 		return ret;
 
 	dlist_init(&rxm_ep->deferred_queue);
+	ofi_metric_init(&rxm_ep->deferred_depth, &rxm_prov, "deferred_tx",
+			OFI_METRIC_GAUGE);
 
 	ret = rxm_ep_rx_queue_init(rxm_ep);
 	if (ret)
@@ -1533,6 +1536,7 @@ static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
 
 	return FI_SUCCESS;
 err:
+	ofi_metric_fini(&rxm_ep->deferred_depth);
 	ofi_bufpool_destroy(rxm_ep->coll_pool);
 	ofi_bufpool_destroy(rxm_ep->rx_pool);
 	ofi_bufpool_destroy(rxm_ep->tx_pool);
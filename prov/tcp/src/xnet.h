@@ -60,6 +60,7 @@
 #include <ofi_util.h>
 #include <ofi_proto.h>
 #include <ofi_net.h>
+#include <ofi_metrics.h>
 
 #include "xnet_proto.h"
 
@@ -315,6 +316,9 @@ struct xnet_progress {
 	struct dlist_entry	unexp_msg_list;
 	struct dlist_entry	unexp_tag_list;
 	struct dlist_entry	saved_tag_list;
+	/* eps on the unexpected lists, and how often one was added */
+	struct ofi_metric	unexp_eps;
+	struct ofi_metric	unexp_cnt;
 	struct fd_signal	signal;
 
 	struct slist		event_list;
@@ -649,6 +653,23 @@ static inline bool xnet_has_unexp(struct xnet_ep *ep)
 	return ep->cur_rx.handler && !ep->cur_rx.entry;
 }
 
+static inline void xnet_insert_unexp(struct xnet_ep *ep, struct dlist_entry *list)
+{
+	struct xnet_progress *progress = xnet_ep2_progress(ep);
+
+	assert(dlist_empty(&ep->unexp_entry));
+	dlist_insert_tail(&ep->unexp_entry, list);
+	ofi_metric_inc(&progress->unexp_eps);
+	ofi_metric_inc(&progress->unexp_cnt);
+}
+
+static inline void xnet_remove_unexp(struct xnet_ep *ep)
+{
+	assert(!dlist_empty(&ep->unexp_entry));
+	dlist_remove_init(&ep->unexp_entry);
+	ofi_metric_dec(&xnet_ep2_progress(ep)->unexp_eps);
+}
+
 void xnet_recv_saved(struct xnet_xfer_entry *saved_entry,
 		     struct xnet_xfer_entry *rx_entry);
 void xnet_complete_saved(struct xnet_xfer_entry *saved_entry);
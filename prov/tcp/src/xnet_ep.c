@@ -391,7 +391,8 @@ void xnet_ep_disable(struct xnet_ep *ep, int cm_err, void* err_data,
 		return;
 	};
 
-	dlist_remove_init(&ep->unexp_entry);
+	if (!dlist_empty(&ep->unexp_entry))
+		xnet_remove_unexp(ep);
 	xnet_halt_sock(xnet_ep2_progress(ep), ep->bsock.sock);
 
 	ret = ofi_shutdown(ep->bsock.sock, SHUT_RDWR);
@@ -542,7 +543,8 @@ static int xnet_ep_close(struct fid *fid)
 
 	progress = xnet_ep2_progress(ep);
 	ofi_genlock_lock(&progress->lock);
-	dlist_remove_init(&ep->unexp_entry);
+	if (!dlist_empty(&ep->unexp_entry))
+		xnet_remove_unexp(ep);
 	xnet_halt_sock(progress, ep->bsock.sock);
 	xnet_ep_flush_all_queues(ep);
 	ofi_genlock_unlock(&progress->lock);
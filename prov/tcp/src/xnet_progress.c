@@ -550,7 +550,7 @@ int xnet_start_recv(struct xnet_ep *ep, struct xnet_xfer_entry *rx_entry)
 
 	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
 	if (!dlist_empty(&ep->unexp_entry)) {
-		dlist_remove_init(&ep->unexp_entry);
+		xnet_remove_unexp(ep);
 		xnet_update_pollflag(ep, POLLIN, true);
 	}
 
@@ -601,8 +601,7 @@ static int xnet_op_msg(struct xnet_ep *ep)
 	rx_entry = xnet_get_rx_entry(ep);
 	if (!rx_entry) {
 		if (dlist_empty(&ep->unexp_entry)) {
-			dlist_insert_tail(&ep->unexp_entry,
-					  &xnet_ep2_progress(ep)->unexp_msg_list);
+			xnet_insert_unexp(ep, &xnet_ep2_progress(ep)->unexp_msg_list);
 			xnet_update_pollflag(ep, POLLIN, false);
 		}
 		return -FI_EAGAIN;
@@ -631,8 +630,7 @@ static int xnet_op_tagged(struct xnet_ep *ep)
 				goto start;
 		}
 		if (dlist_empty(&ep->unexp_entry)) {
-			dlist_insert_tail(&ep->unexp_entry,
-					  &xnet_ep2_progress(ep)->unexp_tag_list);
+			xnet_insert_unexp(ep, &xnet_ep2_progress(ep)->unexp_tag_list);
 			xnet_update_pollflag(ep, POLLIN, false);
 		}
 		return -FI_EAGAIN;
@@ -1497,6 +1495,11 @@ int xnet_init_progress(struct xnet_progress *progress, struct fi_info *info)
 	if (ret)
 		return ret;
 
+	ofi_metric_init(&progress->unexp_eps, &xnet_prov, "unexp_eps",
+			OFI_METRIC_GAUGE);
+	ofi_metric_init(&progress->unexp_cnt, &xnet_prov, "unexp_msgs",
+			OFI_METRIC_COUNTER);
+
 	ret = xnet_init_locks(progress, info);
 	if (ret)
 		goto err1;
@@ -1559,6 +1562,8 @@ err2:
 	ofi_genlock_destroy(&progress->rdm_lock);
 	ofi_genlock_destroy(&progress->lock);
 err1:
+	ofi_metric_fini(&progress->unexp_cnt);
+	ofi_metric_fini(&progress->unexp_eps);
 	fd_signal_free(&progress->signal);
 	return ret;
 }
@@ -1579,5 +1584,7 @@ void xnet_close_progress(struct xnet_progress *progress)
 	ofi_bufpool_destroy(progress->xfer_pool);
 	ofi_genlock_destroy(&progress->lock);
 	ofi_genlock_destroy(&progress->rdm_lock);
+	ofi_metric_fini(&progress->unexp_cnt);
+	ofi_metric_fini(&progress->unexp_eps);
 	fd_signal_free(&progress->signal);
 }
@@ -15,5 +15,11 @@ AC_DEFUN([FI_UDP_CONFIGURE],[
 	                       [udp_h_happy=0])
 	      ])
 
+	AS_IF([test $udp_h_happy -eq 1],
+	      [AC_CHECK_FUNCS([sendmmsg recvmmsg])
+	       AC_CHECK_DECLS([UDP_SEGMENT, UDP_GRO], [], [],
+			      [#include <netinet/udp.h>])
+	      ])
+
 	AS_IF([test $udp_h_happy -eq 1], [$1], [$2])
 ])
@@ -55,6 +55,7 @@
 
 #include <ofi.h>
 #include <ofi_enosys.h>
+#include <ofi_iov.h>
 #include <ofi_rbuf.h>
 #include <ofi_list.h>
 #include <ofi_signal.h>
@@ -79,6 +80,17 @@ int udpx_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
 
 #define UDPX_FLAG_MULTI_RECV	1
 #define UDPX_IOV_LIMIT		4
+#define UDPX_INJECT_SIZE	1472
+#define UDPX_MMSG_BATCH		32
+#define UDPX_GSO_MAX_SEGS	64
+#define UDPX_GSO_MAX_SIZE	65507
+
+struct udpx_env {
+	int	gso;
+	int	gro;
+};
+
+extern struct udpx_env udpx_env;
 
 struct udpx_ep_entry {
 	void			*context;
@@ -90,6 +102,26 @@ struct udpx_ep_entry {
 
 OFI_DECLARE_CIRQUE(struct udpx_ep_entry, udpx_rx_cirq);
 
+/*
+ * Sends are queued and written to the socket in batches, either when the
+ * queue fills or when the endpoint is progressed.
+ */
+struct udpx_tx_entry {
+	void			*context;
+	struct iovec		iov[UDPX_IOV_LIMIT];
+	uint8_t			iov_count;
+	uint8_t			resv[sizeof(size_t) - 1];
+	size_t			len;
+	socklen_t		addrlen;
+	union {
+		struct sockaddr		sa;
+		struct sockaddr_in	sin;
+		struct sockaddr_in6	sin6;
+	} addr;
+};
+
+OFI_DECLARE_CIRQUE(struct udpx_tx_entry, udpx_tx_cirq);
+
 struct udpx_ep;
 typedef void (*udpx_rx_comp_func)(struct udpx_ep *ep, void *context,
 		uint64_t flags, size_t len, void *buf, void *addr);
@@ -100,8 +132,18 @@ struct udpx_ep {
 	udpx_rx_comp_func	rx_comp;
 	udpx_tx_comp_func	tx_comp;
 	struct udpx_rx_cirq	*rxq;    /* protected by rx_cq lock */
+	struct udpx_tx_cirq	*txq;    /* protected by tx_cq lock */
 	SOCKET			sock;
 	int			is_bound;
+	int			gso;
+	int			gro;
+	struct iovec		*tx_iov;
+	/* datagrams received with GRO and not yet copied out */
+	void			*gro_buf;
+	size_t			gro_off;
+	size_t			gro_len;
+	size_t			gro_seg;
+	struct sockaddr_in6	gro_addr;
 	ofi_atomic32_t		ref;
 };
 
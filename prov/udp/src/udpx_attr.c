@@ -34,12 +34,12 @@
 
 #define UDPX_TX_CAPS (OFI_TX_MSG_CAPS | FI_MULTICAST)
 #define UDPX_RX_CAPS (FI_SOURCE | OFI_RX_MSG_CAPS)
-#define UDPX_DOMAIN_CAPS (FI_LOCAL_COMM | FI_REMOTE_COMM)
+#define UDPX_DOMAIN_CAPS (FI_LOCAL_COMM | FI_REMOTE_COMM | FI_SHARED_AV)
 
 struct fi_tx_attr udpx_tx_attr = {
 	.caps = UDPX_TX_CAPS,
 	.comp_order = FI_ORDER_STRICT,
-	.inject_size = 1472,
+	.inject_size = UDPX_INJECT_SIZE,
 	.size = 1024,
 	.iov_limit = UDPX_IOV_LIMIT
 };
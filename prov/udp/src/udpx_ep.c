@@ -35,6 +35,17 @@
 
 #include "udpx.h"
 
+#if HAVE_DECL_UDP_SEGMENT || HAVE_DECL_UDP_GRO
+#include <netinet/udp.h>
+#endif
+
+#if HAVE_DECL_UDP_SEGMENT
+#define UDPX_CTRL_SIZE		CMSG_SPACE(sizeof(uint16_t))
+#else
+#define UDPX_CTRL_SIZE		1
+#endif
+#define UDPX_GRO_BUF_SIZE	(1 << 16)
+
 
 static int udpx_setname(fid_t fid, void *addr, size_t addrlen)
 {
@@ -270,34 +281,374 @@ static void udpx_rx_src_comp_signal(struct udpx_ep *ep, void *context,
 	ep->util_ep.rx_cq->wait->signal(ep->util_ep.rx_cq->wait);
 }
 
-static void udpx_ep_progress(struct util_ep *util_ep)
+#if HAVE_SENDMMSG && HAVE_RECVMMSG
+#define udpx_mmsghdr mmsghdr
+#else
+struct udpx_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+#endif
+
+static int udpx_sendmmsg(SOCKET sock, struct udpx_mmsghdr *msgs,
+			 unsigned int cnt)
+{
+#if HAVE_SENDMMSG && HAVE_RECVMMSG
+	return sendmmsg(sock, msgs, cnt, 0);
+#else
+	unsigned int i;
+	ssize_t ret;
+
+	for (i = 0; i < cnt; i++) {
+		ret = ofi_sendmsg_udp(sock, &msgs[i].msg_hdr, 0);
+		if (ret < 0)
+			return i ? (int) i : -1;
+		msgs[i].msg_len = (unsigned int) ret;
+	}
+	return (int) cnt;
+#endif
+}
+
+static int udpx_recvmmsg(SOCKET sock, struct udpx_mmsghdr *msgs,
+			 unsigned int cnt)
+{
+#if HAVE_SENDMMSG && HAVE_RECVMMSG
+	return recvmmsg(sock, msgs, cnt, 0, NULL);
+#else
+	unsigned int i;
+	ssize_t ret;
+
+	for (i = 0; i < cnt; i++) {
+		ret = ofi_recvmsg_udp(sock, &msgs[i].msg_hdr, 0);
+		if (ret < 0)
+			return i ? (int) i : -1;
+		msgs[i].msg_len = (unsigned int) ret;
+	}
+	return (int) cnt;
+#endif
+}
+
+#define udpx_rxq_entry(ep, i) \
+	(&(ep)->rxq->buf[((ep)->rxq->rcnt + (i)) & (ep)->rxq->size_mask])
+#define udpx_txq_entry(ep, i) \
+	(&(ep)->txq->buf[((ep)->txq->rcnt + (i)) & (ep)->txq->size_mask])
+
+#if HAVE_DECL_UDP_SEGMENT
+/*
+ * Coalesce queued sends that follow the entry at index into a single
+ * GSO message.  The kernel splits the payload back into gso_size
+ * datagrams, so every send but the last must be exactly gso_size bytes.
+ */
+static size_t udpx_gso_gather(struct udpx_ep *ep, size_t index, size_t avail,
+			      struct msghdr *hdr, size_t slot, char *ctrl)
+{
+	struct udpx_tx_entry *first, *entry;
+	struct cmsghdr *cmsg;
+	struct iovec *iov;
+	uint16_t gso_size;
+	size_t segs, len;
+
+	iov = &ep->tx_iov[slot * UDPX_GSO_MAX_SEGS];
+	first = udpx_txq_entry(ep, index);
+	if (first->iov_count != 1 || !first->len)
+		return 1;
+
+	iov[0] = first->iov[0];
+	len = first->len;
+	for (segs = 1; segs < UDPX_GSO_MAX_SEGS && index + segs < avail;
+	     segs++) {
+		entry = udpx_txq_entry(ep, index + segs);
+		if (entry->iov_count != 1 || entry->len > first->len ||
+		    len + entry->len > UDPX_GSO_MAX_SIZE ||
+		    entry->addrlen != first->addrlen ||
+		    memcmp(&entry->addr, &first->addr, first->addrlen))
+			break;
+
+		iov[segs] = entry->iov[0];
+		len += entry->len;
+		if (entry->len < first->len) {
+			segs++;
+			break;
+		}
+	}
+
+	if (segs == 1)
+		return 1;
+
+	gso_size = (uint16_t) first->len;
+	hdr->msg_iov = iov;
+	hdr->msg_iovlen = segs;
+	hdr->msg_control = ctrl;
+	hdr->msg_controllen = CMSG_SPACE(sizeof(gso_size));
+	cmsg = CMSG_FIRSTHDR(hdr);
+	cmsg->cmsg_level = IPPROTO_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(gso_size));
+	memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+	return segs;
+}
+#endif
+
+/* Returns the number of queued sends carried by the message. */
+static size_t udpx_tx_gather(struct udpx_ep *ep, size_t index, size_t avail,
+			     struct msghdr *hdr, size_t slot, char *ctrl)
+{
+	struct udpx_tx_entry *entry;
+
+	entry = udpx_txq_entry(ep, index);
+	hdr->msg_name = &entry->addr;
+	hdr->msg_namelen = entry->addrlen;
+	hdr->msg_iov = entry->iov;
+	hdr->msg_iovlen = entry->iov_count;
+	hdr->msg_control = NULL;
+	hdr->msg_controllen = 0;
+	hdr->msg_flags = 0;
+
+#if HAVE_DECL_UDP_SEGMENT
+	if (ep->gso)
+		return udpx_gso_gather(ep, index, avail, hdr, slot, ctrl);
+#endif
+	return 1;
+}
+
+/*
+ * Write queued sends to the socket, limited by the space left in the
+ * CQ.  On a failure other than a full socket buffer, the failed send is
+ * removed from the queue and its context returned, so that the caller
+ * can report the error once the CQ lock is released.
+ */
+static int udpx_flush_tx(struct udpx_ep *ep, void **err_context)
+{
+	struct udpx_mmsghdr msgs[UDPX_MMSG_BATCH];
+	char ctrl[UDPX_MMSG_BATCH][UDPX_CTRL_SIZE];
+	size_t segs[UDPX_MMSG_BATCH];
+	struct udpx_tx_entry *entry;
+	size_t avail, index, i, j;
+	unsigned int cnt;
+	int ret;
+
+	for (;;) {
+		avail = MIN(ofi_cirque_usedcnt(ep->txq),
+			    ofi_cirque_freecnt(ep->util_ep.tx_cq->cirq));
+		if (!avail)
+			return 0;
+
+		for (cnt = 0, index = 0; cnt < UDPX_MMSG_BATCH && index < avail;
+		     cnt++) {
+			segs[cnt] = udpx_tx_gather(ep, index, avail,
+					&msgs[cnt].msg_hdr, cnt, ctrl[cnt]);
+			index += segs[cnt];
+		}
+
+		ret = udpx_sendmmsg(ep->sock, msgs, cnt);
+		if (ret < 0) {
+			if (OFI_SOCK_TRY_SND_RCV_AGAIN(errno))
+				return 0;
+
+			if (segs[0] > 1) {
+				FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+					"GSO send failed (%s), disabling\n",
+					strerror(errno));
+				ep->gso = 0;
+				continue;
+			}
+
+			ret = -errno;
+			entry = ofi_cirque_head(ep->txq);
+			*err_context = entry->context;
+			ofi_cirque_discard(ep->txq);
+			return ret;
+		}
+
+		for (i = 0; i < (size_t) ret; i++) {
+			for (j = 0; j < segs[i]; j++) {
+				entry = ofi_cirque_head(ep->txq);
+				ep->tx_comp(ep, entry->context);
+				ofi_cirque_discard(ep->txq);
+			}
+		}
+
+		if ((unsigned int) ret < cnt)
+			return 0;
+	}
+}
+
+static void udpx_progress_tx(struct udpx_ep *ep)
+{
+	struct fi_cq_err_entry err_entry;
+	void *context;
+	int ret;
+
+	do {
+		ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
+		ret = udpx_flush_tx(ep, &context);
+		ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
+		if (!ret)
+			break;
+
+		memset(&err_entry, 0, sizeof err_entry);
+		err_entry.op_context = context;
+		err_entry.flags = FI_SEND;
+		err_entry.err = -ret;
+		err_entry.prov_errno = ret;
+		if (ofi_cq_write_error(ep->util_ep.tx_cq, &err_entry))
+			FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+				"unable to report send error\n");
+	} while (ret);
+}
+
+static void udpx_progress_rx(struct udpx_ep *ep, size_t cnt)
+{
+	struct udpx_mmsghdr msgs[UDPX_MMSG_BATCH];
+	struct sockaddr_in6 addr[UDPX_MMSG_BATCH];
+	struct udpx_ep_entry *entry;
+	struct msghdr *hdr;
+	int i, ret;
+
+	cnt = MIN(cnt, UDPX_MMSG_BATCH);
+	for (i = 0; i < (int) cnt; i++) {
+		entry = udpx_rxq_entry(ep, i);
+		hdr = &msgs[i].msg_hdr;
+		hdr->msg_name = &addr[i];
+		hdr->msg_namelen = sizeof(addr[i]);
+		hdr->msg_iov = entry->iov;
+		hdr->msg_iovlen = entry->iov_count;
+		hdr->msg_control = NULL;
+		hdr->msg_controllen = 0;
+		hdr->msg_flags = 0;
+	}
+
+	ret = udpx_recvmmsg(ep->sock, msgs, (unsigned int) cnt);
+	for (i = 0; i < ret; i++) {
+		entry = ofi_cirque_head(ep->rxq);
+		ep->rx_comp(ep, entry->context, 0, msgs[i].msg_len, NULL,
+			    &addr[i]);
+		ofi_cirque_discard(ep->rxq);
+	}
+}
+
+#if HAVE_DECL_UDP_GRO
+/*
+ * Datagrams already queued on the socket stay coalesced, and the kernel
+ * only reports their segment size while UDP_GRO is set.  The option is
+ * therefore cleared once the socket has been drained.
+ */
+static void udpx_disable_gro(struct udpx_ep *ep)
+{
+	int val = 0;
+
+	if (setsockopt(ep->sock, IPPROTO_UDP, UDP_GRO, &val, sizeof(val))) {
+		FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+			"unable to disable UDP_GRO (%s)\n", strerror(errno));
+		return;
+	}
+	free(ep->gro_buf);
+	ep->gro_buf = NULL;
+}
+
+/*
+ * Copy the datagrams left in the GRO buffer into posted receives, one
+ * datagram per receive.  Returns the number of receives still available.
+ */
+static size_t udpx_gro_deliver(struct udpx_ep *ep, size_t cnt)
 {
-	struct udpx_ep *ep;
 	struct udpx_ep_entry *entry;
+	size_t len, seg;
+
+	for (; cnt && ep->gro_off < ep->gro_len; cnt--) {
+		entry = ofi_cirque_head(ep->rxq);
+		seg = MIN(ep->gro_seg, ep->gro_len - ep->gro_off);
+		if (ep->gro &&
+		    ofi_total_iov_len(entry->iov, entry->iov_count) < seg) {
+			FI_INFO(&udpx_prov, FI_LOG_EP_DATA,
+				"receive buffer smaller than GRO segment, "
+				"disabling GRO\n");
+			ep->gro = 0;
+		}
+
+		len = ofi_copy_to_iov(entry->iov, entry->iov_count, 0,
+				      (char *) ep->gro_buf + ep->gro_off, seg);
+		ep->rx_comp(ep, entry->context, 0, len, NULL, &ep->gro_addr);
+		ofi_cirque_discard(ep->rxq);
+		ep->gro_off += seg;
+	}
+	return cnt;
+}
+
+/*
+ * With GRO, the kernel may hand back several datagrams from the same
+ * source as one buffer.  Split it at the reported segment size and
+ * complete one posted receive per datagram.  Datagrams without a posted
+ * receive stay in the buffer until more receives are posted.
+ */
+static void udpx_progress_gro(struct udpx_ep *ep, size_t cnt)
+{
+	char ctrl[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr *cmsg;
 	struct msghdr hdr;
-	struct sockaddr_in6 addr;
+	struct iovec iov;
 	ssize_t ret;
+	int gso_size;
+
+	while ((cnt = udpx_gro_deliver(ep, cnt))) {
+		iov.iov_base = ep->gro_buf;
+		iov.iov_len = UDPX_GRO_BUF_SIZE;
+		hdr.msg_name = &ep->gro_addr;
+		hdr.msg_namelen = sizeof(ep->gro_addr);
+		hdr.msg_iov = &iov;
+		hdr.msg_iovlen = 1;
+		hdr.msg_control = ctrl;
+		hdr.msg_controllen = sizeof(ctrl);
+		hdr.msg_flags = 0;
+
+		ret = ofi_recvmsg_udp(ep->sock, &hdr, 0);
+		if (ret < 0) {
+			if (!ep->gro)
+				udpx_disable_gro(ep);
+			return;
+		}
+
+		ep->gro_off = 0;
+		ep->gro_len = (size_t) ret;
+		ep->gro_seg = (size_t) ret;
+		for (cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+		     cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+			if (cmsg->cmsg_level == IPPROTO_UDP &&
+			    cmsg->cmsg_type == UDP_GRO) {
+				memcpy(&gso_size, CMSG_DATA(cmsg),
+				       sizeof(gso_size));
+				ep->gro_seg = (size_t) gso_size;
+			}
+		}
+	}
+}
+#endif
+
+static void udpx_ep_progress(struct util_ep *util_ep)
+{
+	struct udpx_ep *ep;
+	size_t cnt;
 
 	ep = container_of(util_ep, struct udpx_ep, util_ep);
-	hdr.msg_name = &addr;
-	hdr.msg_namelen = sizeof(addr);
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
+	if (ep->util_ep.tx_cq)
+		udpx_progress_tx(ep);
+
+	if (!ep->util_ep.rx_cq)
+		return;
 
 	ofi_genlock_lock(&ep->util_ep.rx_cq->cq_lock);
-	if (ofi_cirque_isempty(ep->rxq))
+	cnt = MIN(ofi_cirque_usedcnt(ep->rxq),
+		  ofi_cirque_freecnt(ep->util_ep.rx_cq->cirq));
+	if (!cnt)
 		goto out;
 
-	entry = ofi_cirque_head(ep->rxq);
-	hdr.msg_iov = entry->iov;
-	hdr.msg_iovlen = entry->iov_count;
-
-	ret = ofi_recvmsg_udp(ep->sock, &hdr, 0);
-	if (ret >= 0) {
-		ep->rx_comp(ep, entry->context, 0, ret, NULL, &addr);
-		ofi_cirque_discard(ep->rxq);
+#if HAVE_DECL_UDP_GRO
+	if (ep->gro_buf) {
+		udpx_progress_gro(ep, cnt);
+		goto out;
 	}
+#endif
+	udpx_progress_rx(ep, cnt);
 out:
 	ofi_genlock_unlock(&ep->util_ep.rx_cq->cq_lock);
 }
@@ -387,30 +738,92 @@ udpx_dest_addrlen(struct udpx_ep *ep, fi_addr_t addr, uint64_t flags)
 		ep->util_ep.av->addrlen;
 }
 
-static ssize_t udpx_sendto(struct udpx_ep *ep, const void *buf, size_t len,
-			   const void *addr, size_t addrlen, void *context)
+/* Sends are written to the socket as soon as they are posted, unless the
+ * caller passes FI_MORE, in which case they are held until a post without
+ * FI_MORE, a full batch, or the next progress call.
+ */
+static ssize_t udpx_queue_tx(struct udpx_ep *ep, const struct iovec *iov,
+			     size_t iov_count, const void *addr, size_t addrlen,
+			     void *context, uint64_t flags)
 {
+	struct udpx_tx_entry *entry;
+	int flush;
 	ssize_t ret;
 
+	if (iov_count > UDPX_IOV_LIMIT || addrlen > sizeof(entry->addr))
+		return -FI_EINVAL;
+
 	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+	if (ofi_cirque_isfull(ep->txq)) {
 		ret = -FI_EAGAIN;
 		goto out;
 	}
 
-	ret = ofi_sendto_socket(ep->sock, buf, len, 0,
-				addr, (socklen_t)addrlen);
-	if (ret == (ssize_t)len) {
-		ep->tx_comp(ep, context);
-		ret = 0;
-	} else {
+	entry = ofi_cirque_next(ep->txq);
+	entry->context = context;
+	entry->len = 0;
+	for (entry->iov_count = 0; entry->iov_count < iov_count;
+	     entry->iov_count++) {
+		entry->iov[entry->iov_count] = iov[entry->iov_count];
+		entry->len += iov[entry->iov_count].iov_len;
+	}
+	entry->addrlen = (socklen_t) addrlen;
+	memcpy(&entry->addr, addr, addrlen);
+	ofi_cirque_commit(ep->txq);
+	ret = 0;
+out:
+	flush = !(flags & FI_MORE) ||
+		ofi_cirque_usedcnt(ep->txq) >= UDPX_MMSG_BATCH;
+	ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
+
+	if (flush)
+		udpx_progress_tx(ep);
+	return ret;
+}
+
+/* Injected data is sent immediately, after any queued sends.  A completion
+ * is written for the given context when comp is set.
+ */
+static ssize_t udpx_inject_to(struct udpx_ep *ep, const void *buf, size_t len,
+			      const void *addr, size_t addrlen, int comp,
+			      void *context)
+{
+	ssize_t ret;
+
+	udpx_progress_tx(ep);
+
+	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
+	if (!ofi_cirque_isempty(ep->txq) ||
+	    (comp && ofi_cirque_isfull(ep->util_ep.tx_cq->cirq))) {
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	ret = ofi_sendto_socket(ep->sock, buf, len, 0, addr,
+				(socklen_t) addrlen);
+	if (ret != (ssize_t) len) {
 		ret = -errno;
+		goto out;
 	}
+
+	if (comp)
+		ep->tx_comp(ep, context);
+	ret = 0;
 out:
 	ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
 	return ret;
 }
 
+static ssize_t udpx_sendto(struct udpx_ep *ep, const void *buf, size_t len,
+			   const void *addr, size_t addrlen, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return udpx_queue_tx(ep, &iov, 1, addr, addrlen, context, 0);
+}
+
 static ssize_t udpx_send(struct fid_ep *ep_fid, const void *buf, size_t len,
 			 void *desc, fi_addr_t dest_addr, void *context)
 {
@@ -436,34 +849,26 @@ static ssize_t udpx_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 			    uint64_t flags)
 {
 	struct udpx_ep *ep;
-	struct msghdr hdr;
-	ssize_t ret;
+	char buf[UDPX_INJECT_SIZE];
+	size_t len;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	hdr.msg_name = (void *)udpx_dest_addr(ep, msg->addr, flags);
-	hdr.msg_namelen = (int)udpx_dest_addrlen(ep, msg->addr, flags);
-	hdr.msg_iov = (struct iovec *)msg->msg_iov;
-	hdr.msg_iovlen = msg->iov_count;
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
-
-	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
-		ret = -FI_EAGAIN;
-		goto out;
+	if (flags & FI_INJECT) {
+		len = ofi_total_iov_len(msg->msg_iov, msg->iov_count);
+		if (len > sizeof(buf))
+			return -FI_EINVAL;
+
+		ofi_copy_from_iov(buf, len, msg->msg_iov, msg->iov_count, 0);
+		return udpx_inject_to(ep, buf, len,
+				      udpx_dest_addr(ep, msg->addr, flags),
+				      udpx_dest_addrlen(ep, msg->addr, flags),
+				      1, msg->context);
 	}
 
-	ret = ofi_sendmsg_udp(ep->sock, &hdr, 0);
-	if (ret >= 0) {
-		ep->tx_comp(ep, msg->context);
-		ret = 0;
-	} else {
-		ret = -errno;
-	}
-out:
-	ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
-	return ret;
+	return udpx_queue_tx(ep, msg->msg_iov, msg->iov_count,
+			     udpx_dest_addr(ep, msg->addr, flags),
+			     udpx_dest_addrlen(ep, msg->addr, flags),
+			     msg->context, flags);
 }
 
 static ssize_t udpx_sendv(struct fid_ep *ep_fid, const struct iovec *iov,
@@ -498,26 +903,22 @@ static ssize_t udpx_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
 			   fi_addr_t dest_addr)
 {
 	struct udpx_ep *ep;
-	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	ret = ofi_sendto_socket(ep->sock, buf, len, 0,
-				ofi_ip_av_get_addr(ep->util_ep.av, (int)dest_addr),
-				(socklen_t)ep->util_ep.av->addrlen);
-	return ret == (ssize_t)len ? 0 : -errno;
+	return udpx_inject_to(ep, buf, len,
+			      ofi_ip_av_get_addr(ep->util_ep.av, (int)dest_addr),
+			      ep->util_ep.av->addrlen, 0, NULL);
 }
 
 static ssize_t udpx_inject_mc(struct fid_ep *ep_fid, const void *buf,
 			      size_t len, fi_addr_t dest_addr)
 {
 	struct udpx_ep *ep;
-	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	ret = ofi_sendto_socket(ep->sock, buf, len, 0,
-				(const void *)(uintptr_t)dest_addr,
-				(socklen_t)ofi_sizeofaddr((const void *)(uintptr_t)dest_addr));
-	return ret == (ssize_t)len ? 0 : -errno;
+	return udpx_inject_to(ep, buf, len, (const void *)(uintptr_t)dest_addr,
+			      ofi_sizeofaddr((const void *)(uintptr_t)dest_addr),
+			      0, NULL);
 }
 
 static struct fi_ops_msg udpx_msg_ops = {
@@ -569,6 +970,9 @@ static int udpx_ep_close(struct fid *fid)
 	}
 
 	udpx_rx_cirq_free(ep->rxq);
+	udpx_tx_cirq_free(ep->txq);
+	free(ep->tx_iov);
+	free(ep->gro_buf);
 	ofi_close_socket(ep->sock);
 	ofi_endpoint_close(&ep->util_ep);
 	free(ep);
@@ -590,6 +994,13 @@ static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 		ofi_atomic_inc32(&cq->ref);
 		ep->tx_comp = cq->wait ? udpx_tx_comp_signal :
 					 udpx_tx_comp;
+
+		/* Queued sends are written from the progress function */
+		ret = fid_list_insert(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
 	}
 
 	if (flags & FI_RECV) {
@@ -721,6 +1132,46 @@ static struct fi_ops udpx_ep_fi_ops = {
 	.ops_open = fi_no_ops_open,
 };
 
+static void udpx_ep_init_offload(struct udpx_ep *ep)
+{
+#if HAVE_DECL_UDP_SEGMENT || HAVE_DECL_UDP_GRO
+	socklen_t optlen;
+	int val;
+#endif
+
+#if HAVE_DECL_UDP_SEGMENT
+	if (udpx_env.gso) {
+		optlen = sizeof(val);
+		if (getsockopt(ep->sock, IPPROTO_UDP, UDP_SEGMENT, &val,
+			       &optlen)) {
+			FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+				"UDP_SEGMENT not supported (%s)\n",
+				strerror(errno));
+		} else {
+			ep->tx_iov = calloc(UDPX_MMSG_BATCH * UDPX_GSO_MAX_SEGS,
+					    sizeof(*ep->tx_iov));
+			ep->gso = ep->tx_iov != NULL;
+		}
+	}
+#endif
+#if HAVE_DECL_UDP_GRO
+	if (udpx_env.gro) {
+		val = 1;
+		optlen = sizeof(val);
+		ep->gro_buf = malloc(UDPX_GRO_BUF_SIZE);
+		if (ep->gro_buf &&
+		    setsockopt(ep->sock, IPPROTO_UDP, UDP_GRO, &val, optlen)) {
+			FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+				"UDP_GRO not supported (%s)\n",
+				strerror(errno));
+			free(ep->gro_buf);
+			ep->gro_buf = NULL;
+		}
+		ep->gro = ep->gro_buf != NULL;
+	}
+#endif
+}
+
 static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 {
 	int family;
@@ -733,6 +1184,12 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 		return ret;
 	}
 
+	ep->txq = udpx_tx_cirq_create(info->tx_attr->size);
+	if (!ep->txq) {
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
 	family = info->src_addr ?
 		 ((struct sockaddr *) info->src_addr)->sa_family : AF_INET;
 	ep->sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
@@ -745,17 +1202,19 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 		ret = udpx_setname(&ep->util_ep.ep_fid.fid, info->src_addr,
 				   info->src_addrlen);
 		if (ret)
-			goto err1;
+			goto err2;
 	}
 
 	ret = fi_fd_nonblock((int)ep->sock);
 	if (ret)
 		goto err2;
 
+	udpx_ep_init_offload(ep);
 	return 0;
 err2:
 	ofi_close_socket(ep->sock);
 err1:
+	udpx_tx_cirq_free(ep->txq);
 	udpx_rx_cirq_free(ep->rxq);
 	return ret;
 }
@@ -38,6 +38,17 @@
 #include <sys/types.h>
 
 
+struct udpx_env udpx_env = {
+	.gso = 0,
+	.gro = 0,
+};
+
+static void udpx_init_env(void)
+{
+	fi_param_get_bool(&udpx_prov, "gso", &udpx_env.gso);
+	fi_param_get_bool(&udpx_prov, "gro", &udpx_env.gro);
+}
+
 static int udpx_getinfo(uint32_t version, const char *node, const char *service,
 			uint64_t flags, const struct fi_info *hints,
 			struct fi_info **info)
@@ -64,6 +75,15 @@ UDP_INI
 {
 	fi_param_define(&udpx_prov, "iface", FI_PARAM_STRING,
 			"Specify interface name");
+	fi_param_define(&udpx_prov, "gso", FI_PARAM_BOOL,
+			"Coalesce queued sends of equal size to the same "
+			"destination using UDP segmentation offload "
+			"(default: no)");
+	fi_param_define(&udpx_prov, "gro", FI_PARAM_BOOL,
+			"Enable UDP generic receive offload, splitting "
+			"coalesced datagrams into posted receives (default: no)");
+
+	udpx_init_env();
 
 	return &udpx_prov;
 }
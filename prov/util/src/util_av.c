@@ -42,6 +42,12 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <inttypes.h>
+#include <sched.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 #if HAVE_GETIFADDRS
 #include <net/if.h>
@@ -49,7 +55,7 @@
 #endif
 
 #include <ofi_util.h>
-
+#include "fasthash.h"
 
 enum {
 	UTIL_NO_ENTRY = -1,
@@ -240,10 +246,524 @@ int ofi_get_addr(uint32_t *addr_format, uint64_t flags,
 	}
 }
 
+/*
+ * Named AVs live in a shared memory segment named after the AV, so that
+ * every process on the node opening the same name resolves the same
+ * fi_addr_t values from a single copy of the addresses.  The segment holds
+ * a header, the fi_addr of each address in the order it was first inserted
+ * (returned through map_addr), an open addressing index keyed by address,
+ * and the entries.  Processes that open the AV for writing serialize
+ * updates through a lock in the header.  FI_READ opens only resolve
+ * addresses already in the AV.
+ *
+ * The segment is sized for the count of the process creating it and never
+ * grows, so inserts fail with -FI_ENOSPC once count addresses are in use.
+ * Each open records its pid in the header, and the segment is removed when
+ * the last process closes it.  Opens of processes that have died are
+ * dropped whenever the table is updated, but addresses they inserted are
+ * left in the AV.  The header records the pid of the process initializing
+ * it, and a writer that finds that process gone finishes the job instead.
+ */
+#define UTIL_AV_SHM_MAGIC	0x5641444552414853ULL	/* "SHAREDAV" */
+#define UTIL_AV_SHM_VERSION	2
+#define UTIL_AV_SHM_TOMBSTONE	UINT64_MAX
+#define UTIL_AV_SHM_MAX_OPENS	256
+#define UTIL_AV_SHM_TIMEOUT_MS	1000
+
+struct util_av_shm_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	addrlen;
+	uint64_t	count;
+	uint64_t	entry_size;
+	/* addresses listed in the map_addr array */
+	uint64_t	stored;
+	/* entries below next have been used */
+	uint64_t	next;
+	/* pid of the process that initialized the header */
+	uint32_t	init;
+	uint32_t	resv;
+	/* pid of the process holding each open of the AV, or 0 */
+	uint32_t	pids[UTIL_AV_SHM_MAX_OPENS];
+#if HAVE_PTHREAD_MUTEX_CONSISTENT
+	pthread_mutex_t	lock;
+#else
+	uint32_t	lock;
+#endif
+};
+
+struct util_av_shm_entry {
+	uint32_t	use_cnt;
+	uint32_t	resv;
+	uint8_t		data[];
+};
+
+/* index slots hold fi_addr + 1, 0 if never used or a tombstone */
+static inline fi_addr_t *util_av_shm_map(struct util_av_shm_hdr *hdr)
+{
+	return (fi_addr_t *) (hdr + 1);
+}
+
+static inline uint64_t *util_av_shm_index(struct util_av_shm_hdr *hdr)
+{
+	return (uint64_t *) (util_av_shm_map(hdr) + hdr->count);
+}
+
+static inline struct util_av_shm_entry *
+util_av_shm_entry(struct util_av_shm_hdr *hdr, fi_addr_t fi_addr)
+{
+	return (struct util_av_shm_entry *)
+		((char *) (util_av_shm_index(hdr) + hdr->count * 2) +
+		 fi_addr * hdr->entry_size);
+}
+
+static size_t util_av_shm_size(size_t count, size_t entry_size)
+{
+	return sizeof(struct util_av_shm_hdr) + count * sizeof(fi_addr_t) +
+	       count * 2 * sizeof(uint64_t) + count * entry_size;
+}
+
+#ifndef _WIN32
+static int util_av_shm_alive(uint32_t pid)
+{
+	return !kill((pid_t) pid, 0) || errno != ESRCH;
+}
+#else
+static int util_av_shm_alive(uint32_t pid)
+{
+	return 1;
+}
+#endif
+
+/* Drops the opens of processes that exited without closing the AV */
+static void util_av_shm_reap(struct util_av *av)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	int i;
+
+	for (i = 0; i < UTIL_AV_SHM_MAX_OPENS; i++) {
+		if (hdr->pids[i] && !util_av_shm_alive(hdr->pids[i])) {
+			FI_INFO(av->prov, FI_LOG_AV, "releasing shared AV open "
+				"of exited process %u\n", hdr->pids[i]);
+			hdr->pids[i] = 0;
+		}
+	}
+}
+
+#if HAVE_PTHREAD_MUTEX_CONSISTENT
+/*
+ * The lock is a robust process shared mutex, so that a process dying while
+ * it holds the lock does not block the other users of the AV.  Updates
+ * store an entry before publishing it in the index, so the state left
+ * behind by a dead holder is usable.
+ */
+static int util_av_shm_lock_init(struct util_av_shm_hdr *hdr)
+{
+	pthread_mutexattr_t attr;
+	int ret;
+
+	ret = pthread_mutexattr_init(&attr);
+	if (ret)
+		return -ret;
+
+	ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if (!ret)
+		ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!ret)
+		ret = pthread_mutex_init(&hdr->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return -ret;
+}
+
+static int util_av_shm_lock(struct util_av *av)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	int ret;
+
+	ret = pthread_mutex_lock(&hdr->lock);
+	if (ret == EOWNERDEAD) {
+		FI_WARN(av->prov, FI_LOG_AV,
+			"process updating the shared AV exited, recovering\n");
+		util_av_shm_reap(av);
+		ret = pthread_mutex_consistent(&hdr->lock);
+		if (ret)
+			pthread_mutex_unlock(&hdr->lock);
+	}
+	if (ret) {
+		FI_WARN(av->prov, FI_LOG_AV, "unable to lock shared AV: %s\n",
+			strerror(ret));
+		return -ret;
+	}
+	return 0;
+}
+
+static void util_av_shm_unlock(struct util_av_shm_hdr *hdr)
+{
+	pthread_mutex_unlock(&hdr->lock);
+}
+#else
+/*
+ * Without robust mutexes, a lock left held by a dead process cannot be
+ * recovered, so waiting for it times out with an error instead.
+ */
+static int util_av_shm_lock_init(struct util_av_shm_hdr *hdr)
+{
+	hdr->lock = 0;
+	return 0;
+}
+
+static int util_av_shm_lock(struct util_av *av)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	uint64_t start = ofi_gettime_ms();
+
+	while (!ofi_atomic_cas_bool(32, &hdr->lock, 0, 1)) {
+		if (ofi_gettime_ms() - start > UTIL_AV_SHM_TIMEOUT_MS) {
+			FI_WARN(av->prov, FI_LOG_AV,
+				"timed out waiting for the shared AV lock\n");
+			return -FI_ETIMEDOUT;
+		}
+		sched_yield();
+	}
+	return 0;
+}
+
+static void util_av_shm_unlock(struct util_av_shm_hdr *hdr)
+{
+	ofi_atomic_store_explicit(32, &hdr->lock, 0, memory_order_release);
+}
+#endif
+
+/* returns the index slot holding addr, or -1 */
+static ssize_t util_av_shm_find(struct util_av *av, const void *addr)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	struct util_av_shm_entry *entry;
+	uint64_t *index = util_av_shm_index(hdr);
+	uint64_t mask = hdr->count * 2 - 1, i, n, val;
+
+	i = fasthash64(addr, av->addrlen, 0) & mask;
+	for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+		val = ofi_atomic_load_explicit(64, &index[i],
+					       memory_order_acquire);
+		if (!val)
+			break;
+		if (val == UTIL_AV_SHM_TOMBSTONE)
+			continue;
+
+		entry = util_av_shm_entry(hdr, val - 1);
+		if (ofi_atomic_load_explicit(32, &entry->use_cnt,
+					     memory_order_acquire) &&
+		    !memcmp(entry->data, addr, av->addrlen))
+			return (ssize_t) i;
+	}
+	return -1;
+}
+
+static fi_addr_t util_av_shm_lookup(struct util_av *av, const void *addr)
+{
+	ssize_t i;
+
+	i = util_av_shm_find(av, addr);
+	return i < 0 ? FI_ADDR_NOTAVAIL : util_av_shm_index(av->shm_hdr)[i] - 1;
+}
+
+/* The segment cannot be resized under the processes that have it mapped */
+static int util_av_shm_alloc(struct util_av_shm_hdr *hdr, fi_addr_t *fi_addr)
+{
+	uint64_t i;
+
+	if (hdr->next < hdr->count) {
+		*fi_addr = hdr->next++;
+		return 0;
+	}
+
+	for (i = 0; i < hdr->count; i++) {
+		if (!util_av_shm_entry(hdr, i)->use_cnt) {
+			*fi_addr = i;
+			return 0;
+		}
+	}
+	return -FI_ENOSPC;
+}
+
+static int util_av_shm_insert(struct util_av *av, const void *addr,
+			      fi_addr_t *fi_addr)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	struct util_av_shm_entry *entry;
+	uint64_t *index = util_av_shm_index(hdr);
+	uint64_t mask = hdr->count * 2 - 1, i, val;
+	fi_addr_t new_addr;
+	int ret;
+
+	if (av->flags & FI_READ) {
+		new_addr = util_av_shm_lookup(av, addr);
+		if (fi_addr)
+			*fi_addr = new_addr;
+		return new_addr == FI_ADDR_NOTAVAIL ? -FI_EADDRNOTAVAIL : 0;
+	}
+
+	ret = util_av_shm_lock(av);
+	if (ret)
+		goto out;
+
+	new_addr = util_av_shm_lookup(av, addr);
+	if (new_addr != FI_ADDR_NOTAVAIL) {
+		entry = util_av_shm_entry(hdr, new_addr);
+		entry->use_cnt++;
+		goto unlock;
+	}
+
+	ret = util_av_shm_alloc(hdr, &new_addr);
+	if (ret)
+		goto unlock;
+
+	entry = util_av_shm_entry(hdr, new_addr);
+	memcpy(entry->data, addr, av->addrlen);
+	ofi_atomic_store_explicit(32, &entry->use_cnt, 1, memory_order_release);
+
+	/* at most count slots are live, so a free slot is always found */
+	i = fasthash64(addr, av->addrlen, 0) & mask;
+	for (;;) {
+		val = index[i];
+		if (!val || val == UTIL_AV_SHM_TOMBSTONE)
+			break;
+		i = (i + 1) & mask;
+	}
+	ofi_atomic_store_explicit(64, &index[i], new_addr + 1,
+				  memory_order_release);
+
+	if (hdr->stored < hdr->count)
+		util_av_shm_map(hdr)[hdr->stored++] = new_addr;
+unlock:
+	util_av_shm_unlock(hdr);
+out:
+	if (fi_addr)
+		*fi_addr = ret ? FI_ADDR_NOTAVAIL : new_addr;
+	return ret;
+}
+
+/* FI_READ opens took no reference when inserting, so there is none to drop */
+static int util_av_shm_remove(struct util_av *av, fi_addr_t fi_addr)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	struct util_av_shm_entry *entry;
+	ssize_t i;
+	int ret = 0;
+
+	if (av->flags & FI_READ)
+		return 0;
+
+	ret = util_av_shm_lock(av);
+	if (ret)
+		return ret;
+
+	entry = util_av_shm_entry(hdr, fi_addr);
+	if (fi_addr >= hdr->next || !entry->use_cnt) {
+		ret = -FI_ENOENT;
+		goto out;
+	}
+
+	if (entry->use_cnt > 1) {
+		entry->use_cnt--;
+		goto out;
+	}
+
+	i = util_av_shm_find(av, entry->data);
+	assert(i >= 0);
+	ofi_atomic_store_explicit(64, &util_av_shm_index(hdr)[i],
+				  UTIL_AV_SHM_TOMBSTONE, memory_order_release);
+	ofi_atomic_store_explicit(32, &entry->use_cnt, 0, memory_order_release);
+out:
+	util_av_shm_unlock(hdr);
+	return ret;
+}
+
+/* Records an open of the AV by this process.  Caller holds the lock. */
+static int util_av_shm_attach(struct util_av *av)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	int i;
+
+	util_av_shm_reap(av);
+	for (i = 0; i < UTIL_AV_SHM_MAX_OPENS; i++) {
+		if (!hdr->pids[i]) {
+			hdr->pids[i] = (uint32_t) getpid();
+			return 0;
+		}
+	}
+	return -FI_EBUSY;
+}
+
+/* Returns the number of opens left.  Caller holds the lock. */
+static int util_av_shm_detach(struct util_av *av)
+{
+	struct util_av_shm_hdr *hdr = av->shm_hdr;
+	uint32_t pid = (uint32_t) getpid();
+	int i, cnt = 0;
+
+	for (i = 0; i < UTIL_AV_SHM_MAX_OPENS; i++) {
+		if (hdr->pids[i] == pid) {
+			hdr->pids[i] = 0;
+			break;
+		}
+	}
+
+	util_av_shm_reap(av);
+	for (i = 0; i < UTIL_AV_SHM_MAX_OPENS; i++)
+		cnt += hdr->pids[i] != 0;
+	return cnt;
+}
+
+static void util_av_shm_close(struct util_av *av)
+{
+	int cnt = 1;
+
+	if (!util_av_shm_lock(av)) {
+		cnt = util_av_shm_detach(av);
+		util_av_shm_unlock(av->shm_hdr);
+	}
+
+	/* only the last process to close the AV removes its name */
+	if (cnt) {
+		free((char *) av->shm.name);
+		av->shm.name = NULL;
+	}
+	ofi_shm_unmap(&av->shm);
+	av->shm_hdr = NULL;
+}
+
+static int util_av_shm_init(struct util_av *av, struct util_av_shm_hdr *hdr,
+			    size_t addrlen, size_t count, size_t entry_size)
+{
+	int ret;
+
+	ret = util_av_shm_lock_init(hdr);
+	if (ret) {
+		FI_WARN(av->prov, FI_LOG_AV,
+			"unable to initialize shared AV lock\n");
+		return ret;
+	}
+
+	hdr->version = UTIL_AV_SHM_VERSION;
+	hdr->addrlen = (uint32_t) addrlen;
+	hdr->count = count;
+	hdr->entry_size = entry_size;
+	ofi_atomic_store_explicit(64, &hdr->magic, UTIL_AV_SHM_MAGIC,
+				  memory_order_release);
+	return 0;
+}
+
+static int util_av_shm_open(struct util_av *av, const struct fi_av_attr *attr,
+			    const struct util_av_attr *util_attr, size_t count)
+{
+	struct util_av_shm_hdr *hdr;
+	size_t entry_size;
+	uint64_t start;
+	uint32_t pid, owner;
+	int ret;
+
+	if (!(util_attr->flags & OFI_AV_NAMED)) {
+		FI_WARN(av->prov, FI_LOG_AV, "Shared AV is unsupported\n");
+		return -FI_ENOSYS;
+	}
+
+	entry_size = sizeof(struct util_av_shm_entry) +
+		     ofi_get_aligned_size(util_attr->addrlen, 8);
+	ret = ofi_shm_map(&av->shm, attr->name,
+			  util_av_shm_size(count, entry_size),
+			  (attr->flags & FI_READ) ? 1 : 0, (void **) &hdr);
+	if (ret) {
+		FI_WARN(av->prov, FI_LOG_AV, "unable to map shared AV %s\n",
+			attr->name);
+		return ret;
+	}
+
+	pid = (uint32_t) getpid();
+	if (!(attr->flags & FI_READ) &&
+	    ofi_atomic_cas_bool(32, &hdr->init, 0, pid)) {
+		ret = util_av_shm_init(av, hdr, util_attr->addrlen, count,
+				       entry_size);
+		if (ret)
+			goto err;
+	}
+
+	/* another process is creating the AV */
+	start = ofi_gettime_ms();
+	while (ofi_atomic_load_explicit(64, &hdr->magic, memory_order_acquire) !=
+	       UTIL_AV_SHM_MAGIC) {
+		owner = ofi_atomic_load_explicit(32, &hdr->init,
+						 memory_order_acquire);
+		if (!(attr->flags & FI_READ) && !util_av_shm_alive(owner) &&
+		    ofi_atomic_cas_bool(32, &hdr->init, owner, pid)) {
+			FI_WARN(av->prov, FI_LOG_AV, "process %u exited while "
+				"creating shared AV %s, recovering\n", owner,
+				attr->name);
+			ret = util_av_shm_init(av, hdr, util_attr->addrlen,
+					       count, entry_size);
+			if (ret)
+				goto err;
+			break;
+		}
+
+		if (ofi_gettime_ms() - start > UTIL_AV_SHM_TIMEOUT_MS) {
+			FI_WARN(av->prov, FI_LOG_AV,
+				"shared AV %s was not initialized\n",
+				attr->name);
+			ret = -FI_EAGAIN;
+			goto err;
+		}
+		sched_yield();
+	}
+
+	if (hdr->version != UTIL_AV_SHM_VERSION) {
+		FI_WARN(av->prov, FI_LOG_AV, "shared AV %s has version %u, "
+			"expected %u\n", attr->name, hdr->version,
+			UTIL_AV_SHM_VERSION);
+		ret = -FI_EINVAL;
+		goto err;
+	}
+
+	if (hdr->addrlen != util_attr->addrlen || hdr->count != count ||
+	    hdr->entry_size != entry_size) {
+		FI_WARN(av->prov, FI_LOG_AV, "shared AV %s was created with "
+			"addrlen %u and count %" PRIu64 ", opened with addrlen "
+			"%zu and count %zu\n", attr->name, hdr->addrlen,
+			hdr->count, util_attr->addrlen, count);
+		ret = -FI_EINVAL;
+		goto err;
+	}
+
+	av->shm_hdr = hdr;
+	ret = util_av_shm_lock(av);
+	if (ret)
+		goto err;
+
+	ret = util_av_shm_attach(av);
+	util_av_shm_unlock(hdr);
+	if (ret) {
+		FI_WARN(av->prov, FI_LOG_AV, "shared AV %s is opened by too "
+			"many processes\n", attr->name);
+		goto err;
+	}
+	return 0;
+err:
+	av->shm_hdr = NULL;
+	/* leave the name to the process creating the AV */
+	free((char *) av->shm.name);
+	av->shm.name = NULL;
+	ofi_shm_unmap(&av->shm);
+	return ret;
+}
+
 void *ofi_av_get_addr(struct util_av *av, fi_addr_t fi_addr)
 {
 	struct util_av_entry *entry;
 
+	if (av->shm_hdr)
+		return util_av_shm_entry(av->shm_hdr, fi_addr)->data;
+
 	entry = ofi_bufpool_get_ibuf(av->av_entry_pool, fi_addr);
 	return entry->data;
 }
@@ -289,6 +809,9 @@ int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr)
 
 	assert(ofi_mutex_held(&av->lock));
 	ofi_straddr_log(av->prov, FI_LOG_INFO, FI_LOG_AV, "inserting addr", addr);
+	if (av->shm_hdr)
+		return util_av_shm_insert(av, addr, fi_addr);
+
 	HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
 	if (entry) {
 		if (fi_addr)
@@ -316,11 +839,188 @@ int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr)
 	return 0;
 }
 
+/*
+ * Bulk insertion.  The hash of every address is computed up front, on
+ * several threads for large batches, then the hash table and entry pool
+ * are sized for the whole batch and the addresses are added under a
+ * single acquisition of the AV lock, without per-address logging.
+ */
+#define UTIL_AV_BULK_THREAD_MIN	(64 * 1024)
+#define UTIL_AV_BULK_THREAD_MAX	8
+
+struct util_av_hash_arg {
+	pthread_t	thread;
+	const char	*addr;
+	size_t		addrlen;
+	size_t		keylen;
+	unsigned	*hashv;
+	size_t		start;
+	size_t		end;
+};
+
+static void *util_av_hash_thread(void *arg)
+{
+	struct util_av_hash_arg *hash_arg = arg;
+	size_t i;
+
+	for (i = hash_arg->start; i < hash_arg->end; i++)
+		HASH_VALUE(hash_arg->addr + i * hash_arg->addrlen,
+			   hash_arg->keylen, hash_arg->hashv[i]);
+	return NULL;
+}
+
+static void util_av_hash_addrs(struct util_av *av, const void *addr,
+			       size_t addrlen, size_t count, unsigned *hashv)
+{
+	struct util_av_hash_arg args[UTIL_AV_BULK_THREAD_MAX];
+	size_t i, nthreads = 1, per_thread;
+	long cpus;
+
+	if (count >= UTIL_AV_BULK_THREAD_MIN) {
+		cpus = ofi_sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = MIN(count / (UTIL_AV_BULK_THREAD_MIN / 4),
+			       UTIL_AV_BULK_THREAD_MAX);
+		if (cpus > 0)
+			nthreads = MIN(nthreads, (size_t) cpus);
+	}
+	per_thread = (count + nthreads - 1) / nthreads;
+
+	for (i = 0; i < nthreads; i++) {
+		args[i].addr = addr;
+		args[i].addrlen = addrlen;
+		args[i].keylen = av->addrlen;
+		args[i].hashv = hashv;
+		args[i].start = i * per_thread;
+		args[i].end = MIN(count, (i + 1) * per_thread);
+	}
+
+	/* the calling thread hashes the first slice */
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&args[i].thread, NULL, util_av_hash_thread,
+				   &args[i])) {
+			args[0].end = count;
+			break;
+		}
+	}
+	util_av_hash_thread(&args[0]);
+	while (--i > 0)
+		pthread_join(args[i].thread, NULL);
+}
+
+static void util_av_reserve(struct util_av *av, size_t count)
+{
+	UT_hash_table *tbl;
+	size_t total;
+	int oomed = 0;
+
+	total = HASH_COUNT(av->hash) + count;
+	while (av->av_entry_pool->entry_cnt < total &&
+	       !ofi_bufpool_grow(av->av_entry_pool))
+		;
+
+	/* uthash only expands a table that has items */
+	if (!av->hash)
+		return;
+
+	tbl = av->hash->hh.tbl;
+	while (!tbl->noexpand && tbl->num_buckets < total / 2 &&
+	       tbl->num_buckets < (1U << 30) && !oomed)
+		HASH_EXPAND_BUCKETS(hh, tbl, oomed);
+	(void) oomed;
+}
+
+/*
+ * Inserts count addresses stored addrlen bytes apart.  Entries with errs[i]
+ * already set are skipped, and errs[i] is set for addresses that could not
+ * be inserted.  Returns the number of addresses inserted.
+ */
+size_t ofi_av_insert_addrs(struct util_av *av, const void *addr,
+			   size_t addrlen, size_t count, fi_addr_t *fi_addr,
+			   int *errs)
+{
+	struct util_av_entry *entry;
+	const char *cur;
+	unsigned *hashv;
+	size_t i, inserted = 0;
+	int reserved;
+
+	hashv = malloc(count * sizeof(*hashv));
+	if (hashv)
+		util_av_hash_addrs(av, addr, addrlen, count, hashv);
+
+	ofi_mutex_lock(&av->lock);
+	if (av->shm_hdr) {
+		for (i = 0; i < count; i++) {
+			if (errs[i])
+				continue;
+			errs[i] = -util_av_shm_insert(av, (const char *) addr +
+						      i * addrlen, fi_addr ?
+						      &fi_addr[i] : NULL);
+			if (!errs[i])
+				inserted++;
+		}
+		goto out;
+	}
+
+	util_av_reserve(av, count);
+	reserved = av->hash != NULL;
+	for (i = 0; i < count; i++) {
+		if (errs[i])
+			continue;
+
+		cur = (const char *) addr + i * addrlen;
+		if (!hashv) {
+			HASH_FIND(hh, av->hash, cur, av->addrlen, entry);
+		} else {
+			HASH_FIND_BYHASHVALUE(hh, av->hash, cur, av->addrlen,
+					      hashv[i], entry);
+		}
+		if (entry) {
+			ofi_atomic_inc32(&entry->use_cnt);
+			goto next;
+		}
+
+		entry = ofi_ibuf_alloc(av->av_entry_pool);
+		if (!entry) {
+			errs[i] = FI_ENOMEM;
+			if (fi_addr)
+				fi_addr[i] = FI_ADDR_NOTAVAIL;
+			continue;
+		}
+
+		memcpy(entry->data, cur, av->addrlen);
+		ofi_atomic_initialize32(&entry->use_cnt, 1);
+		if (!hashv) {
+			HASH_ADD(hh, av->hash, data, av->addrlen, entry);
+		} else {
+			HASH_ADD_BYHASHVALUE(hh, av->hash, data, av->addrlen,
+					     hashv[i], entry);
+		}
+		if (!reserved) {
+			util_av_reserve(av, count - i - 1);
+			reserved = 1;
+		}
+next:
+		if (fi_addr)
+			fi_addr[i] = ofi_buf_index(entry);
+		inserted++;
+	}
+out:
+	ofi_mutex_unlock(&av->lock);
+	FI_INFO(av->prov, FI_LOG_AV, "inserted %zu of %zu addresses\n",
+		inserted, count);
+	free(hashv);
+	return inserted;
+}
+
 int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr)
 {
 	struct util_av_entry *av_entry;
 
 	assert(ofi_mutex_held(&av->lock));
+	if (av->shm_hdr)
+		return util_av_shm_remove(av, fi_addr);
+
 	av_entry = ofi_bufpool_get_ibuf(av->av_entry_pool, fi_addr);
 	if (!av_entry)
 		return -FI_ENOENT;
@@ -338,6 +1038,9 @@ fi_addr_t ofi_av_lookup_fi_addr_unsafe(struct util_av *av, const void *addr)
 {
 	struct util_av_entry *entry = NULL;
 
+	if (av->shm_hdr)
+		return util_av_shm_lookup(av, addr);
+
 	HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
 	return entry ? ofi_buf_index(entry) : FI_ADDR_NOTAVAIL;
 }
@@ -389,6 +1092,11 @@ int ofi_av_bind(struct fid *av_fid, struct fid *eq_fid, uint64_t flags)
 
 static void util_av_close(struct util_av *av)
 {
+	if (av->shm_hdr) {
+		util_av_shm_close(av);
+		return;
+	}
+
 	HASH_CLEAR(hh, av->hash);
 	ofi_bufpool_destroy(av->av_entry_pool);
 }
@@ -436,6 +1144,9 @@ int ofi_av_close(struct util_av *av)
 
 size_t ofi_av_size(struct util_av *av)
 {
+	if (av->shm_hdr)
+		return av->shm_hdr->count;
+
 	return av->av_entry_pool->entry_cnt ?
 	       av->av_entry_pool->entry_cnt :
 	       av->av_entry_pool->attr.chunk_cnt;
@@ -444,7 +1155,7 @@ size_t ofi_av_size(struct util_av *av)
 static int util_verify_av_util_attr(struct util_domain *domain,
 				    const struct util_av_attr *util_attr)
 {
-	if (util_attr->flags & ~(OFI_AV_DYN_ADDRLEN)) {
+	if (util_attr->flags & ~(OFI_AV_DYN_ADDRLEN | OFI_AV_NAMED)) {
 		FI_WARN(domain->prov, FI_LOG_AV, "invalid internal flags\n");
 		return -FI_EINVAL;
 	}
@@ -474,9 +1185,6 @@ static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 		.flags		= OFI_BUFPOOL_NO_TRACK | OFI_BUFPOOL_INDEXED,
 	};
 
-	/* TODO: Handle FI_READ */
-	/* TODO: Handle mmap - shared AV */
-
 	ret = util_verify_av_util_attr(av->domain, util_attr);
 	if (ret)
 		return ret;
@@ -490,6 +1198,9 @@ static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 	av->flags = util_attr->flags | attr->flags;
 	av->hash = NULL;
 
+	if (attr->name)
+		return util_av_shm_open(av, attr, util_attr, orig_size);
+
 	pool_attr.chunk_cnt = orig_size;
 	return ofi_bufpool_create_attr(&pool_attr, &av->av_entry_pool);
 }
@@ -511,9 +1222,9 @@ static int util_verify_av_attr(struct util_domain *domain,
 		return -FI_EINVAL;
 	}
 
-	if (attr->name) {
-		FI_WARN(domain->prov, FI_LOG_AV, "Shared AV is unsupported\n");
-		return -FI_ENOSYS;
+	if ((attr->flags & FI_READ) && !attr->name) {
+		FI_WARN(domain->prov, FI_LOG_AV, "FI_READ requires a named AV\n");
+		return -FI_EINVAL;
 	}
 
 	if (attr->flags & ~(FI_EVENT | FI_READ | FI_SYMMETRIC | FI_PEER)) {
@@ -524,8 +1235,9 @@ static int util_verify_av_attr(struct util_domain *domain,
 	return 0;
 }
 
-int ofi_av_init_lightweight(struct util_domain *domain, const struct fi_av_attr *attr,
-			    struct util_av *av, void *context)
+static int util_av_init_lightweight(struct util_domain *domain,
+				    const struct fi_av_attr *attr,
+				    struct util_av *av, void *context)
 {
 	int ret;
 
@@ -544,23 +1256,35 @@ int ofi_av_init_lightweight(struct util_domain *domain, const struct fi_av_attr
 	 */
 	av->context = context;
 	av->domain = domain;
+	av->shm_hdr = NULL;
 	ofi_mutex_init(&av->ep_list_lock);
 	dlist_init(&av->ep_list);
 	ofi_atomic_inc32(&domain->ref);
 	return 0;
 }
 
+int ofi_av_init_lightweight(struct util_domain *domain, const struct fi_av_attr *attr,
+			    struct util_av *av, void *context)
+{
+	if (attr->name) {
+		FI_WARN(domain->prov, FI_LOG_AV, "Shared AV is unsupported\n");
+		return -FI_ENOSYS;
+	}
+
+	return util_av_init_lightweight(domain, attr, av, context);
+}
+
 int ofi_av_init(struct util_domain *domain, const struct fi_av_attr *attr,
 		const struct util_av_attr *util_attr,
 		struct util_av *av, void *context)
 {
-	int ret = ofi_av_init_lightweight(domain, attr, av, context);
+	int ret = util_av_init_lightweight(domain, attr, av, context);
 	if (ret)
 		return ret;
 
 	ret = util_av_init(av, attr, util_attr);
 	if (ret)
-		return ret;
+		(void) ofi_av_close_lightweight(av);
 	return ret;
 }
 
@@ -628,6 +1352,41 @@ static int ip_av_insert_addr(struct util_av *av, const void *addr,
 	return ret;
 }
 
+static int ip_av_insert_bulk(struct util_av *av, const void *addr,
+			     size_t addrlen, size_t count, fi_addr_t *fi_addr,
+			     int *sync_err, void *context)
+{
+	int *errs;
+	size_t i, success_cnt;
+
+	errs = sync_err ? sync_err : calloc(count, sizeof(*errs));
+	if (!errs)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		if (!ofi_valid_dest_ipaddr((const struct sockaddr *)
+					   ((const char *) addr + i * addrlen))) {
+			errs[i] = FI_EADDRNOTAVAIL;
+			if (fi_addr)
+				fi_addr[i] = FI_ADDR_NOTAVAIL;
+		}
+	}
+
+	success_cnt = ofi_av_insert_addrs(av, addr, addrlen, count, fi_addr,
+					  errs);
+	if (av->eq) {
+		for (i = 0; i < count; i++) {
+			if (errs[i])
+				ofi_av_write_event(av, i, errs[i], context);
+		}
+		ofi_av_write_event(av, success_cnt, 0, context);
+	}
+
+	if (errs != sync_err)
+		free(errs);
+	return av->eq ? 0 : (int) success_cnt;
+}
+
 int ofi_ip_av_insertv(struct util_av *av, const void *addr, size_t addrlen,
 		      size_t count, fi_addr_t *fi_addr, uint64_t flags,
 		      void *context)
@@ -656,6 +1415,10 @@ int ofi_ip_av_insertv(struct util_av *av, const void *addr, size_t addrlen,
 		memset(sync_err, 0, sizeof(*sync_err) * count);
 	}
 
+	if (count >= OFI_AV_BULK_MIN)
+		return ip_av_insert_bulk(av, addr, addrlen, count, fi_addr,
+					 sync_err, context);
+
 	for (i = 0; i < count; i++) {
 		ret = ip_av_insert_addr(av, (const char *) addr + i * addrlen,
 					fi_addr ? &fi_addr[i] : NULL, context);
@@ -999,6 +1762,7 @@ int ofi_ip_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 		util_attr.addrlen = sizeof(struct sockaddr_in6);
 		util_attr.flags = OFI_AV_DYN_ADDRLEN;
 	}
+	util_attr.flags |= OFI_AV_NAMED;
 
 	if (attr->type == FI_AV_UNSPEC)
 		attr->type = FI_AV_MAP;
@@ -1013,6 +1777,9 @@ int ofi_ip_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 		return ret;
 	}
 
+	if (util_av->shm_hdr)
+		attr->map_addr = util_av_shm_map(util_av->shm_hdr);
+
 	*av = &util_av->av_fid;
 	(*av)->fid.ops = &ip_av_fi_ops;
 	(*av)->ops = &ip_av_ops;
@@ -117,7 +117,7 @@ static void ofi_bufpool_region_free(struct ofi_bufpool_region *buf_region)
 	}
 }
 
-int ofi_bufpool_grow(struct ofi_bufpool *pool)
+static int ofi_bufpool_grow_locked(struct ofi_bufpool *pool)
 {
 	struct ofi_bufpool_region *buf_region;
 	struct ofi_bufpool_hdr *buf_hdr;
@@ -209,12 +209,172 @@ err1:
 	return ret;
 }
 
+int ofi_bufpool_grow(struct ofi_bufpool *pool)
+{
+	int ret;
+
+	if (!(pool->attr.flags & OFI_BUFPOOL_THREAD_CACHE))
+		return ofi_bufpool_grow_locked(pool);
+
+	ofi_mutex_lock(&pool->lock);
+	ret = ofi_bufpool_grow_locked(pool);
+	ofi_mutex_unlock(&pool->lock);
+	return ret;
+}
+
+static struct ofi_bufpool_cache *ofi_bufpool_get_cache(struct ofi_bufpool *pool)
+{
+	uint64_t id;
+
+#ifdef _WIN32
+	id = GetCurrentThreadId();
+#else
+	id = (uintptr_t) pthread_self();
+#endif
+	/* Fibonacci hashing spreads out the aligned thread handles */
+	id *= 0x9e3779b97f4a7c15ULL;
+	return &pool->cache[(id >> 32) & pool->cache_mask];
+}
+
+/*
+ * The pool lock is never taken with a cache lock held: growing the pool may
+ * allocate or map memory, which must not happen under a spinlock.  Buffers
+ * move between the pool and a cache through a private list instead.
+ */
+
+/* Takes up to half a cache worth of buffers from the pool's free list */
+static size_t ofi_bufpool_cache_refill(struct ofi_bufpool *pool,
+				       struct slist *list)
+{
+	struct slist_entry *entry;
+	size_t cnt;
+
+	ofi_mutex_lock(&pool->lock);
+	for (cnt = 0; cnt < OFI_BUFPOOL_CACHE_MAX / 2; cnt++) {
+		if (slist_empty(&pool->free_list.entries) &&
+		    ofi_bufpool_grow_locked(pool))
+			break;
+
+		entry = slist_remove_head(&pool->free_list.entries);
+		slist_insert_head(entry, list);
+	}
+	ofi_mutex_unlock(&pool->lock);
+	return cnt;
+}
+
+static void ofi_bufpool_cache_drain(struct ofi_bufpool *pool,
+				    struct slist *list)
+{
+	struct slist_entry *entry;
+
+	ofi_mutex_lock(&pool->lock);
+	while (!slist_empty(list)) {
+		entry = slist_remove_head(list);
+		slist_insert_head(entry, &pool->free_list.entries);
+	}
+	ofi_mutex_unlock(&pool->lock);
+}
+
+void *ofi_bufpool_cache_alloc(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_cache *cache;
+	struct ofi_bufpool_hdr *buf_hdr;
+	struct slist_entry *entry;
+	struct slist list;
+	size_t cnt;
+
+	cache = ofi_bufpool_get_cache(pool);
+	ofi_spin_lock(&cache->lock);
+	while (!cache->cnt) {
+		ofi_spin_unlock(&cache->lock);
+		slist_init(&list);
+		cnt = ofi_bufpool_cache_refill(pool, &list);
+		if (!cnt)
+			return NULL;
+
+		ofi_spin_lock(&cache->lock);
+		for (; cnt; cnt--, cache->cnt++) {
+			entry = slist_remove_head(&list);
+			slist_insert_head(entry, &cache->free_list);
+		}
+	}
+
+	slist_remove_head_container(&cache->free_list, struct ofi_bufpool_hdr,
+				    buf_hdr, entry.slist);
+	cache->cnt--;
+	ofi_spin_unlock(&cache->lock);
+
+	assert(ofi_atomic_inc32(&buf_hdr->region->use_cnt));
+	return ofi_buf_data(buf_hdr);
+}
+
+void ofi_bufpool_cache_free(struct ofi_bufpool *pool, void *buf)
+{
+	struct ofi_bufpool_cache *cache;
+	struct slist_entry *entry;
+	struct slist list;
+	size_t cnt;
+
+	slist_init(&list);
+	cache = ofi_bufpool_get_cache(pool);
+	ofi_spin_lock(&cache->lock);
+	slist_insert_head(&ofi_buf_hdr(buf)->entry.slist, &cache->free_list);
+	if (++cache->cnt > OFI_BUFPOOL_CACHE_MAX) {
+		for (cnt = OFI_BUFPOOL_CACHE_MAX / 2; cnt; cnt--, cache->cnt--) {
+			entry = slist_remove_head(&cache->free_list);
+			slist_insert_head(entry, &list);
+		}
+	}
+	ofi_spin_unlock(&cache->lock);
+
+	if (!slist_empty(&list))
+		ofi_bufpool_cache_drain(pool, &list);
+}
+
+static int ofi_bufpool_cache_init(struct ofi_bufpool *pool)
+{
+	size_t cnt, i;
+	long cpus;
+	int ret;
+
+	/* about one cache per CPU, threads that hash together share */
+	cpus = ofi_sysconf(_SC_NPROCESSORS_ONLN);
+	cnt = roundup_power_of_two(MIN(MAX(cpus, 1), 64));
+	ret = ofi_memalign((void **) &pool->cache, OFI_BUFPOOL_CACHE_ALIGN,
+			   cnt * sizeof(*pool->cache));
+	if (ret)
+		return -FI_ENOMEM;
+
+	memset(pool->cache, 0, cnt * sizeof(*pool->cache));
+	for (i = 0; i < cnt; i++) {
+		ofi_spin_init(&pool->cache[i].lock);
+		slist_init(&pool->cache[i].free_list);
+	}
+	pool->cache_mask = cnt - 1;
+	ofi_mutex_init(&pool->lock);
+	return 0;
+}
+
+static void ofi_bufpool_cache_cleanup(struct ofi_bufpool *pool)
+{
+	size_t i;
+
+	for (i = 0; i <= pool->cache_mask; i++)
+		ofi_spin_destroy(&pool->cache[i].lock);
+	ofi_freealign(pool->cache);
+	ofi_mutex_destroy(&pool->lock);
+}
+
 int ofi_bufpool_create_attr(struct ofi_bufpool_attr *attr,
 			      struct ofi_bufpool **buf_pool)
 {
 	struct ofi_bufpool *pool;
 	size_t entry_sz;
 
+	if ((attr->flags & OFI_BUFPOOL_THREAD_CACHE) &&
+	    (attr->flags & OFI_BUFPOOL_INDEXED))
+		return -FI_EINVAL;
+
 	pool = calloc(1, sizeof(**buf_pool));
 	if (!pool)
 		return -FI_ENOMEM;
@@ -240,6 +400,12 @@ int ofi_bufpool_create_attr(struct ofi_bufpool_attr *attr,
 	pool->alloc_size = (pool->attr.chunk_cnt + 1) * pool->entry_size;
 	pool->region_size = pool->alloc_size - pool->entry_size;
 
+	if ((pool->attr.flags & OFI_BUFPOOL_THREAD_CACHE) &&
+	    ofi_bufpool_cache_init(pool)) {
+		free(pool);
+		return -FI_ENOMEM;
+	}
+
 	*buf_pool = pool;
 	return FI_SUCCESS;
 }
@@ -261,6 +427,8 @@ void ofi_bufpool_destroy(struct ofi_bufpool *pool)
 		free(buf_region);
 	}
 	free(pool->region_table);
+	if (pool->attr.flags & OFI_BUFPOOL_THREAD_CACHE)
+		ofi_bufpool_cache_cleanup(pool);
 	free(pool);
 }
 
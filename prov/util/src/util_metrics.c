@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <ofi.h>
+#include <ofi_metrics.h>
+
+#define OFI_METRICS_SEG_MAX	64
+
+static pthread_mutex_t ofi_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ofi_metrics_hdr *ofi_metrics_hdr;
+static struct ofi_metrics_slot *ofi_metrics_slots;
+static char ofi_metrics_name[64];
+static size_t ofi_metrics_size;
+static size_t ofi_metrics_refs;
+/* 0 until FI_METRICS has been read, then 1 if enabled or -1 */
+static int ofi_metrics_state;
+
+void ofi_metrics_init(void)
+{
+	fi_param_define(NULL, "metrics", FI_PARAM_BOOL,
+			"Export provider counters through shared memory, "
+			"where they can be viewed with fi_top (default: no)");
+}
+
+#ifndef _WIN32
+static int ofi_metrics_open(void)
+{
+	struct ofi_metrics_hdr *hdr;
+	int fd = -1, i;
+
+	for (i = 0; i < OFI_METRICS_SEG_MAX; i++) {
+		snprintf(ofi_metrics_name, sizeof(ofi_metrics_name),
+			 "/" OFI_METRICS_PREFIX "%d.%d", (int) getpid(), i);
+		fd = shm_open(ofi_metrics_name, O_RDWR | O_CREAT | O_EXCL,
+			      S_IRUSR | S_IWUSR);
+		if (fd >= 0 || errno != EEXIST)
+			break;
+	}
+	if (fd < 0)
+		goto err;
+
+	ofi_metrics_size = sizeof(*hdr) +
+			   OFI_METRICS_SLOTS * sizeof(struct ofi_metrics_slot);
+	if (ftruncate(fd, ofi_metrics_size))
+		goto err_unlink;
+
+	hdr = mmap(NULL, ofi_metrics_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		goto err_unlink;
+	close(fd);
+
+	hdr->version = OFI_METRICS_VERSION;
+	hdr->slot_size = sizeof(struct ofi_metrics_slot);
+	hdr->slot_cnt = OFI_METRICS_SLOTS;
+	hdr->pid = (uint32_t) getpid();
+	ofi_atomic_store_explicit(64, &hdr->magic, OFI_METRICS_MAGIC,
+				  memory_order_release);
+
+	ofi_metrics_hdr = hdr;
+	ofi_metrics_slots = (struct ofi_metrics_slot *) (hdr + 1);
+	return 0;
+
+err_unlink:
+	close(fd);
+	shm_unlink(ofi_metrics_name);
+err:
+	FI_WARN(&core_prov, FI_LOG_CORE,
+		"unable to create metrics segment: %s\n", strerror(errno));
+	return -FI_ENOMEM;
+}
+
+static void ofi_metrics_close(void)
+{
+	shm_unlink(ofi_metrics_name);
+	munmap(ofi_metrics_hdr, ofi_metrics_size);
+	ofi_metrics_hdr = NULL;
+	ofi_metrics_slots = NULL;
+}
+
+static void ofi_metrics_unlink(void)
+{
+	shm_unlink(ofi_metrics_name);
+}
+#else
+static int ofi_metrics_open(void)
+{
+	FI_WARN(&core_prov, FI_LOG_CORE, "metrics are not supported\n");
+	return -FI_ENOSYS;
+}
+
+static void ofi_metrics_close(void)
+{
+}
+
+static void ofi_metrics_unlink(void)
+{
+}
+#endif
+
+void ofi_metric_init(struct ofi_metric *metric, const struct fi_provider *prov,
+		     const char *name, enum ofi_metric_type type)
+{
+	struct ofi_metrics_slot *slot;
+	int enabled = 0;
+	uint32_t i;
+
+	metric->local = 0;
+	metric->value = &metric->local;
+	metric->slot = NULL;
+
+	pthread_mutex_lock(&ofi_metrics_lock);
+	if (!ofi_metrics_state) {
+		fi_param_get_bool(NULL, "metrics", &enabled);
+		ofi_metrics_state = enabled ? 1 : -1;
+	}
+	if (ofi_metrics_state < 0 ||
+	    (!ofi_metrics_hdr && ofi_metrics_open()))
+		goto unlock;
+
+	for (i = 0; i < OFI_METRICS_SLOTS; i++) {
+		if (!(ofi_metrics_slots[i].gen & 1))
+			break;
+	}
+	if (i == OFI_METRICS_SLOTS) {
+		FI_WARN_ONCE(&core_prov, FI_LOG_CORE,
+			     "metrics segment full, %s/%s not exported\n",
+			     prov->name, name);
+		goto unlock;
+	}
+
+	slot = &ofi_metrics_slots[i];
+	slot->value = 0;
+	slot->type = (uint16_t) type;
+	snprintf(slot->name, sizeof(slot->name), "%s/%s", prov->name, name);
+	ofi_atomic_store_explicit(32, &slot->gen, slot->gen + 1,
+				  memory_order_release);
+	if (i >= ofi_metrics_hdr->used)
+		ofi_atomic_store_explicit(32, &ofi_metrics_hdr->used, i + 1,
+					  memory_order_release);
+
+	metric->slot = slot;
+	metric->value = &slot->value;
+	ofi_metrics_refs++;
+unlock:
+	pthread_mutex_unlock(&ofi_metrics_lock);
+}
+
+void ofi_metric_fini(struct ofi_metric *metric)
+{
+	struct ofi_metrics_slot *slot = metric->slot;
+
+	if (!slot)
+		return;
+
+	pthread_mutex_lock(&ofi_metrics_lock);
+	metric->local = ofi_metric_get(metric);
+	metric->value = &metric->local;
+	metric->slot = NULL;
+	ofi_atomic_store_explicit(32, &slot->gen, slot->gen + 1,
+				  memory_order_release);
+	if (!--ofi_metrics_refs)
+		ofi_metrics_close();
+	pthread_mutex_unlock(&ofi_metrics_lock);
+}
+
+/*
+ * Metrics still registered at this point are not released by their owners
+ * until after libfabric is cleaned up, so only the name is removed.
+ */
+void ofi_metrics_cleanup(void)
+{
+	pthread_mutex_lock(&ofi_metrics_lock);
+	if (ofi_metrics_hdr) {
+		if (ofi_metrics_refs)
+			ofi_metrics_unlink();
+		else
+			ofi_metrics_close();
+	}
+	ofi_metrics_state = 0;
+	pthread_mutex_unlock(&ofi_metrics_lock);
+}
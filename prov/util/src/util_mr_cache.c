@@ -173,7 +173,7 @@ void ofi_mr_cache_notify(struct ofi_mr_cache *cache, const void *addr, size_t le
 	struct ofi_mr_entry *entry;
 	struct iovec iov;
 
-	cache->notify_cnt++;
+	ofi_metric_inc(&cache->notify_cnt);
 	iov.iov_base = (void *) addr;
 	iov.iov_len = len;
 
@@ -228,7 +228,7 @@ void ofi_mr_cache_delete(struct ofi_mr_cache *cache, struct ofi_mr_entry *entry)
 	       entry->info.iov.iov_base, entry->info.iov.iov_len);
 
 	pthread_mutex_lock(&mm_lock);
-	cache->delete_cnt++;
+	ofi_metric_inc(&cache->delete_cnt);
 
 	if (--entry->use_cnt == 0) {
 		if (!entry->node) {
@@ -343,7 +343,7 @@ int ofi_mr_cache_search(struct ofi_mr_cache *cache, const struct ofi_mr_info *in
 			pthread_mutex_lock(&mm_lock);
 		}
 
-		cache->search_cnt++;
+		ofi_metric_inc(&cache->search_cnt);
 		*entry = ofi_mr_rbt_find(&cache->tree, info);
 
 		if (*entry &&
@@ -368,7 +368,7 @@ int ofi_mr_cache_search(struct ofi_mr_cache *cache, const struct ofi_mr_info *in
 	return ret;
 
 hit:
-	cache->hit_cnt++;
+	ofi_metric_inc(&cache->hit_cnt);
 	if ((*entry)->use_cnt++ == 0)
 		dlist_remove_init(&(*entry)->list_entry);
 	pthread_mutex_unlock(&mm_lock);
@@ -386,7 +386,7 @@ struct ofi_mr_entry *ofi_mr_cache_find(struct ofi_mr_cache *cache,
 	       attr->mr_iov->iov_base, attr->mr_iov->iov_len);
 
 	pthread_mutex_lock(&mm_lock);
-	cache->search_cnt++;
+	ofi_metric_inc(&cache->search_cnt);
 
 	info.iov = *attr->mr_iov;
 	entry = ofi_mr_rbt_find(&cache->tree, &info);
@@ -399,7 +399,7 @@ struct ofi_mr_entry *ofi_mr_cache_find(struct ofi_mr_cache *cache,
 		goto unlock;
 	}
 
-	cache->hit_cnt++;
+	ofi_metric_inc(&cache->hit_cnt);
 	if ((entry)->use_cnt++ == 0)
 		dlist_remove_init(&(entry)->list_entry);
 
@@ -445,6 +445,14 @@ buf_free:
 	return ret;
 }
 
+static void ofi_mr_cache_metrics_fini(struct ofi_mr_cache *cache)
+{
+	ofi_metric_fini(&cache->search_cnt);
+	ofi_metric_fini(&cache->delete_cnt);
+	ofi_metric_fini(&cache->hit_cnt);
+	ofi_metric_fini(&cache->notify_cnt);
+}
+
 void ofi_mr_cache_cleanup(struct ofi_mr_cache *cache)
 {
 	/* If we don't have a domain, initialization failed */
@@ -452,9 +460,12 @@ void ofi_mr_cache_cleanup(struct ofi_mr_cache *cache)
 		return;
 
 	FI_INFO(cache->domain->prov, FI_LOG_MR, "MR cache stats: "
-		"searches %zu, deletes %zu, hits %zu notify %zu\n",
-		cache->search_cnt, cache->delete_cnt, cache->hit_cnt,
-		cache->notify_cnt);
+		"searches %" PRIu64 ", deletes %" PRIu64 ", hits %" PRIu64
+		" notify %" PRIu64 "\n",
+		ofi_metric_get(&cache->search_cnt),
+		ofi_metric_get(&cache->delete_cnt),
+		ofi_metric_get(&cache->hit_cnt),
+		ofi_metric_get(&cache->notify_cnt));
 
 	while (ofi_mr_cache_flush(cache, true))
 		;
@@ -462,6 +473,7 @@ void ofi_mr_cache_cleanup(struct ofi_mr_cache *cache)
 	pthread_mutex_destroy(&cache->lock);
 	ofi_monitors_del_cache(cache);
 	ofi_rbmap_cleanup(&cache->tree);
+	ofi_mr_cache_metrics_fini(cache);
 	ofi_atomic_dec32(&cache->domain->ref);
 	ofi_bufpool_destroy(cache->entry_pool);
 	assert(cache->cached_cnt == 0);
@@ -488,10 +500,14 @@ int ofi_mr_cache_init(struct util_domain *domain,
 	cache->cached_size = 0;
 	cache->uncached_cnt = 0;
 	cache->uncached_size = 0;
-	cache->search_cnt = 0;
-	cache->delete_cnt = 0;
-	cache->hit_cnt = 0;
-	cache->notify_cnt = 0;
+	ofi_metric_init(&cache->search_cnt, domain->prov, "mr_cache.searches",
+			OFI_METRIC_COUNTER);
+	ofi_metric_init(&cache->delete_cnt, domain->prov, "mr_cache.deletes",
+			OFI_METRIC_COUNTER);
+	ofi_metric_init(&cache->hit_cnt, domain->prov, "mr_cache.hits",
+			OFI_METRIC_COUNTER);
+	ofi_metric_init(&cache->notify_cnt, domain->prov, "mr_cache.notifies",
+			OFI_METRIC_COUNTER);
 	cache->domain = domain;
 	ofi_atomic_inc32(&domain->ref);
 
@@ -512,6 +528,7 @@ del:
 	ofi_monitors_del_cache(cache);
 destroy:
 	ofi_rbmap_cleanup(&cache->tree);
+	ofi_mr_cache_metrics_fini(cache);
 	ofi_atomic_dec32(&cache->domain->ref);
 	pthread_mutex_destroy(&cache->lock);
 	cache->domain = NULL;
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * The cumulative ack releases the leading sequence numbers of a packet
+ * from the tx window, while range acks only mark which of the others need
+ * not be resent: the peer may drop what it holds past a gap, so a packet
+ * is only released once the cumulative ack covers all of it.
+ *
+ * On a retransmission timeout the oldest unacked packet is always resent,
+ * even if the peer reported holding all of it, since the cumulative ack
+ * that would have released it may have been lost.  Holes before the
+ * highest range acked sequence number are resent once they are older
+ * than the smoothed RTT, without waiting for the timer.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ofi_rdgram.h>
+
+
+int ofi_rdg_init(struct ofi_rdg *rdg, const struct ofi_rdg_attr *attr)
+{
+	if (attr->peer_size < sizeof(struct ofi_rdg_peer) || !attr->ops ||
+	    !attr->ops->resend || !attr->ops->release || !attr->ops->send_ack)
+		return -FI_EINVAL;
+
+	rdg->attr = *attr;
+	if (!rdg->attr.ack_batch)
+		rdg->attr.ack_batch = 1;
+	rdg->peers = NULL;
+	rdg->peer_cnt = 0;
+	dlist_init(&rdg->ack_list);
+	return 0;
+}
+
+void ofi_rdg_close(struct ofi_rdg *rdg)
+{
+	size_t i;
+
+	for (i = 0; i < rdg->peer_cnt; i++)
+		free(rdg->peers[i]);
+	free(rdg->peers);
+	rdg->peers = NULL;
+	rdg->peer_cnt = 0;
+}
+
+static int rdg_grow_peers(struct ofi_rdg *rdg, uint64_t index)
+{
+	struct ofi_rdg_peer **peers;
+	size_t cnt;
+
+	cnt = roundup_power_of_two(MAX(index + 1, 64));
+	peers = realloc(rdg->peers, cnt * sizeof(*peers));
+	if (!peers)
+		return -FI_ENOMEM;
+
+	memset(&peers[rdg->peer_cnt], 0,
+	       (cnt - rdg->peer_cnt) * sizeof(*peers));
+	rdg->peers = peers;
+	rdg->peer_cnt = cnt;
+	return 0;
+}
+
+int ofi_rdg_peer_create(struct ofi_rdg *rdg, uint64_t index,
+			struct ofi_rdg_peer **peer)
+{
+	if (index >= rdg->peer_cnt && rdg_grow_peers(rdg, index))
+		return -FI_ENOMEM;
+
+	if (!rdg->peers[index]) {
+		rdg->peers[index] = calloc(1, rdg->attr.peer_size);
+		if (!rdg->peers[index])
+			return -FI_ENOMEM;
+
+		rdg->peers[index]->rto = MAX(OFI_RDG_INIT_RTO,
+					     rdg->attr.min_rto);
+		dlist_init(&rdg->peers[index]->unacked);
+	}
+
+	*peer = rdg->peers[index];
+	return 0;
+}
+
+/* The transport may still be sending the packet, in which case it is
+ * released from ofi_rdg_send_done() */
+static void rdg_release(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt)
+{
+	pkt->flags |= OFI_RDG_PKT_ACKED;
+	if (pkt->flags & OFI_RDG_PKT_IN_USE)
+		return;
+
+	dlist_remove(&pkt->entry);
+	rdg->attr.ops->release(rdg, pkt);
+}
+
+void ofi_rdg_peer_flush(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer)
+{
+	struct ofi_rdg_pkt *pkt;
+
+	while (!dlist_empty(&peer->unacked)) {
+		dlist_pop_front(&peer->unacked, struct ofi_rdg_pkt, pkt, entry);
+		peer->unacked_cnt -= ofi_rdg_pkt_unacked(pkt);
+		rdg->attr.ops->release(rdg, pkt);
+	}
+
+	if (peer->ack_pending) {
+		dlist_remove(&peer->ack_entry);
+		peer->ack_pending = 0;
+	}
+}
+
+int ofi_rdg_send_done(struct ofi_rdg *rdg, struct ofi_rdg_pkt *pkt)
+{
+	if (pkt->send_cnt && --pkt->send_cnt)
+		return 0;
+
+	pkt->flags &= ~OFI_RDG_PKT_IN_USE;
+	if (!(pkt->flags & OFI_RDG_PKT_ACKED))
+		return 0;
+
+	dlist_remove(&pkt->entry);
+	rdg->attr.ops->release(rdg, pkt);
+	return 1;
+}
+
+void ofi_rdg_pkt_acked(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+		       struct ofi_rdg_pkt *pkt)
+{
+	if (pkt->flags & OFI_RDG_PKT_ACKED)
+		return;
+
+	peer->unacked_cnt -= ofi_rdg_pkt_unacked(pkt);
+	pkt->acked_cnt = pkt->seg_cnt;
+	rdg_release(rdg, pkt);
+}
+
+/*
+ * RTO estimation as described in RFC 6298.  Samples must only be taken
+ * from packets that were never retransmitted (Karn's algorithm).
+ */
+static void rdg_update_rtt(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			   uint64_t rtt)
+{
+	uint64_t delta;
+
+	rtt = MAX(rtt, 1);
+	if (!peer->srtt) {
+		peer->srtt = rtt;
+		peer->rttvar = rtt / 2;
+	} else {
+		delta = peer->srtt > rtt ? peer->srtt - rtt : rtt - peer->srtt;
+		peer->rttvar = (3 * peer->rttvar + delta) / 4;
+		peer->srtt = (7 * peer->srtt + rtt) / 8;
+	}
+
+	peer->rto = MAX(peer->srtt + 4 * peer->rttvar, rdg->attr.min_rto);
+	peer->rto = MIN(peer->rto, OFI_RDG_MAX_RTO);
+}
+
+/* Mask of the sequence numbers of pkt that fall in the ranges */
+static uint64_t rdg_range_mask(struct ofi_rdg_pkt *pkt, uint64_t seq_no,
+			       const struct ofi_rdg_range *range,
+			       uint32_t range_cnt)
+{
+	int64_t lo, hi, start;
+	uint64_t mask = 0;
+	uint32_t i;
+
+	start = (int64_t) (pkt->seq_no - seq_no);
+	for (i = 0; i < range_cnt; i++) {
+		lo = MAX(start, (int64_t) range[i].start);
+		hi = MIN(start + pkt->seg_cnt,
+			 (int64_t) range[i].start + range[i].len);
+		if (lo < hi)
+			mask |= ofi_rdg_win_mask((uint32_t) (hi - lo)) <<
+				(lo - start);
+	}
+	return mask;
+}
+
+/* Returns the number of sequence numbers newly covered by the cumulative
+ * ack */
+static uint32_t rdg_ack_pkt(struct ofi_rdg_peer *peer, struct ofi_rdg_pkt *pkt,
+			    uint64_t seq_no, const struct ofi_rdg_range *range,
+			    uint32_t range_cnt)
+{
+	uint64_t acked_mask;
+	uint32_t cum = 0, newly = 0;
+
+	if (ofi_before(pkt->seq_no, seq_no))
+		cum = (uint32_t) MIN(seq_no - pkt->seq_no, pkt->seg_cnt);
+	if (cum > pkt->acked_cnt) {
+		newly = cum - pkt->acked_cnt;
+		pkt->acked_cnt = cum;
+		peer->unacked_cnt -= newly;
+	}
+
+	acked_mask = ofi_rdg_win_mask(pkt->acked_cnt);
+	pkt->sacked = rdg_range_mask(pkt, seq_no, range, range_cnt) &
+		      ~acked_mask;
+	if (pkt->acked_cnt < pkt->seg_cnt &&
+	    (pkt->sacked | acked_mask) == ofi_rdg_win_mask(pkt->seg_cnt))
+		pkt->flags |= OFI_RDG_PKT_SACKED;
+	else
+		pkt->flags &= ~OFI_RDG_PKT_SACKED;
+
+	return newly;
+}
+
+int ofi_rdg_recv_ack(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+		     uint64_t seq_no, const struct ofi_rdg_range *range,
+		     uint32_t range_cnt)
+{
+	struct ofi_rdg_pkt *pkt;
+	struct dlist_entry *tmp;
+	uint64_t sack_high = 0, rtt_ts = 0, now;
+	uint32_t acked = 0, newly;
+	int sacked = 0, resent = 0, first;
+
+	if (peer->last_rx_ack == seq_no && !range_cnt)
+		return 0;
+
+	peer->last_rx_ack = seq_no;
+
+	dlist_foreach_container_safe(&peer->unacked, struct ofi_rdg_pkt,
+				     pkt, entry, tmp) {
+		if (ofi_before(seq_no + OFI_RDG_RX_BITS, pkt->seq_no))
+			break;
+		if (pkt->flags & OFI_RDG_PKT_ACKED)
+			continue;
+
+		first = !(pkt->flags & OFI_RDG_PKT_RETRANS) &&
+			!pkt->acked_cnt && !pkt->sacked;
+		newly = rdg_ack_pkt(peer, pkt, seq_no, range, range_cnt);
+		if (first && (newly || pkt->sacked))
+			rtt_ts = pkt->timestamp;
+		if (pkt->sacked) {
+			sack_high = pkt->seq_no + ofi_msb(pkt->sacked) - 1;
+			sacked = 1;
+		}
+		if (!newly)
+			continue;
+
+		peer->retry_cnt = 0;
+		acked += newly;
+		if (pkt->acked_cnt == pkt->seg_cnt)
+			rdg_release(rdg, pkt);
+	}
+
+	now = ofi_gettime_us();
+	if (rtt_ts)
+		rdg_update_rtt(rdg, peer, now - rtt_ts);
+	if (acked && rdg->attr.ops->ack)
+		rdg->attr.ops->ack(rdg, peer, acked);
+
+	if (!sacked)
+		return 1;
+
+	dlist_foreach_container(&peer->unacked, struct ofi_rdg_pkt,
+				pkt, entry) {
+		if (!ofi_before(pkt->seq_no, sack_high))
+			break;
+		if (pkt->flags & (OFI_RDG_PKT_IN_USE | OFI_RDG_PKT_ACKED |
+				  OFI_RDG_PKT_SACKED) ||
+		    now < pkt->timestamp + peer->srtt)
+			continue;
+		pkt->flags |= OFI_RDG_PKT_RETRANS;
+		if (rdg->attr.ops->resend(rdg, pkt))
+			break;
+		resent = 1;
+	}
+	if (resent && rdg->attr.ops->loss)
+		rdg->attr.ops->loss(rdg, peer, 0);
+	return 1;
+}
+
+int ofi_rdg_progress_peer(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer,
+			  uint64_t now)
+{
+	struct ofi_rdg_pkt *pkt;
+	int retry = 0, head = 1, skip;
+
+	if (peer->retry_cnt > rdg->attr.max_retry)
+		return -FI_ETIMEDOUT;
+
+	dlist_foreach_container(&peer->unacked, struct ofi_rdg_pkt,
+				pkt, entry) {
+		if (pkt->flags & OFI_RDG_PKT_ACKED)
+			continue;
+		skip = pkt->flags & OFI_RDG_PKT_IN_USE ||
+		       (pkt->flags & OFI_RDG_PKT_SACKED && !head) ||
+		       now < pkt->timestamp + peer->rto;
+		head = 0;
+		if (skip)
+			continue;
+		retry = 1;
+		pkt->flags |= OFI_RDG_PKT_RETRANS;
+		if (rdg->attr.ops->resend(rdg, pkt))
+			break;
+	}
+
+	if (retry) {
+		peer->retry_cnt++;
+		peer->rto = MIN(peer->rto << 1, OFI_RDG_MAX_RTO);
+		if (rdg->attr.ops->loss)
+			rdg->attr.ops->loss(rdg, peer, 1);
+	}
+	return 0;
+}
+
+void ofi_rdg_rx_skip(struct ofi_rdg_peer *peer, uint64_t seq_no)
+{
+	if (!ofi_before(peer->rx_seq_no, seq_no))
+		return;
+
+	if (seq_no - peer->rx_seq_no >= OFI_RDG_RX_BITS) {
+		memset(peer->rx_held, 0, sizeof(peer->rx_held));
+		peer->rx_held_cnt = 0;
+		peer->rx_seq_no = seq_no;
+		return;
+	}
+
+	while (peer->rx_seq_no != seq_no)
+		ofi_rdg_rx_next(peer);
+}
+
+/*
+ * Held sequence numbers are stored by their value modulo OFI_RDG_RX_BITS,
+ * so rotate them to their offset from the next expected one first.
+ */
+uint32_t ofi_rdg_ack_ranges(struct ofi_rdg_peer *peer,
+			    struct ofi_rdg_range *range, uint32_t max)
+{
+	uint64_t rel[OFI_RDG_RX_WORDS] = { 0 };
+	uint64_t word, bit, base;
+	uint32_t cnt = 0;
+	int i;
+
+	if (!peer->rx_held_cnt)
+		return 0;
+
+	base = peer->rx_seq_no % OFI_RDG_RX_BITS;
+	for (i = 0; i < OFI_RDG_RX_WORDS; i++) {
+		for (word = peer->rx_held[i]; word; word &= word - 1) {
+			bit = i * 64 + ofi_lsb(word) - 1;
+			bit = (bit + OFI_RDG_RX_BITS - base) % OFI_RDG_RX_BITS;
+			rel[bit / 64] |= 1ULL << (bit % 64);
+		}
+	}
+
+	/* Offset 0 is the next expected sequence number, which may still be
+	 * marked while it is being delivered */
+	rel[0] &= ~1ULL;
+	for (i = 0; i < OFI_RDG_RX_WORDS; i++) {
+		for (word = rel[i]; word; word &= word - 1) {
+			bit = i * 64 + ofi_lsb(word) - 1;
+			if (cnt && range[cnt - 1].start + range[cnt - 1].len ==
+			    bit) {
+				range[cnt - 1].len++;
+				continue;
+			}
+			if (cnt == max)
+				return cnt;
+			range[cnt].start = (uint32_t) bit;
+			range[cnt++].len = 1;
+		}
+	}
+	return cnt;
+}
+
+void ofi_rdg_ack_req(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer)
+{
+	if (!peer->ack_pending++)
+		dlist_insert_tail(&peer->ack_entry, &rdg->ack_list);
+
+	if (peer->ack_pending >= rdg->attr.ack_batch)
+		rdg->attr.ops->send_ack(rdg, peer);
+}
+
+void ofi_rdg_flush_acks(struct ofi_rdg *rdg)
+{
+	struct ofi_rdg_peer *peer;
+
+	while (!dlist_empty(&rdg->ack_list)) {
+		dlist_pop_front(&rdg->ack_list, struct ofi_rdg_peer, peer,
+				ack_entry);
+		peer->ack_pending = 0;
+		rdg->attr.ops->send_ack(rdg, peer);
+	}
+}
+
+void ofi_rdg_ack_sent(struct ofi_rdg *rdg, struct ofi_rdg_peer *peer)
+{
+	peer->last_tx_ack = peer->rx_seq_no;
+	if (peer->ack_pending) {
+		dlist_remove(&peer->ack_entry);
+		peer->ack_pending = 0;
+	}
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <ofi_trace.h>
+#include <ofi_list.h>
+
+#define OFI_TRACE_CALIBRATE_NS	1000000
+
+static pthread_mutex_t ofi_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ofi_trace_key;
+static DEFINE_LIST(ofi_trace_rings);
+static int ofi_trace_active;
+static char ofi_trace_dir[PATH_MAX];
+static size_t ofi_trace_records;
+static enum ofi_trace_clock ofi_trace_clk;
+static uint64_t ofi_trace_tsc_mult;
+static uint64_t ofi_trace_sync_tsc;
+static uint64_t ofi_trace_sync_ns;
+
+static uint32_t ofi_trace_gettid(void)
+{
+#ifdef __linux__
+	return (uint32_t) syscall(SYS_gettid);
+#else
+	static uint32_t next_tid;
+
+	return __sync_add_and_fetch(&next_tid, 1);
+#endif
+}
+
+static int ofi_trace_have_tsc(void)
+{
+	unsigned cpuinfo[4] = { 0 };
+
+	ofi_cpuid(0x80000000, 0, cpuinfo);
+	if (cpuinfo[0] < 0x80000007)
+		return 0;
+
+	/* invariant TSC: constant rate, does not stop in deep C-states */
+	ofi_cpuid(0x80000007, 0, cpuinfo);
+	return cpuinfo[3] & (1 << 8);
+}
+
+/* nsec per tick, scaled by 2^32, measured against the monotonic clock */
+static void ofi_trace_calibrate(void)
+{
+	uint64_t ns, tsc;
+
+	ofi_trace_sync_ns = ofi_gettime_ns();
+	ofi_trace_sync_tsc = ofi_trace_rdtsc();
+	do {
+		ns = ofi_gettime_ns();
+		tsc = ofi_trace_rdtsc();
+	} while (ns - ofi_trace_sync_ns < OFI_TRACE_CALIBRATE_NS);
+
+	ofi_trace_tsc_mult = ((ns - ofi_trace_sync_ns) << 32) /
+			     MAX(tsc - ofi_trace_sync_tsc, 1);
+}
+
+static void ofi_trace_ring_close(struct ofi_trace_ring *ring)
+{
+	if (ring->hdr->clock == OFI_TRACE_CLOCK_TSC) {
+		ring->hdr->sync_ns[1] = ofi_gettime_ns();
+		ring->hdr->sync_tsc[1] = ofi_trace_rdtsc();
+	}
+	munmap(ring->hdr, ring->size);
+	free(ring);
+}
+
+static void ofi_trace_thread_exit(void *arg)
+{
+	struct ofi_trace_ring *ring = arg;
+
+	pthread_mutex_lock(&ofi_trace_lock);
+	dlist_remove(&ring->entry);
+	ofi_trace_ring_close(ring);
+	pthread_mutex_unlock(&ofi_trace_lock);
+}
+
+static struct ofi_trace_ring *ofi_trace_ring_create(void)
+{
+	struct ofi_trace_ring *ring;
+	struct ofi_trace_hdr *hdr;
+	char path[PATH_MAX];
+	uint32_t tid;
+	size_t size;
+	int fd;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	tid = ofi_trace_gettid();
+	if (snprintf(path, sizeof(path), "%s/fi_trace.%d.%u", ofi_trace_dir,
+		     (int) getpid(), tid) >= (int) sizeof(path)) {
+		errno = ENAMETOOLONG;
+		goto err1;
+	}
+	size = sizeof(*hdr) + ofi_trace_records * sizeof(struct ofi_trace_rec);
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto err1;
+	if (ftruncate(fd, size))
+		goto err2;
+
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		goto err2;
+	close(fd);
+
+	hdr->version = OFI_TRACE_VERSION;
+	hdr->rec_size = sizeof(struct ofi_trace_rec);
+	hdr->capacity = ofi_trace_records;
+	hdr->pid = (uint32_t) getpid();
+	hdr->tid = tid;
+	hdr->clock = ofi_trace_clk;
+	hdr->tsc_mult = ofi_trace_tsc_mult;
+	hdr->sync_tsc[0] = ofi_trace_sync_tsc;
+	hdr->sync_ns[0] = ofi_trace_sync_ns;
+	/* a reader that sees the magic sees a complete header */
+	__atomic_store_n(&hdr->magic, OFI_TRACE_MAGIC, __ATOMIC_RELEASE);
+
+	ring->hdr = hdr;
+	ring->recs = (struct ofi_trace_rec *) (hdr + 1);
+	ring->mask = ofi_trace_records - 1;
+	ring->size = size;
+	return ring;
+
+err2:
+	close(fd);
+	unlink(path);
+err1:
+	FI_WARN(&core_prov, FI_LOG_CORE, "unable to create trace file %s: %s\n",
+		path, strerror(errno));
+	free(ring);
+	return NULL;
+}
+
+struct ofi_trace_ring *ofi_trace_ring_get(void)
+{
+	struct ofi_trace_ring *ring = NULL;
+
+	if (!ofi_trace_active)
+		return NULL;
+
+	ring = pthread_getspecific(ofi_trace_key);
+	if (ring)
+		return ring;
+
+	pthread_mutex_lock(&ofi_trace_lock);
+	if (!ofi_trace_active)
+		goto unlock;
+
+	ring = ofi_trace_ring_create();
+	if (!ring)
+		goto unlock;
+
+	if (pthread_setspecific(ofi_trace_key, ring)) {
+		ofi_trace_ring_close(ring);
+		ring = NULL;
+		goto unlock;
+	}
+	dlist_insert_tail(&ring->entry, &ofi_trace_rings);
+unlock:
+	pthread_mutex_unlock(&ofi_trace_lock);
+	return ring;
+}
+
+int ofi_trace_open(const char *dir, size_t records, enum ofi_trace_clock clock)
+{
+	int ret = 0;
+
+	if (strlen(dir) >= sizeof(ofi_trace_dir) - 32)
+		return -FI_EINVAL;
+
+	pthread_mutex_lock(&ofi_trace_lock);
+	if (ofi_trace_active) {
+		ret = -FI_EALREADY;
+		goto unlock;
+	}
+
+	if (pthread_key_create(&ofi_trace_key, ofi_trace_thread_exit)) {
+		ret = -FI_ENOMEM;
+		goto unlock;
+	}
+
+	strcpy(ofi_trace_dir, dir);
+	ofi_trace_records = roundup_power_of_two(MAX(records, 2));
+	ofi_trace_clk = OFI_TRACE_CLOCK_MONO;
+	if (clock == OFI_TRACE_CLOCK_TSC) {
+		if (ofi_trace_have_tsc()) {
+			ofi_trace_calibrate();
+			ofi_trace_clk = OFI_TRACE_CLOCK_TSC;
+		} else {
+			FI_INFO(&core_prov, FI_LOG_CORE, "no invariant TSC, "
+				"tracing with the monotonic clock\n");
+		}
+	}
+	ofi_trace_active = 1;
+unlock:
+	pthread_mutex_unlock(&ofi_trace_lock);
+	return ret;
+}
+
+void ofi_trace_close(void)
+{
+	struct ofi_trace_ring *ring;
+
+	pthread_mutex_lock(&ofi_trace_lock);
+	if (!ofi_trace_active)
+		goto unlock;
+
+	while (!dlist_empty(&ofi_trace_rings)) {
+		dlist_pop_front(&ofi_trace_rings, struct ofi_trace_ring,
+				ring, entry);
+		ofi_trace_ring_close(ring);
+	}
+	pthread_key_delete(ofi_trace_key);
+	ofi_trace_active = 0;
+unlock:
+	pthread_mutex_unlock(&ofi_trace_lock);
+}
+
+int ofi_trace_enabled(void)
+{
+	return ofi_trace_active;
+}
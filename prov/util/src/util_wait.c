@@ -39,6 +39,9 @@
 #include <ofi_util.h>
 #include <ofi_epoll.h>
 
+/* default limit of an adaptive spin, in microseconds */
+#define OFI_WAIT_SPIN_MAX	50
+
 
 int ofi_trywait(struct fid_fabric *fabric, struct fid **fids, int count)
 {
@@ -123,6 +126,65 @@ int fi_wait_cleanup(struct util_wait *wait)
 	return 0;
 }
 
+static void util_wait_init_policy(struct util_wait *wait)
+{
+	char *policy = NULL;
+	int spin_max = OFI_WAIT_SPIN_MAX;
+
+	fi_param_get_str(NULL, "wait_policy", &policy);
+	fi_param_get_int(NULL, "wait_spin_max", &spin_max);
+
+	if (!policy || !strcasecmp(policy, "adaptive")) {
+		wait->policy = OFI_WAIT_ADAPTIVE;
+	} else if (!strcasecmp(policy, "spin")) {
+		wait->policy = OFI_WAIT_SPIN;
+	} else if (!strcasecmp(policy, "block")) {
+		wait->policy = OFI_WAIT_BLOCK;
+	} else {
+		FI_WARN(wait->prov, FI_LOG_FABRIC,
+			"unknown FI_WAIT_POLICY %s, using adaptive\n", policy);
+		wait->policy = OFI_WAIT_ADAPTIVE;
+	}
+
+	/* with a single CPU, the event cannot arrive while we spin */
+	if (spin_max > 0 && ofi_sysconf(_SC_NPROCESSORS_ONLN) == 1)
+		spin_max = 0;
+	wait->spin_max = spin_max > 0 ? (uint64_t) spin_max * 1000 : 0;
+	wait->wait_avg = 0;
+}
+
+/* Returns the time, in ns, to spin before blocking */
+static uint64_t util_wait_spin_time(struct util_wait *wait)
+{
+	uint64_t spin;
+
+	switch (wait->policy) {
+	case OFI_WAIT_SPIN:
+		return UINT64_MAX;
+	case OFI_WAIT_BLOCK:
+		return 0;
+	default:
+		spin = wait->wait_avg * 2;
+		return spin <= wait->spin_max ? spin : 0;
+	}
+}
+
+/*
+ * Samples are capped so that one long idle period does not disable
+ * spinning, while a run of them does.
+ */
+static void util_wait_update_avg(struct util_wait *wait, uint64_t start)
+{
+	uint64_t elapsed;
+
+	if (wait->policy != OFI_WAIT_ADAPTIVE)
+		return;
+
+	elapsed = MIN(ofi_gettime_ns() - start, wait->spin_max * 4);
+	wait->wait_avg = wait->wait_avg - (wait->wait_avg >> 3) +
+			 (elapsed >> 3);
+}
+
 int ofi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 		  struct util_wait *wait)
 {
@@ -131,6 +193,7 @@ int ofi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 	int ret;
 
 	wait->prov = fabric->prov;
+	util_wait_init_policy(wait);
 	ofi_atomic_initialize32(&wait->ref, 0);
 	wait->wait_fid.fid.fclass = FI_CLASS_WAIT;
 
@@ -331,7 +394,11 @@ static int util_wait_update_pollfd(struct util_wait_fd *wait_fd,
 	return -FI_EAGAIN;
 }
 
-static int util_wait_fd_try(struct util_wait *wait)
+/*
+ * The signal is left set, so that it is not lost while spinning between
+ * calls that do not block.
+ */
+static int util_wait_fd_check(struct util_wait *wait)
 {
 	struct ofi_wait_fid_entry *fid_entry;
 	struct ofi_wait_fd_entry *fd_entry;
@@ -340,7 +407,6 @@ static int util_wait_fd_try(struct util_wait *wait)
 	int ret;
 
 	wait_fd = container_of(wait, struct util_wait_fd, util_wait);
-	fd_signal_reset(&wait_fd->signal);
 	ofi_mutex_lock(&wait->lock);
 	dlist_foreach_container(&wait_fd->fd_list, struct ofi_wait_fd_entry,
 				fd_entry, entry) {
@@ -371,41 +437,71 @@ release:
 	return ret;
 }
 
+static int util_wait_fd_try(struct util_wait *wait)
+{
+	struct util_wait_fd *wait_fd;
+
+	wait_fd = container_of(wait, struct util_wait_fd, util_wait);
+	fd_signal_reset(&wait_fd->signal);
+	return util_wait_fd_check(wait);
+}
+
+/*
+ * While spinning, progress is driven through util_wait_fd_check and the
+ * fds are polled without blocking, until the spin time runs out.
+ */
 static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 {
 	struct ofi_epollfds_event event;
 	struct util_wait_fd *wait;
-	uint64_t endtime;
-	int ret;
+	uint64_t start, spin, endtime;
+	int ret, spinning = 0;
 
 	wait = container_of(wait_fid, struct util_wait_fd, util_wait.wait_fid);
+	start = ofi_gettime_ns();
+	spin = util_wait_spin_time(&wait->util_wait);
 	endtime = ofi_timeout_time(timeout);
 
 	while (1) {
-		ret = wait->util_wait.wait_try(&wait->util_wait);
-		if (ret)
-			return ret == -FI_EAGAIN ? 0 : ret;
+		ret = spinning ? util_wait_fd_check(&wait->util_wait) :
+		      wait->util_wait.wait_try(&wait->util_wait);
+		if (ret) {
+			ret = (ret == -FI_EAGAIN) ? 0 : ret;
+			break;
+		}
 
-		if (ofi_adjust_timeout(endtime, &timeout))
-			return -FI_ETIMEDOUT;
+		if (ofi_adjust_timeout(endtime, &timeout)) {
+			ret = -FI_ETIMEDOUT;
+			break;
+		}
 
+		spinning = spin && (ofi_gettime_ns() - start < spin);
 		ret = (wait->util_wait.wait_obj == FI_WAIT_FD) ?
-		      ofi_epoll_wait(wait->epoll_fd, &event, 1, timeout) :
-		      ofi_pollfds_wait(wait->pollfds, &event, 1, timeout);
-		if (ret > 0)
-			return FI_SUCCESS;
+		      ofi_epoll_wait(wait->epoll_fd, &event, 1,
+				     spinning ? 0 : timeout) :
+		      ofi_pollfds_wait(wait->pollfds, &event, 1,
+				       spinning ? 0 : timeout);
+		if (ret > 0) {
+			ret = FI_SUCCESS;
+			break;
+		}
 
 		if (ret < 0) {
 #if ENABLE_DEBUG
 			/* ignore interrupts in order to enable debugging */
-			if (ret == -FI_EINTR)
+			if (ret == -FI_EINTR) {
+				spinning = 0;
 				continue;
+			}
 #endif
 			FI_WARN(wait->util_wait.prov, FI_LOG_FABRIC,
 				"poll failed\n");
 			return ret;
 		}
 	}
+
+	util_wait_update_avg(&wait->util_wait, start);
+	return ret;
 }
 
 static int util_wait_fd_control(struct fid *fid, int command, void *arg)
@@ -593,9 +689,14 @@ static int util_wait_yield_run(struct fid_wait *wait_fid, int timeout)
 {
 	struct util_wait_yield *wait;
 	struct ofi_wait_fid_entry *fid_entry;
+	uint64_t start, spin, endtime;
 	int ret = 0;
 
 	wait = container_of(wait_fid, struct util_wait_yield, util_wait.wait_fid);
+	start = ofi_gettime_ns();
+	spin = util_wait_spin_time(&wait->util_wait);
+	endtime = ofi_timeout_time(timeout);
+
 	while (!wait->signal) {
 		ofi_mutex_lock(&wait->util_wait.lock);
 		dlist_foreach_container(&wait->util_wait.fid_list,
@@ -608,13 +709,21 @@ static int util_wait_yield_run(struct fid_wait *wait_fid, int timeout)
 			}
 		}
 		ofi_mutex_unlock(&wait->util_wait.lock);
-		sched_yield();
+
+		if (ofi_adjust_timeout(endtime, &timeout)) {
+			util_wait_update_avg(&wait->util_wait, start);
+			return -FI_ETIMEDOUT;
+		}
+
+		if (!spin || ofi_gettime_ns() - start >= spin)
+			sched_yield();
 	}
 
 	ofi_mutex_lock(&wait->signal_lock);
 	wait->signal = 0;
 	ofi_mutex_unlock(&wait->signal_lock);
 
+	util_wait_update_avg(&wait->util_wait, start);
 	return FI_SUCCESS;
 }
 
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/*
+ * Each benchmark compares a few modes, listed once as X(id, description)
+ * pairs, for example:
+ *
+ *	#define BENCH_MODES(X)				\
+ *		X(BENCH_LOCKED, "locked pool")		\
+ *		X(BENCH_CACHED, "thread cache")
+ *	BENCH_DECLARE_MODES(BENCH_MODES);
+ *
+ * declares the ids, BENCH_MAX, and bench_name[] holding the descriptions.
+ */
+#define BENCH_MODE_ID(id, name)		id,
+#define BENCH_MODE_NAME(id, name)	name,
+#define BENCH_DECLARE_MODES(MODES)					\
+	enum { MODES(BENCH_MODE_ID) BENCH_MAX };			\
+	static const char *bench_name[BENCH_MAX] = { MODES(BENCH_MODE_NAME) }
+
+#endif /* _BENCH_H_ */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures buffer pool allocations from several threads sharing a pool,
+ * serialized by a lock as callers must for a plain pool, against a pool
+ * with per-thread caches.  Each buffer is checked to have a single owner,
+ * and every buffer is verified to be back in the pool at the end.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <ofi.h>
+#include <ofi_mem.h>
+
+#include "bench.h"
+
+#define BURST_MAX	64
+
+#define BENCH_MODES(X)				\
+	X(BENCH_LOCKED, "locked pool")		\
+	X(BENCH_CACHED, "thread cache")
+BENCH_DECLARE_MODES(BENCH_MODES);
+
+struct bench_buf {
+	uint64_t	owner;
+	uint64_t	seq;
+};
+
+struct bench_thread {
+	pthread_t	thread;
+	uint64_t	id;
+	int		failed;
+};
+
+static struct ofi_bufpool *pool;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t count = 1000000;
+static int burst = 16;
+static int mode;
+
+static void *bench_thread(void *arg)
+{
+	struct bench_thread *bt = arg;
+	struct bench_buf *buf[BURST_MAX];
+	uint64_t i;
+	int j;
+
+	for (i = 0; i < count; i += burst) {
+		for (j = 0; j < burst; j++) {
+			if (mode == BENCH_LOCKED)
+				pthread_mutex_lock(&pool_lock);
+			buf[j] = ofi_buf_alloc(pool);
+			if (mode == BENCH_LOCKED)
+				pthread_mutex_unlock(&pool_lock);
+
+			if (!buf[j] || buf[j]->owner ||
+			    ofi_buf_pool(buf[j]) != pool) {
+				bt->failed = 1;
+				return NULL;
+			}
+			buf[j]->owner = bt->id;
+			buf[j]->seq = i + j;
+		}
+
+		for (j = 0; j < burst; j++) {
+			if (buf[j]->owner != bt->id || buf[j]->seq != i + j)
+				bt->failed = 1;
+			buf[j]->owner = 0;
+
+			if (mode == BENCH_LOCKED)
+				pthread_mutex_lock(&pool_lock);
+			ofi_buf_free(buf[j]);
+			if (mode == BENCH_LOCKED)
+				pthread_mutex_unlock(&pool_lock);
+		}
+	}
+	return NULL;
+}
+
+/* Every buffer must be free, and allocating all of them must not grow */
+static int check_pool(void)
+{
+	struct bench_buf **bufs;
+	uint8_t *seen;
+	size_t cnt, i, index;
+	int ret = 0;
+
+	cnt = pool->entry_cnt;
+	bufs = calloc(cnt, sizeof(*bufs));
+	seen = calloc(cnt, 1);
+	if (!bufs || !seen) {
+		ret = 1;
+		goto out;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		bufs[i] = ofi_buf_alloc(pool);
+		if (!bufs[i] || pool->entry_cnt != cnt) {
+			ret = 1;
+			break;
+		}
+		index = ofi_buf_index(bufs[i]);
+		if (index >= cnt || seen[index]++ ||
+		    ofi_buf_region(bufs[i])->index != index / pool->attr.chunk_cnt)
+			ret = 1;
+	}
+	while (i--)
+		ofi_buf_free(bufs[i]);
+out:
+	free(seen);
+	free(bufs);
+	return ret;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\tallocations per thread (default 1000000)\n");
+	printf("  -b <burst>\tbuffers held at once by a thread (default 16)\n");
+	printf("  -t <threads>\tthreads (default 4)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_thread *bt;
+	uint64_t start, elapsed;
+	int threads = 4, i, op, ret = 0, failed;
+
+	while ((op = getopt(argc, argv, "n:b:t:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	bt = calloc(MAX(threads, 1), sizeof(*bt));
+	if (threads < 1 || burst < 1 || burst > BURST_MAX || !count || !bt) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	ofi_mem_init();
+	printf("%" PRIu64 " allocations per thread in bursts of %d, "
+	       "%d threads\n", count, burst, threads);
+	for (mode = 0; mode < BENCH_MAX; mode++) {
+		if (ofi_bufpool_create(&pool, sizeof(struct bench_buf), 0, 0, 0,
+				       mode == BENCH_CACHED ?
+				       OFI_BUFPOOL_THREAD_CACHE : 0)) {
+			printf("ERROR: ofi_bufpool_create failed\n");
+			return EXIT_FAILURE;
+		}
+
+		failed = 0;
+		start = ofi_gettime_ns();
+		for (i = 0; i < threads; i++) {
+			bt[i].id = i + 1;
+			bt[i].failed = 0;
+			if (pthread_create(&bt[i].thread, NULL, bench_thread,
+					   &bt[i]))
+				failed = 1;
+		}
+		for (i = 0; i < threads; i++) {
+			pthread_join(bt[i].thread, NULL);
+			failed |= bt[i].failed;
+		}
+		elapsed = ofi_gettime_ns() - start;
+		failed |= check_pool();
+
+		printf("%-14s %8.2f ns/alloc+free %8.2f Mop/s %6zu bufs%s\n",
+		       bench_name[mode], (double) elapsed / count,
+		       (double) count * threads * 1000 / elapsed,
+		       pool->entry_cnt, failed ? "  ERROR: check failed" : "");
+		ret |= failed;
+		ofi_bufpool_destroy(pool);
+	}
+
+	ofi_mem_fini();
+	free(bt);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
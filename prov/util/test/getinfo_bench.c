@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures fi_getinfo with the persistent getinfo cache, when each call
+ * misses and queries the providers, against calls served from the cache
+ * file.  The cached result is verified against the providers' own.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <ofi.h>
+#include <rdma/fi_errno.h>
+
+static char dir[] = "/tmp/fi_getinfo_bench.XXXXXX";
+
+static void clear_dir(void)
+{
+	char path[PATH_MAX];
+	struct dirent *dent;
+	DIR *dirp;
+
+	dirp = opendir(dir);
+	if (!dirp)
+		return;
+	while ((dent = readdir(dirp))) {
+		if (dent->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+		unlink(path);
+	}
+	closedir(dirp);
+}
+
+static char *info_str(struct fi_info *info)
+{
+	struct fi_info *cur;
+	char *str = NULL, *tmp;
+	size_t len = 0, n;
+	const char *s;
+
+	for (cur = info; cur; cur = cur->next) {
+		s = fi_tostr(cur, FI_TYPE_INFO);
+		n = strlen(s);
+		tmp = realloc(str, len + n + 1);
+		if (!tmp) {
+			free(str);
+			return NULL;
+		}
+		str = tmp;
+		memcpy(str + len, s, n + 1);
+		len += n;
+	}
+	return str;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\tcalls per test (default 100)\n");
+	printf("  -p <prov>\tprovider name hint (default none)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct fi_info *hints, *info;
+	char *expect = NULL, *str;
+	uint64_t start, elapsed;
+	int count = 100, i, miss, op, ret, failed = 0;
+
+	hints = fi_allocinfo();
+	if (!hints) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	while ((op = getopt(argc, argv, "n:p:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'p':
+			hints->fabric_attr->prov_name = strdup(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			fi_freeinfo(hints);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (count < 1 || !mkdtemp(dir)) {
+		printf("ERROR: setup failed\n");
+		fi_freeinfo(hints);
+		return EXIT_FAILURE;
+	}
+	setenv("FI_GETINFO_CACHE", dir, 1);
+
+	/* the first call also loads the providers */
+	start = ofi_gettime_ns();
+	ret = fi_getinfo(fi_version(), NULL, NULL, 0, hints, &info);
+	elapsed = ofi_gettime_ns() - start;
+	if (ret) {
+		printf("fi_getinfo: %s, skipping\n", fi_strerror(-ret));
+		goto out;
+	}
+	expect = info_str(info);
+	fi_freeinfo(info);
+	printf("%-20s %10.2f us\n", "first call",
+	       (double) elapsed / 1000);
+
+	for (miss = 1; miss >= 0; miss--) {
+		elapsed = 0;
+		for (i = 0; i < count; i++) {
+			if (miss)
+				clear_dir();
+			start = ofi_gettime_ns();
+			ret = fi_getinfo(fi_version(), NULL, NULL, 0, hints,
+					 &info);
+			elapsed += ofi_gettime_ns() - start;
+			if (ret) {
+				failed = 1;
+				break;
+			}
+			str = info_str(info);
+			if (!expect || !str || strcmp(str, expect))
+				failed = 1;
+			free(str);
+			fi_freeinfo(info);
+		}
+		printf("%-20s %10.2f us/call%s\n",
+		       miss ? "cache miss" : "cache hit",
+		       (double) elapsed / count / 1000,
+		       failed ? "  ERROR: wrong result" : "");
+	}
+
+out:
+	clear_dir();
+	rmdir(dir);
+	free(expect);
+	fi_freeinfo(hints);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost of logging a message, written synchronously against
+ * queued for the log thread, in text and JSON, and with rate limiting.
+ * Each run logs from a child process into a file, which is checked for
+ * every message in order, or for the rate limit.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <ofi.h>
+#include <rdma/fi_errno.h>
+
+#include "bench.h"
+
+#define RATE_LIMIT	100
+
+#define BENCH_MODES(X)				\
+	X(BENCH_SYNC, "sync, text")		\
+	X(BENCH_ASYNC, "async, text")		\
+	X(BENCH_JSON, "async, json")		\
+	X(BENCH_RATE, "async, rate limited")
+BENCH_DECLARE_MODES(BENCH_MODES);
+
+static uint64_t count = 100000;
+static int threads = 2;
+
+static void *log_thread(void *arg)
+{
+	int id = (int) (uintptr_t) arg;
+	char str[24];
+	uint64_t i;
+
+	for (i = 0; i < count; i++) {
+		/* changed after each call, so must be copied when queued */
+		snprintf(str, sizeof(str), "s%" PRIu64, i);
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"log_bench %d %" PRIu64 " %s %.1f %*d \"q\"\n",
+			id, i, str, 0.5, 4, 7);
+	}
+	return NULL;
+}
+
+static void run_child(int mode, int fd)
+{
+	struct fi_param *params;
+	pthread_t *thread;
+	uint64_t start, elapsed;
+	int i, count_params;
+
+	if (dup2(fd, STDERR_FILENO) < 0)
+		exit(EXIT_FAILURE);
+
+	setenv("FI_LOG_LEVEL", "warn", 1);
+	setenv("FI_LOG_ASYNC", mode == BENCH_SYNC ? "0" : "1", 1);
+	setenv("FI_LOG_FORMAT", mode == BENCH_JSON ? "json" : "text", 1);
+	if (mode == BENCH_RATE)
+		setenv("FI_LOG_RATE_LIMIT", OFI_STR_INT(RATE_LIMIT), 1);
+	else
+		unsetenv("FI_LOG_RATE_LIMIT");
+
+	/* initializes the library, which reads the variables */
+	if (!fi_getparams(&params, &count_params))
+		fi_freeparams(params);
+
+	thread = calloc(threads, sizeof(*thread));
+	if (!thread)
+		exit(EXIT_FAILURE);
+
+	start = ofi_gettime_ns();
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&thread[i], NULL, log_thread,
+				   (void *) (uintptr_t) i))
+			exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+	elapsed = ofi_gettime_ns() - start;
+
+	printf("%-20s %8.2f ns/msg ", bench_name[mode],
+	       (double) elapsed / (count * threads));
+	fflush(stdout);
+	free(thread);
+	/* queued messages are written out when the library is unloaded */
+	exit(EXIT_SUCCESS);
+}
+
+/* Returns the number of messages logged, or -1 if one is out of order */
+static int64_t check_file(int mode, FILE *file)
+{
+	char line[4096], *msg, quote[8];
+	uint64_t *next, i, s;
+	int64_t total = 0;
+	double val;
+	int id, num;
+
+	next = calloc(threads, sizeof(*next));
+	if (!next)
+		return -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		msg = strstr(line, "log_bench ");
+		if (!msg)
+			continue;
+
+		if (mode == BENCH_JSON &&
+		    (line[0] != '{' || !strstr(msg, "\\\"q\\\"\"}")))
+			goto err;
+
+		if (sscanf(msg, "log_bench %d %" SCNu64 " s%" SCNu64
+			   " %lf %d %7s", &id, &i, &s, &val, &num,
+			   quote) != 6 || id < 0 || id >= threads ||
+		    i != s || val != 0.5 || num != 7)
+			goto err;
+
+		if (mode != BENCH_RATE && i != next[id]++)
+			goto err;
+		total++;
+	}
+	free(next);
+	return total;
+err:
+	printf("bad line: %s", line);
+	free(next);
+	return -1;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\tmessages per thread (default 100000)\n");
+	printf("  -t <threads>\tthreads (default 2)\n");
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/fi_log_bench.XXXXXX";
+	int64_t total, expect, limit;
+	uint64_t start, secs;
+	int mode, op, fd, status, ret = 0;
+	FILE *file;
+	pid_t pid;
+
+	while ((op = getopt(argc, argv, "n:t:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (threads < 1 || !count) {
+		printf("ERROR: invalid options\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%" PRIu64 " messages per thread, %d threads\n", count, threads);
+	for (mode = 0; mode < BENCH_MAX; mode++) {
+		fd = mkstemp(path);
+		if (fd < 0) {
+			printf("ERROR: mkstemp failed\n");
+			return EXIT_FAILURE;
+		}
+
+		fflush(stdout);
+		start = ofi_gettime_ms();
+		pid = fork();
+		if (pid < 0) {
+			printf("ERROR: fork failed\n");
+			return EXIT_FAILURE;
+		}
+		if (!pid)
+			run_child(mode, fd);
+
+		waitpid(pid, &status, 0);
+		secs = (ofi_gettime_ms() - start) / 1000;
+		file = fdopen(fd, "r");
+		if (!file || fseek(file, 0, SEEK_SET)) {
+			printf("ERROR: cannot read %s\n", path);
+			return EXIT_FAILURE;
+		}
+
+		total = check_file(mode, file);
+		expect = (int64_t) count * threads;
+		/* the first second is never limited, the run may span more */
+		limit = MIN(expect, RATE_LIMIT * (int64_t) (secs + 2));
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			printf("ERROR: child failed\n");
+			ret = 1;
+		} else if (mode == BENCH_RATE ?
+			   total < MIN(expect, RATE_LIMIT) || total > limit :
+			   total != expect) {
+			printf("ERROR: %" PRId64 " of %" PRId64 " messages\n",
+			       total, expect);
+			ret = 1;
+		} else {
+			printf("%" PRId64 " logged\n", total);
+		}
+
+		fclose(file);
+		unlink(path);
+		strcpy(path, "/tmp/fi_log_bench.XXXXXX");
+	}
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
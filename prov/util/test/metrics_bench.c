@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost of a metric update, kept locally and exported through
+ * the shared memory segment, against a plain increment.  Each thread
+ * updates its own metric, and every metric's final value is verified.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <ofi.h>
+#include <ofi_metrics.h>
+
+#include "bench.h"
+
+#define BENCH_MODES(X)				\
+	X(BENCH_PLAIN, "plain increment")	\
+	X(BENCH_LOCAL, "metric, disabled")	\
+	X(BENCH_SHM, "metric, exported")
+BENCH_DECLARE_MODES(BENCH_MODES);
+
+struct bench_thread {
+	pthread_t		thread;
+	struct ofi_metric	metric;
+	uint64_t		plain;
+};
+
+static uint64_t count = 10000000;
+static int mode;
+
+static void *bench_thread(void *arg)
+{
+	struct bench_thread *bt = arg;
+	volatile uint64_t *plain = &bt->plain;
+	uint64_t i;
+
+	for (i = 0; i < count; i++) {
+		if (mode == BENCH_PLAIN)
+			(*plain)++;
+		else
+			ofi_metric_inc(&bt->metric);
+	}
+	return NULL;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\tupdates per thread (default 10000000)\n");
+	printf("  -t <threads>\tthreads (default 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_thread *bt;
+	uint64_t start, elapsed, value;
+	int threads = 1, i, op, ret = 0, failed;
+
+	while ((op = getopt(argc, argv, "n:t:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	bt = calloc(MAX(threads, 1), sizeof(*bt));
+	if (threads < 1 || !count || !bt) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	ofi_metrics_init();
+	printf("%" PRIu64 " updates per thread, %d threads\n", count, threads);
+	for (mode = 0; mode < BENCH_MAX; mode++) {
+		if (mode != BENCH_PLAIN) {
+			ofi_metrics_cleanup();
+			if (mode == BENCH_SHM)
+				setenv("FI_METRICS", "1", 1);
+			else
+				unsetenv("FI_METRICS");
+		}
+
+		failed = 0;
+		for (i = 0; i < threads; i++) {
+			bt[i].plain = 0;
+			ofi_metric_init(&bt[i].metric, &core_prov,
+					"metrics_bench", OFI_METRIC_COUNTER);
+			if (!bt[i].metric.slot != (mode != BENCH_SHM))
+				failed = 1;
+		}
+
+		start = ofi_gettime_ns();
+		for (i = 0; i < threads; i++) {
+			if (pthread_create(&bt[i].thread, NULL, bench_thread,
+					   &bt[i]))
+				failed = 1;
+		}
+		for (i = 0; i < threads; i++)
+			pthread_join(bt[i].thread, NULL);
+		elapsed = ofi_gettime_ns() - start;
+
+		for (i = 0; i < threads; i++) {
+			value = mode == BENCH_PLAIN ? bt[i].plain :
+				ofi_metric_get(&bt[i].metric);
+			if (value != count)
+				failed = 1;
+			ofi_metric_fini(&bt[i].metric);
+		}
+
+		printf("%-20s %8.2f ns/op %8.2f Mop/s%s\n", bench_name[mode],
+		       (double) elapsed / count,
+		       (double) count * threads * 1000 / elapsed,
+		       failed ? "  ERROR: wrong count" : "");
+		ret |= failed;
+	}
+
+	ofi_metrics_cleanup();
+	free(bt);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures inserting a job's worth of addresses into a private AV and
+ * into a named, shared one, and resolving them from a second process that
+ * opens the shared AV read-only.  The second process checks that every
+ * address resolves to the fi_addr_t assigned by the first.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#include <ofi.h>
+#include <rdma/fi_domain.h>
+
+static size_t count = 100000;
+static char av_name[64];
+static struct fid_fabric *fabric;
+static struct fid_domain *domain;
+
+static int open_domain(void)
+{
+	struct fi_info *hints, *info;
+	int ret;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return -FI_ENOMEM;
+
+	hints->fabric_attr->prov_name = strdup("udp");
+	hints->ep_attr->type = FI_EP_DGRAM;
+	hints->caps = FI_MSG | FI_SHARED_AV;
+	hints->addr_format = FI_SOCKADDR_IN;
+	ret = fi_getinfo(fi_version(), NULL, NULL, 0, hints, &info);
+	fi_freeinfo(hints);
+	if (ret)
+		return ret;
+
+	ret = fi_fabric(info->fabric_attr, &fabric, NULL);
+	if (!ret)
+		ret = fi_domain(fabric, info, &domain, NULL);
+	fi_freeinfo(info);
+	return ret;
+}
+
+static void close_domain(void)
+{
+	if (domain)
+		fi_close(&domain->fid);
+	if (fabric)
+		fi_close(&fabric->fid);
+}
+
+static struct sockaddr_in *alloc_addrs(void)
+{
+	struct sockaddr_in *addrs;
+	size_t i;
+
+	addrs = calloc(count, sizeof(*addrs));
+	if (!addrs)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		addrs[i].sin_family = AF_INET;
+		addrs[i].sin_addr.s_addr = htonl(0x0a000000 + (uint32_t) i / 64);
+		addrs[i].sin_port = htons(20000 + i % 64);
+	}
+	return addrs;
+}
+
+static int insert(const char *name, uint64_t flags, struct sockaddr_in *addrs,
+		  fi_addr_t *fi_addrs, struct fid_av **av, fi_addr_t **map)
+{
+	struct fi_av_attr attr = {
+		.type = FI_AV_TABLE,
+		.count = count,
+		.name = name,
+		.flags = flags,
+	};
+	uint64_t start, elapsed;
+	int ret;
+
+	ret = fi_av_open(domain, &attr, av, NULL);
+	if (ret)
+		return ret;
+
+	start = ofi_gettime_ns();
+	ret = fi_av_insert(*av, addrs, count, fi_addrs, 0, NULL);
+	elapsed = ofi_gettime_ns() - start;
+	if (ret != (int) count)
+		return ret < 0 ? ret : -FI_EOTHER;
+
+	if (map)
+		*map = attr.map_addr;
+	printf("%-24s %8.2f ns/addr\n", flags & FI_READ ? "shared AV, FI_READ" :
+	       name ? "shared AV" : "private AV", (double) elapsed / count);
+	fflush(stdout);
+	return 0;
+}
+
+static int reader(int fd)
+{
+	struct sockaddr_in *addrs, addr;
+	fi_addr_t *fi_addrs, *map = NULL;
+	struct fid_av *av = NULL;
+	size_t i, addrlen;
+	char c;
+	int ret, failed = 0;
+
+	if (read(fd, &c, 1) != 1 || c != 'y')
+		return EXIT_FAILURE;
+
+	addrs = alloc_addrs();
+	fi_addrs = calloc(count, sizeof(*fi_addrs));
+	ret = addrs && fi_addrs ? open_domain() : -FI_ENOMEM;
+	if (!ret)
+		ret = insert(av_name, FI_READ, addrs, fi_addrs, &av, &map);
+	if (ret) {
+		printf("ERROR: reader: %s\n", fi_strerror(-ret));
+		failed = 1;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		addrlen = sizeof(addr);
+		if (fi_addrs[i] != map[i] ||
+		    fi_av_lookup(av, fi_addrs[i], &addr, &addrlen) ||
+		    memcmp(&addr, &addrs[i], sizeof(addr)))
+			failed = 1;
+	}
+	if (failed)
+		printf("ERROR: reader resolved a different address\n");
+out:
+	if (av)
+		fi_close(&av->fid);
+	close_domain();
+	free(fi_addrs);
+	free(addrs);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\taddresses (default 100000)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in *addrs;
+	fi_addr_t *fi_addrs;
+	struct fid_av *av;
+	int op, ret, status, fds[2];
+	char c;
+	pid_t pid;
+
+	while ((op = getopt(argc, argv, "n:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	snprintf(av_name, sizeof(av_name), "shared_av_bench.%d", getpid());
+	if (!count || pipe(fds)) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+	if (!pid) {
+		close(fds[1]);
+		exit(reader(fds[0]));
+	}
+	close(fds[0]);
+
+	addrs = alloc_addrs();
+	fi_addrs = calloc(count, sizeof(*fi_addrs));
+	ret = addrs && fi_addrs ? open_domain() : -FI_ENOMEM;
+	if (ret) {
+		printf("fi_getinfo: %s, skipping\n", fi_strerror(-ret));
+		c = 'n';
+		ret = write(fds[1], &c, 1);
+		waitpid(pid, &status, 0);
+		ret = 0;
+		goto out;
+	}
+
+	printf("%zu addresses\n", count);
+	ret = insert(NULL, 0, addrs, fi_addrs, &av, NULL);
+	if (!ret) {
+		fi_close(&av->fid);
+		ret = insert(av_name, 0, addrs, fi_addrs, &av, NULL);
+	}
+	c = ret ? 'n' : 'y';
+	if (write(fds[1], &c, 1) != 1)
+		ret = -FI_EOTHER;
+	waitpid(pid, &status, 0);
+	if (!ret) {
+		fi_close(&av->fid);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			ret = -FI_EOTHER;
+	} else {
+		printf("ERROR: %s\n", fi_strerror(-ret));
+	}
+out:
+	close(fds[1]);
+	close_domain();
+	free(fi_addrs);
+	free(addrs);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
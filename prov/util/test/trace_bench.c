@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost per traced operation of the binary trace rings, with
+ * both clock sources, against formatting the same event as text the way
+ * the trace hook's log output does.  Each thread records into its own
+ * ring, and the record count of every ring is verified afterwards.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <ofi_trace.h>
+
+#include "bench.h"
+
+#define BENCH_MODES(X)					\
+	X(BENCH_TEXT, "text (FI_TRACE format)")		\
+	X(BENCH_MONO, "binary, monotonic clock")	\
+	X(BENCH_TSC, "binary, tsc clock")
+BENCH_DECLARE_MODES(BENCH_MODES);
+
+static uint64_t count = 1000000;
+static int mode;
+static uint32_t clock_used;
+static FILE *devnull;
+
+static void *bench_thread(void *arg)
+{
+	struct ofi_trace_ring *ring;
+	struct ofi_trace_rec *rec;
+	char buf[1024];
+	uint64_t i;
+	int len;
+
+	for (i = 0; i < count; i++) {
+		if (mode == BENCH_TEXT) {
+			/* log prefix plus the hook's TRACE_EP_MSG text */
+			len = snprintf(buf, sizeof(buf),
+				"libfabric:%d:%" PRIu64 "::ofi_hook_trace:"
+				"ep_data:trace_send():%d<trace> "
+				"buf %p len %zu addr %zu data %lu "
+				"flags 0x%zx ctx %p\n", (int) getpid(),
+				ofi_gettime_ns() / 1000000, __LINE__,
+				(void *) buf, (size_t) 64, (size_t) i, 0UL,
+				(size_t) 0, arg);
+			fwrite(buf, 1, len, devnull);
+			continue;
+		}
+
+		ring = ofi_trace_ring_get();
+		if (!ring)
+			return (void *) 1;
+		rec = ofi_trace_reserve(ring);
+		rec->fid = (uintptr_t) &ring;
+		rec->context = (uintptr_t) arg;
+		rec->len = 64;
+		rec->addr = i;
+		rec->tag = 0;
+		rec->flags = 0;
+		rec->op = OFI_TRACE_SEND;
+		rec->ret = 0;
+		rec->count = 0;
+		ofi_trace_commit(ring, rec);
+	}
+	return NULL;
+}
+
+static int verify(const char *dir, int threads)
+{
+	struct ofi_trace_hdr hdr;
+	char path[PATH_MAX];
+	struct dirent *dent;
+	DIR *dirp;
+	FILE *file;
+	int rings = 0, ret = 0;
+
+	dirp = opendir(dir);
+	if (!dirp)
+		return -1;
+
+	while ((dent = readdir(dirp))) {
+		if (strncmp(dent->d_name, "fi_trace.", 9))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+		file = fopen(path, "r");
+		if (!file || fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+		    hdr.magic != OFI_TRACE_MAGIC || hdr.head != count)
+			ret = -1;
+		else
+			clock_used = hdr.clock;
+		if (file)
+			fclose(file);
+		unlink(path);
+		rings++;
+	}
+	closedir(dirp);
+	return ret || rings != threads ? -1 : 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("  -n <count>\toperations per thread (default 1000000)\n");
+	printf("  -t <threads>\tthreads (default 1)\n");
+	printf("  -r <records>\trecords per ring (default %d)\n",
+	       OFI_TRACE_DEF_RECORDS);
+}
+
+int main(int argc, char **argv)
+{
+	char dir[] = "/tmp/fi_trace_bench.XXXXXX";
+	pthread_t *thread;
+	size_t records = OFI_TRACE_DEF_RECORDS;
+	uint64_t start, elapsed;
+	void *res;
+	int threads = 1, i, op, ret = 0, failed;
+
+	while ((op = getopt(argc, argv, "n:t:r:h")) != -1) {
+		switch (op) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'r':
+			records = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	thread = calloc(MAX(threads, 1), sizeof(*thread));
+	devnull = fopen("/dev/null", "w");
+	if (threads < 1 || !count || !thread || !devnull || !mkdtemp(dir)) {
+		printf("ERROR: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%" PRIu64 " operations per thread, %d threads\n",
+	       count, threads);
+	for (mode = 0; mode < BENCH_MAX; mode++) {
+		if (mode != BENCH_TEXT &&
+		    ofi_trace_open(dir, records, mode == BENCH_TSC ?
+				   OFI_TRACE_CLOCK_TSC : OFI_TRACE_CLOCK_MONO)) {
+			printf("ERROR: ofi_trace_open failed\n");
+			ret = 1;
+			break;
+		}
+
+		failed = 0;
+		start = ofi_gettime_ns();
+		for (i = 0; i < threads; i++) {
+			if (pthread_create(&thread[i], NULL, bench_thread,
+					   (void *) (uintptr_t) i))
+				failed = 1;
+		}
+		for (i = 0; i < threads; i++) {
+			pthread_join(thread[i], &res);
+			if (res)
+				failed = 1;
+		}
+		elapsed = ofi_gettime_ns() - start;
+
+		if (mode != BENCH_TEXT) {
+			ofi_trace_close();
+			if (verify(dir, threads))
+				failed = 1;
+		}
+
+		printf("%-26s %8.1f ns/op %8.2f Mop/s%s%s\n", bench_name[mode],
+		       (double) elapsed / count,
+		       (double) count * threads * 1000 / elapsed,
+		       mode == BENCH_TSC && clock_used != OFI_TRACE_CLOCK_TSC ?
+		       "  (no invariant tsc, used monotonic)" : "",
+		       failed ? "  ERROR: records missing" : "");
+		ret |= failed;
+	}
+
+	rmdir(dir);
+	fclose(devnull);
+	free(thread);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -50,10 +50,13 @@
 #include "ofi_prov.h"
 #include "ofi_perf.h"
 #include "ofi_hmem.h"
+#include "ofi_metrics.h"
+#include "fasthash.h"
 #include <rdma/fi_ext.h>
 
 #ifdef HAVE_LIBDL
 #include <dlfcn.h>
+#include <sys/stat.h>
 #endif
 
 
@@ -75,8 +78,19 @@ struct ofi_info_match {
 	enum fi_ep_type ep_type;
 };
 
+/* A provider library found at init but not opened yet */
+struct ofi_lazy_lib {
+	struct ofi_lazy_lib	*next;
+	char			*name;
+	char			*path;
+};
+
 static struct ofi_prov *prov_head, *prov_tail;
 static enum ofi_prov_order prov_order = OFI_PROV_ORDER_VERSION;
+static struct ofi_lazy_lib *lazy_libs;
+static int prov_lazy;
+/* Identifies the installed providers for the getinfo cache */
+static uint64_t prov_id;
 int ofi_init = 0;
 extern struct ofi_common_locks common_locks;
 
@@ -424,6 +438,7 @@ static void ofi_ordered_provs_init(void)
 		 */
 		"ofi_hook_perf", "ofi_hook_trace", "ofi_hook_debug",
 		"ofi_hook_noop", "ofi_hook_hmem", "ofi_hook_dmabuf_peer_mem",
+		"ofi_hook_latency", "ofi_hook_netem",
 
 		/* So do the offload providers. */
 		"off_coll",
@@ -621,6 +636,163 @@ static void ofi_reg_dl_prov(const char *lib)
 	}
 }
 
+static void ofi_free_lazy_lib(struct ofi_lazy_lib *lib)
+{
+	free(lib->name);
+	free(lib->path);
+	free(lib);
+}
+
+/*
+ * Records a library named lib<name>-fi.so to be opened when a provider
+ * it may contain is needed.  Returns an error if it should be opened now.
+ */
+static int ofi_defer_dl_prov(const char *lib)
+{
+	const char *prefix = "lib", *suffix = "-" FI_LIB_SUFFIX;
+	struct ofi_lazy_lib *lazy;
+	const char *name;
+	size_t len;
+
+	name = strrchr(lib, '/');
+	name = name ? name + 1 : lib;
+	len = strlen(name);
+	if (strncmp(name, prefix, strlen(prefix)) ||
+	    len <= strlen(prefix) + strlen(suffix) ||
+	    strcmp(name + len - strlen(suffix), suffix))
+		return -FI_EINVAL;
+
+	lazy = calloc(1, sizeof(*lazy));
+	if (!lazy)
+		return -FI_ENOMEM;
+
+	lazy->name = strndup(name + strlen(prefix),
+			     len - strlen(prefix) - strlen(suffix));
+	lazy->path = strdup(lib);
+	if (!lazy->name || !lazy->path) {
+		ofi_free_lazy_lib(lazy);
+		return -FI_ENOMEM;
+	}
+
+	FI_DBG(&core_prov, FI_LOG_CORE, "deferring provider lib %s\n", lib);
+	lazy->next = lazy_libs;
+	lazy_libs = lazy;
+	return 0;
+}
+
+static void ofi_add_dl_prov(const char *lib)
+{
+	struct stat st;
+
+	prov_id = fasthash64(lib, strlen(lib), prov_id);
+	if (!stat(lib, &st)) {
+		prov_id = fasthash64(&st.st_size, sizeof(st.st_size), prov_id);
+		prov_id = fasthash64(&st.st_mtime, sizeof(st.st_mtime),
+				     prov_id);
+	}
+
+	if (!prov_lazy || ofi_defer_dl_prov(lib))
+		ofi_reg_dl_prov(lib);
+}
+
+/* Matches the library name against ";" separated provider names */
+static bool ofi_lazy_match(const struct ofi_lazy_lib *lib, const char *names)
+{
+	const char *name;
+	size_t len;
+
+	for (name = names; *name; name += len + (name[len] == ';')) {
+		len = strcspn(name, ";");
+		if (*name == '^')
+			continue;
+
+		if (ofi_has_util_prefix(name)) {
+			name += strlen(OFI_UTIL_PREFIX);
+			len -= strlen(OFI_UTIL_PREFIX);
+		} else if (ofi_has_offload_prefix(name)) {
+			name += strlen(OFI_OFFLOAD_PREFIX);
+			len -= strlen(OFI_OFFLOAD_PREFIX);
+		}
+		if (strlen(lib->name) == len &&
+		    !strncasecmp(lib->name, name, len))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * True if a requested provider is neither registered nor named after a
+ * deferred library, and so could be in any of them.
+ */
+static bool ofi_lazy_unknown(const char *names)
+{
+	struct ofi_lazy_lib *lib;
+	struct ofi_prov *prov;
+	const char *name;
+	size_t len;
+	bool found = false;
+
+	for (name = names; *name; name += len + (name[len] == ';')) {
+		len = strcspn(name, ";");
+		if (*name == '^')
+			continue;
+
+		found = true;
+		prov = ofi_getprov(name, len);
+		if (prov && prov->provider)
+			continue;
+
+		for (lib = lazy_libs; lib; lib = lib->next) {
+			if (ofi_lazy_match(lib, name))
+				break;
+		}
+		if (!lib)
+			return true;
+	}
+	return !found;
+}
+
+/* Only core providers are skipped, utility and hook providers layer on any */
+static bool ofi_lazy_core(const struct ofi_lazy_lib *lib)
+{
+	return ofi_getprov(lib->name, strlen(lib->name)) != NULL;
+}
+
+/*
+ * Opens the deferred libraries that may provide one of the given names,
+ * which may be layered, or all of them if names is NULL.
+ */
+void ofi_load_lazy_provs(char **names)
+{
+	struct ofi_lazy_lib *lib, **prev;
+	bool all = !names || !names[0];
+	int i;
+
+	if (!lazy_libs)
+		return;
+
+	pthread_mutex_lock(&common_locks.ini_lock);
+	for (i = 0; !all && names[i]; i++)
+		all = ofi_lazy_unknown(names[i]);
+
+	for (prev = &lazy_libs; *prev; ) {
+		lib = *prev;
+		for (i = 0; !all && names[i]; i++) {
+			if (ofi_lazy_match(lib, names[i]))
+				break;
+		}
+		if (!all && names[i] == NULL && ofi_lazy_core(lib)) {
+			prev = &lib->next;
+			continue;
+		}
+
+		*prev = lib->next;
+		ofi_reg_dl_prov(lib->path);
+		ofi_free_lazy_lib(lib);
+	}
+	pthread_mutex_unlock(&common_locks.ini_lock);
+}
+
 static void ofi_ini_dir(const char *dir)
 {
 	int n;
@@ -637,7 +809,7 @@ static void ofi_ini_dir(const char *dir)
 			       "asprintf failed to allocate memory\n");
 			goto libdl_done;
 		}
-		ofi_reg_dl_prov(lib);
+		ofi_add_dl_prov(lib);
 
 		free(liblist[n]);
 		free(lib);
@@ -678,7 +850,7 @@ static void ofi_find_prov_libs(void)
 			continue;
 		}
 
-		ofi_reg_dl_prov(lib);
+		ofi_add_dl_prov(lib);
 		free(lib);
 	}
 }
@@ -702,6 +874,13 @@ static void ofi_load_dl_prov(void)
 			"starts with @, loaded providers are given preference "
 			"based on discovery order, rather than version. "
 			"(default: " PROVDLDIR ")");
+	fi_param_define(NULL, "provider_lazy", FI_PARAM_BOOL,
+			"Open provider libraries only once fi_getinfo or "
+			"fi_fabric may need them, based on the provider names "
+			"requested through hints, FI_PROVIDER or the fabric "
+			"attributes.  Ignored if FI_PROVIDER_PATH starts with "
+			"@ (default: no)");
+	fi_param_get_bool(NULL, "provider_lazy", &prov_lazy);
 
 	fi_param_get_str(NULL, "provider_path", &provdir);
 	if (!provdir || !strlen(provdir)) {
@@ -709,6 +888,7 @@ static void ofi_load_dl_prov(void)
 		dirs = ofi_split_and_alloc(PROVDLDIR, ":", NULL);
 	} else if (provdir[0] == '@') {
 		prov_order = OFI_PROV_ORDER_REGISTER;
+		prov_lazy = 0;
 		if (strlen(provdir) == 1)
 			dirs = ofi_split_and_alloc(PROVDLDIR, ":", NULL);
 		else
@@ -731,6 +911,10 @@ static void ofi_load_dl_prov(void)
 {
 }
 
+void ofi_load_lazy_provs(char **names)
+{
+}
+
 #endif
 
 static char **hooks;
@@ -793,6 +977,7 @@ static void ofi_hook_fini(void)
 
 void fi_ini(void)
 {
+	struct ofi_prov *prov;
 	char *param_val = NULL;
 
 	pthread_mutex_lock(&common_locks.ini_lock);
@@ -811,6 +996,7 @@ void fi_ini(void)
 	ofi_hook_init();
 	ofi_hmem_init();
 	ofi_monitors_init();
+	ofi_metrics_init();
 
 	fi_param_define(NULL, "provider", FI_PARAM_STRING,
 			"Only use specified provider (default: all available)");
@@ -840,6 +1026,16 @@ void fi_ini(void)
 			"(default: false)");
 	fi_param_get_bool(NULL, "av_remove_cleanup", &ofi_av_remove_cleanup);
 
+	fi_param_define(NULL, "wait_policy", FI_PARAM_STRING,
+			"How blocking calls on wait objects implemented by "
+			"the utility code wait for events: adaptive, spin "
+			"or block.  Adaptive waits poll for a time learned "
+			"from recent waits before blocking, and the others "
+			"only poll or block (default: adaptive)");
+	fi_param_define(NULL, "wait_spin_max", FI_PARAM_INT,
+			"Maximum time, in microseconds, that an adaptive "
+			"wait polls before blocking (default: 50)");
+
 	fi_param_define(NULL, "offload_coll_provider", FI_PARAM_STRING,
 			"The name of a colective offload provider (default: \
 			empty - no provider)");
@@ -875,10 +1071,22 @@ void fi_ini(void)
 	ofi_register_provider(HOOK_DEBUG_INIT, NULL);
 	ofi_register_provider(HOOK_HMEM_INIT, NULL);
 	ofi_register_provider(HOOK_DMABUF_PEER_MEM_INIT, NULL);
+	ofi_register_provider(HOOK_LATENCY_INIT, NULL);
+	ofi_register_provider(HOOK_NETEM_INIT, NULL);
 	ofi_register_provider(HOOK_NOOP_INIT, NULL);
 
 	ofi_register_provider(COLL_INIT, NULL);
 
+	for (prov = prov_head; prov; prov = prov->next) {
+		if (!prov->provider || prov->dlhandle)
+			continue;
+		prov_id = fasthash64(prov->prov_name, strlen(prov->prov_name),
+				     prov_id);
+		prov_id = fasthash64(&prov->provider->version,
+				     sizeof(prov->provider->version), prov_id);
+	}
+	ofi_getinfo_cache_init(prov_id);
+
 	ofi_init = 1;
 
 unlock:
@@ -887,6 +1095,7 @@ unlock:
 
 FI_DESTRUCTOR(fi_fini(void))
 {
+	struct ofi_lazy_lib *lib;
 	struct ofi_prov *prov;
 
 	pthread_mutex_lock(&common_locks.ini_lock);
@@ -894,14 +1103,25 @@ FI_DESTRUCTOR(fi_fini(void))
 	if (!ofi_init)
 		goto unlock;
 
+	/* queued messages refer to strings of the providers */
+	fi_log_drain();
+
 	while (prov_head) {
 		prov = prov_head;
 		prov_head = prov->next;
 		ofi_free_prov(prov);
 	}
 
+	while (lazy_libs) {
+		lib = lazy_libs;
+		lazy_libs = lib->next;
+		ofi_free_lazy_lib(lib);
+	}
+	prov_id = 0;
+
 	ofi_free_filter(&prov_filter);
 	ofi_monitors_cleanup();
+	ofi_metrics_cleanup();
 	ofi_hmem_cleanup();
 	ofi_hook_fini();
 	ofi_mem_fini();
@@ -1202,9 +1422,13 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 	}
 
 	if (flags == FI_PROV_ATTR_ONLY) {
+		ofi_load_lazy_provs(NULL);
 		return ofi_getprovinfo(info);
 	}
 
+	if (!ofi_getinfo_cache_get(version, node, service, flags, hints, info))
+		return 0;
+
 	if (hints && hints->fabric_attr && hints->fabric_attr->prov_name) {
 		prov_vec = ofi_split_and_alloc(hints->fabric_attr->prov_name,
 					       ";", &count);
@@ -1212,6 +1436,10 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 			return -FI_ENOMEM;
 		FI_DBG(&core_prov, FI_LOG_CORE, "hints prov_name: %s\n",
 		       hints->fabric_attr->prov_name);
+		ofi_load_lazy_provs(prov_vec);
+	} else {
+		ofi_load_lazy_provs(prov_filter.negated ? NULL :
+				    prov_filter.names);
 	}
 
 	*info = tail = NULL;
@@ -1284,6 +1512,9 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 		ofi_reorder_info(info);
 	}
 
+	if (*info)
+		ofi_getinfo_cache_put(version, node, service, flags, hints,
+				      *info);
 	return *info ? 0 : -FI_ENODATA;
 }
 DEFAULT_SYMVER(fi_getinfo_, fi_getinfo, FABRIC_1.3);
@@ -1425,6 +1656,7 @@ int DEFAULT_SYMVER_PRE(fi_fabric)(struct fi_fabric_attr *attr,
 {
 	struct ofi_prov *prov;
 	const char *top_name;
+	char *names[2];
 	int ret;
 
 	if (!attr || !attr->prov_name || !attr->name)
@@ -1432,6 +1664,10 @@ int DEFAULT_SYMVER_PRE(fi_fabric)(struct fi_fabric_attr *attr,
 
 	fi_ini();
 
+	names[0] = attr->prov_name;
+	names[1] = NULL;
+	ofi_load_lazy_provs(names);
+
 	top_name = strrchr(attr->prov_name, OFI_NAME_DELIM);
 	if (top_name)
 		top_name++;
@@ -0,0 +1,859 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Persistent fi_getinfo cache.  When FI_GETINFO_CACHE names a directory,
+ * each fi_getinfo result is saved to a file there, keyed by the call's
+ * arguments, the libfabric build, the installed providers, the provider
+ * related environment and a fingerprint of the host's network interfaces
+ * and RDMA devices.  A later call with the same key reads the file instead
+ * of loading and querying providers.  The full key is stored in the file
+ * and compared on lookup; its hash only names the file.
+ *
+ * Some providers, such as shm, name the source address after the calling
+ * process when no node or service is given.  Such string addresses ending
+ * in the caller's pid are saved without it, and the pid of the process
+ * reading the cache is appended on replay.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <net/if.h>
+#endif
+
+#include <rdma/fi_errno.h>
+#include "ofi.h"
+#include "ofi_net.h"
+#include "ofi_util.h"
+#include "fasthash.h"
+
+#define OFI_GC_MAGIC		0x454843414349464fULL	/* "OFICACHE" */
+#define OFI_GC_VERSION		2
+#define OFI_GC_MAX_SIZE		(64 * 1024 * 1024)
+
+struct ofi_gc_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	key_len;
+	uint64_t	data_len;
+};
+
+struct ofi_gc_buf {
+	uint8_t		*data;
+	size_t		len;
+	size_t		size;
+	int		err;
+};
+
+struct ofi_gc_reader {
+	const uint8_t	*data;
+	size_t		len;
+	size_t		off;
+};
+
+static char *ofi_gc_dir;
+static uint64_t ofi_gc_prov_id;
+static uint64_t ofi_gc_hw_id;
+static int ofi_gc_hw_valid;
+
+/*
+ * Serialization.  Structures are written as raw bytes with their pointers
+ * cleared, which is sufficient since the key includes the library build.
+ */
+
+static void ofi_gc_put(struct ofi_gc_buf *buf, const void *data, size_t len)
+{
+	uint8_t *tmp;
+	size_t size;
+
+	if (buf->err)
+		return;
+
+	if (buf->len + len > buf->size) {
+		size = MAX(buf->size * 2, buf->len + len);
+		size = MAX(size, 4096);
+		tmp = realloc(buf->data, size);
+		if (!tmp) {
+			buf->err = -FI_ENOMEM;
+			return;
+		}
+		buf->data = tmp;
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+/* A NULL pointer is recorded separately from an empty buffer */
+static void ofi_gc_put_blob(struct ofi_gc_buf *buf, const void *data,
+			    size_t len)
+{
+	uint8_t present = data != NULL;
+
+	ofi_gc_put(buf, &present, sizeof(present));
+	if (present)
+		ofi_gc_put(buf, data, len);
+}
+
+static void ofi_gc_put_str(struct ofi_gc_buf *buf, const char *str)
+{
+	uint32_t len = str ? (uint32_t) strlen(str) + 1 : 0;
+
+	ofi_gc_put(buf, &len, sizeof(len));
+	if (len)
+		ofi_gc_put(buf, str, len);
+}
+
+static int ofi_gc_get(struct ofi_gc_reader *rd, void *data, size_t len)
+{
+	if (rd->len - rd->off < len)
+		return -FI_EINVAL;
+
+	memcpy(data, rd->data + rd->off, len);
+	rd->off += len;
+	return 0;
+}
+
+static int ofi_gc_get_blob(struct ofi_gc_reader *rd, void **data, size_t len)
+{
+	uint8_t present;
+
+	if (ofi_gc_get(rd, &present, sizeof(present)))
+		return -FI_EINVAL;
+	if (!present)
+		return 0;
+	if (rd->len - rd->off < len)
+		return -FI_EINVAL;
+
+	*data = malloc(MAX(len, 1));
+	if (!*data)
+		return -FI_ENOMEM;
+	return ofi_gc_get(rd, *data, len);
+}
+
+static int ofi_gc_get_str(struct ofi_gc_reader *rd, char **str)
+{
+	uint32_t len;
+
+	if (ofi_gc_get(rd, &len, sizeof(len)))
+		return -FI_EINVAL;
+	if (!len)
+		return 0;
+
+	if (rd->len - rd->off < len || rd->data[rd->off + len - 1])
+		return -FI_EINVAL;
+
+	*str = strdup((const char *) rd->data + rd->off);
+	if (!*str)
+		return -FI_ENOMEM;
+	rd->off += len;
+	return 0;
+}
+
+enum {
+	OFI_GC_TX	= 1 << 0,
+	OFI_GC_RX	= 1 << 1,
+	OFI_GC_EP	= 1 << 2,
+	OFI_GC_DOMAIN	= 1 << 3,
+	OFI_GC_FABRIC	= 1 << 4,
+	OFI_GC_NIC	= 1 << 5,
+};
+
+static void ofi_gc_put_nic(struct ofi_gc_buf *buf, const struct fid_nic *nic)
+{
+	struct fi_device_attr dev = { 0 };
+	struct fi_bus_attr bus = { 0 };
+	struct fi_link_attr link = { 0 };
+
+	if (nic->device_attr)
+		dev = *nic->device_attr;
+	ofi_gc_put_str(buf, dev.name);
+	ofi_gc_put_str(buf, dev.device_id);
+	ofi_gc_put_str(buf, dev.device_version);
+	ofi_gc_put_str(buf, dev.vendor_id);
+	ofi_gc_put_str(buf, dev.driver);
+	ofi_gc_put_str(buf, dev.firmware);
+
+	if (nic->bus_attr)
+		bus = *nic->bus_attr;
+	ofi_gc_put(buf, &bus, sizeof(bus));
+
+	if (nic->link_attr)
+		link = *nic->link_attr;
+	ofi_gc_put_str(buf, link.address);
+	ofi_gc_put_str(buf, link.network_type);
+	link.address = NULL;
+	link.network_type = NULL;
+	ofi_gc_put(buf, &link, sizeof(link));
+}
+
+/*
+ * Returns the length of a string source address without a trailing pid,
+ * or 0 if the address does not end in pid.
+ */
+static uint32_t ofi_gc_pid_addr(const struct fi_info *info, uint32_t pid)
+{
+	const char *addr = info->src_addr;
+	char suffix[16];
+	size_t len, n;
+
+	if (!pid || info->addr_format != FI_ADDR_STR || !addr)
+		return 0;
+
+	len = strnlen(addr, info->src_addrlen);
+	n = snprintf(suffix, sizeof(suffix), "%u", pid);
+	if (len <= n || len == info->src_addrlen ||
+	    strcmp(addr + len - n, suffix) ||
+	    isdigit((unsigned char) addr[len - n - 1]))
+		return 0;
+	return (uint32_t) (len - n);
+}
+
+/*
+ * Returns -FI_ENOSYS for an fi_info that references live objects, such as
+ * an opened fabric or provider specific NIC data, which cannot be cached.
+ * A source address ending in pid, if non-zero, is marked to be rewritten
+ * for the process reading it.
+ */
+static int ofi_gc_put_info(struct ofi_gc_buf *buf, const struct fi_info *info,
+			   uint32_t pid)
+{
+	struct fi_info copy = *info;
+	struct fi_ep_attr ep_attr;
+	struct fi_domain_attr domain_attr;
+	struct fi_fabric_attr fabric_attr;
+	uint32_t pid_addr;
+	uint8_t present = 0;
+
+	if (info->handle || (info->nic && info->nic->prov_attr) ||
+	    (info->domain_attr && info->domain_attr->domain) ||
+	    (info->fabric_attr && info->fabric_attr->fabric))
+		return -FI_ENOSYS;
+
+	present |= info->tx_attr ? OFI_GC_TX : 0;
+	present |= info->rx_attr ? OFI_GC_RX : 0;
+	present |= info->ep_attr ? OFI_GC_EP : 0;
+	present |= info->domain_attr ? OFI_GC_DOMAIN : 0;
+	present |= info->fabric_attr ? OFI_GC_FABRIC : 0;
+	present |= info->nic ? OFI_GC_NIC : 0;
+	ofi_gc_put(buf, &present, sizeof(present));
+
+	copy.next = NULL;
+	copy.src_addr = NULL;
+	copy.dest_addr = NULL;
+	copy.tx_attr = NULL;
+	copy.rx_attr = NULL;
+	copy.ep_attr = NULL;
+	copy.domain_attr = NULL;
+	copy.fabric_attr = NULL;
+	copy.nic = NULL;
+	ofi_gc_put(buf, &copy, sizeof(copy));
+	pid_addr = ofi_gc_pid_addr(info, pid);
+	ofi_gc_put(buf, &pid_addr, sizeof(pid_addr));
+	ofi_gc_put_blob(buf, info->src_addr, info->src_addrlen);
+	ofi_gc_put_blob(buf, info->dest_addr, info->dest_addrlen);
+
+	if (info->tx_attr)
+		ofi_gc_put(buf, info->tx_attr, sizeof(*info->tx_attr));
+	if (info->rx_attr)
+		ofi_gc_put(buf, info->rx_attr, sizeof(*info->rx_attr));
+	if (info->ep_attr) {
+		ep_attr = *info->ep_attr;
+		ep_attr.auth_key = NULL;
+		ofi_gc_put(buf, &ep_attr, sizeof(ep_attr));
+		ofi_gc_put_blob(buf, info->ep_attr->auth_key,
+				info->ep_attr->auth_key_size);
+	}
+	if (info->domain_attr) {
+		domain_attr = *info->domain_attr;
+		domain_attr.name = NULL;
+		domain_attr.auth_key = NULL;
+		ofi_gc_put(buf, &domain_attr, sizeof(domain_attr));
+		ofi_gc_put_str(buf, info->domain_attr->name);
+		ofi_gc_put_blob(buf, info->domain_attr->auth_key,
+				info->domain_attr->auth_key_size);
+	}
+	if (info->fabric_attr) {
+		fabric_attr = *info->fabric_attr;
+		fabric_attr.name = NULL;
+		fabric_attr.prov_name = NULL;
+		ofi_gc_put(buf, &fabric_attr, sizeof(fabric_attr));
+		ofi_gc_put_str(buf, info->fabric_attr->name);
+		ofi_gc_put_str(buf, info->fabric_attr->prov_name);
+	}
+	if (info->nic)
+		ofi_gc_put_nic(buf, info->nic);
+	return 0;
+}
+
+static int ofi_gc_get_nic(struct ofi_gc_reader *rd, struct fid_nic **nic)
+{
+	struct fi_link_attr link;
+	char *address = NULL, *network_type = NULL;
+	int ret;
+
+	*nic = ofi_nic_dup(NULL);
+	if (!*nic)
+		return -FI_ENOMEM;
+
+	ret = ofi_gc_get_str(rd, &(*nic)->device_attr->name);
+	ret = ret ? ret : ofi_gc_get_str(rd, &(*nic)->device_attr->device_id);
+	ret = ret ? ret :
+	      ofi_gc_get_str(rd, &(*nic)->device_attr->device_version);
+	ret = ret ? ret : ofi_gc_get_str(rd, &(*nic)->device_attr->vendor_id);
+	ret = ret ? ret : ofi_gc_get_str(rd, &(*nic)->device_attr->driver);
+	ret = ret ? ret : ofi_gc_get_str(rd, &(*nic)->device_attr->firmware);
+	ret = ret ? ret : ofi_gc_get(rd, (*nic)->bus_attr,
+				     sizeof(*(*nic)->bus_attr));
+	ret = ret ? ret : ofi_gc_get_str(rd, &address);
+	ret = ret ? ret : ofi_gc_get_str(rd, &network_type);
+	ret = ret ? ret : ofi_gc_get(rd, &link, sizeof(link));
+	if (!ret) {
+		link.address = address;
+		link.network_type = network_type;
+		*(*nic)->link_attr = link;
+		return 0;
+	}
+
+	free(address);
+	free(network_type);
+	return ret;
+}
+
+/* Replaces the pid ending a saved source address with the caller's */
+static int ofi_gc_get_pid_addr(struct fi_info *info, uint32_t pid_addr)
+{
+	char *addr;
+	int len;
+
+	if (!info->src_addr || pid_addr >= info->src_addrlen)
+		return -FI_EINVAL;
+
+	len = asprintf(&addr, "%.*s%d", (int) pid_addr,
+		       (char *) info->src_addr, (int) getpid());
+	if (len < 0)
+		return -FI_ENOMEM;
+
+	free(info->src_addr);
+	info->src_addr = addr;
+	info->src_addrlen = (size_t) len + 1;
+	return 0;
+}
+
+static int ofi_gc_get_info(struct ofi_gc_reader *rd, struct fi_info **info)
+{
+	struct fi_info *cur;
+	uint32_t pid_addr;
+	uint8_t present;
+	int ret;
+
+	if (ofi_gc_get(rd, &present, sizeof(present)))
+		return -FI_EINVAL;
+
+	cur = calloc(1, sizeof(*cur));
+	if (!cur)
+		return -FI_ENOMEM;
+
+	ret = ofi_gc_get(rd, cur, sizeof(*cur));
+	if (ret) {
+		free(cur);
+		return ret;
+	}
+
+	/*
+	 * Pointers were cleared when written, but a damaged file must not
+	 * leave any for fi_freeinfo.  Fields are filled in as they are read.
+	 */
+	cur->next = NULL;
+	cur->src_addr = NULL;
+	cur->dest_addr = NULL;
+	cur->handle = NULL;
+	cur->tx_attr = NULL;
+	cur->rx_attr = NULL;
+	cur->ep_attr = NULL;
+	cur->domain_attr = NULL;
+	cur->fabric_attr = NULL;
+	cur->nic = NULL;
+
+	ret = ofi_gc_get(rd, &pid_addr, sizeof(pid_addr));
+	ret = ret ? ret : ofi_gc_get_blob(rd, &cur->src_addr,
+					  cur->src_addrlen);
+	if (!ret && pid_addr)
+		ret = ofi_gc_get_pid_addr(cur, pid_addr);
+	ret = ret ? ret : ofi_gc_get_blob(rd, &cur->dest_addr,
+					  cur->dest_addrlen);
+	if (!ret && (present & OFI_GC_TX)) {
+		cur->tx_attr = calloc(1, sizeof(*cur->tx_attr));
+		ret = cur->tx_attr ? ofi_gc_get(rd, cur->tx_attr,
+						sizeof(*cur->tx_attr)) :
+		      -FI_ENOMEM;
+	}
+	if (!ret && (present & OFI_GC_RX)) {
+		cur->rx_attr = calloc(1, sizeof(*cur->rx_attr));
+		ret = cur->rx_attr ? ofi_gc_get(rd, cur->rx_attr,
+						sizeof(*cur->rx_attr)) :
+		      -FI_ENOMEM;
+	}
+	if (!ret && (present & OFI_GC_EP)) {
+		cur->ep_attr = calloc(1, sizeof(*cur->ep_attr));
+		ret = cur->ep_attr ? ofi_gc_get(rd, cur->ep_attr,
+						sizeof(*cur->ep_attr)) :
+		      -FI_ENOMEM;
+		if (cur->ep_attr)
+			cur->ep_attr->auth_key = NULL;
+		ret = ret ? ret :
+		      ofi_gc_get_blob(rd, (void **) &cur->ep_attr->auth_key,
+				      cur->ep_attr->auth_key_size);
+	}
+	if (!ret && (present & OFI_GC_DOMAIN)) {
+		cur->domain_attr = calloc(1, sizeof(*cur->domain_attr));
+		ret = cur->domain_attr ? ofi_gc_get(rd, cur->domain_attr,
+						    sizeof(*cur->domain_attr)) :
+		      -FI_ENOMEM;
+		if (cur->domain_attr) {
+			cur->domain_attr->domain = NULL;
+			cur->domain_attr->name = NULL;
+			cur->domain_attr->auth_key = NULL;
+		}
+		ret = ret ? ret : ofi_gc_get_str(rd, &cur->domain_attr->name);
+		ret = ret ? ret :
+		      ofi_gc_get_blob(rd, (void **) &cur->domain_attr->auth_key,
+				      cur->domain_attr->auth_key_size);
+	}
+	if (!ret && (present & OFI_GC_FABRIC)) {
+		cur->fabric_attr = calloc(1, sizeof(*cur->fabric_attr));
+		ret = cur->fabric_attr ? ofi_gc_get(rd, cur->fabric_attr,
+						    sizeof(*cur->fabric_attr)) :
+		      -FI_ENOMEM;
+		if (cur->fabric_attr) {
+			cur->fabric_attr->fabric = NULL;
+			cur->fabric_attr->name = NULL;
+			cur->fabric_attr->prov_name = NULL;
+		}
+		ret = ret ? ret : ofi_gc_get_str(rd, &cur->fabric_attr->name);
+		ret = ret ? ret :
+		      ofi_gc_get_str(rd, &cur->fabric_attr->prov_name);
+	}
+	if (!ret && (present & OFI_GC_NIC))
+		ret = ofi_gc_get_nic(rd, &cur->nic);
+
+	if (ret) {
+		fi_freeinfo(cur);
+		return ret;
+	}
+	*info = cur;
+	return 0;
+}
+
+/*
+ * Key
+ */
+
+#ifndef _WIN32
+extern char **environ;
+
+static int ofi_gc_strcmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*
+ * Variables that may change what providers report: those read through
+ * fi_param, those read directly by provider libraries, the library search
+ * path, and the device selection of the GPU runtimes used for FI_HMEM.
+ */
+static const char *ofi_gc_env[] = {
+	"FI_", "OFI_", "PSM2_", "PSM3_", "UCX_", "HFI_", "CXI_", "GNI_",
+	"LD_LIBRARY_PATH=", "CUDA_VISIBLE_DEVICES=", "ROCR_VISIBLE_DEVICES=",
+	"HIP_VISIBLE_DEVICES=", "ZE_AFFINITY_MASK=", "NEURON_RT_VISIBLE_CORES=",
+};
+
+static int ofi_gc_env_match(const char *var)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ofi_gc_env); i++) {
+		if (!strncmp(var, ofi_gc_env[i], strlen(ofi_gc_env[i])))
+			return 1;
+	}
+	return 0;
+}
+
+static void ofi_gc_put_env(struct ofi_gc_buf *buf)
+{
+	char **vars;
+	size_t i, cnt;
+
+	for (cnt = 0; environ[cnt]; cnt++)
+		;
+
+	vars = calloc(cnt + 1, sizeof(*vars));
+	if (!vars) {
+		buf->err = -FI_ENOMEM;
+		return;
+	}
+
+	for (i = 0, cnt = 0; environ[i]; i++) {
+		if (ofi_gc_env_match(environ[i]))
+			vars[cnt++] = environ[i];
+	}
+	qsort(vars, cnt, sizeof(*vars), ofi_gc_strcmp);
+	for (i = 0; i < cnt; i++)
+		ofi_gc_put_str(buf, vars[i]);
+	free(vars);
+}
+
+static void ofi_gc_put_dir(struct ofi_gc_buf *buf, const char *path)
+{
+	struct dirent **names;
+	int i, n;
+
+	n = scandir(path, &names, NULL, alphasort);
+	if (n < 0)
+		return;
+
+	ofi_gc_put_str(buf, path);
+	for (i = 0; i < n; i++) {
+		ofi_gc_put_str(buf, names[i]->d_name);
+		free(names[i]);
+	}
+	free(names);
+}
+
+/*
+ * Fingerprint of the hardware providers look for: addresses and state of
+ * the network interfaces, and the RDMA and fabric devices in sysfs.
+ */
+static uint64_t ofi_gc_hw_fingerprint(void)
+{
+	static const char *dirs[] = {
+		"/sys/class/infiniband", "/sys/class/cxi", "/sys/class/hfi1",
+	};
+	struct ofi_gc_buf buf = { 0 };
+	uint64_t id;
+	size_t i;
+#if HAVE_GETIFADDRS
+	struct ifaddrs *ifaddrs, *ifa;
+	uint32_t flags;
+
+	if (!ofi_getifaddrs(&ifaddrs)) {
+		for (ifa = ifaddrs; ifa; ifa = ifa->ifa_next) {
+			ofi_gc_put_str(&buf, ifa->ifa_name);
+			flags = ifa->ifa_flags & (IFF_UP | IFF_RUNNING);
+			ofi_gc_put(&buf, &flags, sizeof(flags));
+			if (ifa->ifa_addr &&
+			    (ifa->ifa_addr->sa_family == AF_INET ||
+			     ifa->ifa_addr->sa_family == AF_INET6))
+				ofi_gc_put(&buf, ifa->ifa_addr,
+					   ofi_sizeofaddr(ifa->ifa_addr));
+		}
+		freeifaddrs(ifaddrs);
+	}
+#endif
+	for (i = 0; i < ARRAY_SIZE(dirs); i++)
+		ofi_gc_put_dir(&buf, dirs[i]);
+
+	id = fasthash64(buf.data, buf.len, 0);
+	free(buf.data);
+	return id;
+}
+
+static void ofi_gc_put_host(struct ofi_gc_buf *buf)
+{
+	char host[256] = { 0 };
+
+	gethostname(host, sizeof(host) - 1);
+	ofi_gc_put_str(buf, host);
+}
+#else
+static void ofi_gc_put_env(struct ofi_gc_buf *buf)
+{
+	buf->err = -FI_ENOSYS;
+}
+
+static uint64_t ofi_gc_hw_fingerprint(void)
+{
+	return 0;
+}
+
+static void ofi_gc_put_host(struct ofi_gc_buf *buf)
+{
+}
+#endif
+
+static int
+ofi_gc_key(struct ofi_gc_buf *key, uint32_t version, const char *node,
+	   const char *service, uint64_t flags, const struct fi_info *hints)
+{
+	uint8_t has_hints = hints != NULL;
+	int ret;
+
+	/* Interfaces are assumed not to change during the process' life */
+	if (!ofi_gc_hw_valid) {
+		ofi_gc_hw_id = ofi_gc_hw_fingerprint();
+		ofi_gc_hw_valid = 1;
+	}
+
+	ofi_gc_put_str(key, VERSION BUILD_ID);
+	ofi_gc_put(key, &ofi_gc_prov_id, sizeof(ofi_gc_prov_id));
+	ofi_gc_put(key, &ofi_gc_hw_id, sizeof(ofi_gc_hw_id));
+	ofi_gc_put_host(key);
+	ofi_gc_put_env(key);
+	ofi_gc_put(key, &version, sizeof(version));
+	ofi_gc_put(key, &flags, sizeof(flags));
+	ofi_gc_put_str(key, node);
+	ofi_gc_put_str(key, service);
+	ofi_gc_put(key, &has_hints, sizeof(has_hints));
+	if (hints) {
+		ret = ofi_gc_put_info(key, hints, 0);
+		if (ret)
+			key->err = ret;
+	}
+	return key->err;
+}
+
+static char *ofi_gc_path(const struct ofi_gc_buf *key)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/fi_getinfo.%016" PRIx64, ofi_gc_dir,
+		     fasthash64(key->data, key->len, 0)) < 0)
+		return NULL;
+	return path;
+}
+
+/*
+ * File access
+ */
+
+#ifndef _WIN32
+static int ofi_gc_read(const char *path, struct ofi_gc_buf *file)
+{
+	struct stat st;
+	ssize_t n;
+	int fd, ret = -FI_ENODATA;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -FI_ENODATA;
+
+	if (fstat(fd, &st) || st.st_size < sizeof(struct ofi_gc_hdr) ||
+	    st.st_size > OFI_GC_MAX_SIZE)
+		goto out;
+
+	file->data = malloc(st.st_size);
+	if (!file->data)
+		goto out;
+
+	for (file->len = 0; file->len < (size_t) st.st_size;
+	     file->len += n) {
+		n = read(fd, file->data + file->len, st.st_size - file->len);
+		if (n <= 0)
+			goto out;
+	}
+	ret = 0;
+out:
+	close(fd);
+	return ret;
+}
+
+/* Written under a temporary name and renamed, so readers see whole files */
+static void ofi_gc_write(const char *path, const struct ofi_gc_buf *key,
+			 const struct ofi_gc_buf *data)
+{
+	struct ofi_gc_hdr hdr = {
+		.magic		= OFI_GC_MAGIC,
+		.version	= OFI_GC_VERSION,
+		.key_len	= (uint32_t) key->len,
+		.data_len	= data->len,
+	};
+	struct iovec iov[3] = {
+		{ .iov_base = &hdr, .iov_len = sizeof(hdr) },
+		{ .iov_base = key->data, .iov_len = key->len },
+		{ .iov_base = data->data, .iov_len = data->len },
+	};
+	char *tmp;
+	ssize_t n;
+	int fd;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) < 0)
+		return;
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		goto free;
+
+	n = writev(fd, iov, 3);
+	close(fd);
+	if (n != (ssize_t) (sizeof(hdr) + key->len + data->len) ||
+	    rename(tmp, path)) {
+		FI_INFO(&core_prov, FI_LOG_CORE,
+			"unable to write getinfo cache %s\n", path);
+		unlink(tmp);
+	}
+free:
+	free(tmp);
+}
+#else
+static int ofi_gc_read(const char *path, struct ofi_gc_buf *file)
+{
+	return -FI_ENODATA;
+}
+
+static void ofi_gc_write(const char *path, const struct ofi_gc_buf *key,
+			 const struct ofi_gc_buf *data)
+{
+}
+#endif
+
+/*
+ * Interface
+ */
+
+void ofi_getinfo_cache_init(uint64_t prov_id)
+{
+	fi_param_define(NULL, "getinfo_cache", FI_PARAM_STRING,
+			"Directory, preferably node local, where fi_getinfo "
+			"results are saved and reused by later processes with "
+			"the same arguments, providers, environment and "
+			"network devices (default: none)");
+	fi_param_get_str(NULL, "getinfo_cache", &ofi_gc_dir);
+	if (ofi_gc_dir && !*ofi_gc_dir)
+		ofi_gc_dir = NULL;
+
+	ofi_gc_prov_id = prov_id;
+	ofi_gc_hw_valid = 0;
+}
+
+int ofi_getinfo_cache_get(uint32_t version, const char *node,
+			  const char *service, uint64_t flags,
+			  const struct fi_info *hints, struct fi_info **info)
+{
+	struct ofi_gc_buf key = { 0 }, file = { 0 };
+	struct ofi_gc_reader rd;
+	struct ofi_gc_hdr hdr;
+	struct fi_info *head = NULL, **tail = &head;
+	uint32_t cnt;
+	char *path = NULL;
+	int ret = -FI_ENODATA;
+
+	if (!ofi_gc_dir || ofi_gc_key(&key, version, node, service, flags,
+				      hints))
+		goto out;
+
+	path = ofi_gc_path(&key);
+	if (!path || ofi_gc_read(path, &file))
+		goto out;
+
+	rd.data = file.data;
+	rd.len = file.len;
+	rd.off = 0;
+	if (ofi_gc_get(&rd, &hdr, sizeof(hdr)) || hdr.magic != OFI_GC_MAGIC ||
+	    hdr.version != OFI_GC_VERSION || hdr.key_len != key.len ||
+	    sizeof(hdr) + hdr.key_len + hdr.data_len != file.len ||
+	    memcmp(file.data + sizeof(hdr), key.data, key.len))
+		goto out;
+
+	rd.off += hdr.key_len;
+	if (ofi_gc_get(&rd, &cnt, sizeof(cnt)))
+		goto out;
+
+	while (cnt--) {
+		if (ofi_gc_get_info(&rd, tail)) {
+			fi_freeinfo(head);
+			head = NULL;
+			goto out;
+		}
+		tail = &(*tail)->next;
+	}
+
+	FI_INFO(&core_prov, FI_LOG_CORE, "using getinfo cache %s\n", path);
+	*info = head;
+	ret = 0;
+out:
+	free(path);
+	free(key.data);
+	free(file.data);
+	return ret;
+}
+
+void ofi_getinfo_cache_put(uint32_t version, const char *node,
+			   const char *service, uint64_t flags,
+			   const struct fi_info *hints,
+			   const struct fi_info *info)
+{
+	struct ofi_gc_buf key = { 0 }, data = { 0 };
+	const struct fi_info *cur;
+	uint32_t cnt = 0, pid = 0;
+	char *path = NULL;
+	int ret;
+
+	if (!ofi_gc_dir || ofi_gc_key(&key, version, node, service, flags,
+				      hints))
+		goto out;
+
+	for (cur = info; cur; cur = cur->next)
+		cnt++;
+
+	/* source addresses named by the caller are never per process */
+	if (!node && !service && !(hints && hints->src_addr))
+		pid = (uint32_t) getpid();
+
+	ofi_gc_put(&data, &cnt, sizeof(cnt));
+	for (cur = info; cur; cur = cur->next) {
+		ret = ofi_gc_put_info(&data, cur, pid);
+		if (ret)
+			goto out;
+	}
+	if (data.err)
+		goto out;
+
+	path = ofi_gc_path(&key);
+	if (path)
+		ofi_gc_write(path, &key, &data);
+out:
+	free(path);
+	free(key.data);
+	free(data.data);
+}
@@ -36,6 +36,8 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <sched.h>
 
 #include <rdma/fi_errno.h>
 #include <rdma/fi_ext.h>
@@ -89,6 +91,22 @@ struct ofi_filter prov_log_filter;
 extern struct ofi_common_locks common_locks;
 
 static pid_t pid;
+static int log_json;
+static int log_rate_limit;
+static int log_async;
+
+#define OFI_LOG_MSG_MAX		1024
+#define OFI_LOG_LINE_MAX	2048
+#define OFI_LOG_RATE_SLOTS	256
+
+/*
+ * Rate limiting state of each call site: the current second in the upper
+ * half and the number of messages logged during it in the lower half.
+ */
+static uint64_t log_rate_state[OFI_LOG_RATE_SLOTS];
+static uint32_t log_rate_dropped[OFI_LOG_RATE_SLOTS];
+
+static void ofi_log_async_start(void);
 
 static int fi_convert_log_str(const char *value)
 {
@@ -107,8 +125,9 @@ static int fi_convert_log_str(const char *value)
 void fi_log_init(void)
 {
 	struct ofi_filter subsys_filter;
-	int level, i;
+	int level, i, async = 0;
 	char *levelstr = NULL, *provstr = NULL, *subsysstr = NULL;
+	char *formatstr = NULL;
 
 	fi_param_define(NULL, "log_interval", FI_PARAM_INT,
 			"Delay in ms between rate limited log messages "
@@ -137,6 +156,24 @@ void fi_log_init(void)
 	}
 	ofi_free_filter(&subsys_filter);
 	pid = getpid();
+
+	fi_param_define(NULL, "log_format", FI_PARAM_STRING,
+			"Format of log messages: text, or json for one JSON "
+			"object per line (default: text)");
+	fi_param_get_str(NULL, "log_format", &formatstr);
+	log_json = formatstr && !strcasecmp(formatstr, "json");
+
+	fi_param_define(NULL, "log_rate_limit", FI_PARAM_INT,
+			"Maximum number of messages logged per second from "
+			"each call site, 0 for no limit (default: 0)");
+	fi_param_get_int(NULL, "log_rate_limit", &log_rate_limit);
+
+	fi_param_define(NULL, "log_async", FI_PARAM_BOOL,
+			"Queue log messages in per thread buffers and format "
+			"them on a background thread (default: no)");
+	fi_param_get_bool(NULL, "log_async", &async);
+	if (async)
+		ofi_log_async_start();
 }
 
 static int ofi_log_enabled(const struct fi_provider *prov,
@@ -149,14 +186,141 @@ static int ofi_log_enabled(const struct fi_provider *prov,
 		FI_LOG_TAG(prov_filtered, level, subsys));
 }
 
+/* Appends to buf at offset n, and returns the new length */
+static size_t ofi_log_printf(char *buf, size_t size, size_t n,
+			     const char *fmt, ...)
+{
+	va_list vargs;
+	int ret;
+
+	if (n + 1 >= size)
+		return n;
+
+	va_start(vargs, fmt);
+	ret = vsnprintf(buf + n, size - n, fmt, vargs);
+	va_end(vargs);
+	return ret < 0 ? n : MIN(n + ret, size - 1);
+}
+
+/* The final newline of str, which is present in most messages, is dropped */
+static size_t ofi_log_json_str(char *buf, size_t size, size_t n,
+			       const char *str)
+{
+	for (; *str && n + 8 < size; str++) {
+		switch (*str) {
+		case '"':
+		case '\\':
+			buf[n++] = '\\';
+			buf[n++] = *str;
+			break;
+		case '\n':
+			if (str[1]) {
+				buf[n++] = '\\';
+				buf[n++] = 'n';
+			}
+			break;
+		case '\t':
+			buf[n++] = '\\';
+			buf[n++] = 't';
+			break;
+		default:
+			if ((unsigned char) *str < 0x20)
+				n = ofi_log_printf(buf, size, n, "\\u%04x",
+						   (unsigned char) *str);
+			else
+				buf[n++] = *str;
+			break;
+		}
+	}
+	buf[n] = '\0';
+	return n;
+}
+
+static size_t ofi_log_line(char *buf, size_t size, const char *prov_name,
+			   enum fi_log_level level, enum fi_log_subsys subsys,
+			   const char *func, int line, time_t time,
+			   const char *msg)
+{
+	size_t n;
+
+	if (!log_json)
+		return ofi_log_printf(buf, size, 0,
+				      "%s:%d:%ld:%s:%s:%s:%s():%d<%s> %s",
+				      PACKAGE, pid, (unsigned long) time,
+				      log_prefix, prov_name, log_subsys[subsys],
+				      func, line, log_levels[level], msg);
+
+	n = ofi_log_printf(buf, size, 0, "{\"time\":%ld,\"pid\":%d,",
+			   (unsigned long) time, pid);
+	if (*log_prefix) {
+		n = ofi_log_printf(buf, size, n, "\"prefix\":\"");
+		n = ofi_log_json_str(buf, size, n, log_prefix);
+		n = ofi_log_printf(buf, size, n, "\",");
+	}
+	n = ofi_log_printf(buf, size, n, "\"prov\":\"%s\",\"subsys\":\"%s\","
+			   "\"level\":\"%s\",\"func\":\"%s\",\"line\":%d,"
+			   "\"msg\":\"", prov_name, log_subsys[subsys],
+			   log_levels[level], func, line);
+	n = ofi_log_json_str(buf, size, n, msg);
+	n = MIN(n, size - 4);
+	return ofi_log_printf(buf, size, n, "\"}\n");
+}
+
+/* Notes the messages that were rate limited before the final newline */
+static void ofi_log_note_dropped(char *msg, size_t size, uint32_t dropped)
+{
+	size_t n = strlen(msg);
+
+	if (n && msg[n - 1] == '\n')
+		n--;
+	ofi_log_printf(msg, size, n, " (%u similar messages suppressed)\n",
+		       dropped);
+}
+
 static void ofi_log(const struct fi_provider *prov, enum fi_log_level level,
 		    enum fi_log_subsys subsys, const char *func, int line,
 		    const char *msg)
 {
-	fprintf(stderr, "%s:%d:%ld:%s:%s:%s:%s():%d<%s> %s",
-		PACKAGE, pid, (unsigned long) time(NULL), log_prefix,
-		prov->name, log_subsys[subsys], func, line,
-		log_levels[level], msg);
+	char buf[OFI_LOG_LINE_MAX];
+	size_t len;
+
+	len = ofi_log_line(buf, sizeof(buf), prov->name, level, subsys,
+			   func, line, time(NULL), msg);
+	fwrite(buf, 1, len, stderr);
+}
+
+/*
+ * Call sites are hashed into a small table, so sites that collide share
+ * a limit.  Returns false if the message should be dropped, otherwise
+ * dropped is set to the number dropped since the last one logged.
+ */
+static int ofi_log_rate_check(const char *func, int line, uint32_t *dropped)
+{
+	uint64_t now, old, new;
+	uint32_t cnt;
+	size_t i;
+
+	i = (((uintptr_t) func >> 3) * 31 + line) % OFI_LOG_RATE_SLOTS;
+	now = (ofi_gettime_ms() / 1000) & UINT32_MAX;
+	do {
+		old = ofi_atomic_load_explicit(64, &log_rate_state[i],
+					       memory_order_relaxed);
+		if ((old >> 32) != now) {
+			new = (now << 32) | 1;
+		} else if ((old & UINT32_MAX) < (uint64_t) log_rate_limit) {
+			new = old + 1;
+		} else {
+			ofi_atomic_add_and_fetch(32, &log_rate_dropped[i], 1);
+			return false;
+		}
+	} while (!ofi_atomic_cas_bool(64, &log_rate_state[i], old, new));
+
+	do {
+		cnt = ofi_atomic_load_explicit(32, &log_rate_dropped[i],
+					       memory_order_relaxed);
+	} while (cnt && !ofi_atomic_cas_bool(32, &log_rate_dropped[i], cnt, 0));
+	*dropped = cnt;
+	return true;
 }
 
 static int ofi_log_ready(const struct fi_provider *prov,
@@ -312,6 +476,587 @@ void ofi_tostr_log_subsys(char *buf, size_t len, enum fi_log_subsys subsys)
 	ofi_strncatf(buf, len, log_subsys[subsys]);
 }
 
+#ifndef _WIN32
+
+#define OFI_LOG_RING_SIZE	(1 << 18)
+#define OFI_LOG_REC_MAX		4096
+#define OFI_LOG_SPEC_MAX	32
+/* ms between passes of the log thread */
+#define OFI_LOG_INTERVAL	10
+
+enum {
+	OFI_LOG_ARG_NONE,
+	OFI_LOG_ARG_INT,
+	OFI_LOG_ARG_LONG,
+	OFI_LOG_ARG_LLONG,
+	OFI_LOG_ARG_INTMAX,
+	OFI_LOG_ARG_SIZE,
+	OFI_LOG_ARG_PTRDIFF,
+	OFI_LOG_ARG_DOUBLE,
+	OFI_LOG_ARG_PTR,
+	OFI_LOG_ARG_STR,
+};
+
+/* One conversion of a format string, width_arg and prec_arg are for '*' */
+struct ofi_log_spec {
+	int	len;
+	int	type;
+	int	width_arg;
+	int	prec_arg;
+	int	prec;
+};
+
+/*
+ * A message captured by fi_log and formatted by the log thread.  Each
+ * argument takes an 8 byte slot, except strings, which are copied after a
+ * slot holding their length.  A record without fmt pads the ring up to its
+ * end, as does any space too small to hold a record header.
+ */
+struct ofi_log_rec {
+	uint32_t			size;
+	uint16_t			level;
+	uint16_t			subsys;
+	int32_t				line;
+	uint32_t			dropped;
+	int64_t				time;
+	const struct fi_provider	*prov;
+	const char			*func;
+	const char			*fmt;
+	uint64_t			args[];
+};
+
+/*
+ * The owning thread is the only producer and the log thread the only
+ * consumer.  A ring is freed by the log thread once its owner has exited
+ * and it has been drained.
+ */
+struct ofi_log_ring {
+	struct dlist_entry	entry;
+	uint64_t		head;
+	uint64_t		tail;
+	uint32_t		exited;
+	uint64_t		buf[OFI_LOG_RING_SIZE / sizeof(uint64_t)];
+};
+
+static pthread_mutex_t log_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t log_async_key;
+static int log_async_key_init;
+static pthread_t log_async_thread;
+static int log_async_stop;
+static DEFINE_LIST(log_async_rings);
+/* output of the log thread, written with one call per pass */
+static char log_async_out[1 << 16];
+static size_t log_async_len;
+
+static int ofi_log_parse(const char *fmt, struct ofi_log_spec *spec)
+{
+	const char *p = fmt + 1;
+	char *end;
+	int mod = OFI_LOG_ARG_INT;
+
+	spec->type = OFI_LOG_ARG_NONE;
+	spec->width_arg = 0;
+	spec->prec_arg = 0;
+	spec->prec = -1;
+	if (*p == '%') {
+		spec->len = 2;
+		return 0;
+	}
+
+	p += strspn(p, "-+ #0'");
+	if (*p == '*') {
+		spec->width_arg = 1;
+		p++;
+	} else {
+		while (isdigit((unsigned char) *p))
+			p++;
+	}
+	if (*p == '.') {
+		if (p[1] == '*') {
+			spec->prec_arg = 1;
+			p += 2;
+		} else {
+			spec->prec = (int) strtol(p + 1, &end, 10);
+			p = end;
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		p += (p[1] == 'h') ? 2 : 1;
+		break;
+	case 'l':
+		if (p[1] == 'l') {
+			mod = OFI_LOG_ARG_LLONG;
+			p += 2;
+		} else {
+			mod = OFI_LOG_ARG_LONG;
+			p++;
+		}
+		break;
+	case 'j':
+		mod = OFI_LOG_ARG_INTMAX;
+		p++;
+		break;
+	case 'z':
+		mod = OFI_LOG_ARG_SIZE;
+		p++;
+		break;
+	case 't':
+		mod = OFI_LOG_ARG_PTRDIFF;
+		p++;
+		break;
+	}
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		spec->type = mod;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (mod != OFI_LOG_ARG_INT && mod != OFI_LOG_ARG_LONG)
+			return -FI_EINVAL;
+		spec->type = OFI_LOG_ARG_DOUBLE;
+		break;
+	case 'c':
+		if (mod != OFI_LOG_ARG_INT)
+			return -FI_EINVAL;
+		spec->type = OFI_LOG_ARG_INT;
+		break;
+	case 's':
+		if (mod != OFI_LOG_ARG_INT)
+			return -FI_EINVAL;
+		spec->type = OFI_LOG_ARG_STR;
+		break;
+	case 'p':
+		if (mod != OFI_LOG_ARG_INT)
+			return -FI_EINVAL;
+		spec->type = OFI_LOG_ARG_PTR;
+		break;
+	default:
+		/* %n, %m, wide characters and long doubles */
+		return -FI_EINVAL;
+	}
+
+	spec->len = (int) (p - fmt) + 1;
+	return spec->len < OFI_LOG_SPEC_MAX ? 0 : -FI_EINVAL;
+}
+
+/* Returns the size of the record, or 0 if the message cannot be queued */
+static size_t ofi_log_capture(struct ofi_log_rec *rec, size_t size,
+			      const char *fmt, va_list vargs)
+{
+	struct ofi_log_spec spec;
+	uint64_t *slot = rec->args;
+	uint64_t *end = (uint64_t *) ((char *) rec + size);
+	const char *str;
+	size_t len;
+	double val;
+
+	for (; (fmt = strchr(fmt, '%')); fmt += spec.len) {
+		if (ofi_log_parse(fmt, &spec) || end - slot < 3)
+			return 0;
+
+		if (spec.width_arg)
+			*slot++ = (uint64_t) va_arg(vargs, int);
+		if (spec.prec_arg) {
+			spec.prec = va_arg(vargs, int);
+			*slot++ = (uint64_t) spec.prec;
+		}
+
+		switch (spec.type) {
+		case OFI_LOG_ARG_INT:
+			*slot++ = (uint64_t) va_arg(vargs, int);
+			break;
+		case OFI_LOG_ARG_LONG:
+			*slot++ = (uint64_t) va_arg(vargs, long);
+			break;
+		case OFI_LOG_ARG_LLONG:
+			*slot++ = (uint64_t) va_arg(vargs, long long);
+			break;
+		case OFI_LOG_ARG_INTMAX:
+			*slot++ = (uint64_t) va_arg(vargs, intmax_t);
+			break;
+		case OFI_LOG_ARG_SIZE:
+			*slot++ = (uint64_t) va_arg(vargs, size_t);
+			break;
+		case OFI_LOG_ARG_PTRDIFF:
+			*slot++ = (uint64_t) va_arg(vargs, ptrdiff_t);
+			break;
+		case OFI_LOG_ARG_DOUBLE:
+			val = va_arg(vargs, double);
+			memcpy(slot++, &val, sizeof(val));
+			break;
+		case OFI_LOG_ARG_PTR:
+			*slot++ = (uintptr_t) va_arg(vargs, void *);
+			break;
+		case OFI_LOG_ARG_STR:
+			str = va_arg(vargs, const char *);
+			if (!str)
+				str = "(null)";
+			len = strnlen(str, spec.prec >= 0 ?
+				      MIN(spec.prec, OFI_LOG_MSG_MAX) :
+				      OFI_LOG_MSG_MAX);
+			if ((size_t) (end - slot - 1) * sizeof(*slot) <= len)
+				return 0;
+			*slot++ = len;
+			memcpy(slot, str, len);
+			((char *) slot)[len] = '\0';
+			slot += len / sizeof(*slot) + 1;
+			break;
+		default:
+			break;
+		}
+	}
+	return (char *) slot - (char *) rec;
+}
+
+#define OFI_LOG_PRINT(buf, size, spec, arg, nargs, val)			\
+	((nargs) == 0 ? snprintf(buf, size, spec, val) :		\
+	 (nargs) == 1 ? snprintf(buf, size, spec, (arg)[0], val) :	\
+	 snprintf(buf, size, spec, (arg)[0], (arg)[1], val))
+
+/* Formats a captured message, one conversion at a time */
+static void ofi_log_replay(const struct ofi_log_rec *rec, char *msg,
+			   size_t size)
+{
+	struct ofi_log_spec spec;
+	const uint64_t *slot = rec->args;
+	const char *fmt = rec->fmt, *pct;
+	char conv[OFI_LOG_SPEC_MAX];
+	size_t n = 0, len;
+	double val;
+	int arg[2], nargs, ret = 0;
+
+	while ((pct = strchr(fmt, '%')) && n + 1 < size) {
+		len = MIN((size_t) (pct - fmt), size - n - 1);
+		memcpy(msg + n, fmt, len);
+		n += len;
+
+		(void) ofi_log_parse(pct, &spec);
+		memcpy(conv, pct, spec.len);
+		conv[spec.len] = '\0';
+		nargs = 0;
+		if (spec.width_arg)
+			arg[nargs++] = (int) *slot++;
+		if (spec.prec_arg)
+			arg[nargs++] = (int) *slot++;
+
+		switch (spec.type) {
+		case OFI_LOG_ARG_NONE:
+			msg[n] = '%';
+			ret = 1;
+			break;
+		case OFI_LOG_ARG_INT:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (int) *slot);
+			break;
+		case OFI_LOG_ARG_LONG:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (long) *slot);
+			break;
+		case OFI_LOG_ARG_LLONG:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (long long) *slot);
+			break;
+		case OFI_LOG_ARG_INTMAX:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (intmax_t) *slot);
+			break;
+		case OFI_LOG_ARG_SIZE:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (size_t) *slot);
+			break;
+		case OFI_LOG_ARG_PTRDIFF:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (ptrdiff_t) *slot);
+			break;
+		case OFI_LOG_ARG_DOUBLE:
+			memcpy(&val, slot, sizeof(val));
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    val);
+			break;
+		case OFI_LOG_ARG_PTR:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (void *) (uintptr_t) *slot);
+			break;
+		case OFI_LOG_ARG_STR:
+			ret = OFI_LOG_PRINT(msg + n, size - n, conv, arg, nargs,
+					    (const char *) (slot + 1));
+			slot += *slot / sizeof(*slot) + 1;
+			break;
+		}
+		if (spec.type != OFI_LOG_ARG_NONE)
+			slot++;
+		if (ret > 0)
+			n = MIN(n + ret, size - 1);
+		fmt = pct + spec.len;
+	}
+
+	len = MIN(strlen(fmt), size - n - 1);
+	memcpy(msg + n, fmt, len);
+	msg[n + len] = '\0';
+}
+
+static void ofi_log_ring_exit(void *arg)
+{
+	struct ofi_log_ring *ring = arg;
+
+	ofi_atomic_store_explicit(32, &ring->exited, 1, memory_order_release);
+}
+
+static struct ofi_log_ring *ofi_log_ring_get(void)
+{
+	struct ofi_log_ring *ring;
+
+	ring = pthread_getspecific(log_async_key);
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	if (pthread_setspecific(log_async_key, ring)) {
+		free(ring);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&log_async_lock);
+	dlist_insert_tail(&ring->entry, &log_async_rings);
+	pthread_mutex_unlock(&log_async_lock);
+	return ring;
+}
+
+static int ofi_log_ring_put(struct ofi_log_ring *ring,
+			    const struct ofi_log_rec *rec)
+{
+	struct ofi_log_rec *pad;
+	uint64_t head, tail, off, room;
+
+	head = ring->head;
+	tail = ofi_atomic_load_explicit(64, &ring->tail, memory_order_acquire);
+	off = head % OFI_LOG_RING_SIZE;
+	room = OFI_LOG_RING_SIZE - off;
+	if (room < rec->size) {
+		if (head + room + rec->size - tail > OFI_LOG_RING_SIZE)
+			return -FI_EAGAIN;
+
+		if (room >= sizeof(*pad)) {
+			pad = (struct ofi_log_rec *) ((char *) ring->buf + off);
+			pad->size = (uint32_t) room;
+			pad->fmt = NULL;
+		}
+		head += room;
+		off = 0;
+	} else if (head + rec->size - tail > OFI_LOG_RING_SIZE) {
+		return -FI_EAGAIN;
+	}
+
+	memcpy((char *) ring->buf + off, rec, rec->size);
+	ofi_atomic_store_explicit(64, &ring->head, head + rec->size,
+				  memory_order_release);
+
+	/* wake the log thread early once the ring fills past half */
+	if (head + rec->size - tail > OFI_LOG_RING_SIZE / 2 &&
+	    head - tail <= OFI_LOG_RING_SIZE / 2)
+		pthread_cond_signal(&log_async_cond);
+	return 0;
+}
+
+static void ofi_log_async_flush(void)
+{
+	if (log_async_len)
+		fwrite(log_async_out, 1, log_async_len, stderr);
+	log_async_len = 0;
+}
+
+static void ofi_log_async_write(const struct ofi_log_rec *rec)
+{
+	char msg[OFI_LOG_MSG_MAX];
+
+	ofi_log_replay(rec, msg, sizeof(msg));
+	if (rec->dropped)
+		ofi_log_note_dropped(msg, sizeof(msg), rec->dropped);
+
+	if (sizeof(log_async_out) - log_async_len < OFI_LOG_LINE_MAX)
+		ofi_log_async_flush();
+	log_async_len += ofi_log_line(log_async_out + log_async_len,
+				      sizeof(log_async_out) - log_async_len,
+				      rec->prov->name, rec->level, rec->subsys,
+				      rec->func, rec->line, (time_t) rec->time,
+				      msg);
+}
+
+static void ofi_log_ring_drain(struct ofi_log_ring *ring)
+{
+	struct ofi_log_rec *rec;
+	uint64_t head, tail, off, room;
+
+	head = ofi_atomic_load_explicit(64, &ring->head, memory_order_acquire);
+	for (tail = ring->tail; tail != head; tail += room) {
+		off = tail % OFI_LOG_RING_SIZE;
+		room = OFI_LOG_RING_SIZE - off;
+		if (room < sizeof(*rec))
+			continue;
+
+		rec = (struct ofi_log_rec *) ((char *) ring->buf + off);
+		if (rec->fmt)
+			ofi_log_async_write(rec);
+		room = rec->size;
+	}
+	ofi_atomic_store_explicit(64, &ring->tail, tail, memory_order_release);
+}
+
+/* Called with log_async_lock held */
+static void ofi_log_async_drain(void)
+{
+	struct ofi_log_ring *ring;
+	struct dlist_entry *tmp;
+	uint32_t exited;
+
+	dlist_foreach_container_safe(&log_async_rings, struct ofi_log_ring,
+				     ring, entry, tmp) {
+		exited = ofi_atomic_load_explicit(32, &ring->exited,
+						  memory_order_acquire);
+		ofi_log_ring_drain(ring);
+		if (exited) {
+			dlist_remove(&ring->entry);
+			free(ring);
+		}
+	}
+	ofi_log_async_flush();
+}
+
+static void *ofi_log_async_run(void *arg)
+{
+	pthread_mutex_lock(&log_async_lock);
+	while (!log_async_stop) {
+		ofi_wait_cond(&log_async_cond, &log_async_lock,
+			      OFI_LOG_INTERVAL);
+		ofi_log_async_drain();
+	}
+	pthread_mutex_unlock(&log_async_lock);
+	return NULL;
+}
+
+/* The log thread does not exist in the child, which logs synchronously */
+static void ofi_log_async_atfork_child(void)
+{
+	log_async = 0;
+}
+
+static void ofi_log_async_start(void)
+{
+	if (!log_async_key_init) {
+		if (pthread_key_create(&log_async_key, ofi_log_ring_exit))
+			goto err;
+		pthread_atfork(NULL, NULL, ofi_log_async_atfork_child);
+		log_async_key_init = 1;
+	}
+
+	log_async_stop = 0;
+	if (pthread_create(&log_async_thread, NULL, ofi_log_async_run, NULL))
+		goto err;
+
+	log_async = 1;
+	return;
+err:
+	FI_WARN(&core_prov, FI_LOG_CORE,
+		"unable to start log thread, logging synchronously\n");
+}
+
+void fi_log_drain(void)
+{
+	if (!log_async)
+		return;
+
+	log_async = 0;
+	pthread_mutex_lock(&log_async_lock);
+	log_async_stop = 1;
+	pthread_cond_signal(&log_async_cond);
+	pthread_mutex_unlock(&log_async_lock);
+	pthread_join(log_async_thread, NULL);
+
+	/* Threads that saw log_async set may have queued messages after
+	 * the log thread's last pass; write them out from here.
+	 */
+	pthread_mutex_lock(&log_async_lock);
+	ofi_log_async_drain();
+	pthread_mutex_unlock(&log_async_lock);
+}
+
+static int ofi_log_async_put(const struct fi_provider *prov,
+			     enum fi_log_level level,
+			     enum fi_log_subsys subsys, const char *func,
+			     int line, uint32_t dropped, const char *fmt,
+			     va_list vargs)
+{
+	uint64_t data[OFI_LOG_REC_MAX / sizeof(uint64_t)];
+	struct ofi_log_rec *rec = (struct ofi_log_rec *) data;
+	struct ofi_log_ring *ring;
+	int ret;
+
+	rec->size = (uint32_t) ofi_log_capture(rec, sizeof(data), fmt, vargs);
+	if (!rec->size)
+		return -FI_EINVAL;
+
+	ring = ofi_log_ring_get();
+	if (!ring)
+		return -FI_ENOMEM;
+
+	rec->level = (uint16_t) level;
+	rec->subsys = (uint16_t) subsys;
+	rec->line = line;
+	rec->dropped = dropped;
+	rec->time = (int64_t) time(NULL);
+	rec->prov = prov;
+	rec->func = func;
+	rec->fmt = fmt;
+
+	/* wait for room rather than reorder messages */
+	while ((ret = ofi_log_ring_put(ring, rec)) == -FI_EAGAIN && log_async) {
+		pthread_cond_signal(&log_async_cond);
+		sched_yield();
+	}
+	return ret;
+}
+
+#else /* _WIN32 */
+
+static void ofi_log_async_start(void)
+{
+	FI_WARN(&core_prov, FI_LOG_CORE,
+		"asynchronous logging is not supported\n");
+}
+
+void fi_log_drain(void)
+{
+}
+
+static int ofi_log_async_put(const struct fi_provider *prov,
+			     enum fi_log_level level,
+			     enum fi_log_subsys subsys, const char *func,
+			     int line, uint32_t dropped, const char *fmt,
+			     va_list vargs)
+{
+	return -FI_ENOSYS;
+}
+
+#endif /* _WIN32 */
+
 void fi_log_fini(void)
 {
 	ofi_free_filter(&prov_log_filter);
@@ -350,13 +1095,29 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 		enum fi_log_subsys subsys, const char *func, int line,
 		const char *fmt, ...)
 {
-	char msg[1024];
-	int size = 0;
+	char msg[OFI_LOG_MSG_MAX];
+	uint32_t dropped = 0;
 	va_list vargs;
+	int ret;
+
+	if (log_rate_limit > 0 && !ofi_log_rate_check(func, line, &dropped))
+		return;
+
+	/* queued messages are only formatted for the default log function */
+	if (log_async && log_fid.ops->log == ofi_log) {
+		va_start(vargs, fmt);
+		ret = ofi_log_async_put(prov, level, subsys, func, line,
+					dropped, fmt, vargs);
+		va_end(vargs);
+		if (!ret)
+			return;
+	}
 
 	va_start(vargs, fmt);
-	vsnprintf(msg + size, sizeof(msg) - size, fmt, vargs);
+	vsnprintf(msg, sizeof(msg), fmt, vargs);
 	va_end(vargs);
+	if (dropped)
+		ofi_log_note_dropped(msg, sizeof(msg), dropped);
 
 	log_fid.ops->log(prov, level, subsys, func, line, msg);
 }
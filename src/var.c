@@ -102,6 +102,7 @@ int DEFAULT_SYMVER_PRE(fi_getparams)(struct fi_param **params, int *count)
 	char *tmp;
 
 	fi_ini();
+	ofi_load_lazy_provs(NULL);
 
 	for (entry = param_list.next, cnt = 0; entry != &param_list;
 	     entry = entry->next)
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ofi_metrics.h>
+
+#define SHM_DIR		"/dev/shm"
+#define MAX_SEGS	64
+
+struct seg {
+	char				name[NAME_MAX];
+	const struct ofi_metrics_hdr	*hdr;
+	const struct ofi_metrics_slot	*slots;
+	size_t				size;
+	/* slot generation and value at the previous sample */
+	uint32_t			*gen;
+	uint64_t			*value;
+};
+
+struct row {
+	char		name[OFI_METRICS_NAME_MAX + 16];
+	uint16_t	type;
+	int		instances;
+	uint64_t	value;
+	uint64_t	delta;
+};
+
+static struct seg segs[MAX_SEGS];
+static int seg_cnt;
+static struct row *rows;
+static size_t row_cnt, row_size;
+
+static int parse_name(const char *name, int *pid, int *idx)
+{
+	if (strncmp(name, OFI_METRICS_PREFIX, strlen(OFI_METRICS_PREFIX)))
+		return -1;
+	return sscanf(name + strlen(OFI_METRICS_PREFIX), "%d.%d",
+		      pid, idx) == 2 ? 0 : -1;
+}
+
+static int pid_alive(int pid)
+{
+	return !kill(pid, 0) || errno != ESRCH;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *map_seg(const char *name, size_t *size)
+{
+	struct ofi_metrics_hdr *hdr;
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "/%s", name);
+	fd = shm_open(path, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || (size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED)
+		return NULL;
+
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) !=
+	    OFI_METRICS_MAGIC || hdr->version != OFI_METRICS_VERSION ||
+	    hdr->slot_size != sizeof(struct ofi_metrics_slot) ||
+	    sizeof(*hdr) + (size_t) hdr->slot_cnt * hdr->slot_size >
+	    (size_t) st.st_size) {
+		munmap(hdr, st.st_size);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return hdr;
+}
+
+static int list_segs(int remove)
+{
+	const struct ofi_metrics_hdr *hdr;
+	struct dirent *dent;
+	char path[PATH_MAX];
+	size_t size;
+	int pid, idx, alive, found = 0;
+	DIR *dir;
+
+	dir = opendir(SHM_DIR);
+	if (!dir) {
+		fprintf(stderr, "%s: %s\n", SHM_DIR, strerror(errno));
+		return -1;
+	}
+
+	printf("%8s %4s %6s  %s\n", "PID", "SEG", "SLOTS", "STATE");
+	while ((dent = readdir(dir))) {
+		if (parse_name(dent->d_name, &pid, &idx))
+			continue;
+
+		alive = pid_alive(pid);
+		hdr = map_seg(dent->d_name, &size);
+		printf("%8d %4d %6" PRIu32 "  %s\n", pid, idx,
+		       hdr ? hdr->used : 0, alive ? "running" :
+		       remove ? "exited, removed" : "exited");
+		if (hdr)
+			munmap((void *) hdr, size);
+		if (!alive && remove) {
+			snprintf(path, sizeof(path), "/%s", dent->d_name);
+			shm_unlink(path);
+		}
+		found++;
+	}
+	closedir(dir);
+
+	if (!found)
+		printf("no metrics found, run with FI_METRICS=1\n");
+	return 0;
+}
+
+/* Segments are created as providers register metrics, so look again
+ * every interval. */
+static void scan_segs(int pid)
+{
+	struct dirent *dent;
+	struct seg *seg;
+	int seg_pid, idx, i;
+	DIR *dir;
+
+	dir = opendir(SHM_DIR);
+	if (!dir)
+		return;
+
+	while ((dent = readdir(dir)) && seg_cnt < MAX_SEGS) {
+		if (parse_name(dent->d_name, &seg_pid, &idx) || seg_pid != pid)
+			continue;
+
+		for (i = 0; i < seg_cnt; i++) {
+			if (!strcmp(segs[i].name, dent->d_name))
+				break;
+		}
+		if (i < seg_cnt)
+			continue;
+
+		seg = &segs[seg_cnt];
+		seg->hdr = map_seg(dent->d_name, &seg->size);
+		if (!seg->hdr)
+			continue;
+
+		seg->gen = calloc(seg->hdr->slot_cnt, sizeof(*seg->gen));
+		seg->value = calloc(seg->hdr->slot_cnt, sizeof(*seg->value));
+		if (!seg->gen || !seg->value) {
+			free(seg->gen);
+			free(seg->value);
+			munmap((void *) seg->hdr, seg->size);
+			continue;
+		}
+		seg->slots = (const struct ofi_metrics_slot *) (seg->hdr + 1);
+		strcpy(seg->name, dent->d_name);
+		seg_cnt++;
+	}
+	closedir(dir);
+}
+
+static struct row *get_row(const char *name, uint16_t type)
+{
+	struct row *row;
+	size_t i;
+
+	for (i = 0; i < row_cnt; i++) {
+		if (!strcmp(rows[i].name, name) && rows[i].type == type)
+			return &rows[i];
+	}
+
+	if (row_cnt == row_size) {
+		row_size = row_size ? row_size * 2 : 64;
+		row = realloc(rows, row_size * sizeof(*rows));
+		if (!row)
+			return NULL;
+		rows = row;
+	}
+
+	row = &rows[row_cnt++];
+	memset(row, 0, sizeof(*row));
+	strcpy(row->name, name);
+	row->type = type;
+	return row;
+}
+
+/*
+ * A slot is read between two loads of its generation, which changes
+ * whenever the slot is claimed or released.  A counter's delta is taken
+ * against the previous sample of the same slot generation, so metrics
+ * that come and go between samples do not distort the rates.
+ */
+static void sample(int instances)
+{
+	struct ofi_metrics_slot copy;
+	const struct ofi_metrics_slot *slot;
+	char name[sizeof(rows->name)];
+	struct seg *seg;
+	struct row *row;
+	uint32_t gen, used, i;
+	int s;
+
+	row_cnt = 0;
+	for (s = 0; s < seg_cnt; s++) {
+		seg = &segs[s];
+		used = __atomic_load_n(&seg->hdr->used, __ATOMIC_ACQUIRE);
+		for (i = 0; i < used && i < seg->hdr->slot_cnt; i++) {
+			slot = &seg->slots[i];
+			gen = __atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE);
+			if (!(gen & 1)) {
+				seg->gen[i] = gen;
+				continue;
+			}
+
+			memcpy(&copy, slot, sizeof(copy));
+			copy.value = __atomic_load_n(&slot->value,
+						     __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->gen, __ATOMIC_RELAXED) != gen)
+				continue;
+			copy.name[sizeof(copy.name) - 1] = '\0';
+
+			if (instances)
+				snprintf(name, sizeof(name), "%s[%d.%" PRIu32 "]",
+					 copy.name, s, i);
+			else
+				strcpy(name, copy.name);
+
+			row = get_row(name, copy.type);
+			if (!row)
+				continue;
+			row->instances++;
+			row->value += copy.value;
+			row->delta += copy.value -
+				      (seg->gen[i] == gen ? seg->value[i] : 0);
+
+			seg->gen[i] = gen;
+			seg->value[i] = copy.value;
+		}
+	}
+}
+
+static int row_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct row *) a)->name,
+		      ((const struct row *) b)->name);
+}
+
+static void display(int pid, double interval, int batch, int first)
+{
+	struct row *row;
+	size_t i;
+
+	if (!batch)
+		printf("\033[H\033[2J");
+	printf("fi_top - pid %d, %d segment%s, %.1f s interval\n\n", pid,
+	       seg_cnt, seg_cnt == 1 ? "" : "s", interval);
+	printf("%-44s %-7s %4s %16s %14s\n", "METRIC", "TYPE", "N",
+	       "VALUE", "RATE/s");
+
+	qsort(rows, row_cnt, sizeof(*rows), row_cmp);
+	for (i = 0; i < row_cnt; i++) {
+		row = &rows[i];
+		printf("%-44s %-7s %4d %16" PRIu64, row->name,
+		       row->type == OFI_METRIC_COUNTER ? "counter" : "gauge",
+		       row->instances, row->value);
+		if (row->type == OFI_METRIC_COUNTER && !first)
+			printf(" %14.1f", row->delta / interval);
+		printf("\n");
+	}
+	if (batch)
+		printf("\n");
+	fflush(stdout);
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("\n");
+	printf("Displays the metrics that a process run with FI_METRICS=1\n");
+	printf("exports.  Without -p, lists the processes that have\n");
+	printf("metrics.  Counters are shown with their rate over the\n");
+	printf("last interval, gauges with their current level.\n");
+	printf("\n");
+	printf("  -p <pid>\tprocess to monitor\n");
+	printf("  -d <secs>\tinterval between updates (default 1)\n");
+	printf("  -n <count>\texit after count updates\n");
+	printf("  -b\t\tbatch mode, do not clear the screen\n");
+	printf("  -i\t\tshow each instance instead of totals per name\n");
+	printf("  -r\t\tremove metrics left behind by exited processes\n");
+}
+
+int main(int argc, char **argv)
+{
+	double interval = 1.0, start, elapsed;
+	int pid = 0, count = 0, batch = 0, instances = 0, remove = 0;
+	int op, i, iter;
+
+	while ((op = getopt(argc, argv, "p:d:n:birh")) != -1) {
+		switch (op) {
+		case 'p':
+			pid = atoi(optarg);
+			break;
+		case 'd':
+			interval = atof(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'b':
+			batch = 1;
+			break;
+		case 'i':
+			instances = 1;
+			break;
+		case 'r':
+			remove = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (!pid)
+		return list_segs(remove) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if (interval <= 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	scan_segs(pid);
+	if (!seg_cnt) {
+		fprintf(stderr, "no metrics found for pid %d\n", pid);
+		return EXIT_FAILURE;
+	}
+
+	sample(instances);
+	start = now();
+	display(pid, interval, batch, 1);
+	for (iter = 1; !count || iter < count; iter++) {
+		usleep((useconds_t) (interval * 1000000));
+		if (!pid_alive(pid)) {
+			printf("pid %d exited\n", pid);
+			break;
+		}
+
+		scan_segs(pid);
+		sample(instances);
+		elapsed = now() - start;
+		start += elapsed;
+		display(pid, elapsed, batch, 0);
+	}
+
+	for (i = 0; i < seg_cnt; i++) {
+		munmap((void *) segs[i].hdr, segs[i].size);
+		free(segs[i].gen);
+		free(segs[i].value);
+	}
+	free(rows);
+	return EXIT_SUCCESS;
+}
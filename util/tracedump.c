@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2024 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <rdma/fi_errno.h>
+#include <ofi_trace.h>
+
+#define HASH_SIZE	4096
+
+struct event {
+	double				ns;
+	size_t				seq;
+	const struct ofi_trace_hdr	*hdr;
+	struct ofi_trace_rec		rec;
+};
+
+/* operations posted with a context that have not completed yet */
+struct pending {
+	struct pending	*next;
+	uint32_t	pid;
+	uint64_t	context;
+	uint16_t	op;
+};
+
+static struct event *events;
+static size_t event_cnt, event_size;
+static struct ofi_trace_hdr **hdrs;
+static size_t hdr_cnt;
+static struct pending *pending[HASH_SIZE];
+
+static double tsc_to_ns(const struct ofi_trace_hdr *hdr, uint64_t ts)
+{
+	double rate;
+
+	if (hdr->clock != OFI_TRACE_CLOCK_TSC)
+		return (double) ts;
+
+	if (hdr->sync_tsc[1] > hdr->sync_tsc[0])
+		rate = (double) (hdr->sync_ns[1] - hdr->sync_ns[0]) /
+		       (double) (hdr->sync_tsc[1] - hdr->sync_tsc[0]);
+	else
+		rate = (double) hdr->tsc_mult / (double) (1ULL << 32);
+
+	return (double) hdr->sync_ns[0] +
+	       ((double) ts - (double) hdr->sync_tsc[0]) * rate;
+}
+
+static int load_file(const char *path)
+{
+	struct ofi_trace_hdr *hdr, **tmp_hdrs;
+	struct ofi_trace_rec *recs;
+	struct event *tmp;
+	uint64_t head, cnt, i;
+	FILE *file;
+	long size;
+
+	file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "%s: unable to open\n", path);
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	rewind(file);
+	if (size < (long) sizeof(*hdr))
+		goto bad;
+
+	hdr = malloc(size);
+	if (!hdr || fread(hdr, 1, size, file) != (size_t) size) {
+		free(hdr);
+		goto bad;
+	}
+	fclose(file);
+
+	if (hdr->magic != OFI_TRACE_MAGIC ||
+	    hdr->version != OFI_TRACE_VERSION ||
+	    hdr->rec_size != sizeof(struct ofi_trace_rec) ||
+	    !hdr->capacity || (hdr->capacity & (hdr->capacity - 1)) ||
+	    sizeof(*hdr) + hdr->capacity * hdr->rec_size > (size_t) size) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		goto err;
+	}
+
+	tmp_hdrs = realloc(hdrs, (hdr_cnt + 1) * sizeof(*hdrs));
+	if (!tmp_hdrs)
+		goto err;
+	hdrs = tmp_hdrs;
+	hdrs[hdr_cnt++] = hdr;
+
+	recs = (struct ofi_trace_rec *) (hdr + 1);
+	head = hdr->head;
+	cnt = MIN(head, hdr->capacity);
+	if (head > hdr->capacity)
+		fprintf(stderr, "%s: ring wrapped, oldest %" PRIu64
+			" of %" PRIu64 " records lost\n", path,
+			head - cnt, head);
+
+	if (event_cnt + cnt > event_size) {
+		event_size = MAX(event_size * 2, event_cnt + cnt);
+		tmp = realloc(events, event_size * sizeof(*events));
+		if (!tmp)
+			return -1;
+		events = tmp;
+	}
+
+	for (i = head - cnt; i < head; i++) {
+		events[event_cnt].rec = recs[i & (hdr->capacity - 1)];
+		events[event_cnt].hdr = hdr;
+		events[event_cnt].ns = tsc_to_ns(hdr, events[event_cnt].rec.ts);
+		events[event_cnt].seq = event_cnt;
+		event_cnt++;
+	}
+	return 0;
+
+err:
+	free(hdr);
+	return -1;
+
+bad:
+	fprintf(stderr, "%s: unable to read\n", path);
+	fclose(file);
+	return -1;
+}
+
+static int load_path(const char *path)
+{
+	char file[PATH_MAX];
+	struct dirent *dent;
+	struct stat st;
+	DIR *dir;
+	int ret = 0;
+
+	if (stat(path, &st)) {
+		fprintf(stderr, "%s: not found\n", path);
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode))
+		return load_file(path);
+
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+
+	while ((dent = readdir(dir))) {
+		if (strncmp(dent->d_name, "fi_trace.", 9))
+			continue;
+		snprintf(file, sizeof(file), "%s/%s", path, dent->d_name);
+		ret |= load_file(file);
+	}
+	closedir(dir);
+	return ret;
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+	const struct event *x = a, *y = b;
+
+	if (x->ns != y->ns)
+		return x->ns < y->ns ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int is_inject(uint16_t op)
+{
+	return op == OFI_TRACE_INJECT || op == OFI_TRACE_INJECTDATA ||
+	       op == OFI_TRACE_INJECT_WRITE ||
+	       op == OFI_TRACE_INJECT_WRITEDATA ||
+	       op == OFI_TRACE_TINJECT || op == OFI_TRACE_TINJECTDATA;
+}
+
+static struct pending **pending_find(uint32_t pid, uint64_t context)
+{
+	struct pending **p;
+
+	p = &pending[(context ^ (context >> 12) ^ pid) % HASH_SIZE];
+	while (*p && ((*p)->pid != pid || (*p)->context != context))
+		p = &(*p)->next;
+	return p;
+}
+
+static void print_text(FILE *out, double start)
+{
+	const struct ofi_trace_rec *rec;
+	size_t i;
+
+	for (i = 0; i < event_cnt; i++) {
+		rec = &events[i].rec;
+		fprintf(out, "%14.3f %u/%u %-16s fid 0x%" PRIx64
+			" ctx 0x%" PRIx64 " len %" PRIu64,
+			(events[i].ns - start) / 1000, events[i].hdr->pid,
+			events[i].hdr->tid, ofi_trace_op_str(rec->op),
+			rec->fid, rec->context, rec->len);
+		if (rec->addr != FI_ADDR_NOTAVAIL)
+			fprintf(out, " addr %" PRIu64, rec->addr);
+		fprintf(out, " tag 0x%" PRIx64 " flags 0x%" PRIx64,
+			rec->tag, rec->flags);
+		if (rec->count)
+			fprintf(out, " count %u", rec->count);
+		if (rec->ret)
+			fprintf(out, " ret %d (%s)", rec->ret,
+				fi_strerror(-rec->ret));
+		fprintf(out, "\n");
+	}
+}
+
+static void print_args(FILE *out, const struct ofi_trace_rec *rec)
+{
+	fprintf(out, ", \"args\": {\"fid\": \"0x%" PRIx64 "\", "
+		"\"ctx\": \"0x%" PRIx64 "\", \"len\": %" PRIu64 ", "
+		"\"tag\": \"0x%" PRIx64 "\", \"flags\": \"0x%" PRIx64 "\", "
+		"\"ret\": %d}}", rec->fid, rec->context, rec->len,
+		rec->tag, rec->flags, rec->ret);
+}
+
+/*
+ * Chrome trace event format, loadable by chrome://tracing and Perfetto.
+ * A transfer posted with a context becomes an async span that ends at
+ * its first completion; everything else is an instant event.
+ */
+static void print_chrome(FILE *out, double start)
+{
+	const struct ofi_trace_rec *rec;
+	struct pending **p, *entry;
+	const char *name;
+	const char *sep = "";
+	uint32_t pid, tid;
+	double ts;
+	size_t i;
+
+	fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	for (i = 0; i < event_cnt; i++) {
+		rec = &events[i].rec;
+		pid = events[i].hdr->pid;
+		tid = events[i].hdr->tid;
+		ts = (events[i].ns - start) / 1000;
+		name = ofi_trace_op_str(rec->op);
+
+		if (rec->op < OFI_TRACE_CQ_ENTRY && !rec->ret &&
+		    rec->context && !is_inject(rec->op)) {
+			p = pending_find(pid, rec->context);
+			if (!*p) {
+				*p = calloc(1, sizeof(**p));
+				if (!*p)
+					goto instant;
+				(*p)->pid = pid;
+				(*p)->context = rec->context;
+			}
+			(*p)->op = rec->op;
+			fprintf(out, "%s\n{\"name\": \"%s\", \"cat\": \"op\", "
+				"\"ph\": \"b\", \"id\": \"0x%" PRIx64 "\", "
+				"\"pid\": %u, \"tid\": %u, \"ts\": %.3f",
+				sep, name, rec->context, pid, tid, ts);
+			print_args(out, rec);
+			sep = ",";
+			continue;
+		}
+
+		if (rec->op >= OFI_TRACE_CQ_ENTRY) {
+			p = pending_find(pid, rec->context);
+			if (*p) {
+				entry = *p;
+				fprintf(out, "%s\n{\"name\": \"%s\", "
+					"\"cat\": \"op\", \"ph\": \"e\", "
+					"\"id\": \"0x%" PRIx64 "\", "
+					"\"pid\": %u, \"tid\": %u, "
+					"\"ts\": %.3f", sep,
+					ofi_trace_op_str(entry->op),
+					rec->context, pid, tid, ts);
+				print_args(out, rec);
+				sep = ",";
+				*p = entry->next;
+				free(entry);
+				if (rec->op == OFI_TRACE_CQ_ENTRY)
+					continue;
+			}
+		}
+instant:
+		fprintf(out, "%s\n{\"name\": \"%s\", \"cat\": \"%s\", "
+			"\"ph\": \"i\", \"s\": \"t\", \"pid\": %u, "
+			"\"tid\": %u, \"ts\": %.3f", sep, name,
+			rec->op >= OFI_TRACE_CQ_ENTRY ? "cq" : "op",
+			pid, tid, ts);
+		print_args(out, rec);
+		sep = ",";
+	}
+	fprintf(out, "\n]}\n");
+
+	for (i = 0; i < HASH_SIZE; i++) {
+		while (pending[i]) {
+			entry = pending[i];
+			pending[i] = entry->next;
+			free(entry);
+		}
+	}
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS] PATH...\n", argv0);
+	printf("\n");
+	printf("Converts binary trace files written by the ofi_hook_trace\n");
+	printf("provider to text.  A PATH that is a directory is searched\n");
+	printf("for fi_trace.* files.  Events from all files are merged\n");
+	printf("in time order.\n");
+	printf("\n");
+	printf("  -c\t\twrite Chrome trace event JSON instead of text\n");
+	printf("  -o <file>\twrite output to file (default stdout)\n");
+}
+
+int main(int argc, char **argv)
+{
+	FILE *out = stdout;
+	char *file = NULL;
+	int chrome = 0, op, ret = 0;
+	size_t i;
+
+	while ((op = getopt(argc, argv, "co:h")) != -1) {
+		switch (op) {
+		case 'c':
+			chrome = 1;
+			break;
+		case 'o':
+			file = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (optind == argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (; optind < argc; optind++)
+		ret |= load_path(argv[optind]);
+
+	if (file) {
+		out = fopen(file, "w");
+		if (!out) {
+			fprintf(stderr, "%s: unable to create\n", file);
+			return EXIT_FAILURE;
+		}
+	}
+
+	qsort(events, event_cnt, sizeof(*events), event_cmp);
+	if (chrome)
+		print_chrome(out, event_cnt ? events[0].ns : 0);
+	else
+		print_text(out, event_cnt ? events[0].ns : 0);
+
+	if (out != stdout)
+		fclose(out);
+
+	for (i = 0; i < hdr_cnt; i++)
+		free(hdrs[i]);
+	free(hdrs);
+	free(events);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}